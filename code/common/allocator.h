@@ -0,0 +1,192 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+// Backing memory for containers, see DynamicArray.
+// A NULL allocator means malloc/realloc/free.
+// Reallocate(a, NULL, 0, size) allocates, Reallocate(a, p, size, 0) frees.
+// Allocations are aligned to ARENA_ALIGNMENT.
+struct Allocator
+{
+    void* (*Reallocate)(Allocator* allocator, void* ptr, size_t oldSize, size_t newSize);
+};
+
+// Bump allocation in a MemoryArena.
+// The block at the top of the arena grows and shrinks in place,
+// everything else is only reclaimed when the arena is reset.
+struct ArenaAllocator
+{
+    Allocator base;
+    MemoryArena* arena;
+};
+
+#define POOL_MIN_BLOCK_SHIFT 4 // 16 bytes
+#define POOL_NUM_SIZE_CLASSES 24 // up to 128 MB
+
+// Power-of-two size classes carved out of a MemoryArena.
+// Freed blocks go to a free list and are handed out again to the next allocation of the same class,
+// which suits lots of small arrays that come and go (smoothing groups, per-group lists).
+struct PoolAllocator
+{
+    Allocator base;
+    MemoryArena* arena;
+    void* freeLists[POOL_NUM_SIZE_CLASSES];
+};
+
+inline void* HeapReallocate(void* ptr, size_t newSize)
+{
+    if (newSize == 0)
+    {
+        free(ptr);
+        return NULL;
+    }
+
+    void* result = realloc(ptr, newSize);
+    if (result == NULL)
+    {
+        Sys_FatalError("Failed to allocate %s", FormatBytes(newSize));
+    }
+
+    return result;
+}
+
+inline void* Reallocate(Allocator* allocator, void* ptr, size_t oldSize, size_t newSize)
+{
+    if (allocator == NULL)
+    {
+        return HeapReallocate(ptr, newSize);
+    }
+
+    return allocator->Reallocate(allocator, ptr, oldSize, newSize);
+}
+
+inline void* ArenaReallocate(Allocator* allocator, void* ptr, size_t oldSize, size_t newSize)
+{
+    MemoryArena* arena = ((ArenaAllocator*)allocator)->arena;
+    const size_t offset = (u8*)ptr - arena->base_ptr;
+    const bool isTop = ptr != NULL && offset + oldSize == arena->mem_used;
+    if (isTop && newSize <= oldSize)
+    {
+        arena->mem_used = offset + newSize;
+        return newSize > 0 ? ptr : NULL;
+    }
+
+    if (isTop)
+    {
+        PushSize(arena, newSize - oldSize);
+        return ptr;
+    }
+
+    if (newSize == 0)
+    {
+        return NULL;
+    }
+
+    AlignArena(arena, ARENA_ALIGNMENT);
+    void* result = PushSize(arena, newSize);
+    if (ptr != NULL)
+    {
+        memcpy(result, ptr, MIN(oldSize, newSize));
+    }
+
+    return result;
+}
+
+inline void InitArenaAllocator(ArenaAllocator* allocator, MemoryArena* arena)
+{
+    allocator->base.Reallocate = &ArenaReallocate;
+    allocator->arena = arena;
+}
+
+inline u32 GetPoolSizeClass(size_t size)
+{
+    u32 sizeClass = 0;
+    while (((size_t)1 << (sizeClass + POOL_MIN_BLOCK_SHIFT)) < size)
+    {
+        sizeClass++;
+    }
+
+    return sizeClass;
+}
+
+inline void* PoolReallocate(Allocator* allocator, void* ptr, size_t oldSize, size_t newSize)
+{
+    PoolAllocator* pool = (PoolAllocator*)allocator;
+    const u32 oldClass = GetPoolSizeClass(oldSize);
+    const u32 newClass = GetPoolSizeClass(newSize);
+    if (ptr != NULL && newSize > 0 && oldClass == newClass)
+    {
+        return ptr;
+    }
+
+    void* result = NULL;
+    if (newSize > 0)
+    {
+        if (newClass >= POOL_NUM_SIZE_CLASSES)
+        {
+            Sys_FatalError("PoolReallocate: %s is too large for a pool", FormatBytes(newSize));
+        }
+
+        if (pool->freeLists[newClass] != NULL)
+        {
+            result = pool->freeLists[newClass];
+            pool->freeLists[newClass] = *(void**)result;
+        }
+        else
+        {
+            AlignArena(pool->arena, ARENA_ALIGNMENT);
+            result = PushSize(pool->arena, (size_t)1 << (newClass + POOL_MIN_BLOCK_SHIFT));
+        }
+    }
+
+    if (ptr != NULL)
+    {
+        if (result != NULL)
+        {
+            memcpy(result, ptr, MIN(oldSize, newSize));
+        }
+        *(void**)ptr = pool->freeLists[oldClass];
+        pool->freeLists[oldClass] = ptr;
+    }
+
+    return result;
+}
+
+inline void InitPoolAllocator(PoolAllocator* allocator, MemoryArena* arena)
+{
+    memset(allocator, 0, sizeof(PoolAllocator));
+    allocator->base.Reallocate = &PoolReallocate;
+    allocator->arena = arena;
+}
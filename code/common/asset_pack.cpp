@@ -0,0 +1,381 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "asset_pack.h"
+
+namespace
+{
+struct Local
+{
+    MappedFile file;
+    const AssetPackHeader* header;
+    const AssetPackEntry* entries;
+    const char* strings;
+    u64 bytesRead;
+};
+}
+
+static Local local;
+
+bool Asset_MountPack(const char* filePath)
+{
+    assert(local.header == NULL);
+
+    if (!Sys_MapFile(&local.file, filePath))
+    {
+        return false;
+    }
+
+    // the pack is a build artifact, so a broken one is an error rather than a reason to fall back
+    const u8* base = (const u8*)local.file.data;
+    const u64 fileSize = local.file.size;
+    const AssetPackHeader* header = (const AssetPackHeader*)base;
+    if (fileSize < sizeof(AssetPackHeader) || header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION)
+    {
+        Sys_FatalError("%s is not a valid asset pack, re-run AssetPacker.", filePath);
+    }
+
+    const u64 tocSize = (u64)header->numEntries * sizeof(AssetPackEntry);
+    if (header->tocOffset > fileSize || tocSize > fileSize - header->tocOffset ||
+        header->stringsOffset > fileSize || header->numStringBytes > fileSize - header->stringsOffset ||
+        header->numStringBytes == 0 || base[header->stringsOffset + header->numStringBytes - 1] != '\0')
+    {
+        Sys_FatalError("%s: corrupt table of contents", filePath);
+    }
+
+    const AssetPackEntry* entries = (const AssetPackEntry*)(base + header->tocOffset);
+    for (u32 i = 0; i < header->numEntries; ++i)
+    {
+        const AssetPackEntry* entry = &entries[i];
+        if (entry->offset > fileSize || entry->size > fileSize - entry->offset ||
+            entry->pathOffset >= header->numStringBytes || entry->compression >= AssetCompression::Count)
+        {
+            Sys_FatalError("%s: corrupt entry %u", filePath, i);
+        }
+    }
+
+    local.header = header;
+    local.entries = entries;
+    local.strings = (const char*)(base + header->stringsOffset);
+
+    return true;
+}
+
+void Asset_UnmountPack()
+{
+    Sys_UnmapFile(&local.file);
+    local.header = NULL;
+    local.entries = NULL;
+    local.strings = NULL;
+}
+
+bool Asset_IsPackMounted()
+{
+    return local.header != NULL;
+}
+
+static const AssetPackEntry* FindEntry(const char* path)
+{
+    char normalized[MAX_PATH];
+    strncpy(normalized, path, sizeof(normalized) - 1);
+    normalized[sizeof(normalized) - 1] = '\0';
+    for (char* c = normalized; *c != '\0'; ++c)
+    {
+        *c = *c == '\\' ? '/' : *c;
+    }
+
+    // the table of contents is sorted by path
+    u32 first = 0;
+    u32 last = local.header->numEntries;
+    while (first < last)
+    {
+        const u32 middle = first + (last - first) / 2;
+        const s32 order = strcmp(local.strings + local.entries[middle].pathOffset, normalized);
+        if (order == 0)
+        {
+            return &local.entries[middle];
+        }
+
+        if (order < 0)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return NULL;
+}
+
+bool Asset_Open(AssetFile* file, const char* path)
+{
+    memset(file, 0, sizeof(AssetFile));
+
+    const AssetPackEntry* entry = local.header != NULL ? FindEntry(path) : NULL;
+    if (entry != NULL)
+    {
+        const u8* data = (const u8*)local.file.data + entry->offset;
+        if (entry->compression == AssetCompression::None)
+        {
+            file->data = data;
+            file->size = entry->size;
+            return true;
+        }
+
+        void* allocation = malloc(entry->uncompressedSize);
+        if (allocation == NULL)
+        {
+            Sys_FatalError("Asset_Open: failed to allocate %s for %s", FormatBytes(entry->uncompressedSize), path);
+        }
+        if (!Asset_DecompressLZ(allocation, entry->uncompressedSize, data, entry->size))
+        {
+            Sys_FatalError("Asset_Open: %s is corrupt in the asset pack", path);
+        }
+        assert(Asset_HashContent(allocation, entry->uncompressedSize) == entry->contentHash);
+
+        file->data = allocation;
+        file->size = entry->uncompressedSize;
+        file->allocation = allocation;
+        return true;
+    }
+
+    // files that aren't in the pack can still be loaded from disk, which is handy while editing assets
+    void* data;
+    size_t size;
+    if (!Sys_ReadDataFromFile(&data, &size, fmt("%s/%s", ASSET_DIR, path)))
+    {
+        return false;
+    }
+
+    file->data = data;
+    file->size = size;
+    file->allocation = data;
+    local.bytesRead += size;
+
+    return true;
+}
+
+void Asset_Close(AssetFile* file)
+{
+    free(file->allocation);
+    memset(file, 0, sizeof(AssetFile));
+}
+
+bool Asset_OpenStream(AssetStream* stream, const char* path)
+{
+    memset(stream, 0, sizeof(AssetStream));
+
+    // pack entries are already in memory, compressed ones have to be decompressed as a whole
+    if (local.header != NULL && FindEntry(path) != NULL)
+    {
+        AssetFile file;
+        Asset_Open(&file, path);
+        stream->data = (const u8*)file.data;
+        stream->size = file.size;
+        stream->allocation = file.allocation;
+        return true;
+    }
+
+    stream->file = Sys_OpenFileForReading(fmt("%s/%s", ASSET_DIR, path), &stream->size);
+    return stream->file != NULL;
+}
+
+void Asset_CloseStream(AssetStream* stream)
+{
+    Sys_CloseFile(stream->file);
+    free(stream->allocation);
+    memset(stream, 0, sizeof(AssetStream));
+}
+
+const void* Asset_ReadRange(AssetStream* stream, u64 offset, u64 size, void* scratch)
+{
+    if (offset > stream->size || size > stream->size - offset)
+    {
+        return NULL;
+    }
+
+    if (stream->data != NULL)
+    {
+        return stream->data + offset;
+    }
+
+    if (!Sys_ReadFileAt(stream->file, scratch, offset, size))
+    {
+        return NULL;
+    }
+    local.bytesRead += size;
+
+    return scratch;
+}
+
+u64 Asset_GetBytesRead()
+{
+    return local.bytesRead;
+}
+
+u32 Asset_FindFiles(char (*paths)[MAX_PATH], u32 maxPaths, const char* dir, const char* extension)
+{
+    u32 numPaths = 0;
+    if (local.header != NULL)
+    {
+        const size_t dirLength = strlen(dir);
+        const size_t extensionLength = strlen(extension);
+        for (u32 i = 0; i < local.header->numEntries && numPaths < maxPaths; ++i)
+        {
+            const char* path = local.strings + local.entries[i].pathOffset;
+            const size_t length = strlen(path);
+            if (length <= dirLength + 1 + extensionLength || strncmp(path, dir, dirLength) != 0 || path[dirLength] != '/')
+            {
+                continue;
+            }
+
+            // no sub-directories
+            if (strchr(path + dirLength + 1, '/') != NULL || strcmp(path + length - extensionLength, extension) != 0)
+            {
+                continue;
+            }
+
+            strcpy(paths[numPaths++], path);
+        }
+
+        return numPaths;
+    }
+
+    const char* fileName;
+    FolderScan* fs = Sys_FolderScan_Begin(fmt("%s/%s", ASSET_DIR, dir), fmt("*%s", extension));
+    while (numPaths < maxPaths && Sys_FolderScan_Next(&fileName, NULL, fs))
+    {
+        PathCombine(paths[numPaths++], dir, fileName);
+    }
+    Sys_FolderScan_End(fs);
+
+    return numPaths;
+}
+
+u64 Asset_HashContent(const void* data, u64 size)
+{
+    // FNV-1a
+    const u8* bytes = (const u8*)data;
+    u64 hash = 14695981039346656037ull;
+    for (u64 i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static bool ReadLength(const u8** input, const u8* end, u64* length)
+{
+    u8 byte;
+    do
+    {
+        if (*input == end)
+        {
+            return false;
+        }
+        byte = *(*input)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+// The stream is a list of sequences:
+// token (literal count << 4 | (match length - ASSET_LZ_MIN_MATCH)), 15 in a nibble means that length bytes follow
+// [literal length bytes] literals offset (u16) [match length bytes]
+// The last sequence stops after its literals.
+bool Asset_DecompressLZ(void* output, u64 outputSize, const void* input, u64 inputSize)
+{
+    const u8* in = (const u8*)input;
+    const u8* const inEnd = in + inputSize;
+    u8* out = (u8*)output;
+    u8* const outStart = out;
+    u8* const outEnd = out + outputSize;
+
+    while (in < inEnd)
+    {
+        const u32 token = *in++;
+
+        u64 numLiterals = token >> 4;
+        if (numLiterals == 15 && !ReadLength(&in, inEnd, &numLiterals))
+        {
+            return false;
+        }
+        if ((u64)(inEnd - in) < numLiterals || (u64)(outEnd - out) < numLiterals)
+        {
+            return false;
+        }
+        memcpy(out, in, numLiterals);
+        in += numLiterals;
+        out += numLiterals;
+
+        if (in == inEnd)
+        {
+            break;
+        }
+
+        if (inEnd - in < 2)
+        {
+            return false;
+        }
+        const u32 offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        u64 matchLength = token & 15;
+        if (matchLength == 15 && !ReadLength(&in, inEnd, &matchLength))
+        {
+            return false;
+        }
+        matchLength += ASSET_LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > (u64)(out - outStart) || (u64)(outEnd - out) < matchLength)
+        {
+            return false;
+        }
+
+        // byte by byte, overlapping matches repeat the last offset bytes
+        const u8* match = out - offset;
+        for (u64 i = 0; i < matchLength; ++i)
+        {
+            out[i] = match[i];
+        }
+        out += matchLength;
+    }
+
+    return out == outEnd;
+}
@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "shared.h"
+
+// Asset pack layout:
+// AssetPackHeader | entry data, each aligned | AssetPackEntry[numEntries] sorted by path | path strings
+// Paths are relative to ASSET_DIR and use '/' separators, e.g. "Sponza/textures/lion_diff.dds".
+
+#define ASSET_DIR "../bachelor/assets"
+#define ASSET_PACK_PATH "../bachelor/assets.pak"
+#define ASSET_PACK_MAGIC 0x4B415042 // "BPAK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_LZ_MIN_MATCH 4
+
+struct AssetCompression
+{
+    enum Type
+    {
+        None,
+        LZ, // LZ77 byte stream, see Asset_DecompressLZ
+        Count
+    };
+};
+
+#pragma pack(push, 1)
+struct AssetPackHeader
+{
+    u32 magic;
+    u32 version;
+    u32 numEntries;
+    u32 numStringBytes;
+    u64 tocOffset;
+    u64 stringsOffset;
+};
+
+struct AssetPackEntry
+{
+    u32 pathOffset; // into the string block
+    u32 compression;
+    u64 offset;
+    u64 size; // stored size
+    u64 uncompressedSize;
+    u64 contentHash; // of the uncompressed data
+};
+#pragma pack(pop)
+
+// The bytes of one asset, either straight from the mounted pack or from a loose file.
+struct AssetFile
+{
+    const void* data;
+    u64 size;
+    void* allocation; // NULL when data points into the pack
+};
+
+// Random access to an asset without loading all of it.
+struct AssetStream
+{
+    const u8* data; // the whole asset when it's in memory (pack entry), NULL otherwise
+    void* file; // loose file, read with positional reads
+    void* allocation; // decompressed pack entry
+    u64 size;
+};
+
+// Maps the pack, all later opens are resolved through its table of contents.
+// Returns false and keeps using loose files when the pack doesn't exist.
+bool Asset_MountPack(const char* filePath);
+void Asset_UnmountPack();
+bool Asset_IsPackMounted();
+
+// path is relative to ASSET_DIR
+bool Asset_Open(AssetFile* file, const char* path);
+void Asset_Close(AssetFile* file);
+
+bool Asset_OpenStream(AssetStream* stream, const char* path);
+void Asset_CloseStream(AssetStream* stream);
+// Returns the bytes [offset; offset + size[ of the asset, pointing into memory when possible
+// and read into scratch otherwise. Returns NULL when the range is invalid or the read failed.
+const void* Asset_ReadRange(AssetStream* stream, u64 offset, u64 size, void* scratch);
+// bytes read from loose files so far
+u64 Asset_GetBytesRead();
+
+// Lists the files of the directory with the given extension (".scene"), paths are relative to ASSET_DIR.
+u32 Asset_FindFiles(char (*paths)[MAX_PATH], u32 maxPaths, const char* dir, const char* extension);
+
+u64 Asset_HashContent(const void* data, u64 size);
+bool Asset_DecompressLZ(void* output, u64 outputSize, const void* input, u64 inputSize);
@@ -0,0 +1,300 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "async_io.h"
+
+#define IO_SPIN_COUNT 64 // polls before a waiting thread yields
+
+namespace
+{
+struct Local
+{
+    u32 numThreads; // 0 when not initialized
+    Thread* threads[IO_MAX_THREADS];
+    Semaphore* wakeUp;
+    volatile s32 quit;
+
+    Mutex lock; // guards the submission queue
+    IoRequest* first;
+    IoRequest* last;
+
+    volatile s64 bytesRead;
+};
+}
+
+static Local local;
+
+static void ReadRequest(IoRequest* request)
+{
+    const bool success = request->file != NULL && Sys_ReadFileAt(request->file, request->buffer, request->offset, request->size);
+    if (success)
+    {
+        AtomicAdd64(&local.bytesRead, (s64)request->size);
+    }
+
+    // the request belongs to the caller again once the status is written, it's the last thing we touch
+    IoQueue* const queue = request->queue;
+    JobCounter* const counter = request->counter;
+    if (queue != NULL)
+    {
+        Sys_LockMutex(&queue->lock);
+        request->next = NULL;
+        if (queue->last != NULL)
+        {
+            queue->last->next = request;
+        }
+        else
+        {
+            queue->first = request;
+        }
+        queue->last = request;
+        AtomicStore32(&request->status, success ? IoStatus::Done : IoStatus::Failed);
+        Sys_UnlockMutex(&queue->lock);
+    }
+    else
+    {
+        AtomicStore32(&request->status, success ? IoStatus::Done : IoStatus::Failed);
+    }
+
+    if (counter != NULL)
+    {
+        Job_DecrementCounter(counter);
+    }
+}
+
+static void IoThreadMain(void* userData)
+{
+    for (;;)
+    {
+        Sys_WaitSemaphore(local.wakeUp);
+
+        // every signal stands for one request, the batch consumes the signals of the extra requests
+        IoRequest* batch[IO_BATCH_SIZE];
+        u32 numRequests = 0;
+        Sys_LockMutex(&local.lock);
+        while (local.first != NULL && numRequests < IO_BATCH_SIZE && (numRequests == 0 || Sys_TryWaitSemaphore(local.wakeUp)))
+        {
+            batch[numRequests++] = local.first;
+            local.first = local.first->next;
+        }
+        if (local.first == NULL)
+        {
+            local.last = NULL;
+        }
+        Sys_UnlockMutex(&local.lock);
+
+        if (numRequests == 0)
+        {
+            if (AtomicLoad32(&local.quit) != 0)
+            {
+                return;
+            }
+            continue;
+        }
+
+        for (u32 i = 0; i < numRequests; ++i)
+        {
+            ReadRequest(batch[i]);
+        }
+    }
+}
+
+void Io_Init(u32 numThreads)
+{
+    assert(local.numThreads == 0);
+    if (numThreads == 0)
+    {
+        numThreads = IO_DEFAULT_THREADS;
+    }
+
+    local.numThreads = MIN(numThreads, IO_MAX_THREADS);
+    local.wakeUp = Sys_CreateSemaphore(0);
+    local.quit = 0;
+    local.first = NULL;
+    local.last = NULL;
+    for (u32 i = 0; i < local.numThreads; ++i)
+    {
+        local.threads[i] = Sys_CreateThread(&IoThreadMain, NULL);
+    }
+}
+
+void Io_Shutdown()
+{
+    if (local.numThreads == 0)
+    {
+        return;
+    }
+
+    // the threads only quit once the submission queue is empty
+    AtomicStore32(&local.quit, 1);
+    Sys_SignalSemaphore(local.wakeUp, local.numThreads);
+    for (u32 i = 0; i < local.numThreads; ++i)
+    {
+        Sys_JoinThread(local.threads[i]);
+    }
+
+    Sys_DestroySemaphore(local.wakeUp);
+    local.numThreads = 0;
+}
+
+void Io_Submit(IoQueue* queue, IoRequest* requests, u32 count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        IoRequest* request = &requests[i];
+        request->status = IoStatus::Pending;
+        request->queue = queue;
+        request->next = i + 1 < count ? &requests[i + 1] : NULL;
+        if (request->counter != NULL)
+        {
+            Job_IncrementCounter(request->counter, 1);
+        }
+    }
+
+    if (queue != NULL)
+    {
+        AtomicAdd32(&queue->numPending, (s32)count);
+    }
+
+    if (local.numThreads == 0)
+    {
+        for (u32 i = 0; i < count; ++i)
+        {
+            ReadRequest(&requests[i]);
+        }
+        return;
+    }
+
+    // the whole batch is linked already, appending it takes the lock once
+    Sys_LockMutex(&local.lock);
+    if (local.last != NULL)
+    {
+        local.last->next = &requests[0];
+    }
+    else
+    {
+        local.first = &requests[0];
+    }
+    local.last = &requests[count - 1];
+    Sys_UnlockMutex(&local.lock);
+
+    Sys_SignalSemaphore(local.wakeUp, count);
+}
+
+IoRequest* Io_PollCompletion(IoQueue* queue)
+{
+    if (AtomicLoad32(&queue->numPending) == 0)
+    {
+        return NULL;
+    }
+
+    Sys_LockMutex(&queue->lock);
+    IoRequest* result = queue->first;
+    if (result != NULL)
+    {
+        queue->first = result->next;
+        if (queue->first == NULL)
+        {
+            queue->last = NULL;
+        }
+    }
+    Sys_UnlockMutex(&queue->lock);
+
+    if (result != NULL)
+    {
+        AtomicAdd32(&queue->numPending, -1);
+    }
+
+    return result;
+}
+
+IoRequest* Io_WaitCompletion(IoQueue* queue)
+{
+    u32 numPolls = 0;
+    while (AtomicLoad32(&queue->numPending) > 0)
+    {
+        IoRequest* result = Io_PollCompletion(queue);
+        if (result != NULL)
+        {
+            return result;
+        }
+
+        if (++numPolls < IO_SPIN_COUNT)
+        {
+            CpuPause();
+        }
+        else
+        {
+            Sys_YieldThread();
+        }
+    }
+
+    return NULL;
+}
+
+IoStatus::Type Io_Wait(IoRequest* request)
+{
+    u32 numPolls = 0;
+    s32 status;
+    while ((status = AtomicLoad32(&request->status)) == IoStatus::Pending)
+    {
+        if (++numPolls < IO_SPIN_COUNT)
+        {
+            CpuPause();
+        }
+        else
+        {
+            Sys_YieldThread();
+        }
+    }
+
+    // with a queue, the I/O thread releases the request when it unlocks the queue
+    if (request->queue != NULL)
+    {
+        Sys_LockMutex(&request->queue->lock);
+        Sys_UnlockMutex(&request->queue->lock);
+    }
+
+    return (IoStatus::Type)status;
+}
+
+u64 Io_GetBytesRead()
+{
+    return (u64)AtomicLoad64(&local.bytesRead);
+}
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "shared.h"
+#include "job_system.h"
+
+// Asynchronous file reads.
+//
+// Io_Submit appends requests to a submission queue that a few I/O threads serve with positional
+// reads, so the submitting thread can decode the data of earlier requests while later ones are read.
+// A completed request is appended to the completion list of its IoQueue, for Io_PollCompletion,
+// and decrements its JobCounter, so that jobs can wait on the data or be started with Job_RunAfter.
+//
+// Files are opened with Sys_OpenFileForReading, offsets and sizes are 64-bit.
+// Without Io_Init, Io_Submit reads the requests right away.
+
+#define IO_MAX_THREADS 8
+#define IO_DEFAULT_THREADS 2 // enough to keep an SSD busy with large reads
+#define IO_BATCH_SIZE 16 // requests an I/O thread takes from the submission queue at once
+
+struct IoStatus
+{
+    enum Type
+    {
+        Pending,
+        Done,
+        Failed,
+        Count
+    };
+};
+
+struct IoQueue;
+
+// Owned by the caller, it must stay alive and unchanged until it completed.
+struct IoRequest
+{
+    void* file;
+    u64 offset;
+    u64 size;
+    void* buffer; // at least size bytes
+    void* userData;
+    JobCounter* counter; // can be NULL
+
+    // written by the I/O system
+    volatile s32 status; // IoStatus::Type
+    IoQueue* queue;
+    IoRequest* next;
+};
+
+// Completion list, zero-initialized means empty.
+struct IoQueue
+{
+    Mutex lock;
+    IoRequest* first;
+    IoRequest* last;
+    volatile s32 numPending; // submitted and not polled yet
+};
+
+// 0 threads picks IO_DEFAULT_THREADS
+void Io_Init(u32 numThreads);
+// waits for the submitted requests
+void Io_Shutdown();
+
+// The requests complete in any order. queue can be NULL when the requests are waited on directly.
+void Io_Submit(IoQueue* queue, IoRequest* requests, u32 count);
+// returns a completed request, NULL if none completed since the last call
+IoRequest* Io_PollCompletion(IoQueue* queue);
+// returns a completed request, NULL once every request submitted to the queue was returned
+IoRequest* Io_WaitCompletion(IoQueue* queue);
+// returns the final status
+IoStatus::Type Io_Wait(IoRequest* request);
+
+// bytes read by the I/O system so far
+u64 Io_GetBytesRead();
@@ -0,0 +1,153 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <emmintrin.h> // _mm_pause, _mm_mfence
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Inline atomics for lock-free code.
+// Loads acquire, stores release and read-modify-writes are sequentially consistent.
+// Values must be naturally aligned.
+
+#if defined(_MSC_VER)
+
+// x64 loads and stores are acquire/release already, they only need to stay in place
+inline s32 AtomicLoad32(const volatile s32* value)
+{
+    const s32 result = *value;
+    _ReadWriteBarrier();
+    return result;
+}
+
+inline s64 AtomicLoad64(const volatile s64* value)
+{
+    const s64 result = *value;
+    _ReadWriteBarrier();
+    return result;
+}
+
+inline void AtomicStore32(volatile s32* value, s32 newValue)
+{
+    _ReadWriteBarrier();
+    *value = newValue;
+}
+
+inline void AtomicStore64(volatile s64* value, s64 newValue)
+{
+    _ReadWriteBarrier();
+    *value = newValue;
+}
+
+// returns the new value
+inline s32 AtomicAdd32(volatile s32* value, s32 amount)
+{
+    return (s32)_InterlockedExchangeAdd((volatile long*)value, (long)amount) + amount;
+}
+
+inline s64 AtomicAdd64(volatile s64* value, s64 amount)
+{
+    return _InterlockedExchangeAdd64((volatile __int64*)value, amount) + amount;
+}
+
+inline bool AtomicCompareExchange32(volatile s32* value, s32 expected, s32 desired)
+{
+    return _InterlockedCompareExchange((volatile long*)value, (long)desired, (long)expected) == (long)expected;
+}
+
+inline bool AtomicCompareExchange64(volatile s64* value, s64 expected, s64 desired)
+{
+    return _InterlockedCompareExchange64((volatile __int64*)value, desired, expected) == expected;
+}
+
+#else
+
+inline s32 AtomicLoad32(const volatile s32* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+inline s64 AtomicLoad64(const volatile s64* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+inline void AtomicStore32(volatile s32* value, s32 newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+inline void AtomicStore64(volatile s64* value, s64 newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+inline s32 AtomicAdd32(volatile s32* value, s32 amount)
+{
+    return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+}
+
+inline s64 AtomicAdd64(volatile s64* value, s64 amount)
+{
+    return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+}
+
+inline bool AtomicCompareExchange32(volatile s32* value, s32 expected, s32 desired)
+{
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+inline bool AtomicCompareExchange64(volatile s64* value, s64 expected, s64 desired)
+{
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#endif
+
+// orders earlier stores before later loads, which acquire/release doesn't
+inline void AtomicFence()
+{
+#if defined(_MSC_VER)
+    _mm_mfence();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+// for spin loops
+inline void CpuPause()
+{
+    _mm_pause();
+}
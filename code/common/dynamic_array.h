@@ -33,102 +33,272 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #pragma once
+#include <new> // placement new
 
+struct ArrayGrowth
+{
+    enum Type
+    {
+        Double, // amortized O(1) pushes
+        OneAndHalf, // less slack for large arrays
+        Exact, // for arrays that are sized once
+        Count
+    };
+};
+
+// Explicit move, DynamicArray can't be copied implicitly.
+template <typename T>
+inline T&& Move(T& value)
+{
+    return static_cast<T&&>(value);
+}
+
+// u64 storage instead of alignas, which vs2013 doesn't have
+template <typename T, u32 N>
+struct DynamicArrayInline
+{
+    static_assert(__alignof(T) <= sizeof(u64), "inline items need at most 8 byte alignment");
+    u64 items[(N * sizeof(T) + sizeof(u64) - 1) / sizeof(u64)];
+    T* GetInline() const { return (T*)items; }
+};
+
+// no storage at all when there's no inline buffer
 template <typename T>
-class DynamicArray
+struct DynamicArrayInline<T, 0>
+{
+    T* GetInline() const { return NULL; }
+};
+
+// Growable array with an optional allocator (heap by default) and an optional inline buffer of N items.
+// The first N items live in the array itself, b is only allocated once the array outgrows them.
+// Heap items are relocated with memcpy when the array grows, so they must not point into themselves.
+// Inline items are moved with T's move constructor when they leave the inline buffer.
+// An all-zero DynamicArray is a valid empty heap array, which is what arena-allocated structs get.
+template <typename T, u32 N = 0>
+class DynamicArray : private DynamicArrayInline<T, N>
 {
 private:
     T* b;
 
     size_t len;
-    size_t cap;
+    size_t cap; // of b
+    Allocator* allocator;
+    ArrayGrowth::Type growth;
+
+    T* Data() const
+    {
+        return N > 0 && b == NULL ? this->GetInline() : b;
+    }
+
+    // dest is uninitialized, source is left destroyed
+    static void MoveItems(T* dest, T* source, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            new (&dest[i]) T(Move(source[i]));
+            source[i].~T();
+        }
+    }
 
     void Realloc(size_t new_len, size_t elem_size)
     {
-        assert(cap <= (SIZE_MAX - 1) / 2);
-        size_t new_cap = CLAMP_MIN(2 * cap, MAX(new_len, 16));
-        assert(new_len <= new_cap);
-        size_t new_size = new_cap * elem_size;
-        T* new_b;
-        if (b)
+        const size_t old_cap = Capacity();
+        assert(old_cap <= (SIZE_MAX - 1) / 2);
+        size_t new_cap;
+        switch (growth)
         {
-            new_b = (T*)realloc(b, new_size);
+        case ArrayGrowth::OneAndHalf:
+            new_cap = MAX(old_cap + old_cap / 2, MAX(new_len, 16));
+            break;
+        case ArrayGrowth::Exact:
+            new_cap = new_len;
+            break;
+        default:
+            new_cap = CLAMP_MIN(2 * old_cap, MAX(new_len, 16));
+            break;
         }
-        else
+        assert(new_len <= new_cap);
+        T* new_b = (T*)Reallocate(allocator, b, cap * elem_size, new_cap * elem_size);
+        if (N > 0 && b == NULL)
         {
-            new_b = (T*)malloc(new_size);
-            len = 0;
+            MoveItems(new_b, this->GetInline(), len);
         }
         cap = new_cap;
         b = new_b;
     }
 
+    void Destroy(size_t first, size_t last)
+    {
+        T* items = Data();
+        for (size_t i = first; i < last; ++i)
+        {
+            items[i].~T();
+        }
+    }
+
+    // copies have to be explicit, see CopyFrom
+    DynamicArray(const DynamicArray<T, N>&);
+    void operator=(const DynamicArray<T, N>&);
+
 public:
     DynamicArray()
     {
         b = NULL;
         len = cap = 0;
+        allocator = NULL;
+        growth = ArrayGrowth::Double;
+    }
+    explicit DynamicArray(Allocator* a, ArrayGrowth::Type g = ArrayGrowth::Double)
+    {
+        b = NULL;
+        len = cap = 0;
+        allocator = a;
+        growth = g;
+    }
+    DynamicArray(DynamicArray<T, N>&& other)
+    {
+        b = NULL;
+        len = cap = 0;
+        allocator = NULL;
+        growth = ArrayGrowth::Double;
+        *this = Move(other);
     }
     ~DynamicArray()
     {
-        if (b)
+        Free();
+    }
+
+    DynamicArray<T, N>& operator=(DynamicArray<T, N>&& other)
+    {
+        if (this == &other)
+            return *this;
+
+        Free();
+        allocator = other.allocator;
+        growth = other.growth;
+        b = other.b;
+        len = other.len;
+        cap = other.cap;
+        if (N > 0 && b == NULL)
         {
-            free(b);
-            b = NULL;
-            len = cap = 0;
+            MoveItems(this->GetInline(), other.GetInline(), len);
         }
+        other.b = NULL;
+        other.len = other.cap = 0;
+
+        return *this;
+    }
+
+    // only while nothing is allocated
+    void SetAllocator(Allocator* a)
+    {
+        assert(b == NULL);
+        allocator = a;
+    }
+    void SetGrowth(ArrayGrowth::Type g)
+    {
+        assert((u32)g < ArrayGrowth::Count);
+        growth = g;
     }
 
     void Fit(size_t num);
     void Reserve(size_t num);
     void Fill(T value);
     u32 Push(T const& obj);
+    u32 Push(T&& obj);
+    void CopyFrom(const DynamicArray<T, N>& source);
+    void Free();
     size_t Length() { return len; }
-    size_t Capacity() { return cap; }
-    size_t UsedBytes() { return b ? len * sizeof(T) : 0; }
-    T* GetEnd() { return b + len; }
-    T* GetStart() { return b; }
+    size_t Capacity() const { return N > 0 && b == NULL ? N : cap; }
+    size_t UsedBytes() { return len * sizeof(T); }
+    T* GetEnd() { return Data() + len; }
+    T* GetStart() { return Data(); }
 
     void Clear()
     {
+        Destroy(0, len);
         len = 0;
     }
 
     T& operator[](u32 i)
     {
         assert(i < len);
-        return b[i];
+        return Data()[i];
     }
 };
 
-template <typename T>
-void DynamicArray<T>::Fit(size_t new_len)
+template <typename T, u32 N>
+void DynamicArray<T, N>::Fit(size_t new_len)
 {
-    if (new_len <= cap)
+    if (new_len <= Capacity())
         return;
     Realloc(new_len, sizeof(T));
 }
 
-template <typename T>
-void DynamicArray<T>::Fill(T value)
+template <typename T, u32 N>
+void DynamicArray<T, N>::Fill(T value)
 {
+    T* items = Data();
     for (u32 i = 0; i < len; ++i)
     {
-        b[i] = value;
+        items[i] = value;
     }
 }
 
-template <typename T>
-void DynamicArray<T>::Reserve(size_t new_len)
+// Resizes to new_len, new items are default-initialized (left uninitialized for plain structs).
+template <typename T, u32 N>
+void DynamicArray<T, N>::Reserve(size_t new_len)
 {
-    Realloc(new_len, sizeof(T));
+    Fit(new_len);
+    T* items = Data();
+    for (size_t i = len; i < new_len; ++i)
+    {
+        new (&items[i]) T;
+    }
+    Destroy(new_len, len);
     len = new_len;
 }
 
-template <typename T>
-u32 DynamicArray<T>::Push(T const& obj)
+template <typename T, u32 N>
+u32 DynamicArray<T, N>::Push(T const& obj)
 {
     Fit(1 + len);
-    b[len++] = obj;
+    new (&Data()[len++]) T(obj);
     return len;
-}
\ No newline at end of file
+}
+
+template <typename T, u32 N>
+u32 DynamicArray<T, N>::Push(T&& obj)
+{
+    Fit(1 + len);
+    new (&Data()[len++]) T(Move(obj));
+    return len;
+}
+
+template <typename T, u32 N>
+void DynamicArray<T, N>::CopyFrom(const DynamicArray<T, N>& source)
+{
+    assert(this != &source);
+    Clear();
+    Fit(source.len);
+    T* items = Data();
+    const T* sourceItems = source.Data();
+    for (size_t i = 0; i < source.len; ++i)
+    {
+        new (&items[i]) T(sourceItems[i]);
+    }
+    len = source.len;
+}
+
+// Clear and give the memory back to the allocator.
+template <typename T, u32 N>
+void DynamicArray<T, N>::Free()
+{
+    Destroy(0, len);
+    if (b != NULL)
+    {
+        Reallocate(allocator, b, cap * sizeof(T), 0);
+    }
+    b = NULL;
+    len = cap = 0;
+}
@@ -0,0 +1,372 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h> // _BitScanForward
+#endif
+
+// Open addressing hash map, laid out like a SwissTable:
+// one control byte per slot (empty, or 7 bits of the hash) stored apart from the key/value pairs,
+// so that a lookup tests 16 slots at a time with SSE2 before touching any key.
+// Probing is linear and deletion shifts the following items back, so there are no tombstones.
+// Keys and values are relocated with memcpy, they should be plain structs, numbers or pointers.
+// Strings can be used as keys with HashMapStringHash/HashMapStringEqual, the map doesn't copy them.
+
+#define HASH_MAP_GROUP_SIZE 16
+#define HASH_MAP_EMPTY 0x80
+#define HASH_MAP_MIN_CAPACITY 16
+
+// murmur3 finalizer, the low bits pick the slot so they have to be well mixed
+inline u32 HashMapMix(u64 key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ull;
+    key ^= key >> 33;
+    return (u32)key;
+}
+
+template <typename K>
+struct HashMapHash
+{
+    u32 operator()(const K& key) const
+    {
+        return HashMapMix((u64)key);
+    }
+};
+
+template <typename K>
+struct HashMapHash<K*>
+{
+    u32 operator()(K* key) const
+    {
+        return HashMapMix((u64)(uintptr_t)key);
+    }
+};
+
+template <typename K>
+struct HashMapEqual
+{
+    bool operator()(const K& a, const K& b) const
+    {
+        return a == b;
+    }
+};
+
+// FNV-1a
+struct HashMapStringHash
+{
+    u32 operator()(const char* key) const
+    {
+        u32 hash = 2166136261u;
+        while (*key != '\0')
+        {
+            hash = (hash ^ (u8)*key++) * 16777619u;
+        }
+        return HashMapMix(hash);
+    }
+};
+
+struct HashMapStringEqual
+{
+    bool operator()(const char* a, const char* b) const
+    {
+        return strcmp(a, b) == 0;
+    }
+};
+
+template <typename K, typename V, typename Hash = HashMapHash<K>, typename Equal = HashMapEqual<K> >
+class HashMap
+{
+public:
+    HashMap()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+    explicit HashMap(Allocator* a)
+    {
+        memset(this, 0, sizeof(*this));
+        allocator = a;
+    }
+    ~HashMap()
+    {
+        Free();
+    }
+
+    // only while nothing is allocated
+    void SetAllocator(Allocator* a)
+    {
+        assert(ctrl == NULL);
+        allocator = a;
+    }
+
+    u32 Length() const { return count; }
+    u32 Capacity() const { return capacity; }
+
+    // Makes room for numItems without rehashing.
+    void Reserve(u32 numItems)
+    {
+        u32 newCapacity = HASH_MAP_MIN_CAPACITY;
+        while (newCapacity - newCapacity / 8 < numItems)
+        {
+            newCapacity *= 2;
+        }
+
+        if (newCapacity > capacity)
+        {
+            Rehash(newCapacity);
+        }
+    }
+
+    V* Find(const K& key)
+    {
+        const u32 slot = FindSlot(key, Hash()(key));
+        return slot != UINT32_MAX ? &slots[slot].value : NULL;
+    }
+
+    // Inserts or overwrites, returns the stored value.
+    V* Insert(const K& key, const V& value)
+    {
+        bool inserted;
+        V* result = FindOrInsert(key, value, &inserted);
+        *result = value;
+        return result;
+    }
+
+    // Returns the existing value when the key is already there, or inserts value.
+    V* FindOrInsert(const K& key, const V& value, bool* inserted)
+    {
+        const u32 hash = Hash()(key);
+        const u32 existing = FindSlot(key, hash);
+        if (existing != UINT32_MAX)
+        {
+            *inserted = false;
+            return &slots[existing].value;
+        }
+
+        if (count + 1 > capacity - capacity / 8)
+        {
+            Rehash(MAX(capacity * 2, HASH_MAP_MIN_CAPACITY));
+        }
+
+        const u32 slot = FindEmptySlot(hash);
+        SetCtrl(slot, (u8)(hash & 0x7F));
+        slots[slot].key = key;
+        slots[slot].value = value;
+        count++;
+        *inserted = true;
+
+        return &slots[slot].value;
+    }
+
+    bool Remove(const K& key)
+    {
+        u32 slot = FindSlot(key, Hash()(key));
+        if (slot == UINT32_MAX)
+        {
+            return false;
+        }
+
+        // shift back the items that were displaced past the removed one
+        const u32 mask = capacity - 1;
+        for (u32 next = (slot + 1) & mask; ctrl[next] != HASH_MAP_EMPTY; next = (next + 1) & mask)
+        {
+            const u32 home = (Hash()(slots[next].key) >> 7) & mask;
+            const bool stays = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+            if (stays)
+            {
+                continue;
+            }
+
+            SetCtrl(slot, ctrl[next]);
+            memcpy(&slots[slot], &slots[next], sizeof(Slot));
+            slot = next;
+        }
+
+        SetCtrl(slot, HASH_MAP_EMPTY);
+        count--;
+
+        return true;
+    }
+
+    // keeps the memory
+    void Clear()
+    {
+        if (ctrl != NULL)
+        {
+            memset(ctrl, HASH_MAP_EMPTY, capacity + HASH_MAP_GROUP_SIZE);
+        }
+        count = 0;
+    }
+
+    void Free()
+    {
+        if (ctrl != NULL)
+        {
+            Reallocate(allocator, ctrl, GetAllocationSize(capacity), 0);
+        }
+        Allocator* a = allocator;
+        memset(this, 0, sizeof(*this));
+        allocator = a;
+    }
+
+    // Iteration: for (u32 s = 0; s < map.Capacity(); ++s) if (map.IsSlotUsed(s)) ...
+    bool IsSlotUsed(u32 slot) const { return ctrl[slot] != HASH_MAP_EMPTY; }
+    const K& GetKey(u32 slot) const { return slots[slot].key; }
+    V* GetValue(u32 slot) { return &slots[slot].value; }
+
+private:
+    struct Slot
+    {
+        K key;
+        V value;
+    };
+
+    u8* ctrl; // capacity + HASH_MAP_GROUP_SIZE bytes, the first group is mirrored at the end for wrap-around loads
+    Slot* slots;
+    u32 count;
+    u32 capacity; // a power of 2
+    Allocator* allocator;
+
+    HashMap(const HashMap&);
+    void operator=(const HashMap&);
+
+    static size_t GetAllocationSize(u32 cap)
+    {
+        return ALIGN_UP((size_t)cap + HASH_MAP_GROUP_SIZE, 16) + (size_t)cap * sizeof(Slot);
+    }
+
+    void SetCtrl(u32 slot, u8 value)
+    {
+        ctrl[slot] = value;
+        if (slot < HASH_MAP_GROUP_SIZE)
+        {
+            ctrl[capacity + slot] = value;
+        }
+    }
+
+    u32 FindSlot(const K& key, u32 hash) const
+    {
+        if (count == 0)
+        {
+            return UINT32_MAX;
+        }
+
+        const u32 mask = capacity - 1;
+        const __m128i tag = _mm_set1_epi8((char)(hash & 0x7F));
+        u32 pos = (hash >> 7) & mask;
+        for (;;)
+        {
+            const __m128i group = _mm_loadu_si128((const __m128i*)(ctrl + pos));
+            u32 matches = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, tag));
+            while (matches != 0)
+            {
+                const u32 bit = CountTrailingZeros(matches);
+                const u32 slot = (pos + bit) & mask;
+                if (Equal()(slots[slot].key, key))
+                {
+                    return slot;
+                }
+                matches &= matches - 1;
+            }
+
+            // items are never stored past an empty slot, see Remove
+            if (_mm_movemask_epi8(group) != 0)
+            {
+                return UINT32_MAX;
+            }
+            pos = (pos + HASH_MAP_GROUP_SIZE) & mask;
+        }
+    }
+
+    u32 FindEmptySlot(u32 hash) const
+    {
+        const u32 mask = capacity - 1;
+        u32 pos = (hash >> 7) & mask;
+        for (;;)
+        {
+            const __m128i group = _mm_loadu_si128((const __m128i*)(ctrl + pos));
+            const u32 empty = (u32)_mm_movemask_epi8(group);
+            if (empty != 0)
+            {
+                return (pos + CountTrailingZeros(empty)) & mask;
+            }
+            pos = (pos + HASH_MAP_GROUP_SIZE) & mask;
+        }
+    }
+
+    void Rehash(u32 newCapacity)
+    {
+        u8* oldCtrl = ctrl;
+        Slot* oldSlots = slots;
+        const u32 oldCapacity = capacity;
+
+        u8* memory = (u8*)Reallocate(allocator, NULL, 0, GetAllocationSize(newCapacity));
+        ctrl = memory;
+        slots = (Slot*)(memory + ALIGN_UP((size_t)newCapacity + HASH_MAP_GROUP_SIZE, 16));
+        capacity = newCapacity;
+        memset(ctrl, HASH_MAP_EMPTY, newCapacity + HASH_MAP_GROUP_SIZE);
+
+        for (u32 s = 0; s < oldCapacity; ++s)
+        {
+            if (oldCtrl[s] == HASH_MAP_EMPTY)
+            {
+                continue;
+            }
+
+            const u32 slot = FindEmptySlot(Hash()(oldSlots[s].key));
+            SetCtrl(slot, oldCtrl[s]);
+            memcpy(&slots[slot], &oldSlots[s], sizeof(Slot));
+        }
+
+        if (oldCtrl != NULL)
+        {
+            Reallocate(allocator, oldCtrl, GetAllocationSize(oldCapacity), 0);
+        }
+    }
+
+    static u32 CountTrailingZeros(u32 value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (u32)index;
+#else
+        return (u32)__builtin_ctz(value);
+#endif
+    }
+};
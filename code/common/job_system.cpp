@@ -0,0 +1,475 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include "job_system.h"
+
+#define JOB_DEQUE_MASK (JOB_DEQUE_SIZE - 1)
+#define JOB_SPIN_COUNT 64 // attempts at finding a job before an idle worker goes to sleep
+#define JOB_CACHE_LINE 64
+
+// Chase-Lev deque with a fixed size, as in "Correct and Efficient Work-Stealing for Weak Memory Models".
+// The owner pushes and pops at bottom, thieves take from top. top and bottom only grow.
+struct JobDeque
+{
+    volatile s64 top;
+    u8 padTop[JOB_CACHE_LINE - sizeof(s64)];
+    volatile s64 bottom;
+    u8 padBottom[JOB_CACHE_LINE - sizeof(s64)];
+    Job jobs[JOB_DEQUE_SIZE];
+};
+
+struct ParallelFor
+{
+    ParallelForFunc function;
+    void* userData;
+    u32 grain;
+};
+
+namespace
+{
+struct Local
+{
+    u32 numThreads; // 0 when not initialized
+    JobDeque* deques[JOB_MAX_WORKERS]; // [0] belongs to the Job_Init thread
+    void* dequeMemory;
+    Thread* threads[JOB_MAX_WORKERS];
+    Semaphore* wakeUp;
+    volatile s32 numSleeping;
+    volatile s32 numQueued; // jobs in the deques and the shared queue
+    volatile s32 quit;
+
+    MpmcRing<Job, JOB_DEQUE_SIZE> sharedJobs; // started by threads outside the pool, e.g. I/O completions
+};
+}
+
+static Local local;
+static THREAD_LOCAL s32 workerIndex = -1;
+static THREAD_LOCAL u32 stealSeed;
+
+static bool PushJob(JobDeque* deque, const Job* job)
+{
+    const s64 b = deque->bottom;
+    const s64 t = AtomicLoad64(&deque->top);
+    if (b - t >= JOB_DEQUE_SIZE)
+    {
+        return false;
+    }
+
+    deque->jobs[b & JOB_DEQUE_MASK] = *job;
+    AtomicStore64(&deque->bottom, b + 1);
+    return true;
+}
+
+static bool PopJob(JobDeque* deque, Job* job)
+{
+    const s64 b = deque->bottom - 1;
+    AtomicStore64(&deque->bottom, b);
+    AtomicFence();
+    const s64 t = AtomicLoad64(&deque->top);
+    if (t > b)
+    {
+        AtomicStore64(&deque->bottom, b + 1);
+        return false;
+    }
+
+    *job = deque->jobs[b & JOB_DEQUE_MASK];
+    if (t == b)
+    {
+        // the last job, a thief might be taking it as well
+        const bool won = AtomicCompareExchange64(&deque->top, t, t + 1);
+        AtomicStore64(&deque->bottom, b + 1);
+        return won;
+    }
+
+    return true;
+}
+
+static bool StealJob(JobDeque* deque, Job* job)
+{
+    const s64 t = AtomicLoad64(&deque->top);
+    AtomicFence();
+    const s64 b = AtomicLoad64(&deque->bottom);
+    if (t >= b)
+    {
+        return false;
+    }
+
+    // the copy is thrown away if another thread took the job first
+    *job = deque->jobs[t & JOB_DEQUE_MASK];
+    return AtomicCompareExchange64(&deque->top, t, t + 1);
+}
+
+static s64 GetDequeSize(const JobDeque* deque)
+{
+    return AtomicLoad64(&deque->bottom) - AtomicLoad64(&deque->top);
+}
+
+static bool FindJob(Job* job)
+{
+    if (PopJob(local.deques[workerIndex], job) || local.sharedJobs.TryPop(job))
+    {
+        AtomicAdd32(&local.numQueued, -1);
+        return true;
+    }
+
+    // xorshift, so that thieves don't all start with the same victim
+    stealSeed ^= stealSeed << 13;
+    stealSeed ^= stealSeed >> 17;
+    stealSeed ^= stealSeed << 5;
+    const u32 start = stealSeed % local.numThreads;
+    for (u32 i = 0; i < local.numThreads; ++i)
+    {
+        const u32 victim = (start + i) % local.numThreads;
+        if (victim != (u32)workerIndex && StealJob(local.deques[victim], job))
+        {
+            AtomicAdd32(&local.numQueued, -1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void RunJob(const Job* job);
+
+static void QueueJob(const Job* job)
+{
+    if (local.numThreads == 0)
+    {
+        RunJob(job);
+        return;
+    }
+
+    AtomicAdd32(&local.numQueued, 1);
+    const bool pushed = workerIndex >= 0 ? PushJob(local.deques[workerIndex], job) : local.sharedJobs.TryPush(*job);
+    if (!pushed)
+    {
+        AtomicAdd32(&local.numQueued, -1);
+        RunJob(job);
+        return;
+    }
+
+    // pairs with the sleep check in WorkerMain: either the worker sees the job or we see the worker
+    if (AtomicLoad32(&local.numSleeping) > 0)
+    {
+        Sys_SignalSemaphore(local.wakeUp, 1);
+    }
+}
+
+static void LockCounter(JobCounter* counter)
+{
+    while (!AtomicCompareExchange32(&counter->lock, 0, 1))
+    {
+        CpuPause();
+    }
+}
+
+static void UnlockCounter(JobCounter* counter)
+{
+    AtomicStore32(&counter->lock, 0);
+}
+
+// The count only reaches zero with the lock held, and Job_Wait takes the lock once it sees zero:
+// the counter can live on the waiter's stack, the last job is done with it when Job_Wait returns.
+static void FinishJob(JobCounter* counter)
+{
+    for (;;)
+    {
+        const s32 count = AtomicLoad32(&counter->count);
+        assert(count > 0);
+        if (count > 1)
+        {
+            if (AtomicCompareExchange32(&counter->count, count, count - 1))
+            {
+                return;
+            }
+            continue;
+        }
+
+        LockCounter(counter);
+        Job continuations[JOB_MAX_CONTINUATIONS];
+        u32 numContinuations = 0;
+        if (AtomicAdd32(&counter->count, -1) == 0)
+        {
+            numContinuations = counter->numContinuations;
+            memcpy(continuations, counter->continuations, numContinuations * sizeof(Job));
+            counter->numContinuations = 0;
+        }
+        UnlockCounter(counter);
+
+        for (u32 i = 0; i < numContinuations; ++i)
+        {
+            QueueJob(&continuations[i]);
+        }
+        return;
+    }
+}
+
+static void RunRange(const ParallelFor* parallelFor, JobCounter* counter, u32 begin, u32 end)
+{
+    const u32 grain = parallelFor->grain;
+    while (begin < end)
+    {
+        // lazy binary splitting: only hand out half of the range when the others emptied our deque
+        if (end - begin > grain && workerIndex >= 0 && local.numThreads > 1 && GetDequeSize(local.deques[workerIndex]) == 0)
+        {
+            const u32 middle = begin + (end - begin) / 2;
+            Job job = {};
+            job.parallelFor = parallelFor;
+            job.counter = counter;
+            job.begin = middle;
+            job.end = end;
+            AtomicAdd32(&counter->count, 1);
+            QueueJob(&job);
+            end = middle;
+            continue;
+        }
+
+        const u32 chunkEnd = MIN(begin + grain, end);
+        parallelFor->function(parallelFor->userData, begin, chunkEnd);
+        begin = chunkEnd;
+    }
+}
+
+static void RunJob(const Job* job)
+{
+    if (job->parallelFor != NULL)
+    {
+        RunRange(job->parallelFor, job->counter, job->begin, job->end);
+    }
+    else
+    {
+        job->function(job->userData);
+    }
+
+    if (job->counter != NULL)
+    {
+        FinishJob(job->counter);
+    }
+}
+
+static void WorkerMain(void* userData)
+{
+    workerIndex = (s32)(uintptr_t)userData;
+    stealSeed = 0x9E3779B9u * (u32)(workerIndex + 1);
+
+    u32 numFailures = 0;
+    while (AtomicLoad32(&local.quit) == 0)
+    {
+        Job job;
+        if (FindJob(&job))
+        {
+            RunJob(&job);
+            numFailures = 0;
+            continue;
+        }
+
+        if (++numFailures < JOB_SPIN_COUNT)
+        {
+            CpuPause();
+            continue;
+        }
+
+        AtomicAdd32(&local.numSleeping, 1);
+        if (AtomicLoad32(&local.numQueued) == 0 && AtomicLoad32(&local.quit) == 0)
+        {
+            Sys_WaitSemaphore(local.wakeUp);
+        }
+        AtomicAdd32(&local.numSleeping, -1);
+        numFailures = 0;
+    }
+}
+
+void Job_Init(u32 numWorkers)
+{
+    assert(local.numThreads == 0);
+    assert(local.sharedJobs.IsIdle());
+    if (numWorkers == 0)
+    {
+        numWorkers = Sys_GetCoreCount() - 1;
+    }
+    numWorkers = MIN(numWorkers, JOB_MAX_WORKERS - 1);
+
+    local.numThreads = numWorkers + 1;
+    local.dequeMemory = malloc(local.numThreads * sizeof(JobDeque) + JOB_CACHE_LINE);
+    if (local.dequeMemory == NULL)
+    {
+        Sys_FatalError("Job_Init: failed to allocate the job deques\n");
+    }
+
+    JobDeque* deques = (JobDeque*)ALIGN_UP_PTR(local.dequeMemory, JOB_CACHE_LINE);
+    for (u32 i = 0; i < local.numThreads; ++i)
+    {
+        local.deques[i] = &deques[i];
+        local.deques[i]->top = 0;
+        local.deques[i]->bottom = 0;
+    }
+
+    local.wakeUp = Sys_CreateSemaphore(0);
+    local.numSleeping = 0;
+    local.numQueued = 0;
+    local.quit = 0;
+
+    workerIndex = 0;
+    stealSeed = 0x9E3779B9u;
+    for (u32 i = 1; i < local.numThreads; ++i)
+    {
+        local.threads[i] = Sys_CreateThread(&WorkerMain, (void*)(uintptr_t)i);
+    }
+}
+
+void Job_Shutdown()
+{
+    if (local.numThreads == 0)
+    {
+        return;
+    }
+
+    assert(workerIndex == 0);
+    assert(local.numQueued == 0);
+    AtomicStore32(&local.quit, 1);
+    Sys_SignalSemaphore(local.wakeUp, local.numThreads);
+    for (u32 i = 1; i < local.numThreads; ++i)
+    {
+        Sys_JoinThread(local.threads[i]);
+    }
+
+    Sys_DestroySemaphore(local.wakeUp);
+    free(local.dequeMemory);
+    local.numThreads = 0;
+    workerIndex = -1;
+}
+
+u32 Job_GetThreadCount()
+{
+    return MAX(local.numThreads, 1);
+}
+
+void Job_Run(JobFunc function, void* userData, JobCounter* counter)
+{
+    Job job = {};
+    job.function = function;
+    job.userData = userData;
+    job.counter = counter;
+    if (counter != NULL)
+    {
+        AtomicAdd32(&counter->count, 1);
+    }
+
+    QueueJob(&job);
+}
+
+void Job_RunAfter(JobCounter* dependency, JobFunc function, void* userData, JobCounter* counter)
+{
+    Job job = {};
+    job.function = function;
+    job.userData = userData;
+    job.counter = counter;
+    if (counter != NULL)
+    {
+        AtomicAdd32(&counter->count, 1);
+    }
+
+    // the count reaches zero with the lock held, so a job added here is either seen by FinishJob or started now
+    LockCounter(dependency);
+    const bool done = AtomicLoad32(&dependency->count) == 0;
+    if (!done)
+    {
+        if (dependency->numContinuations >= JOB_MAX_CONTINUATIONS)
+        {
+            Sys_FatalError("Job_RunAfter: more than %d jobs wait on a counter\n", JOB_MAX_CONTINUATIONS);
+        }
+        dependency->continuations[dependency->numContinuations++] = job;
+    }
+    UnlockCounter(dependency);
+
+    if (done)
+    {
+        QueueJob(&job);
+    }
+}
+
+void Job_IncrementCounter(JobCounter* counter, u32 count)
+{
+    AtomicAdd32(&counter->count, (s32)count);
+}
+
+void Job_DecrementCounter(JobCounter* counter)
+{
+    FinishJob(counter);
+}
+
+void Job_Wait(JobCounter* counter)
+{
+    u32 numFailures = 0;
+    while (AtomicLoad32(&counter->count) > 0)
+    {
+        Job job;
+        if (workerIndex >= 0 && local.numThreads > 0 && FindJob(&job))
+        {
+            RunJob(&job);
+            numFailures = 0;
+        }
+        else if (++numFailures < JOB_SPIN_COUNT)
+        {
+            CpuPause();
+        }
+        else
+        {
+            Sys_YieldThread();
+        }
+    }
+
+    // waits for the job that brought the count to zero to release the counter
+    LockCounter(counter);
+    UnlockCounter(counter);
+}
+
+void Job_ParallelFor(u32 count, ParallelForFunc function, void* userData, u32 minGrain)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    ParallelFor parallelFor;
+    parallelFor.function = function;
+    parallelFor.userData = userData;
+    parallelFor.grain = minGrain > 0 ? minGrain : MAX(count / (Job_GetThreadCount() * 16), 1);
+
+    JobCounter counter = {};
+    RunRange(&parallelFor, &counter, 0, count);
+    Job_Wait(&counter);
+}
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+// Work-stealing job system.
+//
+// Every worker thread, and the thread that called Job_Init, owns a Chase-Lev deque: it pushes and
+// pops jobs at the bottom while idle workers steal from the top of the others. Waiting for jobs
+// (Job_Wait, Job_ParallelFor) runs other jobs in the meantime, so jobs can wait on jobs they started.
+// Idle workers spin for a moment and then sleep on a semaphore until new jobs are pushed.
+//
+// Jobs can be started from any thread. Threads outside the pool push them to a shared queue that
+// the workers check after their own deque. When the job system isn't initialized, jobs run right away.
+
+#define JOB_DEQUE_SIZE 4096 // per worker, jobs that don't fit are run right away
+#define JOB_MAX_CONTINUATIONS 8 // jobs started with Job_RunAfter per counter
+#define JOB_MAX_WORKERS 64
+
+typedef void (*JobFunc)(void* userData);
+// processes items [begin; end[
+typedef void (*ParallelForFunc)(void* userData, u32 begin, u32 end);
+
+struct ParallelFor;
+struct JobCounter;
+
+struct Job
+{
+    JobFunc function;
+    void* userData;
+    JobCounter* counter;
+    const ParallelFor* parallelFor; // when not NULL, a range of a Job_ParallelFor
+    u32 begin;
+    u32 end;
+};
+
+// Counts the unfinished jobs started with it, zero-initialized means no job.
+// A counter must stay alive until Job_Wait on it returned.
+struct JobCounter
+{
+    volatile s32 count;
+    volatile s32 lock; // guards the continuations
+    u32 numContinuations;
+    Job continuations[JOB_MAX_CONTINUATIONS];
+};
+
+// 0 workers means one per core besides the calling thread
+void Job_Init(u32 numWorkers);
+void Job_Shutdown();
+// worker threads + the Job_Init thread, 1 when not initialized
+u32 Job_GetThreadCount();
+
+// counter can be NULL
+void Job_Run(JobFunc function, void* userData, JobCounter* counter);
+// starts the job once dependency reaches zero
+void Job_RunAfter(JobCounter* dependency, JobFunc function, void* userData, JobCounter* counter);
+// runs jobs until the counter reaches zero
+void Job_Wait(JobCounter* counter);
+// Lets work that isn't a job, like a file read, hold the counter: every increment must be matched
+// by a decrement, the last one starts the Job_RunAfter jobs.
+void Job_IncrementCounter(JobCounter* counter, u32 count);
+void Job_DecrementCounter(JobCounter* counter);
+
+// Calls function over [0; count[ in ranges of at least minGrain items and waits for them.
+// A worker only splits its range when the others ran out of work, so the ranges get smaller
+// only as long as there are idle threads. 0 picks a grain from the count and the thread count.
+void Job_ParallelFor(u32 count, ParallelForFunc function, void* userData, u32 minGrain);
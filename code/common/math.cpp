@@ -70,4 +70,104 @@ m4x4 Invert(const m4x4* input)
         invOut[i] = inv[i] * det;
 
     return output;
-}
\ No newline at end of file
+}
+
+// for matrices whose last row is 0 0 0 1
+m4x4 InvertAffine(const m4x4* input)
+{
+    const vec3_t c0 = GetColumn(*input, 0);
+    const vec3_t c1 = GetColumn(*input, 1);
+    const vec3_t c2 = GetColumn(*input, 2);
+    const vec3_t t = GetColumn(*input, 3);
+
+    // the rows of the inverse 3x3 are the cross products of the columns
+    const vec3_t r0 = cross(c1, c2);
+    const vec3_t r1 = cross(c2, c0);
+    const vec3_t r2 = cross(c0, c1);
+    f32 det = dot(c0, r0);
+
+    if (det == 0)
+        return *input;
+
+    det = 1.f / det;
+
+    const vec3_t x = r0 * det;
+    const vec3_t y = r1 * det;
+    const vec3_t z = r2 * det;
+    m4x4 output = Rows3x3(x, y, z);
+    output.E[0][3] = -dot(x, t);
+    output.E[1][3] = -dot(y, t);
+    output.E[2][3] = -dot(z, t);
+
+    return output;
+}
+
+u16 F32ToF16(f32 value)
+{
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const u32 sign = (bits >> 16) & 0x8000;
+    const u32 absBits = bits & 0x7FFFFFFF;
+
+    if (absBits >= 0x7F800000)
+    {
+        // infinity stays infinity, NaN stays NaN
+        return (u16)(sign | (absBits > 0x7F800000 ? 0x7E00 : 0x7C00));
+    }
+    if (absBits >= 0x477FF000)
+    {
+        // rounds past 65504
+        return (u16)(sign | 0x7C00);
+    }
+    if (absBits >= 0x38800000)
+    {
+        // rebias the exponent and round the 13 dropped bits to nearest even
+        const u32 rounded = absBits - 0x38000000 + 0xFFF + ((absBits >> 13) & 1);
+        return (u16)(sign | (rounded >> 13));
+    }
+
+    // denormals, everything below 2^-25 rounds to 0
+    const u32 exponent = absBits >> 23;
+    if (exponent < 102)
+    {
+        return (u16)sign;
+    }
+    const u32 mantissa = (absBits & 0x7FFFFF) | 0x800000;
+    const u32 shift = 126 - exponent;
+    const u32 remainder = mantissa & ((1 << shift) - 1);
+    const u32 halfway = 1 << (shift - 1);
+    u32 result = mantissa >> shift;
+    if (remainder > halfway || (remainder == halfway && (result & 1)))
+    {
+        ++result;
+    }
+    return (u16)(sign | result);
+}
+
+f32 F16ToF32(u16 value)
+{
+    const u32 sign = (u32)(value & 0x8000) << 16;
+    const u32 exponent = (value >> 10) & 0x1F;
+    const u32 mantissa = value & 0x3FF;
+
+    u32 bits;
+    if (exponent == 0)
+    {
+        // zero or denormal
+        const f32 result = (f32)mantissa * (1.0f / 16777216.0f);
+        memcpy(&bits, &result, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    f32 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
@@ -406,4 +406,27 @@ CameraTransform(vec3_t x, vec3_t y, vec3_t z, vec3_t p)
     return R;
 }
 
-m4x4 Invert(const m4x4* input);
\ No newline at end of file
+m4x4 Invert(const m4x4* input);
+m4x4 InvertAffine(const m4x4* input);
+
+// IEEE half floats like HLSL's f32tof16 and f16tof32, rounding to nearest even
+u16 F32ToF16(f32 value);
+f32 F16ToF32(u16 value);
+
+// 'planes' are (normal, d) with the inside where dot(normal, p) + d >= 0
+inline bool
+AABBVisible(const vec4_t* planes, u32 numPlanes, vec3_t center, vec3_t extent)
+{
+    for (u32 i = 0; i < numPlanes; ++i)
+    {
+        const vec4_t p = planes[i];
+        const f32 distance = ((p.x * center.x + p.y * center.y) + p.z * center.z) + p.w;
+        const f32 radius = (fabsf(p.x) * extent.x + fabsf(p.y) * extent.y) + fabsf(p.z) * extent.z;
+        if (distance + radius < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
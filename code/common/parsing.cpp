@@ -82,10 +82,15 @@ void PathRemoveFileSpec(char* inout)
     assert(inout);
     const char* start = inout;
     const char* end = inout + strlen(inout);
-    while (*end != '/' && *end != '\\')
+    while (end > start && *end != '/' && *end != '\\')
     {
         end--;
     }
+    if (end == start && *end != '/' && *end != '\\')
+    {
+        strcpy(inout, "."); // no directory in the path
+        return;
+    }
     inout[end - start] = '\0';
 }
 
@@ -117,11 +122,10 @@ void GetFileName(char* output, const char* input)
     assert(input);
     const char* end = input + strlen(input);
     const char* start = end;
-    while (*start != '/' && *start != '\\')
+    while (start > input && start[-1] != '/' && start[-1] != '\\')
     {
         start--;
     }
-    start++;
 
     size_t n = end - start;
     memcpy(output, start, n + 1);
@@ -0,0 +1,221 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+// Handles are the slot index in the low bits and the generation of the slot in the high bits.
+// Freeing an object bumps the generation of its slot, so old handles to it no longer resolve
+// even once the slot has been reused.
+#define HANDLE_INDEX_BITS 16
+#define HANDLE_INDEX_MASK ((1 << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_MAX_GENERATIONS 0xFFFF
+
+// Zero-initialized handles are null, no object ever has generation 0.
+template <typename T>
+struct Handle
+{
+    u32 value;
+
+    bool IsNull() const
+    {
+        return value == 0;
+    }
+
+    bool operator==(Handle<T> other) const
+    {
+        return value == other.value;
+    }
+
+    bool operator!=(Handle<T> other) const
+    {
+        return value != other.value;
+    }
+};
+
+// Fixed-size pool of T with O(1) Alloc and Free, zero-initialized memory is an empty pool.
+// Objects don't move: the slot index of a handle is stable for the object's lifetime,
+// so it can be used to index parallel arrays. The indices of live objects are also kept
+// packed, GetLiveIndex(0 .. Length()-1) visits every live object without scanning free slots.
+template <typename T, u32 N>
+struct Pool
+{
+public:
+    Pool()
+    {
+        assert(N <= HANDLE_INDEX_MASK + 1);
+        memset(generations, 0, sizeof(generations));
+        numLive = 0;
+        numUsed = 0;
+        freeHead = 0;
+    }
+
+    // Returns a null handle when the pool is full.
+    // The object isn't touched, it holds whatever the previous owner left in it.
+    Handle<T> Alloc()
+    {
+        u32 index;
+        if (freeHead != 0)
+        {
+            index = freeHead - 1;
+            freeHead = slotToLive[index];
+        }
+        else if (numUsed < N)
+        {
+            index = numUsed++;
+        }
+        else
+        {
+            Handle<T> result = {};
+            return result;
+        }
+
+        slotToLive[index] = numLive;
+        live[numLive++] = index;
+
+        return GetHandle(index);
+    }
+
+    // Stale and null handles are ignored.
+    void Free(Handle<T> handle)
+    {
+        if (!IsValid(handle))
+        {
+            return;
+        }
+
+        const u32 index = handle.value & HANDLE_INDEX_MASK;
+        generations[index] = (generations[index] + 1) % HANDLE_MAX_GENERATIONS;
+
+        // the last live index takes the place of the freed one
+        const u32 livePosition = slotToLive[index];
+        const u32 lastIndex = live[--numLive];
+        live[livePosition] = lastIndex;
+        slotToLive[lastIndex] = livePosition;
+
+        slotToLive[index] = freeHead;
+        freeHead = index + 1;
+    }
+
+    // Frees every live object, outstanding handles become stale.
+    void Clear()
+    {
+        while (numLive > 0)
+        {
+            Free(GetHandle(live[numLive - 1]));
+        }
+    }
+
+    bool IsValid(Handle<T> handle) const
+    {
+        const u32 index = handle.value & HANDLE_INDEX_MASK;
+        return handle.value != 0 && IsLive(index) && (handle.value >> HANDLE_INDEX_BITS) == generations[index] + 1;
+    }
+
+    // NULL for stale and null handles
+    T* Get(Handle<T> handle)
+    {
+        return IsValid(handle) ? &items[handle.value & HANDLE_INDEX_MASK] : NULL;
+    }
+
+    const T* Get(Handle<T> handle) const
+    {
+        return IsValid(handle) ? &items[handle.value & HANDLE_INDEX_MASK] : NULL;
+    }
+
+    u32 GetIndex(Handle<T> handle) const
+    {
+        assert(IsValid(handle));
+        return handle.value & HANDLE_INDEX_MASK;
+    }
+
+    // handle of the live object in the slot
+    Handle<T> GetHandle(u32 index) const
+    {
+        assert(IsLive(index));
+        Handle<T> result;
+        result.value = ((generations[index] + 1) << HANDLE_INDEX_BITS) | index;
+        return result;
+    }
+
+    // slot of the i-th live object, i < Length()
+    u32 GetLiveIndex(u32 i) const
+    {
+        assert(i < numLive);
+        return live[i];
+    }
+
+    T& operator[](u32 index)
+    {
+        assert(IsLive(index));
+        return items[index];
+    }
+
+    const T& operator[](u32 index) const
+    {
+        assert(IsLive(index));
+        return items[index];
+    }
+
+    bool IsLive(u32 index) const
+    {
+        return index < numUsed && slotToLive[index] < numLive && live[slotToLive[index]] == index;
+    }
+
+    u32 Length() const
+    {
+        return numLive;
+    }
+
+    u32 Capacity() const
+    {
+        return N;
+    }
+
+    bool IsFull() const
+    {
+        return numLive == N;
+    }
+
+private:
+    Pool(const Pool<T, N>&);
+    void operator=(const Pool<T, N>&);
+
+    T items[N];
+    u32 generations[N]; // handles store the generation + 1
+    u32 slotToLive[N]; // position in live for live slots, next free slot + 1 for freed ones
+    u32 live[N]; // packed slot indices of the live objects
+    u32 numLive;
+    u32 numUsed; // slots at or above were never allocated
+    u32 freeHead; // first freed slot + 1, 0 when there is none
+};
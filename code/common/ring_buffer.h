@@ -0,0 +1,417 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+// Bounded lock-free queues for handing items between threads.
+// N must be a power of 2. T is copied in and out with memcpy semantics, keep it small and POD.
+//
+// SpscRing: one producer thread and one consumer thread.
+// MpmcRing: any number of both, after Dmitry Vyukov's bounded MPMC queue.
+// BlockingRing: either of them with Push and Pop that sleep instead of failing.
+//
+// The indices the producers and the consumers write live on separate cache lines,
+// so that the two sides don't keep stealing each other's line.
+
+#define RING_CACHE_LINE 64
+
+template <typename T, u32 N>
+struct SpscRing
+{
+public:
+    SpscRing()
+    {
+        assert((N & (N - 1)) == 0);
+        head = 0;
+        cachedTail = 0;
+        tail = 0;
+        cachedHead = 0;
+    }
+
+    // producer only
+    bool TryPush(const T& item)
+    {
+        return PushBatch(&item, 1) == 1;
+    }
+
+    // producer only, returns the number of items pushed
+    u32 PushBatch(const T* source, u32 count)
+    {
+        const s64 t = tail;
+        if ((u64)(t - cachedHead) + count > N)
+        {
+            cachedHead = AtomicLoad64(&head);
+        }
+
+        const u32 numFree = (u32)(N - (t - cachedHead));
+        count = MIN(count, numFree);
+        for (u32 i = 0; i < count; ++i)
+        {
+            items[(t + i) & (N - 1)] = source[i];
+        }
+        AtomicStore64(&tail, t + count);
+
+        return count;
+    }
+
+    // consumer only
+    bool TryPop(T* item)
+    {
+        return PopBatch(item, 1) == 1;
+    }
+
+    // consumer only, returns the number of items popped
+    u32 PopBatch(T* dest, u32 maxCount)
+    {
+        const s64 h = head;
+        if (cachedTail - h < (s64)maxCount)
+        {
+            cachedTail = AtomicLoad64(&tail);
+        }
+
+        const u32 count = (u32)MIN((s64)maxCount, cachedTail - h);
+        for (u32 i = 0; i < count; ++i)
+        {
+            dest[i] = items[(h + i) & (N - 1)];
+        }
+        AtomicStore64(&head, h + count);
+
+        return count;
+    }
+
+    // a snapshot, exact only on the producer or consumer thread when the other side is idle
+    u32 Length() const
+    {
+        return (u32)(AtomicLoad64(&tail) - AtomicLoad64(&head));
+    }
+
+private:
+    SpscRing(const SpscRing<T, N>&);
+    void operator=(const SpscRing<T, N>&);
+
+    // consumer side
+    volatile s64 head;
+    s64 cachedTail; // the consumer only reads tail again when it looks empty
+    u8 padConsumer[RING_CACHE_LINE - 2 * sizeof(s64)];
+
+    // producer side
+    volatile s64 tail;
+    s64 cachedHead; // the producer only reads head again when it looks full
+    u8 padProducer[RING_CACHE_LINE - 2 * sizeof(s64)];
+
+    T items[N];
+};
+
+template <typename T, u32 N>
+struct MpmcRing
+{
+public:
+    MpmcRing()
+    {
+        assert((N & (N - 1)) == 0);
+        for (u32 i = 0; i < N; ++i)
+        {
+            cells[i].sequence = i;
+        }
+        enqueuePos = 0;
+        dequeuePos = 0;
+    }
+
+    bool TryPush(const T& item)
+    {
+        return PushBatch(&item, 1) == 1;
+    }
+
+    // Claims up to count consecutive cells with a single CAS, returns the number of items pushed.
+    u32 PushBatch(const T* source, u32 count)
+    {
+        for (;;)
+        {
+            const s64 pos = AtomicLoad64(&enqueuePos);
+
+            // a cell is free for the push with ticket pos when its sequence is pos
+            u32 numFree = 0;
+            while (numFree < count && AtomicLoad64(&cells[(pos + numFree) & (N - 1)].sequence) == pos + numFree)
+            {
+                ++numFree;
+            }
+
+            if (numFree == 0)
+            {
+                const s64 sequence = AtomicLoad64(&cells[pos & (N - 1)].sequence);
+                if (sequence < pos)
+                {
+                    return 0; // full
+                }
+                continue; // another producer took pos
+            }
+
+            if (!AtomicCompareExchange64(&enqueuePos, pos, pos + numFree))
+            {
+                continue;
+            }
+
+            for (u32 i = 0; i < numFree; ++i)
+            {
+                Cell* cell = &cells[(pos + i) & (N - 1)];
+                cell->item = source[i];
+                AtomicStore64(&cell->sequence, pos + i + 1);
+            }
+
+            return numFree;
+        }
+    }
+
+    bool TryPop(T* item)
+    {
+        return PopBatch(item, 1) == 1;
+    }
+
+    // returns the number of items popped
+    u32 PopBatch(T* dest, u32 maxCount)
+    {
+        for (;;)
+        {
+            const s64 pos = AtomicLoad64(&dequeuePos);
+
+            // a cell holds the item of ticket pos when its sequence is pos + 1
+            u32 numReady = 0;
+            while (numReady < maxCount && AtomicLoad64(&cells[(pos + numReady) & (N - 1)].sequence) == pos + numReady + 1)
+            {
+                ++numReady;
+            }
+
+            if (numReady == 0)
+            {
+                const s64 sequence = AtomicLoad64(&cells[pos & (N - 1)].sequence);
+                if (sequence < pos + 1)
+                {
+                    return 0; // empty, or the push of pos isn't done yet
+                }
+                continue; // another consumer took pos
+            }
+
+            if (!AtomicCompareExchange64(&dequeuePos, pos, pos + numReady))
+            {
+                continue;
+            }
+
+            for (u32 i = 0; i < numReady; ++i)
+            {
+                Cell* cell = &cells[(pos + i) & (N - 1)];
+                dest[i] = cell->item;
+                AtomicStore64(&cell->sequence, pos + i + N);
+            }
+
+            return numReady;
+        }
+    }
+
+    // a snapshot, can be off while other threads push and pop
+    u32 Length() const
+    {
+        const s64 length = AtomicLoad64(&enqueuePos) - AtomicLoad64(&dequeuePos);
+        return (u32)CLAMP_MAX(CLAMP_MIN(length, 0), (s64)N);
+    }
+
+    // Empty with every cell free for the next pushes. Zeroed memory the constructor never ran
+    // on fails this, its pushes would report full after the first item.
+    bool IsIdle() const
+    {
+        const s64 pos = AtomicLoad64(&enqueuePos);
+        if (AtomicLoad64(&dequeuePos) != pos)
+        {
+            return false;
+        }
+        for (u32 i = 0; i < N; ++i)
+        {
+            if (AtomicLoad64(&cells[(pos + i) & (N - 1)].sequence) != pos + i)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    MpmcRing(const MpmcRing<T, N>&);
+    void operator=(const MpmcRing<T, N>&);
+
+    struct Cell
+    {
+        volatile s64 sequence;
+        T item;
+    };
+
+    volatile s64 enqueuePos;
+    u8 padEnqueue[RING_CACHE_LINE - sizeof(s64)];
+    volatile s64 dequeuePos;
+    u8 padDequeue[RING_CACHE_LINE - sizeof(s64)];
+    Cell cells[N];
+};
+
+// Adds blocking Push and Pop to a ring. Waiting threads spin for a moment and then sleep on a
+// semaphore, the other side only signals it when it saw a sleeper, so the fast path stays lock-free.
+// Init and Destroy create and release the semaphores.
+template <typename T, typename Ring>
+struct BlockingRing
+{
+public:
+    void Init()
+    {
+        notEmpty = Sys_CreateSemaphore(0);
+        notFull = Sys_CreateSemaphore(0);
+        numWaitingPop = 0;
+        numWaitingPush = 0;
+    }
+
+    void Destroy()
+    {
+        Sys_DestroySemaphore(notEmpty);
+        Sys_DestroySemaphore(notFull);
+    }
+
+    bool TryPush(const T& item)
+    {
+        if (!ring.TryPush(item))
+        {
+            return false;
+        }
+        WakeUp(&numWaitingPop, notEmpty);
+        return true;
+    }
+
+    bool TryPop(T* item)
+    {
+        if (!ring.TryPop(item))
+        {
+            return false;
+        }
+        WakeUp(&numWaitingPush, notFull);
+        return true;
+    }
+
+    void Push(const T& item)
+    {
+        PushBatch(&item, 1);
+    }
+
+    void Pop(T* item)
+    {
+        PopBatch(item, 1);
+    }
+
+    // pushes everything, blocking whenever the ring is full
+    void PushBatch(const T* source, u32 count)
+    {
+        for (u32 numTries = 0; count > 0; ++numTries)
+        {
+            u32 numPushed = ring.PushBatch(source, count);
+            if (numPushed == 0 && numTries >= SpinCount)
+            {
+                // tries once more after announcing itself, so that a pop can't slip in unnoticed
+                AtomicAdd32(&numWaitingPush, 1);
+                numPushed = ring.PushBatch(source, count);
+                if (numPushed == 0)
+                {
+                    Sys_WaitSemaphore(notFull);
+                }
+                AtomicAdd32(&numWaitingPush, -1);
+            }
+
+            if (numPushed == 0)
+            {
+                CpuPause();
+                continue;
+            }
+
+            WakeUp(&numWaitingPop, notEmpty);
+            source += numPushed;
+            count -= numPushed;
+            numTries = 0;
+        }
+    }
+
+    // waits for at least one item, returns the number of items popped
+    u32 PopBatch(T* dest, u32 maxCount)
+    {
+        for (u32 numTries = 0;; ++numTries)
+        {
+            u32 numPopped = ring.PopBatch(dest, maxCount);
+            if (numPopped == 0 && numTries >= SpinCount)
+            {
+                AtomicAdd32(&numWaitingPop, 1);
+                numPopped = ring.PopBatch(dest, maxCount);
+                if (numPopped == 0)
+                {
+                    Sys_WaitSemaphore(notEmpty);
+                }
+                AtomicAdd32(&numWaitingPop, -1);
+            }
+
+            if (numPopped > 0)
+            {
+                WakeUp(&numWaitingPush, notFull);
+                return numPopped;
+            }
+
+            CpuPause();
+        }
+    }
+
+    Ring ring;
+
+private:
+    enum
+    {
+        SpinCount = 64 // failed tries before a thread goes to sleep
+    };
+
+    // A sleeper can also be woken by a signal meant for an earlier one, or for an item another
+    // thread took first: it simply tries again.
+    static void WakeUp(volatile s32* numWaiting, Semaphore* semaphore)
+    {
+        // pairs with the increment before the last try: either the sleeper sees our change or we see the sleeper
+        AtomicFence();
+        if (AtomicLoad32(numWaiting) > 0)
+        {
+            Sys_SignalSemaphore(semaphore, 1);
+        }
+    }
+
+    Semaphore* notEmpty;
+    Semaphore* notFull;
+    volatile s32 numWaitingPop;
+    volatile s32 numWaitingPush;
+};
@@ -67,19 +67,12 @@ bool FileExists(const char* filePath)
     return true;
 }
 
-bool ReadEntireFile(void** memoryBuffer, s32* size, const char* filePath)
+bool ReadEntireFile(void** memoryBuffer, size_t* size, const char* filePath)
 {
-    FILE* file = fopen(filePath, "rb");
-    if (file == NULL)
+    if (!FileExists(filePath))
         return false;
-    fseek(file, 0, SEEK_END);
-    *size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    *memoryBuffer = malloc(*size);
-    if (*memoryBuffer == NULL)
-        Sys_FatalError("Failed to allocate memory for file: %s", filePath);
-    fread(*memoryBuffer, *size, 1, file);
-    fclose(file);
+    if (!Sys_ReadDataFromFile(memoryBuffer, size, filePath))
+        Sys_FatalError("Failed to read file: %s", filePath);
     return true;
 }
 
@@ -93,16 +86,214 @@ char* FormatBytes(u64 byteCount)
     static const char* units[] { "bytes", "KB", "MB", "GB", "TB" };
 
     u32 unitIndex = 0;
-    u32 prev = 0;
-    u32 temp = byteCount;
-    while (temp >= 1024)
+    f64 number = (f64)byteCount;
+    while (number >= 1024.0 && unitIndex + 1 < ARRAY_LEN(units))
     {
         ++unitIndex;
-        prev = temp;
-        temp >>= 10;
+        number /= 1024.0;
     }
 
-    f32 number = (f32)prev / 1024.0;
+    if (unitIndex == 0)
+    {
+        return fmt("%d %s", (int)byteCount, units[unitIndex]);
+    }
 
     return fmt("%.3f %s", number, units[unitIndex]);
 }
+
+void AllocateVirtualArena(MemoryArena* a, size_t reserveSize, const char* name)
+{
+    reserveSize = ALIGN_UP(reserveSize, ARENA_COMMIT_SIZE);
+    void* base = Sys_ReserveMemory(reserveSize);
+    if (base == NULL)
+    {
+        Sys_FatalError("AllocateVirtualArena: failed to reserve %s for %s\n", FormatBytes(reserveSize), name);
+    }
+
+    memset(a, 0, sizeof(*a));
+    a->name = name;
+    a->base_ptr = (u8*)base;
+    a->size = reserveSize;
+    a->is_virtual = true;
+}
+
+void FreeVirtualArena(MemoryArena* a)
+{
+    assert(a->is_virtual);
+    Sys_ReleaseMemory(a->base_ptr);
+    memset(a, 0, sizeof(*a));
+}
+
+void CommitArena(MemoryArena* a, size_t minCommitted)
+{
+    assert(a->is_virtual && minCommitted <= a->size);
+    const size_t committed = MIN(ALIGN_UP(minCommitted, ARENA_COMMIT_SIZE), a->size);
+    if (committed <= a->committed)
+    {
+        return;
+    }
+
+    if (!Sys_CommitMemory(a->base_ptr + a->committed, committed - a->committed))
+    {
+        Sys_FatalError("CommitArena: failed to commit %s for %s\n", FormatBytes(committed - a->committed), a->name);
+    }
+
+    a->committed_bytes += committed - a->committed;
+    a->committed = committed;
+}
+
+void DecommitArena(MemoryArena* a, size_t minCommitted)
+{
+    assert(a->is_virtual);
+    const size_t committed = ALIGN_UP(MAX(a->mem_used, minCommitted), ARENA_COMMIT_SIZE);
+    if (committed >= a->committed)
+    {
+        return;
+    }
+
+    Sys_DecommitMemory(a->base_ptr + committed, a->committed - committed);
+    a->committed_bytes -= a->committed - committed;
+    a->committed = committed;
+}
+
+void GetArenaReport(ArenaReport* report, const MemoryArena* arena)
+{
+    report->name = arena->name != NULL ? arena->name : "unnamed arena";
+    report->reserved = arena->size;
+    report->committed = arena->is_virtual ? arena->committed_bytes : arena->size;
+    report->used = arena->mem_used;
+    report->highWater = arena->high_water;
+    report->numAllocations = arena->num_allocations;
+    report->paddingBytes = arena->padding_bytes;
+    report->budgetUsage = arena->size > 0 ? (f32)((f64)arena->high_water / (f64)arena->size) : 0.0f;
+    report->fragmentation = arena->high_water > 0 ? (f32)((f64)arena->padding_bytes / (f64)arena->high_water) : 0.0f;
+}
+
+#define MAX_TRACKED_ARENAS 32
+
+static MemoryArena* trackedArenas[MAX_TRACKED_ARENAS];
+static u32 numTrackedArenas;
+
+void TrackArena(MemoryArena* arena)
+{
+    if (numTrackedArenas >= MAX_TRACKED_ARENAS)
+    {
+        Sys_FatalError("TrackArena: can't track more than %d arenas\n", MAX_TRACKED_ARENAS);
+    }
+
+    trackedArenas[numTrackedArenas++] = arena;
+}
+
+u32 GetTrackedArenaReports(ArenaReport* reports, u32 maxReports)
+{
+    const u32 count = MIN(numTrackedArenas, maxReports);
+    for (u32 i = 0; i < count; ++i)
+    {
+        GetArenaReport(&reports[i], trackedArenas[i]);
+    }
+
+    return count;
+}
+
+static THREAD_LOCAL MemoryArena scratchArena;
+
+MemoryArena* GetScratchArena()
+{
+    if (scratchArena.base_ptr == NULL)
+    {
+        AllocateVirtualArena(&scratchArena, SCRATCH_ARENA_RESERVE, "scratch arena");
+    }
+
+    return &scratchArena;
+}
+
+void FreeScratchArena()
+{
+    if (scratchArena.base_ptr == NULL)
+    {
+        return;
+    }
+
+#if ARENA_DEBUG
+    if (scratchArena.temp_count != 0 || scratchArena.mem_used != 0)
+    {
+        Sys_FatalError("FreeScratchArena: %s of scratch memory in %d scopes leaked\n", FormatBytes(scratchArena.mem_used), scratchArena.temp_count);
+    }
+#endif
+    FreeVirtualArena(&scratchArena);
+}
+
+// ARENA_DEBUG block layout: header, data rounded up to ARENA_ALIGNMENT, guard
+#define ATOMIC_ARENA_MAGIC 0x41544F4D41524E41ull // "ATOMARNA"
+#define ATOMIC_ARENA_GUARD_SIZE ARENA_ALIGNMENT
+
+struct AtomicBlockHeader
+{
+    u64 size;
+    u64 magic;
+};
+
+void AllocateAtomicArena(AtomicArena* a, size_t size, void* base_ptr, const char* name)
+{
+    u8* aligned = (u8*)ALIGN_UP_PTR(base_ptr, ARENA_ALIGNMENT);
+    assert((size_t)(aligned - (u8*)base_ptr) <= size);
+
+    a->name = name;
+    a->base_ptr = aligned;
+    a->size = size - (aligned - (u8*)base_ptr);
+    a->mem_used = 0;
+    a->high_water = 0;
+}
+
+void ResetAtomicArena(AtomicArena* a)
+{
+    CheckAtomicArena(a);
+    a->high_water = MAX(a->high_water, (size_t)a->mem_used);
+    a->mem_used = 0;
+}
+
+void CheckAtomicArena(const AtomicArena* a)
+{
+#if ARENA_DEBUG
+    const size_t used = (size_t)a->mem_used;
+    size_t offset = 0;
+    while (offset < used)
+    {
+        const AtomicBlockHeader* header = (const AtomicBlockHeader*)(a->base_ptr + offset);
+        if (header->magic != ATOMIC_ARENA_MAGIC)
+        {
+            Sys_FatalError("CheckAtomicArena: block header at offset %llu of %s was overwritten\n", (u64)offset, a->name);
+        }
+
+        const u8* data = (const u8*)(header + 1);
+        const size_t end = ALIGN_UP(header->size, ARENA_ALIGNMENT) + ATOMIC_ARENA_GUARD_SIZE;
+        for (size_t i = header->size; i < end; ++i)
+        {
+            if (data[i] != ATOMIC_ARENA_GUARD_BYTE)
+            {
+                Sys_FatalError("CheckAtomicArena: write past the end of a %s block at offset %llu of %s\n", FormatBytes(header->size), (u64)offset, a->name);
+            }
+        }
+
+        offset += sizeof(AtomicBlockHeader) + end;
+    }
+#endif
+}
+
+void* AtomicPushSizeDebug(AtomicArena* a, size_t size)
+{
+    const s64 blockSize = (s64)(sizeof(AtomicBlockHeader) + ALIGN_UP(size, ARENA_ALIGNMENT) + ATOMIC_ARENA_GUARD_SIZE);
+    const s64 end = Sys_AtomicAdd64(&a->mem_used, blockSize);
+    if (end > (s64)a->size)
+    {
+        Sys_FatalError("AtomicPushSize failed. Tried pushing %s to: %s.\nLimit is: %s\n", FormatBytes(size), a->name, FormatBytes(a->size));
+    }
+
+    AtomicBlockHeader* header = (AtomicBlockHeader*)(a->base_ptr + (end - blockSize));
+    header->size = size;
+    header->magic = ATOMIC_ARENA_MAGIC;
+    u8* data = (u8*)(header + 1);
+    memset(data + size, ATOMIC_ARENA_GUARD_BYTE, (size_t)blockSize - sizeof(AtomicBlockHeader) - size);
+
+    return data;
+}
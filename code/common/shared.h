@@ -142,14 +142,6 @@ struct ClientInput
     f32 dt;
 };
 
-struct SystemMemory
-{
-    u64 permanentStorageSize;
-    void* permanentStorage;
-    u64 transientStorageSize;
-    void* transientStorage;
-};
-
 struct FolderScan;
 
 FolderScan* Sys_FolderScan_Begin(const char* dir, const char* type);
@@ -157,6 +149,30 @@ bool Sys_FolderScan_Next(const char** fileName, const char** filePath, FolderSca
 void Sys_FolderScan_End(FolderScan* fs);
 // the data must be deallocated with free
 bool Sys_ReadDataFromFile(void** data, size_t* size, const char* filePath);
+bool Sys_IsDirectory(const char* path);
+
+// read-only view of a whole file
+struct MappedFile
+{
+    const void* data;
+    u64 size;
+    void* file;
+    void* mapping;
+};
+
+bool Sys_MapFile(MappedFile* mappedFile, const char* filePath);
+void Sys_UnmapFile(MappedFile* mappedFile);
+
+// virtual memory, reserved ranges can be committed and decommitted in pieces
+void* Sys_ReserveMemory(u64 size);
+bool Sys_CommitMemory(void* address, u64 size);
+void Sys_DecommitMemory(void* address, u64 size);
+void Sys_ReleaseMemory(void* address);
+
+// positional reads, they don't move a shared file pointer
+void* Sys_OpenFileForReading(const char* filePath, u64* size);
+bool Sys_ReadFileAt(void* file, void* buffer, u64 offset, u64 size);
+void Sys_CloseFile(void* file);
 
 u64 Sys_GetTimestamp();
 u64 Sys_GetElapsedMilliseconds(u64 startTimestamp);
@@ -164,6 +180,39 @@ u64 Sys_GetElapsedMicroseconds(u64 startTimestamp);
 void Sys_FatalError(const char* format, ...);
 void Sys_Quit();
 
+struct Thread;
+typedef void (*ThreadFunc)(void* userData);
+
+u32 Sys_GetCoreCount();
+Thread* Sys_CreateThread(ThreadFunc function, void* userData);
+// waits for the thread to finish and releases the handle
+void Sys_JoinThread(Thread* thread);
+// returns the incremented value
+s32 Sys_AtomicIncrement(volatile s32* value);
+// returns the new value
+s64 Sys_AtomicAdd64(volatile s64* value, s64 amount);
+
+// a zero-initialized Mutex is unlocked, it doesn't need to be created or destroyed
+struct Mutex
+{
+    void* handle;
+};
+
+void Sys_LockMutex(Mutex* mutex);
+void Sys_UnlockMutex(Mutex* mutex);
+
+struct Semaphore;
+
+Semaphore* Sys_CreateSemaphore(u32 initialCount);
+void Sys_DestroySemaphore(Semaphore* semaphore);
+// blocks until the count is positive and decrements it
+void Sys_WaitSemaphore(Semaphore* semaphore);
+// decrements the count if it's positive, never blocks
+bool Sys_TryWaitSemaphore(Semaphore* semaphore);
+void Sys_SignalSemaphore(Semaphore* semaphore, u32 count);
+// gives the rest of the time slice to another thread
+void Sys_YieldThread();
+
 // You can do almost anything with:
 // 1: Strechy buffers
 // 2: Pointer/uintptr hash tables (uintptr -> uintptr key-value mapping)
@@ -193,37 +242,69 @@ struct KeyCode
 };
 
 // Memory arenas
+// An arena either sits on memory it was handed (AllocateArena) or reserves an address range
+// and commits pages as it grows (AllocateVirtualArena). A sub-arena of a virtual arena is
+// virtual as well: the parent only gives it address space.
 typedef struct
 {
     const char* name;
     u8* base_ptr;
-    size_t size;
+    size_t size; // reserved size for virtual arenas
     size_t mem_used;
+    size_t committed; // [0; committed[ is usable, always size for non-virtual arenas
 
     u32 temp_count; // the amount of times we allocated some memory that should be deleted again
+    bool is_virtual;
+
+    // largest mem_used at the end of a temporary scope, in the current and the last window of
+    // ARENA_DECOMMIT_WINDOW scopes, EndTemporaryMemory keeps these pages committed
+    size_t recent_high_water[2];
+    u32 num_recent_scopes;
+
+    // telemetry, see GetArenaReport
+    size_t high_water; // largest mem_used
+    size_t committed_bytes; // committed by this arena, sub-arenas count their own pages
+    size_t padding_bytes; // skipped to align allocations
+    u64 num_allocations;
 } MemoryArena;
 
 typedef struct
 {
     MemoryArena* arena;
     size_t mem_used;
+    u32 temp_count; // of the arena before this one began
 } TemporaryMemory;
 
-inline void* GrowArena(MemoryArena* a, size_t size)
-{
-    assert(a->mem_used + size <= a->size);
-    u8* result = a->base_ptr + a->mem_used;
-    a->mem_used += size;
-    return (void*)result;
-}
+// debug builds check the order of temporary memory scopes and trash released memory,
+// see thread_arena.h for the checks of the thread-safe arenas
+#if defined(_DEBUG)
+#define ARENA_DEBUG 1
+#else
+#define ARENA_DEBUG 0
+#endif
+#define ARENA_RELEASED_BYTE 0xDD
+
+// pages are committed and decommitted in steps of this size, a multiple of the page size
+#define ARENA_COMMIT_SIZE Kilobytes(64)
+// EndTemporaryMemory gives pages back once this much committed memory is unused by the recent scopes
+#define ARENA_DECOMMIT_THRESHOLD Megabytes(4)
+// temporary scopes per window of recent_high_water
+#define ARENA_DECOMMIT_WINDOW 64
+
+void AllocateVirtualArena(MemoryArena* a, size_t reserveSize, const char* name);
+void FreeVirtualArena(MemoryArena* a);
+// commits pages until at least minCommitted bytes are usable
+void CommitArena(MemoryArena* a, size_t minCommitted);
+// gives back the pages after minCommitted, or after mem_used when that is larger
+void DecommitArena(MemoryArena* a, size_t minCommitted);
 
 inline void AllocateArena(MemoryArena* a, size_t size, void* base_ptr, const char* name)
 {
+    memset(a, 0, sizeof(*a));
     a->size = size;
+    a->committed = size;
     a->base_ptr = (u8*)base_ptr;
-    a->mem_used = 0;
     a->name = name;
-    a->temp_count = 0;
 }
 
 // At the end of a frame we want to make sure that we didn't forget to
@@ -241,6 +322,7 @@ inline TemporaryMemory BeginTemporaryMemory(MemoryArena* a)
     TemporaryMemory result;
     result.arena = a;
     result.mem_used = a->mem_used;
+    result.temp_count = a->temp_count;
     a->temp_count++;
     return result;
 }
@@ -253,9 +335,36 @@ inline void EndTemporaryMemory(TemporaryMemory temp)
 {
     MemoryArena* arena = temp.arena;
     assert(arena->temp_count > 0);
+    assert(arena->temp_count == temp.temp_count + 1); // the inner scope has to end first
     assert(arena->mem_used >= temp.mem_used);
+    const size_t scopeHighWater = arena->mem_used;
     arena->mem_used = temp.mem_used; // revert to the start;
     arena->temp_count--;
+
+    if (arena->is_virtual)
+    {
+        // The pages the recent scopes needed stay committed, so that an arena that is filled and
+        // emptied every frame doesn't decommit and commit them again every frame.
+        // A one-off peak is given back once it has left the windows.
+        const size_t keep = ALIGN_UP(MAX3(arena->mem_used, arena->recent_high_water[0], arena->recent_high_water[1]), ARENA_COMMIT_SIZE);
+        if (arena->committed > keep + ARENA_DECOMMIT_THRESHOLD)
+        {
+            DecommitArena(arena, keep);
+        }
+
+        arena->recent_high_water[0] = MAX(arena->recent_high_water[0], scopeHighWater);
+        if (++arena->num_recent_scopes == ARENA_DECOMMIT_WINDOW)
+        {
+            arena->recent_high_water[1] = arena->recent_high_water[0];
+            arena->recent_high_water[0] = 0;
+            arena->num_recent_scopes = 0;
+        }
+    }
+
+#if ARENA_DEBUG
+    // decommitted pages are gone already
+    memset(arena->base_ptr + temp.mem_used, ARENA_RELEASED_BYTE, MIN(scopeHighWater, arena->committed) - temp.mem_used);
+#endif
 }
 
 #define PushArray(arena, count, type) (type*)PushSize(arena, (count) * sizeof(type))
@@ -268,12 +377,29 @@ inline void* PushSize(MemoryArena* arena, size_t initSize)
     {
         Sys_FatalError("PushSize failed. Tried pushing %s to: %s.\nLimit is: %s\nAmount over limit: %s\n", FormatBytes(size), arena->name, FormatBytes(arena->size), FormatBytes((arena->mem_used + size) - arena->size));
     }
+    if ((arena->mem_used + size) > arena->committed)
+    {
+        CommitArena(arena, arena->mem_used + size);
+    }
     void* result = arena->base_ptr + arena->mem_used;
     arena->mem_used += size;
+    arena->num_allocations++;
+    if (arena->mem_used > arena->high_water)
+    {
+        arena->high_water = arena->mem_used;
+    }
     assert(size >= initSize);
     return result;
 }
 
+// skips bytes so that the next push is aligned, they are counted as padding
+inline void AlignArena(MemoryArena* arena, size_t alignment)
+{
+    const size_t aligned = ALIGN_UP(arena->mem_used, alignment);
+    arena->padding_bytes += aligned - arena->mem_used;
+    arena->mem_used = aligned;
+}
+
 inline u32 PushString(MemoryArena* arena, const char* string)
 {
     if (string == NULL)
@@ -286,13 +412,55 @@ inline u32 PushString(MemoryArena* arena, const char* string)
 
 inline void SubArena(MemoryArena* result, MemoryArena* arena, size_t size, const char* name)
 {
+    if (!arena->is_virtual)
+    {
+        AllocateArena(result, size, PushSize(arena, size), name);
+        return;
+    }
+
+    // the sub-arena gets whole commit steps of address space and commits them itself,
+    // so it can't be carved out of temporary memory that would decommit its pages
+    assert(arena->temp_count == 0);
+    AlignArena(arena, ARENA_COMMIT_SIZE);
+    size = ALIGN_UP(size, ARENA_COMMIT_SIZE);
+    if ((arena->mem_used + size) >= arena->size)
+    {
+        Sys_FatalError("SubArena failed. Tried reserving %s in: %s.\nLimit is: %s\n", FormatBytes(size), arena->name, FormatBytes(arena->size));
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->name = name;
+    result->base_ptr = arena->base_ptr + arena->mem_used;
     result->size = size;
-    result->base_ptr = (u8*)PushSize(arena, size);
-    result->mem_used = 0;
-    result->temp_count = 0;
-    result->name = 0;
+    result->is_virtual = true;
+
+    arena->mem_used += size;
+    arena->committed = MAX(arena->committed, arena->mem_used); // the parent mustn't commit these pages
+    arena->num_allocations++;
+    if (arena->mem_used > arena->high_water)
+    {
+        arena->high_water = arena->mem_used;
+    }
 }
 
+struct ArenaReport
+{
+    const char* name;
+    u64 reserved;
+    u64 committed;
+    u64 used;
+    u64 highWater;
+    u64 numAllocations;
+    u64 paddingBytes;
+    f32 budgetUsage; // high water / reserved
+    f32 fragmentation; // padding / high water
+};
+
+void GetArenaReport(ArenaReport* report, const MemoryArena* arena);
+// Tracked arenas are listed by GetTrackedArenaReports, they must outlive the tracking.
+void TrackArena(MemoryArena* arena);
+u32 GetTrackedArenaReports(ArenaReport* reports, u32 maxReports);
+
 inline u32 GetArenaSizeRemaining(MemoryArena* arena)
 {
     return arena->size - arena->mem_used;
@@ -457,10 +625,18 @@ void StripFileExtension(char* inout);
 
 char* fmt(const char* format, ...);
 bool FileExists(const char* filePath);
-bool ReadEntireFile(void** memoryBuffer, s32* size, const char* filePath);
+bool ReadEntireFile(void** memoryBuffer, size_t* size, const char* filePath);
 char* FormatBytes(u64 byteCount);
 
+#include "allocator.h"
+#include "atomic.h"
 #include "dynamic_array.h"
+#include "hash_map.h"
 #include "math.h"
+#include "pool.h"
+#include "ring_buffer.h"
+#include "simd.h"
 #include "static_array.h"
 #include "static_hash_map.h"
+#include "string_intern.h"
+#include "thread_arena.h"
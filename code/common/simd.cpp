@@ -0,0 +1,333 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+// The cofactors of one output column are 6 products of 3 different input rows,
+// each shuffled by a, b or c. This is the scalar Invert, 4 outputs at a time.
+static vec4 Cofactors(const vec4* a, const vec4* b, const vec4* c, u32 i, u32 j, u32 k, vec4 plus, vec4 minus)
+{
+    vec4 sum = FlipSign((a[i] * b[j]) * c[k], plus);
+    sum = sum + FlipSign((a[i] * c[j]) * b[k], minus);
+    sum = sum + FlipSign((a[j] * b[i]) * c[k], minus);
+    sum = sum + FlipSign((a[j] * c[i]) * b[k], plus);
+    sum = sum + FlipSign((a[k] * b[i]) * c[j], plus);
+    sum = sum + FlipSign((a[k] * c[i]) * b[j], minus);
+    return sum;
+}
+
+mat4 Invert(const mat4* input)
+{
+    vec4 a[4], b[4], c[4];
+    for (u32 r = 0; r < 4; ++r)
+    {
+        a[r] = Shuffle<1, 0, 0, 0>(input->rows[r]);
+        b[r] = Shuffle<2, 2, 1, 1>(input->rows[r]);
+        c[r] = Shuffle<3, 3, 3, 2>(input->rows[r]);
+    }
+
+    // the signs alternate down a column and flip from one column to the next
+    const vec4 even = Vec4(0.0f, -0.0f, 0.0f, -0.0f);
+    const vec4 odd = Vec4(-0.0f, 0.0f, -0.0f, 0.0f);
+    mat4 inv;
+    inv.rows[0] = Cofactors(a, b, c, 1, 2, 3, even, odd);
+    inv.rows[1] = Cofactors(a, b, c, 0, 2, 3, odd, even);
+    inv.rows[2] = Cofactors(a, b, c, 0, 1, 3, even, odd);
+    inv.rows[3] = Cofactors(a, b, c, 0, 1, 2, odd, even);
+
+    f32 p[4];
+    StoreVec4(p, input->rows[0] * inv.rows[0]);
+    f32 det = ((p[0] + p[1]) + p[2]) + p[3];
+
+    if (det == 0)
+        return *input;
+
+    det = 1.f / det;
+
+    const vec4 scale = Vec4Splat(det);
+    for (u32 r = 0; r < 4; ++r)
+    {
+        inv.rows[r] = inv.rows[r] * scale;
+    }
+
+    // we built the columns
+    return Transpose(inv);
+}
+
+mat4 InvertAffine(const mat4* input)
+{
+    const mat4 columns = Transpose(*input);
+    const vec4 r0 = Cross(columns.rows[1], columns.rows[2]);
+    const vec4 r1 = Cross(columns.rows[2], columns.rows[0]);
+    const vec4 r2 = Cross(columns.rows[0], columns.rows[1]);
+    f32 det = Dot3(columns.rows[0], r0);
+
+    if (det == 0)
+        return *input;
+
+    det = 1.f / det;
+
+    const vec4 scale = Vec4Splat(det);
+    mat4 output;
+    output.rows[0] = r0 * scale;
+    output.rows[1] = r1 * scale;
+    output.rows[2] = r2 * scale;
+    output.rows[3] = Vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // translation = -(rotation * t), one dot product per lane
+    const mat4 rotation = Transpose(output);
+    const vec4 t = columns.rows[3];
+    const vec4 translation = -((rotation.rows[0] * Shuffle<0, 0, 0, 0>(t) + rotation.rows[1] * Shuffle<1, 1, 1, 1>(t)) + rotation.rows[2] * Shuffle<2, 2, 2, 2>(t));
+    const vec4 w = Vec4Bits(0, 0, 0, 0xFFFFFFFF);
+    output.rows[0] = Select(output.rows[0], Shuffle<0, 0, 0, 0>(translation), w);
+    output.rows[1] = Select(output.rows[1], Shuffle<1, 1, 1, 1>(translation), w);
+    output.rows[2] = Select(output.rows[2], Shuffle<2, 2, 2, 2>(translation), w);
+
+    return output;
+}
+
+// 4 packed vec3_t to 3 registers of x, y and z
+static void LoadPoints(const vec3_t* points, vec4* x, vec4* y, vec4* z)
+{
+    const f32* v = &points->x;
+    const vec4 l0 = LoadVec4(v); // x0 y0 z0 x1
+    const vec4 l1 = LoadVec4(v + 4); // y1 z1 x2 y2
+    const vec4 l2 = LoadVec4(v + 8); // z2 x3 y3 z3
+    *x = Shuffle2<0, 3, 0, 2>(l0, Shuffle2<2, 2, 1, 1>(l1, l2));
+    *y = Shuffle2<0, 2, 0, 2>(Shuffle2<1, 1, 0, 0>(l0, l1), Shuffle2<3, 3, 2, 2>(l1, l2));
+    *z = Shuffle2<0, 2, 0, 3>(Shuffle2<2, 2, 1, 1>(l0, l1), l2);
+}
+
+static void StorePoints(vec3_t* points, vec4 x, vec4 y, vec4 z)
+{
+    f32* v = &points->x;
+    StoreVec4(v, Shuffle2<0, 2, 0, 2>(Shuffle2<0, 1, 0, 1>(x, y), Shuffle2<0, 0, 1, 1>(z, x)));
+    StoreVec4(v + 4, Shuffle2<0, 2, 0, 2>(Shuffle2<1, 1, 1, 1>(y, z), Shuffle2<2, 2, 2, 2>(x, y)));
+    StoreVec4(v + 8, Shuffle2<0, 2, 0, 2>(Shuffle2<2, 2, 3, 3>(z, x), Shuffle2<3, 3, 3, 3>(y, z)));
+}
+
+// one row of 'm' against 4 points, in the order of the scalar Transform
+static vec4 TransformRow(const vec4* row, vec4 x, vec4 y, vec4 z)
+{
+    return ((x * row[0] + y * row[1]) + z * row[2]) + row[3];
+}
+
+static void SplatRows(const m4x4* m, vec4 rows[3][4])
+{
+    for (u32 r = 0; r < 3; ++r)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            rows[r][c] = Vec4Splat(m->E[r][c]);
+        }
+    }
+}
+
+void TransformPoints(const m4x4* m, const vec3_t* input, vec3_t* output, u32 count)
+{
+    vec4 rows[3][4];
+    SplatRows(m, rows);
+
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        vec4 x, y, z;
+        LoadPoints(input + i, &x, &y, &z);
+        StorePoints(output + i, TransformRow(rows[0], x, y, z), TransformRow(rows[1], x, y, z), TransformRow(rows[2], x, y, z));
+    }
+
+    for (; i < count; ++i)
+    {
+        output[i] = Transform(*m, input[i]);
+    }
+}
+
+void TransformPoints(const m4x4* m, vec3_soa_t input, vec3_soa_t output, u32 count)
+{
+    vec4 rows[3][4];
+    SplatRows(m, rows);
+
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const vec4 x = LoadVec4(input.x + i);
+        const vec4 y = LoadVec4(input.y + i);
+        const vec4 z = LoadVec4(input.z + i);
+        StoreVec4(output.x + i, TransformRow(rows[0], x, y, z));
+        StoreVec4(output.y + i, TransformRow(rows[1], x, y, z));
+        StoreVec4(output.z + i, TransformRow(rows[2], x, y, z));
+    }
+
+    for (; i < count; ++i)
+    {
+        const vec3_t p = { input.x[i], input.y[i], input.z[i] };
+        const vec3_t R = Transform(*m, p);
+        output.x[i] = R.x;
+        output.y[i] = R.y;
+        output.z[i] = R.z;
+    }
+}
+
+void DotProducts(vec3_soa_t a, vec3_soa_t b, f32* output, u32 count)
+{
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const vec4 xx = LoadVec4(a.x + i) * LoadVec4(b.x + i);
+        const vec4 yy = LoadVec4(a.y + i) * LoadVec4(b.y + i);
+        const vec4 zz = LoadVec4(a.z + i) * LoadVec4(b.z + i);
+        StoreVec4(output + i, (xx + yy) + zz);
+    }
+
+    for (; i < count; ++i)
+    {
+        const vec3_t u = { a.x[i], a.y[i], a.z[i] };
+        const vec3_t v = { b.x[i], b.y[i], b.z[i] };
+        output[i] = dot(u, v);
+    }
+}
+
+void CrossProducts(vec3_soa_t a, vec3_soa_t b, vec3_soa_t output, u32 count)
+{
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const vec4 ax = LoadVec4(a.x + i);
+        const vec4 ay = LoadVec4(a.y + i);
+        const vec4 az = LoadVec4(a.z + i);
+        const vec4 bx = LoadVec4(b.x + i);
+        const vec4 by = LoadVec4(b.y + i);
+        const vec4 bz = LoadVec4(b.z + i);
+        StoreVec4(output.x + i, ay * bz - az * by);
+        StoreVec4(output.y + i, az * bx - ax * bz);
+        StoreVec4(output.z + i, ax * by - ay * bx);
+    }
+
+    for (; i < count; ++i)
+    {
+        const vec3_t u = { a.x[i], a.y[i], a.z[i] };
+        const vec3_t v = { b.x[i], b.y[i], b.z[i] };
+        const vec3_t R = cross(u, v);
+        output.x[i] = R.x;
+        output.y[i] = R.y;
+        output.z[i] = R.z;
+    }
+}
+
+void CullAABBs(const vec4_t* planes, u32 numPlanes, vec3_soa_t centers, vec3_soa_t extents, u8* visible, u32 count)
+{
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const vec4 cx = LoadVec4(centers.x + i);
+        const vec4 cy = LoadVec4(centers.y + i);
+        const vec4 cz = LoadVec4(centers.z + i);
+        const vec4 ex = LoadVec4(extents.x + i);
+        const vec4 ey = LoadVec4(extents.y + i);
+        const vec4 ez = LoadVec4(extents.z + i);
+
+        u32 outside = 0;
+        for (u32 p = 0; p < numPlanes && outside != 0xF; ++p)
+        {
+            const vec4 plane = LoadVec4(planes[p].v);
+            const vec4 nx = Shuffle<0, 0, 0, 0>(plane);
+            const vec4 ny = Shuffle<1, 1, 1, 1>(plane);
+            const vec4 nz = Shuffle<2, 2, 2, 2>(plane);
+            const vec4 distance = ((nx * cx + ny * cy) + nz * cz) + Shuffle<3, 3, 3, 3>(plane);
+            const vec4 radius = (Abs(nx) * ex + Abs(ny) * ey) + Abs(nz) * ez;
+            outside |= LessMask(distance + radius, Vec4Zero());
+        }
+
+        for (u32 b = 0; b < 4; ++b)
+        {
+            visible[i + b] = (outside & (1 << b)) == 0;
+        }
+    }
+
+    for (; i < count; ++i)
+    {
+        const vec3_t center = { centers.x[i], centers.y[i], centers.z[i] };
+        const vec3_t extent = { extents.x[i], extents.y[i], extents.z[i] };
+        visible[i] = AABBVisible(planes, numPlanes, center, extent);
+    }
+}
+
+void ComputeBounds(const vec3_t* points, u32 count, vec3_t* min, vec3_t* max)
+{
+    vec4 minX = Vec4Splat(FLT_MAX), minY = minX, minZ = minX;
+    vec4 maxX = Vec4Splat(-FLT_MAX), maxY = maxX, maxZ = maxX;
+
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        vec4 x, y, z;
+        LoadPoints(points + i, &x, &y, &z);
+        minX = Min(x, minX);
+        minY = Min(y, minY);
+        minZ = Min(z, minZ);
+        maxX = Max(x, maxX);
+        maxY = Max(y, maxY);
+        maxZ = Max(z, maxZ);
+    }
+
+    vec3_t lanesMin[4], lanesMax[4];
+    StorePoints(lanesMin, minX, minY, minZ);
+    StorePoints(lanesMax, maxX, maxY, maxZ);
+
+    vec3_t R0 = lanesMin[0], R1 = lanesMax[0];
+    for (u32 l = 1; l < 4; ++l)
+    {
+        for (u32 c = 0; c < 3; ++c)
+        {
+            if (lanesMin[l][c] < R0[c])
+                R0[c] = lanesMin[l][c];
+            if (lanesMax[l][c] > R1[c])
+                R1[c] = lanesMax[l][c];
+        }
+    }
+
+    for (; i < count; ++i)
+    {
+        for (u32 c = 0; c < 3; ++c)
+        {
+            if (points[i][c] < R0[c])
+                R0[c] = points[i][c];
+            if (points[i][c] > R1[c])
+                R1[c] = points[i][c];
+        }
+    }
+
+    *min = R0;
+    *max = R1;
+}
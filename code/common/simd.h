@@ -0,0 +1,391 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <emmintrin.h>
+
+// 4-wide SIMD on top of the scalar types in math.h.
+//
+// Every kernel does the same float operations in the same order as its scalar
+// counterpart (no FMA, no reassociation), so results are bit-identical to
+// math.h as long as the compiler leaves the scalar code alone (/fp:precise).
+// The exception is ComputeBounds, which may pick the other zero when both
+// -0 and +0 are present.
+//
+// Only the primitives section touches intrinsics. A NEON port only needs to
+// reimplement that section; everything below it is written in terms of vec4.
+
+#if !defined(_M_X64) && !defined(__SSE2__)
+#error "simd.h: no SIMD backend for this target"
+#endif
+
+//
+// primitives
+//
+
+struct vec4
+{
+    __m128 m;
+};
+
+inline vec4 Vec4(f32 x, f32 y, f32 z, f32 w)
+{
+    vec4 R = { _mm_setr_ps(x, y, z, w) };
+    return R;
+}
+
+inline vec4 Vec4Splat(f32 v)
+{
+    vec4 R = { _mm_set1_ps(v) };
+    return R;
+}
+
+inline vec4 Vec4Zero()
+{
+    vec4 R = { _mm_setzero_ps() };
+    return R;
+}
+
+// unaligned
+inline vec4 LoadVec4(const f32* v)
+{
+    vec4 R = { _mm_loadu_ps(v) };
+    return R;
+}
+
+inline void StoreVec4(f32* v, vec4 a)
+{
+    _mm_storeu_ps(v, a.m);
+}
+
+inline f32 GetX(vec4 a)
+{
+    return _mm_cvtss_f32(a.m);
+}
+
+// R = { a[X], a[Y], a[Z], a[W] }
+template <int X, int Y, int Z, int W>
+inline vec4 Shuffle(vec4 a)
+{
+    vec4 R = { _mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(W, Z, Y, X)) };
+    return R;
+}
+
+// R = { a[X], a[Y], b[Z], b[W] }
+template <int X, int Y, int Z, int W>
+inline vec4 Shuffle2(vec4 a, vec4 b)
+{
+    vec4 R = { _mm_shuffle_ps(a.m, b.m, _MM_SHUFFLE(W, Z, Y, X)) };
+    return R;
+}
+
+// lanes of 'mask' are all ones or all zeros, R = mask ? b : a
+inline vec4 Select(vec4 a, vec4 b, vec4 mask)
+{
+    vec4 R = { _mm_or_ps(_mm_andnot_ps(mask.m, a.m), _mm_and_ps(mask.m, b.m)) };
+    return R;
+}
+
+inline vec4 Vec4Bits(u32 x, u32 y, u32 z, u32 w)
+{
+    vec4 R = { _mm_castsi128_ps(_mm_setr_epi32((int)x, (int)y, (int)z, (int)w)) };
+    return R;
+}
+
+inline vec4 operator+(vec4 a, vec4 b)
+{
+    vec4 R = { _mm_add_ps(a.m, b.m) };
+    return R;
+}
+
+inline vec4 operator-(vec4 a, vec4 b)
+{
+    vec4 R = { _mm_sub_ps(a.m, b.m) };
+    return R;
+}
+
+inline vec4 operator*(vec4 a, vec4 b)
+{
+    vec4 R = { _mm_mul_ps(a.m, b.m) };
+    return R;
+}
+
+inline vec4 operator/(vec4 a, vec4 b)
+{
+    vec4 R = { _mm_div_ps(a.m, b.m) };
+    return R;
+}
+
+// a < b ? a : b per lane, like the scalar 'if (v < min) min = v'
+inline vec4 Min(vec4 a, vec4 b)
+{
+    vec4 R = { _mm_min_ps(a.m, b.m) };
+    return R;
+}
+
+inline vec4 Max(vec4 a, vec4 b)
+{
+    vec4 R = { _mm_max_ps(a.m, b.m) };
+    return R;
+}
+
+// flips the sign bit where 'mask' has it set
+inline vec4 FlipSign(vec4 a, vec4 mask)
+{
+    vec4 R = { _mm_xor_ps(a.m, mask.m) };
+    return R;
+}
+
+inline vec4 Abs(vec4 a)
+{
+    vec4 R = { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.m) };
+    return R;
+}
+
+// bit i is set when a[i] < b[i]
+inline u32 LessMask(vec4 a, vec4 b)
+{
+    return (u32)_mm_movemask_ps(_mm_cmplt_ps(a.m, b.m));
+}
+
+// bit i is set when a[i] <= b[i]
+inline u32 LessEqualMask(vec4 a, vec4 b)
+{
+    return (u32)_mm_movemask_ps(_mm_cmple_ps(a.m, b.m));
+}
+
+// rounds toward -infinity like floor(), lanes must fit in an s32 and -0 becomes +0
+inline vec4 Floor(vec4 a)
+{
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.m));
+    const __m128 correction = _mm_and_ps(_mm_cmpgt_ps(truncated, a.m), _mm_set1_ps(1.0f));
+    vec4 R = { _mm_sub_ps(truncated, correction) };
+    return R;
+}
+
+// rows become columns
+inline void Transpose(vec4* r0, vec4* r1, vec4* r2, vec4* r3)
+{
+    _MM_TRANSPOSE4_PS(r0->m, r1->m, r2->m, r3->m);
+}
+
+// 4 bytes become floats in [0;255]
+inline vec4 LoadBytes(const u8* v)
+{
+    s32 bits;
+    memcpy(&bits, v, sizeof(bits));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero);
+    vec4 R = { _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)) };
+    return R;
+}
+
+// truncates like a (u8) cast, lanes must be in [0;256[
+inline void StoreBytes(u8* v, vec4 a)
+{
+    const __m128i ints = _mm_cvttps_epi32(a.m);
+    const __m128i words = _mm_packs_epi32(ints, ints);
+    const s32 bits = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    memcpy(v, &bits, sizeof(bits));
+}
+
+// 4 half floats, same results as F16ToF32
+inline vec4 LoadHalf4(const u16* v)
+{
+    const __m128i halves = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)v), _mm_setzero_si128());
+    const __m128i shiftedExponent = _mm_set1_epi32(0x7C00 << 13);
+    __m128i bits = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x7FFF)), 13);
+    const __m128i exponent = _mm_and_si128(bits, shiftedExponent);
+    bits = _mm_add_epi32(bits, _mm_set1_epi32((127 - 15) << 23));
+
+    // infinity and NaN keep the maximum exponent
+    const __m128i infNaN = _mm_cmpeq_epi32(exponent, shiftedExponent);
+    bits = _mm_add_epi32(bits, _mm_and_si128(infNaN, _mm_set1_epi32((128 - 16) << 23)));
+
+    // denormals are renormalized by a float subtraction
+    const __m128i denormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+    const __m128 renormalized = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(1 << 23))), _mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+    bits = _mm_or_si128(_mm_andnot_si128(denormal, bits), _mm_and_si128(denormal, _mm_castps_si128(renormalized)));
+
+    bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x8000)), 16));
+    vec4 R = { _mm_castsi128_ps(bits) };
+    return R;
+}
+
+// 4 half floats rounded to nearest even, same results as F32ToF16
+inline void StoreHalf4(u16* v, vec4 a)
+{
+    __m128i bits = _mm_castps_si128(a.m);
+    const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(0x80000000));
+    bits = _mm_xor_si128(bits, sign);
+
+    // denormals: adding a magic number lines the mantissa up and rounds it
+    const __m128i denormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i denormalResult = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(denormalMagic))), denormalMagic);
+
+    // normals: rebias the exponent and round the 13 dropped bits, overflows become infinity
+    const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+    const __m128i normalResult = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(-((127 - 15) << 23) + 0xFFF)), mantissaOdd), 13);
+
+    const __m128i infNaNResult = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(_mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7F800000)), _mm_set1_epi32(0x0200)));
+
+    const __m128i isDenormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+    const __m128i isInfNaN = _mm_cmpgt_epi32(bits, _mm_set1_epi32(((127 + 16) << 23) - 1));
+    __m128i result = _mm_or_si128(_mm_andnot_si128(isDenormal, normalResult), _mm_and_si128(isDenormal, denormalResult));
+    result = _mm_or_si128(_mm_andnot_si128(isInfNaN, result), _mm_and_si128(isInfNaN, infNaNResult));
+    result = _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+
+    // sign extend so that the signed saturation keeps the 16 bits
+    result = _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+    _mm_storel_epi64((__m128i*)v, _mm_packs_epi32(result, result));
+}
+
+//
+// vec4
+//
+
+inline vec4 operator-(vec4 a)
+{
+    return FlipSign(a, Vec4Splat(-0.0f));
+}
+
+inline vec4 LoadVec3(vec3_t v, f32 w)
+{
+    return Vec4(v.x, v.y, v.z, w);
+}
+
+inline vec3_t StoreVec3(vec4 a)
+{
+    f32 v[4];
+    StoreVec4(v, a);
+    vec3_t R = { v[0], v[1], v[2] };
+    return R;
+}
+
+// same order as dot()
+inline f32 Dot3(vec4 a, vec4 b)
+{
+    const vec4 p = a * b;
+    return (GetX(p) + GetX(Shuffle<1, 1, 1, 1>(p))) + GetX(Shuffle<2, 2, 2, 2>(p));
+}
+
+// w is 0
+inline vec4 Cross(vec4 a, vec4 b)
+{
+    return Shuffle<1, 2, 0, 3>(a) * Shuffle<2, 0, 1, 3>(b) - Shuffle<2, 0, 1, 3>(a) * Shuffle<1, 2, 0, 3>(b);
+}
+
+//
+// mat4, row-major like m4x4
+//
+
+struct mat4
+{
+    vec4 rows[4];
+};
+
+inline mat4 LoadMat4(const m4x4* a)
+{
+    mat4 R;
+    for (u32 r = 0; r < 4; ++r)
+    {
+        R.rows[r] = LoadVec4(a->E[r]);
+    }
+    return R;
+}
+
+inline m4x4 StoreMat4(const mat4& a)
+{
+    m4x4 R;
+    for (u32 r = 0; r < 4; ++r)
+    {
+        StoreVec4(R.E[r], a.rows[r]);
+    }
+    return R;
+}
+
+inline mat4 Transpose(const mat4& a)
+{
+    mat4 R = a;
+    Transpose(&R.rows[0], &R.rows[1], &R.rows[2], &R.rows[3]);
+    return R;
+}
+
+// R.rows[r] = sum of a[r][i] * b.rows[i], starting from 0 like the scalar loop
+inline mat4 operator*(const mat4& a, const mat4& b)
+{
+    mat4 R;
+    for (u32 r = 0; r < 4; ++r)
+    {
+        const vec4 row = a.rows[r];
+        vec4 sum = Vec4Zero();
+        sum = sum + Shuffle<0, 0, 0, 0>(row) * b.rows[0];
+        sum = sum + Shuffle<1, 1, 1, 1>(row) * b.rows[1];
+        sum = sum + Shuffle<2, 2, 2, 2>(row) * b.rows[2];
+        sum = sum + Shuffle<3, 3, 3, 3>(row) * b.rows[3];
+        R.rows[r] = sum;
+    }
+    return R;
+}
+
+// 'columns' is Transpose(a), for transforming many points with the same matrix
+inline vec4 TransformPoint(const mat4& columns, vec4 p)
+{
+    return ((columns.rows[0] * Shuffle<0, 0, 0, 0>(p) + columns.rows[1] * Shuffle<1, 1, 1, 1>(p)) + columns.rows[2] * Shuffle<2, 2, 2, 2>(p)) + columns.rows[3];
+}
+
+// same results as the scalar Invert and InvertAffine
+mat4 Invert(const mat4* input);
+mat4 InvertAffine(const mat4* input);
+
+//
+// batch kernels, 4 items per iteration and the scalar path for the remainder
+//
+
+// structure of arrays
+struct vec3_soa_t
+{
+    f32* x;
+    f32* y;
+    f32* z;
+};
+
+void TransformPoints(const m4x4* m, const vec3_t* input, vec3_t* output, u32 count);
+void TransformPoints(const m4x4* m, vec3_soa_t input, vec3_soa_t output, u32 count);
+void DotProducts(vec3_soa_t a, vec3_soa_t b, f32* output, u32 count);
+void CrossProducts(vec3_soa_t a, vec3_soa_t b, vec3_soa_t output, u32 count);
+// visible[i] is AABBVisible for box i
+void CullAABBs(const vec4_t* planes, u32 numPlanes, vec3_soa_t centers, vec3_soa_t extents, u8* visible, u32 count);
+// count can be 0, which gives FLT_MAX / -FLT_MAX
+void ComputeBounds(const vec3_t* points, u32 count, vec3_t* min, vec3_t* max);
@@ -0,0 +1,175 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+// characters are appended to the current block, strings that don't fit in an empty block get their own allocation
+#define INTERN_BLOCK_SIZE Kilobytes(64)
+
+struct InternKey
+{
+    const char* string;
+    u32 length;
+    u32 hash;
+};
+
+struct InternKeyHash
+{
+    u32 operator()(const InternKey& key) const
+    {
+        return key.hash;
+    }
+};
+
+struct InternKeyEqual
+{
+    bool operator()(const InternKey& a, const InternKey& b) const
+    {
+        return a.hash == b.hash && a.length == b.length && memcmp(a.string, b.string, a.length) == 0;
+    }
+};
+
+// the hash map gives Local a constructor, internal linkage keeps it apart from other files' Local
+namespace
+{
+struct Local
+{
+    Mutex mutex;
+    HashMap<InternKey, const char*, InternKeyHash, InternKeyEqual> strings; // keys point to the interned copies
+    u8* block;
+    u32 blockUsed;
+    u64 usedBytes;
+};
+}
+
+static Local local;
+
+// same value as HashMapStringHash, without needing the null terminator
+static u32 HashRange(const char* string, u32 length)
+{
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (u8)string[i]) * 16777619u;
+    }
+    return HashMapMix(hash);
+}
+
+static char* AllocateString(u32 length)
+{
+    const u32 size = (u32)ALIGN_UP(sizeof(InternHeader) + length + 1, sizeof(InternHeader));
+    u8* memory;
+    if (size > INTERN_BLOCK_SIZE)
+    {
+        memory = (u8*)malloc(size);
+    }
+    else
+    {
+        if (local.block == NULL || local.blockUsed + size > INTERN_BLOCK_SIZE)
+        {
+            local.block = (u8*)malloc(INTERN_BLOCK_SIZE);
+            local.blockUsed = 0;
+        }
+        memory = local.block != NULL ? local.block + local.blockUsed : NULL;
+        local.blockUsed += size;
+    }
+
+    if (memory == NULL)
+    {
+        Sys_FatalError("Intern: failed to allocate %s\n", FormatBytes(size));
+    }
+
+    local.usedBytes += size;
+    return (char*)(memory + sizeof(InternHeader));
+}
+
+const char* Intern(const char* string)
+{
+    if (string == NULL)
+    {
+        return NULL;
+    }
+
+    return InternRange(string, (u32)strlen(string));
+}
+
+const char* InternRange(const char* string, u32 length)
+{
+    InternKey key;
+    key.string = string;
+    key.length = length;
+    key.hash = HashRange(string, length);
+
+    Sys_LockMutex(&local.mutex);
+
+    const char* interned;
+    const char* const* found = local.strings.Find(key);
+    if (found != NULL)
+    {
+        interned = *found;
+    }
+    else
+    {
+        char* copy = AllocateString(length);
+        memcpy(copy, string, length);
+        copy[length] = '\0';
+        InternHeader* header = (InternHeader*)copy - 1;
+        header->hash = key.hash;
+        header->length = length;
+
+        key.string = copy;
+        local.strings.Insert(key, copy);
+        interned = copy;
+    }
+
+    Sys_UnlockMutex(&local.mutex);
+
+    return interned;
+}
+
+u32 Intern_GetCount()
+{
+    Sys_LockMutex(&local.mutex);
+    const u32 count = local.strings.Length();
+    Sys_UnlockMutex(&local.mutex);
+    return count;
+}
+
+u64 Intern_GetUsedBytes()
+{
+    Sys_LockMutex(&local.mutex);
+    const u64 usedBytes = local.usedBytes;
+    Sys_UnlockMutex(&local.mutex);
+    return usedBytes;
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+// Interned strings are stored once for the lifetime of the program and never move:
+// interning equal strings returns the same pointer, so interned strings compare with ==
+// and can be used as pointer keys. The hash and length are stored right before the characters.
+// Interning is thread-safe, reading an interned string needs no lock.
+
+struct InternHeader
+{
+    u32 hash; // HashMapStringHash of the characters
+    u32 length;
+};
+
+// NULL stays NULL
+const char* Intern(const char* string);
+// the range doesn't have to be null-terminated
+const char* InternRange(const char* string, u32 length);
+
+// only valid for pointers returned by Intern/InternRange
+inline u32 Intern_GetHash(const char* interned)
+{
+    return ((const InternHeader*)interned - 1)->hash;
+}
+
+inline u32 Intern_GetLength(const char* interned)
+{
+    return ((const InternHeader*)interned - 1)->length;
+}
+
+u32 Intern_GetCount(); // number of unique strings
+u64 Intern_GetUsedBytes(); // headers and characters
+
+// For HashMap<const char*, V, InternedStringHash> keyed by interned strings:
+// equality is the default pointer comparison and unlike pointer hashing,
+// the iteration order doesn't change from one run to the next.
+struct InternedStringHash
+{
+    u32 operator()(const char* interned) const
+    {
+        return Intern_GetHash(interned);
+    }
+};
@@ -0,0 +1,121 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+// Memory for threads.
+//
+// Every thread has a scratch arena for memory that doesn't outlive a scope, so that worker loops
+// don't have to allocate from the heap. It's a virtual arena: pages are committed the first time
+// they are used and then reused by the following scopes.
+//
+// An AtomicArena is a bump allocator that several threads push to at the same time, e.g. for
+// per-frame data. Pushing is one atomic add, there is no freeing besides resetting the whole
+// arena when no thread is using it anymore.
+//
+// With ARENA_DEBUG, leaving a thread with scratch memory still in use is a fatal error, and every
+// atomic allocation gets a header and guard bytes that are checked when the arena is reset, so
+// writes past the end of a block (into the next one) are caught.
+
+#define SCRATCH_ARENA_RESERVE Megabytes(256)
+
+// the calling thread's scratch arena, reserved the first time it's asked for
+MemoryArena* GetScratchArena();
+// Sys_CreateThread threads release theirs when they return, the main thread keeps it
+void FreeScratchArena();
+
+// TemporaryMemory on the calling thread's scratch arena, released at the end of the scope.
+// Push to scratch.arena, scopes nest.
+struct ScratchMemory
+{
+    MemoryArena* arena;
+    TemporaryMemory temp;
+
+    ScratchMemory()
+    {
+        arena = GetScratchArena();
+        temp = BeginTemporaryMemory(arena);
+    }
+
+    ~ScratchMemory()
+    {
+        EndTemporaryMemory(temp);
+    }
+
+private:
+    ScratchMemory(const ScratchMemory&);
+    ScratchMemory& operator=(const ScratchMemory&);
+};
+
+struct AtomicArena
+{
+    const char* name;
+    u8* base_ptr;
+    size_t size;
+    volatile s64 mem_used;
+
+    // telemetry, updated by ResetAtomicArena
+    size_t high_water;
+};
+
+#define ATOMIC_ARENA_GUARD_BYTE 0xFD
+
+// The arena doesn't own the memory, carve it out of a MemoryArena with PushSize.
+void AllocateAtomicArena(AtomicArena* a, size_t size, void* base_ptr, const char* name);
+// No thread may push during a reset. Checks the guard bytes with ARENA_DEBUG.
+void ResetAtomicArena(AtomicArena* a);
+// Walks the allocations and checks their guard bytes, does nothing without ARENA_DEBUG.
+// No thread may push during the check.
+void CheckAtomicArena(const AtomicArena* a);
+void* AtomicPushSizeDebug(AtomicArena* a, size_t size);
+
+// thread-safe and lock-free, the result is aligned to ARENA_ALIGNMENT
+inline void* AtomicPushSize(AtomicArena* a, size_t size)
+{
+#if ARENA_DEBUG
+    return AtomicPushSizeDebug(a, size);
+#else
+    const s64 blockSize = (s64)ALIGN_UP(size, ARENA_ALIGNMENT);
+    const s64 end = Sys_AtomicAdd64(&a->mem_used, blockSize);
+    if (end > (s64)a->size)
+    {
+        Sys_FatalError("AtomicPushSize failed. Tried pushing %s to: %s.\nLimit is: %s\n", FormatBytes(size), a->name, FormatBytes(a->size));
+    }
+
+    return a->base_ptr + (end - blockSize);
+#endif
+}
+
+#define AtomicPushArray(arena, count, type) (type*)AtomicPushSize(arena, (count) * sizeof(type))
+#define AtomicPushStruct(arena, type) (type*)AtomicPushSize((arena), sizeof(type))
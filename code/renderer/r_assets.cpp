@@ -34,55 +34,78 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "r_private.h"
 
-#define DDSKTX_IMPLEMENT
-#include "../dds-ktx/dds-ktx.h"
-
 AssetsSharedData assetsShared;
 
-unsigned long HashTextureName(const char* str)
+// A streamed texture only has mips [firstMip; num_mips[ in video memory.
+// The file stays open so that finer mips can be read and uploaded later on.
+struct StreamedTexture
 {
-    unsigned long hash = 5381;
-    int c;
-
-    while (c = *str++)
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    ID3D11Texture2D* texture;
+    ID3D11ShaderResourceView* view;
+    DXGI_FORMAT format;
+    u32 firstMip;
+    TextureFile file;
+    Handle<TextureSlot> slot;
+    char name[MAX_PATH];
+};
 
-    return hash;
+namespace
+{
+struct Local
+{
+    StreamedTexture textures[RESIDENCY_MAX_TEXTURES];
+    u32 numTextures;
+    DynamicArray<RenderAABB> meshBounds; // one per MeshFileMesh of the current scene
+    ResourceArray created;
+    DynamicArray<u8> mipData; // read buffer for mips of loose files, reused across uploads
+};
 }
 
-static void CreateTexture(ID3D11Texture2D** tex, ID3D11ShaderResourceView** texSRV, ddsktx_texture_info* tc, void* fileData, s32 size, const char* fileName)
+static Local local;
+
+static DXGI_FORMAT GetTextureFormat(ddsktx_format format)
 {
-    DXGI_FORMAT format;
-    switch (tc->format)
+    switch (format)
     {
     case DDSKTX_FORMAT_BC7:
-        format = DXGI_FORMAT_BC7_UNORM;
-        break;
+        return DXGI_FORMAT_BC7_UNORM;
     case DDSKTX_FORMAT_BC5:
-        format = DXGI_FORMAT_BC5_UNORM;
-        break;
+        return DXGI_FORMAT_BC5_UNORM;
     case DDSKTX_FORMAT_BC4:
-        format = DXGI_FORMAT_BC4_UNORM;
-        break;
+        return DXGI_FORMAT_BC4_UNORM;
     default:
         assert(0);
+        return DXGI_FORMAT_UNKNOWN;
     }
+}
+
+static u32 GetBlockBytes(DXGI_FORMAT format)
+{
+    return format == DXGI_FORMAT_BC4_UNORM ? 8 : 16;
+}
+
+// (Re-)creates the texture with mips [firstMip; num_mips[.
+// Mips that were already resident are copied on the GPU, the others are uploaded from the file data.
+static void CreateStreamedTexture(StreamedTexture* st, u32 firstMip)
+{
+    const ddsktx_texture_info* tc = &st->file.info;
+    assert(firstMip < (u32)tc->num_mips);
 
     D3D11_TEXTURE2D_DESC texDesc;
     ZeroMemory(&texDesc, sizeof(texDesc));
     texDesc.ArraySize = 1;
     texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
     texDesc.CPUAccessFlags = 0;
-    texDesc.Format = format;
+    texDesc.Format = st->format;
     texDesc.Usage = D3D11_USAGE_DEFAULT;
-    texDesc.Width = tc->width;
-    texDesc.Height = tc->height;
-    texDesc.MipLevels = 0;
+    texDesc.Width = MAX(tc->width >> firstMip, 1);
+    texDesc.Height = MAX(tc->height >> firstMip, 1);
+    texDesc.MipLevels = tc->num_mips - firstMip;
     texDesc.SampleDesc.Count = 1;
     texDesc.SampleDesc.Quality = 0;
     texDesc.MiscFlags = 0;
 
-    *tex = CreateTexture2D(&d3d.persistent, &texDesc, NULL, fmt("%s", fileName));
+    ID3D11Texture2D* texture = CreateTexture2D(&local.created, &texDesc, NULL, st->name);
 
     D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
     ZeroMemory(&viewDesc, sizeof(viewDesc));
@@ -92,15 +115,142 @@ static void CreateTexture(ID3D11Texture2D** tex, ID3D11ShaderResourceView** texS
     viewDesc.Texture2DArray.ArraySize = 1;
     viewDesc.Texture2DArray.MostDetailedMip = 0;
 
-    *texSRV = CreateShaderResourceView(&d3d.persistent, *tex, &viewDesc, fmt("%s", fileName));
+    ID3D11ShaderResourceView* view = CreateShaderResourceView(&local.created, texture, &viewDesc, st->name);
+    local.created.Clear(); // owned by the streamed texture, see ReleaseStreamedTextures
+
+    for (u32 m = firstMip; m < (u32)tc->num_mips; ++m)
+    {
+        if (st->texture != NULL && m >= st->firstMip)
+        {
+            d3ds.context->CopySubresourceRegion(texture, m - firstMip, 0, 0, 0, st->texture, m - st->firstMip, NULL);
+            continue;
+        }
+
+        local.mipData.Fit(st->file.mips[m].size);
+        const void* data = TextureFile_ReadMip(&st->file, m, local.mipData.GetStart());
+        if (data == NULL)
+        {
+            Sys_FatalError("Failed to read mip %u of %s", m, st->name);
+        }
+        d3ds.context->UpdateSubresource(texture, m - firstMip, NULL, data, st->file.mips[m].rowPitch, 0);
+    }
+
+    TextureSlot* slot = assetsShared.textures.Get(st->slot);
+    assert(slot != NULL);
+    slot->texture = texture;
+    slot->view = view;
+
+    COM_RELEASE(st->view);
+    COM_RELEASE(st->texture);
+    st->texture = texture;
+    st->view = view;
+    st->firstMip = firstMip;
+}
+
+// Only the mip tail is uploaded here, finer mips are streamed in by UpdateTextureStreaming.
+static void AddStreamedTexture(const TextureFile* file, const char* fileName, Handle<TextureSlot> slot)
+{
+    assert(local.numTextures < RESIDENCY_MAX_TEXTURES);
+
+    StreamedTexture* st = &local.textures[local.numTextures];
+    st->texture = NULL;
+    st->view = NULL;
+    st->file = *file;
+    st->slot = slot;
+    st->format = GetTextureFormat(file->info.format);
+    strncpy(st->name, fileName, sizeof(st->name) - 1);
+
+    const ddsktx_texture_info* tc = &file->info;
+    const u32 index = Residency_AddTexture(&assetsShared.textureResidency, tc->width, tc->height, tc->num_mips, GetBlockBytes(st->format));
+    assert(index == local.numTextures);
+    CreateStreamedTexture(st, assetsShared.textureResidency.textures[index].residentMip);
+
+    assetsShared.textures.Get(slot)->streamedTexture = ++local.numTextures;
+}
+
+static void ComputeMeshBounds(Scene* scene)
+{
+    local.meshBounds.Clear();
+    for (u32 m = 0; m < scene->meshes.Length(); ++m)
+    {
+        const MeshFileMesh* mesh = &scene->meshes[m];
+        RenderAABB bounds;
+        bounds.min.x = bounds.min.y = bounds.min.z = FLT_MAX;
+        bounds.max.x = bounds.max.y = bounds.max.z = -FLT_MAX;
+        for (u32 i = mesh->firstIndex; i < mesh->firstIndex + mesh->numIndexes; ++i)
+        {
+            const vec3_t p = scene->xyz[scene->indexes[i]];
+            bounds.min.x = MIN(bounds.min.x, p.x);
+            bounds.min.y = MIN(bounds.min.y, p.y);
+            bounds.min.z = MIN(bounds.min.z, p.z);
+            bounds.max.x = MAX(bounds.max.x, p.x);
+            bounds.max.y = MAX(bounds.max.y, p.y);
+            bounds.max.z = MAX(bounds.max.z, p.z);
+        }
+        local.meshBounds.Push(bounds);
+    }
+}
+
+void UpdateTextureStreaming(RenderCommandQueue* cmdQueue, Scene* scene)
+{
+    TextureResidency* residency = &assetsShared.textureResidency;
+    if (residency->numTextures == 0 || local.meshBounds.Length() != scene->meshes.Length())
+    {
+        return;
+    }
+
+    // pixels per world unit at distance 1
+    const f32 projScale = cmdQueue->projectionMatrix.E[1][1] * 0.5f * (f32)r_videoConfig.height;
+
+    Residency_BeginFrame(residency);
+    for (u32 m = 0; m < scene->meshes.Length(); ++m)
+    {
+        const MeshFileMesh* mesh = &scene->meshes[m];
+        const Material* material = &scene->materials[mesh->materialIndex];
+        const RenderAABB* bounds = &local.meshBounds[m];
+        const f32 projectedSize = Residency_ProjectedSize(bounds->min, bounds->max, cmdQueue->cameraPosition, projScale);
+        for (u32 t = 0; t < TextureId::Count; ++t)
+        {
+            const TextureSlot* slot = assetsShared.textures.Get(material->textures[t]);
+            if (slot != NULL && slot->streamedTexture != 0)
+            {
+                Residency_Request(residency, slot->streamedTexture - 1, projectedSize);
+            }
+        }
+    }
+
+    ResidencyChange changes[RESIDENCY_MAX_TEXTURES];
+    const u32 numChanges = Residency_Update(residency, changes, ARRAY_LEN(changes));
+    for (u32 c = 0; c < numChanges; ++c)
+    {
+        CreateStreamedTexture(&local.textures[changes[c].textureIndex], changes[c].newMip);
+    }
+}
 
-    for (int m = 0; m < tc->num_mips; ++m)
+void ReleaseStreamedTextures()
+{
+    for (u32 i = 0; i < local.numTextures; ++i)
     {
-        ddsktx_sub_data subData;
-        ddsktx_get_sub(tc, &subData, fileData, size, 0, 0, m);
+        StreamedTexture* st = &local.textures[i];
+        COM_RELEASE(st->view);
+        COM_RELEASE(st->texture);
+        TextureFile_Close(&st->file);
+        assetsShared.textures.Free(st->slot);
+    }
+    local.numTextures = 0;
+    Residency_RemoveAllTextures(&assetsShared.textureResidency);
+    assetsShared.textureMap.Clear();
+}
 
-        d3ds.context->UpdateSubresource(*tex, m, NULL, subData.buff, subData.row_pitch_bytes, 0);
+ID3D11ShaderResourceView* GetMaterialTextureView(const Material* material, TextureId::Type id)
+{
+    const TextureSlot* slot = assetsShared.textures.Get(material->textures[id]);
+    if (slot == NULL)
+    {
+        slot = assetsShared.textures.Get(assetsShared.defaultTextures[id]);
     }
+
+    return slot->view;
 }
 
 static void CreateTexture(ID3D11Texture2D** tex, ID3D11ShaderResourceView** texSRV, Image* image)
@@ -140,118 +290,102 @@ static void CreateTexture(ID3D11Texture2D** tex, ID3D11ShaderResourceView** texS
     d3ds.context->GenerateMips(*texSRV);
 }
 
-void AllocateMeshTextures(Scene* mesh)
+static Handle<TextureSlot> AllocateTextureSlot()
 {
-    u64 timestampBegin = Sys_GetTimestamp();
+    const Handle<TextureSlot> handle = assetsShared.textures.Alloc();
+    if (handle.IsNull())
+    {
+        Sys_FatalError("Out of texture slots (%u)", MAX_TEXTURES);
+    }
+
+    TextureSlot* slot = assetsShared.textures.Get(handle);
+    ZeroMemory(slot, sizeof(*slot));
+
+    return handle;
+}
+
+// The default textures are created once and outlive every scene.
+static void CreateDefaultTextureSlots()
+{
+    if (!assetsShared.defaultTextures[0].IsNull())
+    {
+        return;
+    }
 
-    assert(assetsShared.numTextures + TextureId::Count <= MAX_TEXTURES);
     for (u32 textureIndex = 0; textureIndex < TextureId::Count; ++textureIndex)
     {
-        CreateTexture(&assetsShared.textures[assetsShared.numTextures], &assetsShared.textureViews[assetsShared.numTextures], &defaultTextures[textureIndex]);
-        assetsShared.numTextures++;
+        const Handle<TextureSlot> handle = AllocateTextureSlot();
+        TextureSlot* slot = assetsShared.textures.Get(handle);
+        CreateTexture(&slot->texture, &slot->view, &defaultTextures[textureIndex]);
+        assetsShared.defaultTextures[textureIndex] = handle;
+    }
+}
+
+// textures live next to the scene, in the asset pack or on disk
+static Handle<TextureSlot> LoadSceneTexture(const char* textureName, TextureId::Type id, const char* sceneDir)
+{
+    if (textureName == NULL)
+    {
+        return assetsShared.defaultTextures[id];
     }
 
-    if (assetsShared.newStrings.size == 0)
+    const Handle<TextureSlot>* cachedSlot = assetsShared.textureMap.Find(textureName);
+    if (cachedSlot != NULL)
     {
-        AllocateArena(&assetsShared.newStrings, Megabytes(4), malloc(Megabytes(4)), "string arena");
-        void* stringRegion = PushSize(&assetsShared.newStrings, mesh->strings.mem_used);
-        memcpy(stringRegion, mesh->strings.base_ptr, mesh->strings.mem_used);
-        assetsShared.newStrings.mem_used = mesh->strings.mem_used;
+        return *cachedSlot;
     }
 
-    if (assetsShared.oldStrings.size == 0)
+    const char* filePath = fmt("%s/textures/%s.dds", sceneDir, textureName);
+    TextureFile file;
+    if (!TextureFile_Open(&file, filePath))
     {
-        AllocateArena(&assetsShared.oldStrings, Megabytes(4), malloc(Megabytes(4)), "string arena");
-        void* stringRegion = PushSize(&assetsShared.oldStrings, mesh->strings.mem_used);
-        memcpy(stringRegion, mesh->strings.base_ptr, mesh->strings.mem_used);
-        assetsShared.oldStrings.mem_used = mesh->strings.mem_used;
+        OutputDebugStringA(fmt("failed to load texture: %s\n", filePath));
+        return assetsShared.defaultTextures[id];
     }
 
-    char oldDir[MAX_PATH];
-    GetCurrentDirectoryA(sizeof(oldDir), (LPSTR)&oldDir);
-    char fullPath[MAX_PATH + 1];
-    GetFullPathNameA("../bachelor/assets/Sponza", MAX_PATH, fullPath, NULL);
-    strcat(fullPath, "/");
-    SetCurrentDirectoryA(fullPath);
+    const Handle<TextureSlot> handle = AllocateTextureSlot();
+    AddStreamedTexture(&file, filePath, handle);
+    assetsShared.textureMap.Insert(textureName, handle);
+
+    return handle;
+}
+
+void AllocateMeshTextures(Scene* mesh)
+{
+    u64 timestampBegin = Sys_GetTimestamp();
+
+    CreateDefaultTextureSlots();
+
+    // only the current scene's textures are kept, the handles of the previous one become stale
+    ReleaseStreamedTextures();
+
+    char sceneDir[MAX_PATH];
+    GetDirectoryPath(sceneDir, mesh->name);
 
     for (u32 m = 0; m < mesh->fileMaterials.Length(); ++m)
     {
-        MeshFileMaterial* material = &mesh->fileMaterials[m];
-        Material newMaterial = {};
-        Vec3Copy(newMaterial.specular, material->specularColor);
-        newMaterial.specular.w = material->specularExponent;
-        newMaterial.flags |= material->flags & IS_ALPHA_TESTED;
-        Vec4Copy(newMaterial.alphaTestedColor, material->alphaTestedColor);
-
-        u32 filePathOffset[TextureId::Count] = {};
-        filePathOffset[TextureId::Albedo] = material->albedoOffset;
-        filePathOffset[TextureId::Bump] = material->normalOffset;
-        filePathOffset[TextureId::Specular] = material->specularOffset;
+        // a scene that is loaded again keeps the material settings edited since
+        if (m == mesh->materials.Length())
+        {
+            const MeshFileMaterial* fileMaterial = &mesh->fileMaterials[m];
+            Material newMaterial = {};
+            Vec3Copy(newMaterial.specular, fileMaterial->specularColor);
+            newMaterial.specular.w = fileMaterial->specularExponent;
+            newMaterial.flags |= fileMaterial->flags & IS_ALPHA_TESTED;
+            Vec4Copy(newMaterial.alphaTestedColor, fileMaterial->alphaTestedColor);
+            mesh->materials.Push(newMaterial);
+        }
 
+        Material* material = &mesh->materials[m];
+        const SceneMaterialNames* names = &mesh->materialNames[m];
         for (u32 t = 0; t < TextureId::Count; ++t)
         {
-            if (filePathOffset[t] == 0)
-            {
-                assert(assetsShared.numTextures < MAX_TEXTURES);
-                assetsShared.textures[assetsShared.numTextures] = assetsShared.textures[t];
-                assetsShared.textureViews[assetsShared.numTextures] = assetsShared.textureViews[t];
-                newMaterial.textureIndex[t] = assetsShared.numTextures++;
-                continue;
-            }
-
-            const char* filePath = (const char*)mesh->strings.base_ptr + filePathOffset[t];
-            u32 tHash = HashTextureName(filePath); // hash the file name only
-            filePath = fmt("textures/%s.dds", filePath); // now get the real file path
-            Image* hTexture = assetsShared.textureMap.TryGet(tHash);
-            static Image textures[MAX_TEXTURES] = {};
-            static u32 numTextures = 0;
-            if (hTexture == NULL)
-            {
-                // this helps diagnose invalid file names in debug builds
-                assert(FileExists(filePath));
-
-                void* fileData;
-                s32 size;
-                if (ReadEntireFile(&fileData, &size, filePath))
-                {
-
-                    ddsktx_texture_info tc = {};
-                    if (ddsktx_parse(&tc, fileData, size, NULL))
-                    {
-                        Image* texture = &textures[numTextures];
-                        texture->index = assetsShared.numTextures;
-                        CreateTexture(&assetsShared.textures[assetsShared.numTextures], &assetsShared.textureViews[assetsShared.numTextures], &tc, fileData, size, filePath);
-                        assetsShared.textureMap.Insert(tHash, texture);
-                        numTextures += 1;
-                    }
-                    else
-                    {
-                        assetsShared.textures[assetsShared.numTextures] = assetsShared.textures[t];
-                        assetsShared.textureViews[assetsShared.numTextures] = assetsShared.textureViews[t];
-                    }
-
-                    free(fileData);
-                }
-                else
-                {
-                    assetsShared.textures[assetsShared.numTextures] = assetsShared.textures[t];
-                    assetsShared.textureViews[assetsShared.numTextures] = assetsShared.textureViews[t];
-                }
-            }
-            else
-            {
-                assetsShared.textures[assetsShared.numTextures] = assetsShared.textures[hTexture->index];
-                assetsShared.textureViews[assetsShared.numTextures] = assetsShared.textureViews[hTexture->index];
-            }
-
-            assert(assetsShared.numTextures < MAX_TEXTURES);
-            newMaterial.textureIndex[t] = assetsShared.numTextures++;
+            material->textures[t] = LoadSceneTexture(names->textures[t], (TextureId::Type)t, sceneDir);
         }
-
-        mesh->materials.Push(newMaterial);
     }
 
-    SetCurrentDirectoryA(oldDir);
+    ComputeMeshBounds(mesh);
+
     u64 msElapsed = Sys_GetElapsedMilliseconds(timestampBegin);
     OutputDebugStringA(fmt("textures load: %.3f (ms)\n", msElapsed));
 }
@@ -291,6 +425,18 @@ void AddImmutableObject(DrawBuffer* buffer, Scene* m)
     buffer->numIndexes = m->indexes.Length();
 }
 
+static u32 PushMaterialString(MemoryArena* strings, HashMap<const char*, u32, InternedStringHash>* offsets, const char* interned)
+{
+    if (interned == NULL)
+        return 0;
+
+    const u32* offset = offsets->Find(interned);
+    if (offset != NULL)
+        return *offset;
+
+    return *offsets->Insert(interned, PushString(strings, interned));
+}
+
 void WriteBinaryMaterialToFile(Scene* scene, const char* filePath)
 {
     FILE* file = fopen(filePath, "wb");
@@ -309,18 +455,43 @@ void WriteBinaryMaterialToFile(Scene* scene, const char* filePath)
         Vec4Copy(fileMaterial->alphaTestedColor, currentMaterial->alphaTestedColor);
     }
 
+    // the string table is rebuilt from the interned names, so textures picked in the editor are saved too
+    // and strings shared by several materials are only written once
+    u32 maxStringBytes = 2; // the unused 0 offset and PushSize's limit
+    for (u32 m = 0; m < scene->materialNames.Length(); ++m)
+    {
+        const SceneMaterialNames* names = &scene->materialNames[m];
+        maxStringBytes += names->name != NULL ? Intern_GetLength(names->name) + 1 : 0;
+        for (u32 t = 0; t < TextureId::Count; ++t)
+        {
+            maxStringBytes += names->textures[t] != NULL ? Intern_GetLength(names->textures[t]) + 1 : 0;
+        }
+    }
+
+    MemoryArena strings;
+    AllocateArena(&strings, maxStringBytes, malloc(maxStringBytes), "material string arena");
+    strings.mem_used = 1; // 0 offset for null pointers
+    HashMap<const char*, u32, InternedStringHash> offsets;
+    for (u32 m = 0; m < scene->fileMaterials.Length(); ++m)
+    {
+        const SceneMaterialNames* names = &scene->materialNames[m];
+        MeshFileMaterial* fileMaterial = &scene->fileMaterials[m];
+        fileMaterial->materialOffset = PushMaterialString(&strings, &offsets, names->name);
+        fileMaterial->albedoOffset = PushMaterialString(&strings, &offsets, names->textures[TextureId::Albedo]);
+        fileMaterial->normalOffset = PushMaterialString(&strings, &offsets, names->textures[TextureId::Bump]);
+        fileMaterial->specularOffset = PushMaterialString(&strings, &offsets, names->textures[TextureId::Specular]);
+    }
+
     MaterialFileHeader hdr;
+    hdr.magic = MATERIAL_FILE_MAGIC;
+    hdr.version = MATERIAL_FILE_VERSION;
     hdr.numMaterials = scene->fileMaterials.Length();
-    hdr.numStringBytes = assetsShared.newStrings.mem_used;
+    hdr.numStringBytes = strings.mem_used;
 
     fwrite(&hdr, sizeof(hdr), 1, file);
     fwrite(scene->fileMaterials.GetStart(), scene->fileMaterials.UsedBytes(), 1, file);
-    fwrite(assetsShared.newStrings.base_ptr, assetsShared.newStrings.mem_used, 1, file);
-
-    MemoryArena temp;
-    temp = assetsShared.oldStrings;
-    assetsShared.oldStrings = assetsShared.newStrings;
-    assetsShared.newStrings = temp;
+    fwrite(strings.base_ptr, strings.mem_used, 1, file);
 
+    free(strings.base_ptr);
     fclose(file);
-}
\ No newline at end of file
+}
@@ -203,9 +203,9 @@ void GeometryPass_Draw(RenderCommandQueue* cmdQueue, DrawBuffer* drawBuffer)
         psData.normalStrength.x = r_backendFlags.normalStrength;
         SetShaderData(p->ps.buffers[0], psData);
 
-        p->ps.srvs[0] = assetsShared.textureViews[material->textureIndex[TextureId::Albedo]];
-        p->ps.srvs[1] = assetsShared.textureViews[material->textureIndex[TextureId::Bump]];
-        p->ps.srvs[2] = assetsShared.textureViews[material->textureIndex[TextureId::Specular]];
+        p->ps.srvs[0] = GetMaterialTextureView(material, TextureId::Albedo);
+        p->ps.srvs[1] = GetMaterialTextureView(material, TextureId::Bump);
+        p->ps.srvs[2] = GetMaterialTextureView(material, TextureId::Specular);
         p->ps.numSRVs = 3;
 
         SetPipeline(p, false);
@@ -200,15 +200,25 @@ static void EditLight(Light* light, vec3_t min, vec3_t max)
 
 static void RenderLightEditor(SceneAssets* assets)
 {
-    static s32 selectedLight = 0;
+    static Handle<Light> selectedLight = {};
 
     r_backendFlags.shouldUpdateDirectLight = true;
 
+    Pool<Light, MAX_LIGHTS>* lights = &assets->lights;
+    if (!lights->IsValid(selectedLight) && lights->Length() > 0)
+    {
+        selectedLight = lights->GetHandle(lights->GetLiveIndex(0));
+    }
+
     // Edit
     {
         ImGui::BeginChild("ChildL", { ImGui::GetWindowContentRegionWidth() * 0.65f, 300 }, false, ImGuiWindowFlags_None);
-        EditLight(&assets->lights[selectedLight], assets->meshes[assets->current_asset].aabb.min,
-            assets->meshes[assets->current_asset].aabb.max);
+        Light* light = lights->Get(selectedLight);
+        if (light != NULL)
+        {
+            EditLight(light, assets->meshes[assets->current_asset].aabb.min,
+                assets->meshes[assets->current_asset].aabb.max);
+        }
         ImGui::EndChild();
     }
 
@@ -219,16 +229,28 @@ static void RenderLightEditor(SceneAssets* assets)
         ImGui::BeginChild("ChildR", { 0, 300 }, true, ImGuiWindowFlags_None);
         if (ImGui::BeginTable("split", 1, ImGuiTableFlags_Resizable | ImGuiTableFlags_NoSavedSettings))
         {
-            for (int i = 0; i < assets->lights.Length(); i++)
+            for (u32 i = 0; i < lights->Length(); i++)
             {
                 ImGui::TableNextColumn();
                 if (ImGui::Button(fmt("light #%d", i + 1), ImVec2(-FLT_MIN, 0.0f)))
                 {
-                    selectedLight = i;
+                    selectedLight = lights->GetHandle(lights->GetLiveIndex(i));
                 }
             }
             ImGui::EndTable();
         }
+
+        // new lights start as a copy of the selected one
+        if (!lights->IsFull() && lights->IsValid(selectedLight) && ImGui::Button("Add", ImVec2(-FLT_MIN, 0.0f)))
+        {
+            const Light copy = *lights->Get(selectedLight);
+            selectedLight = lights->Alloc();
+            *lights->Get(selectedLight) = copy;
+        }
+        if (lights->Length() > 1 && ImGui::Button("Remove", ImVec2(-FLT_MIN, 0.0f)))
+        {
+            lights->Free(selectedLight);
+        }
         ImGui::EndChild();
     }
 }
@@ -495,6 +517,45 @@ static void RenderGPUTimings()
     }
 }
 
+static void RenderArenaReports()
+{
+    ArenaReport reports[32];
+    const u32 numReports = GetTrackedArenaReports(reports, ARRAY_LEN(reports));
+
+    int tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (ImGui::BeginTable("Memory arenas", 6, tableFlags))
+    {
+        ImGui::TableSetupColumn("arena", 0);
+        ImGui::TableSetupColumn("used", 0);
+        ImGui::TableSetupColumn("high water", 0);
+        ImGui::TableSetupColumn("committed", 0);
+        ImGui::TableSetupColumn("allocations", 0);
+        ImGui::TableSetupColumn("padding", 0);
+        ImGui::TableHeadersRow();
+
+        for (u32 i = 0; i < numReports; i++)
+        {
+            const ArenaReport* r = &reports[i];
+            ImGui::TableNextRow();
+            ImGui::PushID(i);
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", r->name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%s", FormatBytes(r->used));
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%s (%.1f%%)", FormatBytes(r->highWater), r->budgetUsage * 100.0f);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%s", FormatBytes(r->committed));
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%llu", r->numAllocations);
+            ImGui::TableSetColumnIndex(5);
+            ImGui::Text("%.2f%%", r->fragmentation * 100.0f);
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+}
+
 static void SelectSwapInterval()
 {
     ImGui::Text("Swap Interval");
@@ -551,6 +612,17 @@ static void RenderPerformance()
         ImGui::Text("Rendered  triangles: %d", renderStats.numRenderedTriangles);
         ImGui::Text("Voxelized triangles: %d", renderStats.numVoxelizedTriangles);
 
+        TextureResidency* residency = &assetsShared.textureResidency;
+        ImGui::Text("Resident textures: %s / %s", FormatBytes(residency->residentBytes), FormatBytes(residency->budgetBytes));
+        ImGui::Text("Streamed: %s (%d mips in, %d mips out)", FormatBytes(residency->uploadedBytes), residency->numPromoted, residency->numEvicted);
+        ImGui::Text("Read from disk: %s", FormatBytes(Asset_GetBytesRead()));
+        int budgetMB = (int)(residency->budgetBytes / Megabytes(1));
+        if (SmallSliderInt("Texture budget (MB)", &budgetMB, 1, 1024))
+        {
+            residency->budgetBytes = (u64)budgetMB * Megabytes(1);
+        }
+        SmallSliderFloat("Texture mip bias", &residency->mipBias, -2.0f, 4.0f);
+
         SelectSwapInterval();
 
         ImGui::Separator();
@@ -567,6 +639,12 @@ static void RenderPerformance()
             ImGui::TreePop();
             ImGui::Separator();
         }
+
+        if (ImGui::TreeNodeEx("Memory arenas", ImGuiTreeNodeFlags_None))
+        {
+            RenderArenaReports();
+            ImGui::TreePop();
+        }
     }
     ImGui::End();
 }
@@ -813,34 +891,22 @@ static void EditMaterial(Scene* scene, Material* material, u32 materialIndex)
             ImGui::SetWindowPos(ImGui::GetMousePos(), ImGuiCond_FirstUseEver);
             if (ImGui::BeginTable("split", 4, ImGuiTableFlags_Resizable | ImGuiTableFlags_NoSavedSettings))
             {
-                u8* begin = assetsShared.oldStrings.base_ptr;
-                u8* end = assetsShared.oldStrings.base_ptr + assetsShared.oldStrings.mem_used;
+                for (u32 s = 0; s < assetsShared.textureMap.Capacity(); ++s)
                 {
-                    while (++begin != end)
+                    if (!assetsShared.textureMap.IsSlotUsed(s))
+                    {
+                        continue;
+                    }
+
+                    const Handle<TextureSlot> textureSlot = *assetsShared.textureMap.GetValue(s);
+                    void* texView = (void*)assetsShared.textures.Get(textureSlot)->view;
+                    if (ImGui::ImageButton(texView, { 50, 50 }))
                     {
-                        const char* string = (const char*)begin;
-                        u32 sLen = strlen(string);
-                        
-                        unsigned long hash = HashTextureName(string);
-                        Image* hTexture = assetsShared.textureMap.TryGet(hash);
-                        if (hTexture != NULL)
-                        {
-                            void* texView = (void*)assetsShared.textureViews[hTexture->index];
-                            if (ImGui::ImageButton(texView, { 50, 50 }))
-                            {
-
-                                material->textureIndex[TextureId::Albedo] = hTexture->index;
-                                scene->fileMaterials[materialIndex].albedoOffset = PushString(&assetsShared.newStrings, string);
-                                isPicking = false;
-                            }
-                            ImGui::TableNextColumn();
-                        }
-
-                        if (sLen > 0)
-                        {
-                            begin += sLen;
-                        }
+                        material->textures[TextureId::Albedo] = textureSlot;
+                        scene->materialNames[materialIndex].textures[TextureId::Albedo] = assetsShared.textureMap.GetKey(s);
+                        isPicking = false;
                     }
+                    ImGui::TableNextColumn();
                 }
                 ImGui::EndTable();
             }
@@ -862,7 +928,7 @@ static void RenderMaterials(Scene* scene)
     
     // Preview
     {
-        void* texView = (void*)assetsShared.textureViews[scene->materials[selectedMaterial].textureIndex[TextureId::Albedo]];
+        void* texView = (void*)GetMaterialTextureView(&scene->materials[selectedMaterial], TextureId::Albedo);
         ImGui::Image(texView, { 250, 250 });
     }
 
@@ -876,7 +942,7 @@ static void RenderMaterials(Scene* scene)
             for (int i = 1; i < scene->fileMaterials.Length(); i++)
             {
                 ImGui::TableNextColumn();
-                if (ImGui::Button(fmt("%s", (const char*)scene->strings.base_ptr + scene->fileMaterials[i].materialOffset), ImVec2(-FLT_MIN, 0.0f)))
+                if (ImGui::Button(fmt("%s", scene->materialNames[i].name != NULL ? scene->materialNames[i].name : ""), ImVec2(-FLT_MIN, 0.0f)))
                 {
                     selectedMaterial = i;
                 }
@@ -906,7 +972,12 @@ static void RenderMaterials(Scene* scene)
     {
         if (ImGui::Button("Save To File"))
         {
-            WriteBinaryMaterialToFile(scene, fmt("%s.material", scene->name));
+            WriteBinaryMaterialToFile(scene, fmt("%s/%s.material", ASSET_DIR, scene->name));
+        }
+        if (Asset_IsPackMounted())
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(the asset pack takes precedence, re-run AssetPacker)");
         }
     }
 
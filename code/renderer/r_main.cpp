@@ -49,9 +49,12 @@ void R_Init(void* handle, MemoryPools* memory)
 {
     SubArena(&renderMemory.persistent, &memory->persistent, Megabytes(4), "persistent renderer arena");
     SubArena(&renderMemory.transient, &memory->transient, Megabytes(10), "transient renderer arena");
+    TrackArena(&renderMemory.persistent);
+    TrackArena(&renderMemory.transient);
 
     // Create D3D11 context and pipelines.
     D3D11_Init((HWND)handle);
+    Residency_Init(&assetsShared.textureResidency, Megabytes(128), Megabytes(4));
     Voxel_Init();
     GeometryPass_Init();
     Shadows_Init();
@@ -79,6 +82,7 @@ void R_ShutDown()
     Shadows_Shutdown();
     Voxel_Shutdown();
     SSSO_Filter_Shutdown();
+    ReleaseStreamedTextures();
 
     // always last
     D3D11_Shutdown();
@@ -121,7 +125,7 @@ void R_RenderCommandQueueToOutput(RenderCommandQueue* cmdQueue)
 
                 DrawBuffer_Init(&assetsShared.drawBufferLowRes);
                 AddImmutableObject(&assetsShared.drawBufferLowRes, sceneLowRes);
-                sceneLowRes->materials = scene->materials; // @FIXME: this would incur a double free
+                sceneLowRes->materials.CopyFrom(scene->materials);
 
                 assetsShared.currentMesh = scene;
                 assetsShared.assetID = scene->meshId;
@@ -158,6 +162,8 @@ void R_RenderCommandQueueToOutput(RenderCommandQueue* cmdQueue)
 #endif
             }
 
+            UpdateTextureStreaming(cmdQueue, scene);
+
             // Add AABB to cmdQueue
             cmdQueue->aabb.min = scene->aabb.min;
             cmdQueue->aabb.max = scene->aabb.max;
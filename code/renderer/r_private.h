@@ -34,6 +34,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 #include "r_public.h"
+#include "r_texture_residency.h"
+#include "r_texture_file.h"
 
 #define WIN32_LEAN_AND_MEAN // so that Windows.h includes a lot less garbage
 #include "d3d11.h" // the Windows 7 SDK version is too old and missing stuff we want
@@ -327,29 +329,38 @@ extern Direct3DStatic d3ds;
 // shared asset data
 //
 
-// First eight slots in textures/textureViews are the default textures
+// Materials reference textures through handles to texture slots.
+// Every texture has a single slot, shared by all the materials using it.
+struct TextureSlot
+{
+    ID3D11Texture2D* texture;
+    ID3D11ShaderResourceView* view;
+    u32 streamedTexture; // streamed texture index + 1, 0 for the default textures
+};
+
 struct Scene;
 struct AssetsSharedData
 {
     DrawBuffer drawBuffer;
     DrawBuffer drawBufferLowRes;
 
-    ID3D11Texture2D* textures[MAX_TEXTURES];
-    ID3D11ShaderResourceView* textureViews[MAX_TEXTURES];
-    StaticHashMap<u32, Image, 25> textureMap;
-    u32 numTextures; // also numViews (since textureViews[i] is a view of textures[i])
+    Pool<TextureSlot, MAX_TEXTURES> textures;
+    Handle<TextureSlot> defaultTextures[TextureId::Count]; // live for the renderer's lifetime
+    HashMap<const char*, Handle<TextureSlot>, InternedStringHash> textureMap; // interned texture name -> slot, current scene only
+    TextureResidency textureResidency;
 
     Scene* currentMesh;
     u32 assetID;
-
-    MemoryArena oldStrings;
-    MemoryArena newStrings;
 };
 
 extern AssetsSharedData assetsShared;
 
 void WriteBinaryMaterialToFile(Scene* scene, const char* filePath);
-unsigned long HashTextureName(const char* str);
+void UpdateTextureStreaming(RenderCommandQueue* cmdQueue, Scene* scene);
+// also frees the texture slots of the current scene
+void ReleaseStreamedTextures();
+// falls back to the default texture for stale handles
+ID3D11ShaderResourceView* GetMaterialTextureView(const Material* material, TextureId::Type id);
 
 //
 // shader buffer descriptions
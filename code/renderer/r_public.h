@@ -100,6 +100,10 @@ struct TextureId
 };
 extern Image defaultTextures[TextureId::Count];
 
+#define MATERIAL_FILE_MAGIC 0x54414D42 // "BMAT"
+#define MATERIAL_FILE_VERSION 1
+#define MATERIAL_SIGNATURE_SIZE 4
+
 #pragma pack(push, 1)
 struct MeshFileHeader
 {
@@ -115,7 +119,7 @@ struct MeshFileHeader
 struct MeshFileMaterial
 {
     // offsets into strings are in bytes
-    // ~0 if unused
+    // 0 if unused
     u32 albedoOffset;
     u32 normalOffset;
     u32 specularOffset;
@@ -124,6 +128,8 @@ struct MeshFileMaterial
     vec4_t alphaTestedColor; // average color (rgb) + opacity
     f32 specularExponent;
     u32 flags;
+    f32 coverage; // fraction of albedo texels that pass the alpha test
+    u32 colorSignature[MATERIAL_SIGNATURE_SIZE * MATERIAL_SIGNATURE_SIZE]; // rgba8 thumbnail of the albedo
 };
 
 struct MeshFileMesh
@@ -137,6 +143,8 @@ struct MeshFileMesh
 #pragma pack(push, 1)
 struct MaterialFileHeader
 {
+    u32 magic;
+    u32 version;
     u32 numMaterials;
     u32 numStringBytes;
 };
@@ -154,14 +162,22 @@ struct MaterialFileData
 };
 #pragma pack(pop)
 
+struct TextureSlot;
 struct Material
 {
-    u32 textureIndex[TextureId::Count];
+    Handle<TextureSlot> textures[TextureId::Count]; // stale once the scene's textures are unloaded
     u32 flags;
     vec4_t specular; // w exponent, xyz color
     vec4_t alphaTestedColor; // rgb + opacity
 };
 
+// interned names of a MeshFileMaterial, NULL when unused
+struct SceneMaterialNames
+{
+    const char* name;
+    const char* textures[TextureId::Count];
+};
+
 struct RenderAABB
 {
     vec3_t min;
@@ -182,7 +198,7 @@ struct Scene
     DynamicArray<MeshFileMaterial> fileMaterials;
     DynamicArray<MeshFileMesh> meshes;
     DynamicArray<Material> materials;
-    MemoryArena strings;
+    DynamicArray<SceneMaterialNames> materialNames; // one per fileMaterial
 };
 
 struct Light
@@ -249,7 +265,7 @@ struct SceneAssets
 {
     MemoryArena arena;
 
-    DynamicArray<Light> lights;
+    Pool<Light, MAX_LIGHTS> lights; // a shadow map slice per light
 
     Scene* meshes;
     u32 numMeshes;
@@ -0,0 +1,131 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define DDSKTX_IMPLEMENT
+#include "r_private.h"
+
+static u32 GetBlockBytes(ddsktx_format format, u32* blockDim)
+{
+    *blockDim = 4;
+    switch (format)
+    {
+    case DDSKTX_FORMAT_BC1:
+    case DDSKTX_FORMAT_BC4:
+        return 8;
+    case DDSKTX_FORMAT_BC2:
+    case DDSKTX_FORMAT_BC3:
+    case DDSKTX_FORMAT_BC5:
+    case DDSKTX_FORMAT_BC6H:
+    case DDSKTX_FORMAT_BC7:
+        return 16;
+    case DDSKTX_FORMAT_RGBA8:
+    case DDSKTX_FORMAT_BGRA8:
+        *blockDim = 1;
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+bool TextureFile_Open(TextureFile* file, const char* path)
+{
+    memset(file, 0, sizeof(TextureFile));
+    if (!Asset_OpenStream(&file->stream, path))
+    {
+        return false;
+    }
+
+    u8 probe[TEXTURE_FILE_PROBE_SIZE];
+    const u64 probeSize = MIN(file->stream.size, (u64)sizeof(probe));
+    const void* header = Asset_ReadRange(&file->stream, 0, probeSize, probe);
+    ddsktx_texture_info* info = &file->info;
+    ddsktx_error error;
+    if (header == NULL || !ddsktx_parse(info, header, (int)probeSize, &error))
+    {
+        OutputDebugStringA(fmt("%s: %s\n", path, header != NULL ? error.msg : "read failed"));
+        TextureFile_Close(file);
+        return false;
+    }
+
+    u32 blockDim;
+    const u32 blockBytes = GetBlockBytes(info->format, &blockDim);
+    if (!(info->flags & DDSKTX_TEXTURE_FLAG_DDS) || (info->flags & DDSKTX_TEXTURE_FLAG_CUBEMAP) ||
+        info->depth > 1 || info->num_layers > 1 || blockBytes == 0 ||
+        info->num_mips < 1 || info->num_mips > TEXTURE_FILE_MAX_MIPS)
+    {
+        OutputDebugStringA(fmt("%s: unsupported texture (%s, %d mips)\n", path, ddsktx_format_str(info->format), info->num_mips));
+        TextureFile_Close(file);
+        return false;
+    }
+
+    // mips are stored back to back, most detailed first
+    u64 offset = (u64)info->data_offset;
+    for (u32 m = 0; m < (u32)info->num_mips; ++m)
+    {
+        TextureMip* mip = &file->mips[m];
+        mip->width = MAX(info->width >> m, 1);
+        mip->height = MAX(info->height >> m, 1);
+        const u32 blocksX = (mip->width + blockDim - 1) / blockDim;
+        const u32 blocksY = (mip->height + blockDim - 1) / blockDim;
+        mip->rowPitch = blocksX * blockBytes;
+        mip->size = mip->rowPitch * blocksY;
+        mip->offset = offset;
+        offset += mip->size;
+    }
+
+    // the probe only saw the header, the real data size comes from the stream
+    if (offset > file->stream.size)
+    {
+        OutputDebugStringA(fmt("%s: truncated file\n", path));
+        TextureFile_Close(file);
+        return false;
+    }
+    info->size_bytes = (int)(offset - info->data_offset);
+
+    return true;
+}
+
+void TextureFile_Close(TextureFile* file)
+{
+    Asset_CloseStream(&file->stream);
+    memset(file, 0, sizeof(TextureFile));
+}
+
+const void* TextureFile_ReadMip(TextureFile* file, u32 mip, void* scratch)
+{
+    assert(mip < (u32)file->info.num_mips);
+    const TextureMip* m = &file->mips[mip];
+
+    return Asset_ReadRange(&file->stream, m->offset, m->size, scratch);
+}
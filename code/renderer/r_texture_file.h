@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "../common/asset_pack.h"
+#include "../dds-ktx/dds-ktx.h"
+
+// Random access to the mips of a DDS file.
+// Only the header is read when opening, mips are read on demand.
+
+#define TEXTURE_FILE_MAX_MIPS 16
+#define TEXTURE_FILE_PROBE_SIZE 256 // DDS header + DX10 extension with room to spare
+
+struct TextureMip
+{
+    u64 offset; // in the file
+    u32 size;
+    u32 rowPitch; // bytes per row of blocks
+    u32 width;
+    u32 height;
+};
+
+struct TextureFile
+{
+    AssetStream stream;
+    ddsktx_texture_info info;
+    TextureMip mips[TEXTURE_FILE_MAX_MIPS];
+};
+
+// 2D block-compressed and 8-bit RGBA textures only.
+bool TextureFile_Open(TextureFile* file, const char* path);
+void TextureFile_Close(TextureFile* file);
+// scratch must hold at least file->mips[mip].size bytes, it's left untouched when the data is already in memory
+const void* TextureFile_ReadMip(TextureFile* file, u32 mip, void* scratch);
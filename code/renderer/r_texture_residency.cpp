@@ -0,0 +1,316 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_texture_residency.h"
+
+void Residency_Init(TextureResidency* r, u64 budgetBytes, u64 maxUploadBytesPerFrame)
+{
+    memset(r, 0, sizeof(*r));
+    r->budgetBytes = budgetBytes;
+    r->maxUploadBytesPerFrame = maxUploadBytesPerFrame;
+    r->mipBias = 0.0f;
+}
+
+u64 Residency_GetMipBytes(const ResidentTexture* t, u32 mip)
+{
+    assert(mip < t->numMips);
+    const u64 w = MAX(t->width >> mip, 1);
+    const u64 h = MAX(t->height >> mip, 1);
+    return ((w + 3) / 4) * ((h + 3) / 4) * t->blockBytes;
+}
+
+u64 Residency_GetChainBytes(const ResidentTexture* t, u32 firstMip)
+{
+    u64 bytes = 0;
+    for (u32 m = firstMip; m < t->numMips; ++m)
+    {
+        bytes += Residency_GetMipBytes(t, m);
+    }
+    return bytes;
+}
+
+static u32 ComputeTailMip(u32 width, u32 height, u32 numMips)
+{
+    u32 tailMip = 0;
+    while (tailMip + 1 < numMips && MAX(width >> tailMip, height >> tailMip) > RESIDENCY_TAIL_SIZE)
+    {
+        ++tailMip;
+    }
+
+    // the most detailed mip of a block compressed texture must be a multiple of 4 in size,
+    // mips are at least 1 texel wide
+    while (tailMip > 0 && ((MAX(width >> tailMip, 1) & 3) != 0 || (MAX(height >> tailMip, 1) & 3) != 0))
+    {
+        --tailMip;
+    }
+
+    return tailMip;
+}
+
+u32 Residency_AddTexture(TextureResidency* r, u32 width, u32 height, u32 numMips, u32 blockBytes)
+{
+    assert(r->numTextures < RESIDENCY_MAX_TEXTURES);
+    assert(numMips > 0);
+
+    ResidentTexture* t = &r->textures[r->numTextures];
+    t->width = width;
+    t->height = height;
+    t->numMips = numMips;
+    t->blockBytes = blockBytes;
+    t->tailMip = ComputeTailMip(width, height, numMips);
+    t->residentMip = t->tailMip;
+    t->wantedMip = t->tailMip;
+    t->priority = 0.0f;
+
+    // the tail is always resident, even if it doesn't fit the budget
+    r->residentBytes += Residency_GetChainBytes(t, t->tailMip);
+
+    return r->numTextures++;
+}
+
+void Residency_RemoveAllTextures(TextureResidency* r)
+{
+    r->numTextures = 0;
+    r->residentBytes = 0;
+}
+
+f32 Residency_ProjectedSize(vec3_t aabbMin, vec3_t aabbMax, vec3_t cameraPosition, f32 projScale)
+{
+    const vec3_t center = (aabbMin + aabbMax) * 0.5f;
+    const f32 radius = length(aabbMax - aabbMin) * 0.5f;
+    const f32 distance = length(center - cameraPosition);
+    if (distance <= radius)
+    {
+        return FLT_MAX; // we're inside the bounding sphere
+    }
+
+    return (2.0f * radius * projScale) / distance;
+}
+
+u32 Residency_ComputeWantedMip(const ResidentTexture* t, f32 projectedSize, f32 mipBias)
+{
+    if (projectedSize <= 0.0f)
+    {
+        return t->tailMip;
+    }
+
+    // one texel per pixel across the projected extent
+    const f32 texels = (f32)MAX(t->width, t->height);
+    const f32 mip = floorf(log2f(texels / projectedSize) + mipBias);
+    if (mip <= 0.0f)
+    {
+        return 0;
+    }
+
+    return MIN((u32)mip, t->tailMip);
+}
+
+void Residency_BeginFrame(TextureResidency* r)
+{
+    for (u32 i = 0; i < r->numTextures; ++i)
+    {
+        ResidentTexture* t = &r->textures[i];
+        t->wantedMip = t->tailMip;
+        t->priority = 0.0f;
+    }
+}
+
+void Residency_Request(TextureResidency* r, u32 textureIndex, f32 projectedSize)
+{
+    assert(textureIndex < r->numTextures);
+    ResidentTexture* t = &r->textures[textureIndex];
+    t->wantedMip = MIN(t->wantedMip, Residency_ComputeWantedMip(t, projectedSize, r->mipBias));
+    t->priority = MAX(t->priority, projectedSize);
+}
+
+// Detail nobody asked for goes first (lowest priority first), then the lowest priority textures.
+// Textures promoted this frame are never picked to avoid ping-ponging.
+static s32 FindVictim(TextureResidency* r, s32 exclude, f32 maxPriority, const u32* startMip)
+{
+    s32 victim = -1;
+    bool victimSurplus = false;
+    f32 victimPriority = FLT_MAX;
+    for (u32 i = 0; i < r->numTextures; ++i)
+    {
+        const ResidentTexture* t = &r->textures[i];
+        if ((s32)i == exclude || t->residentMip >= t->tailMip || t->residentMip < startMip[i])
+        {
+            continue;
+        }
+
+        const bool surplus = t->residentMip < t->wantedMip;
+        if (!surplus && t->priority >= maxPriority)
+        {
+            continue;
+        }
+
+        if (victim < 0 || (surplus && !victimSurplus) || (surplus == victimSurplus && t->priority < victimPriority))
+        {
+            victim = (s32)i;
+            victimSurplus = surplus;
+            victimPriority = t->priority;
+        }
+    }
+
+    return victim;
+}
+
+// what FindVictim can give up for a texture: all of its streamed mips when its priority is
+// below maxPriority, otherwise only the ones finer than it wants
+static u64 GetEvictableBytes(const TextureResidency* r, s32 exclude, f32 maxPriority, const u32* startMip)
+{
+    u64 bytes = 0;
+    for (u32 i = 0; i < r->numTextures; ++i)
+    {
+        const ResidentTexture* t = &r->textures[i];
+        if ((s32)i == exclude || t->residentMip < startMip[i])
+        {
+            continue;
+        }
+
+        const u32 lastMip = t->priority < maxPriority ? t->tailMip : MIN(t->wantedMip, t->tailMip);
+        for (u32 m = t->residentMip; m < lastMip; ++m)
+        {
+            bytes += Residency_GetMipBytes(t, m);
+        }
+    }
+
+    return bytes;
+}
+
+static void EvictMip(TextureResidency* r, u32 textureIndex)
+{
+    ResidentTexture* t = &r->textures[textureIndex];
+    assert(t->residentMip < t->tailMip);
+    r->residentBytes -= Residency_GetMipBytes(t, t->residentMip);
+    t->residentMip++;
+    r->numEvicted++;
+}
+
+u32 Residency_Update(TextureResidency* r, ResidencyChange* changes, u32 maxChanges)
+{
+    r->uploadedBytes = 0;
+    r->numPromoted = 0;
+    r->numEvicted = 0;
+
+    u32 startMip[RESIDENCY_MAX_TEXTURES];
+    u32 candidates[RESIDENCY_MAX_TEXTURES];
+    u32 numCandidates = 0;
+    for (u32 i = 0; i < r->numTextures; ++i)
+    {
+        const ResidentTexture* t = &r->textures[i];
+        startMip[i] = t->residentMip;
+        if (t->residentMip <= t->wantedMip)
+        {
+            continue;
+        }
+
+        // insertion sort, highest priority first
+        u32 c = numCandidates++;
+        while (c > 0 && r->textures[candidates[c - 1]].priority < t->priority)
+        {
+            candidates[c] = candidates[c - 1];
+            --c;
+        }
+        candidates[c] = i;
+    }
+
+    // stream in one finer mip per texture and frame
+    for (u32 c = 0; c < numCandidates; ++c)
+    {
+        const u32 index = candidates[c];
+        ResidentTexture* t = &r->textures[index];
+        if (t->residentMip > startMip[index])
+        {
+            continue; // already lost a mip to a more important texture this frame
+        }
+
+        const u64 cost = Residency_GetMipBytes(t, t->residentMip - 1);
+        if (r->uploadedBytes > 0 && r->uploadedBytes + cost > r->maxUploadBytesPerFrame)
+        {
+            break;
+        }
+
+        // evicting for a promotion that doesn't fit anyway would only ping-pong with the victims
+        if (r->residentBytes + cost > r->budgetBytes &&
+            r->residentBytes - GetEvictableBytes(r, (s32)index, t->priority, startMip) + cost > r->budgetBytes)
+        {
+            continue;
+        }
+
+        while (r->residentBytes + cost > r->budgetBytes)
+        {
+            const s32 victim = FindVictim(r, (s32)index, t->priority, startMip);
+            if (victim < 0)
+            {
+                break;
+            }
+            EvictMip(r, (u32)victim);
+        }
+        assert(r->residentBytes + cost <= r->budgetBytes);
+
+        t->residentMip--;
+        r->residentBytes += cost;
+        r->uploadedBytes += cost;
+        r->numPromoted++;
+    }
+
+    // the budget might have shrunk since last frame
+    while (r->residentBytes > r->budgetBytes)
+    {
+        const s32 victim = FindVictim(r, -1, FLT_MAX, startMip);
+        if (victim < 0)
+        {
+            break;
+        }
+        EvictMip(r, (u32)victim);
+    }
+
+    u32 numChanges = 0;
+    for (u32 i = 0; i < r->numTextures; ++i)
+    {
+        if (r->textures[i].residentMip == startMip[i])
+        {
+            continue;
+        }
+
+        assert(numChanges < maxChanges);
+        ResidencyChange* change = &changes[numChanges++];
+        change->textureIndex = i;
+        change->oldMip = startMip[i];
+        change->newMip = r->textures[i].residentMip;
+    }
+
+    return numChanges;
+}
@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "../common/shared.h"
+
+// CPU side of the texture streamer.
+// Only decides which mips should be resident, the D3D11 side lives in r_assets.cpp.
+// Mips are numbered like D3D11 subresources: 0 is the most detailed one.
+
+#define RESIDENCY_MAX_TEXTURES 256
+#define RESIDENCY_TAIL_SIZE 64 // mips at or below this size are loaded up-front
+
+struct ResidentTexture
+{
+    u32 width;
+    u32 height;
+    u32 numMips;
+    u32 blockBytes; // bytes per 4x4 block
+    u32 tailMip; // coarsest streamed mip, always resident
+    u32 residentMip; // most detailed mip currently resident
+    u32 wantedMip; // most detailed mip requested this frame
+    f32 priority; // largest projected size (pixels) of any mesh using the texture this frame
+};
+
+struct ResidencyChange
+{
+    u32 textureIndex;
+    u32 oldMip;
+    u32 newMip;
+};
+
+struct TextureResidency
+{
+    ResidentTexture textures[RESIDENCY_MAX_TEXTURES];
+    u32 numTextures;
+
+    u64 budgetBytes;
+    u64 residentBytes;
+    u64 maxUploadBytesPerFrame;
+    f32 mipBias; // > 0 prefers coarser mips
+
+    // stats of the last update
+    u64 uploadedBytes;
+    u32 numPromoted;
+    u32 numEvicted;
+};
+
+void Residency_Init(TextureResidency* r, u64 budgetBytes, u64 maxUploadBytesPerFrame);
+u32 Residency_AddTexture(TextureResidency* r, u32 width, u32 height, u32 numMips, u32 blockBytes);
+// textures are only removed all at once, when the scene changes
+void Residency_RemoveAllTextures(TextureResidency* r);
+u64 Residency_GetMipBytes(const ResidentTexture* t, u32 mip);
+u64 Residency_GetChainBytes(const ResidentTexture* t, u32 firstMip);
+
+// projected diameter in pixels of the AABB's bounding sphere
+// projScale is the projection's y scale times half the viewport height
+f32 Residency_ProjectedSize(vec3_t aabbMin, vec3_t aabbMax, vec3_t cameraPosition, f32 projScale);
+u32 Residency_ComputeWantedMip(const ResidentTexture* t, f32 projectedSize, f32 mipBias);
+
+// per frame: BeginFrame, Request for every (mesh, texture) pair, then Update
+void Residency_BeginFrame(TextureResidency* r);
+void Residency_Request(TextureResidency* r, u32 textureIndex, f32 projectedSize);
+// returns the number of changes written, at most one per texture
+u32 Residency_Update(TextureResidency* r, ResidencyChange* changes, u32 maxChanges);
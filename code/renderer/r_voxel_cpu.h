@@ -0,0 +1,510 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "r_public.h"
+
+// CPU versions of the voxelization passes, for voxelizing without a GPU
+// (offline, on build machines) and for comparing against the GPU output.
+// The grids have the texel layout of the textures in voxelShared: the 6 faces
+// of the anisotropic voxels are side by side along x, the texture is
+// gridSize.w * 6 wide.
+//
+// The work is split into bricks of CPU_VOXEL_BRICK_SIZE^3 voxels: triangles are
+// binned into the bricks they touch and the bricks are processed in parallel
+// with the job system. A brick owns its voxels, so no atomics are needed.
+
+#define CPU_VOXEL_BRICK_SIZE 8
+#define CPU_VOXEL_BRICK_TEXELS (CPU_VOXEL_BRICK_SIZE * CPU_VOXEL_BRICK_SIZE * CPU_VOXEL_BRICK_SIZE * VoxelFace::Count)
+#define CPU_VOXEL_MAX_MIPS 16
+
+// +x, -x, +y, -y, +z, -z like the shaders
+struct VoxelFace
+{
+    enum Type
+    {
+        PosX,
+        NegX,
+        PosY,
+        NegY,
+        PosZ,
+        NegZ,
+        Count
+    };
+};
+
+// RGBA8 like the UNORM albedo textures, sampled bilinearly with wrapping
+struct CpuAlbedoTexture
+{
+    u32 width;
+    u32 height;
+    const u8* texels;
+};
+
+// the same draws as VoxelizeOpacity_Draw and VoxelizeEmittance_Draw
+struct CpuVoxelGeometry
+{
+    const vec3_t* xyz;
+    const vec2_t* tc; // only read for albedo textures
+    const u32* indexes;
+    const MeshFileMesh* meshes;
+    u32 numMeshes;
+    const Material* materials; // indexed by MeshFileMesh::materialIndex
+    // indexed like materials, NULL or missing texels use alphaTestedColor.rgb like alpha tested materials
+    const CpuAlbedoTexture* albedoTextures;
+    RenderAABB aabb; // mapped to the whole grid
+};
+
+// the light buffer and shadow maps of VoxelizeEmittance_Draw
+struct CpuVoxelLighting
+{
+    const Light* lights;
+    u32 numLights;
+    const f32* shadowMaps; // numLights slices of shadowMapSize^2 depths, NULL when nothing is shadowed
+    u32 shadowMapSize;
+    f32 fixedBias;
+};
+
+// DXGI_FORMAT_R8_UNORM
+struct CpuOpacityGrid
+{
+    uint3_t gridSize;
+    u8* texels;
+};
+
+// DXGI_FORMAT_R16G16B16A16_FLOAT like the emittance maps, and the normal map
+struct CpuEmittanceGrid
+{
+    uint3_t gridSize;
+    u16* texels; // 4 half floats per texel
+    u32* normals; // RGBA8: the average normal in [0;1] and the sample count, can be NULL
+};
+
+struct CpuVoxelStats
+{
+    u32 numTriangles;
+    u32 numBrickTriangles; // triangle/brick pairs after binning
+    u32 numBricks; // bricks touched by at least one triangle
+};
+
+inline size_t CpuVoxel_TexelIndex(uint3_t gridSize, u32 x, u32 y, u32 z, u32 face)
+{
+    return ((size_t)z * gridSize.h + y) * (gridSize.w * VoxelFace::Count) + face * gridSize.w + x;
+}
+
+inline size_t CpuVoxel_NumTexels(uint3_t gridSize)
+{
+    return (size_t)gridSize.w * VoxelFace::Count * gridSize.h * gridSize.d;
+}
+
+void CpuVoxel_AllocateOpacityGrid(CpuOpacityGrid* grid, MemoryArena* arena, uint3_t gridSize);
+
+// Mirrors the opacity voxelization pass: every triangle is projected along the dominant
+// axis of its normal and each covered sample writes the material's opacity to one face
+// per axis, picked by the sign of the normal like ComputeTC. 'conservative' mirrors
+// ConsRasterMode::Software: the triangle is grown by half a voxel and clipped to its
+// grown 2D bounds.
+// Where triangles overlap, the GPU keeps the last write and we keep the largest value.
+// The temporary memory comes from scratch, stats can be NULL.
+void CpuVoxel_VoxelizeOpacity(CpuOpacityGrid* grid, const CpuVoxelGeometry* geometry, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats);
+
+// [min; max[ in voxels
+struct CpuVoxelRegion
+{
+    s32 min[3];
+    s32 max[3];
+};
+
+// CpuVoxel_VoxelizeOpacity for the voxels of the regions only, the rest of the grid is left
+// as is. The regions must be disjoint and inside the grid. origin can be NULL. Otherwise the
+// grid is toroidally addressed and isn't mapped to the geometry's AABB: voxel v is world voxel
+// origin + v, with world voxels of voxelSize from the world's origin, and it's stored at
+// (origin + v) % gridSize. The triangles are rasterized in world voxels, so a texel comes out
+// the same for every origin that covers it.
+void CpuVoxel_VoxelizeOpacityRegions(CpuOpacityGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelRegion* regions, u32 numRegions, const s32* origin, f32 voxelSize, bool conservative, MemoryArena* scratch);
+
+// A flag per brick of a grid for the bricks a change made stale, so that only they are voxelized
+// again and only the mip texels over them are rebuilt. Lights, materials and meshes mark the
+// bricks under their bounds, grown by a voxel for the samples of the conservative mode and
+// the rounding of their positions.
+struct CpuVoxelDirtyBricks
+{
+    uint3_t gridSize;
+    uint3_t numBricks;
+    u8* bricks; // 1 when dirty, x first like the brick indexes of the voxelizers
+};
+
+void CpuVoxel_AllocateDirtyBricks(CpuVoxelDirtyBricks* dirty, MemoryArena* arena, uint3_t gridSize);
+void CpuVoxel_ClearDirtyBricks(CpuVoxelDirtyBricks* dirty);
+u32 CpuVoxel_CountDirtyBricks(const CpuVoxelDirtyBricks* dirty);
+
+// the world space box [min; max] of a grid mapped to aabb, like CpuVoxelGeometry::aabb
+void CpuVoxel_MarkDirtyBounds(CpuVoxelDirtyBricks* dirty, const RenderAABB* aabb, vec3_t min, vec3_t max);
+
+// Where the light adds to the emittance: ShadeDiffuse's window is 0 from the radius on.
+// A light that moved or changed is marked before and after the change.
+void CpuVoxel_MarkDirtyLight(CpuVoxelDirtyBricks* dirty, const RenderAABB* aabb, const Light* light);
+
+// the world space bounds of the triangles of every mesh, numMeshes of them
+void CpuVoxel_ComputeMeshBounds(RenderAABB* bounds, const CpuVoxelGeometry* geometry);
+
+// The meshes drawn with a material, for edits of its color, flags or opacity. Geometry that
+// moved marks its bounds before and after with CpuVoxel_MarkDirtyBounds. Neither covers the
+// shadows the change casts, their lights have to be marked too.
+void CpuVoxel_MarkDirtyMaterial(CpuVoxelDirtyBricks* dirty, const CpuVoxelGeometry* geometry, const RenderAABB* meshBounds, u32 materialIndex);
+
+// CpuVoxel_VoxelizeOpacity for the dirty bricks, the others are left as is. A brick only
+// depends on the triangles binned to it, so the grid ends up as if all of it was voxelized.
+void CpuVoxel_VoxelizeOpacityBricks(CpuOpacityGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelDirtyBricks* dirty, bool conservative, MemoryArena* scratch);
+
+void CpuVoxel_AllocateEmittanceGrid(CpuEmittanceGrid* grid, MemoryArena* arena, uint3_t gridSize, bool normals);
+
+// Mirrors the emittance voxelization pass followed by the format fix: every sample is shaded
+// with ShadeDiffuse and PCF_Visibility (or gets the albedo of emissive materials) and added to
+// the same faces as the opacity, then each texel gets the average of its samples. The sums
+// are kept in the packed half floats of AtomicAddHDR with a sample counter, and the normals
+// are averaged like AtomicAverage, so the rounding matches the GPU's.
+// Each brick is accumulated in a thread's scratch memory, with its triangles in draw order,
+// so the result doesn't depend on the number of threads.
+void CpuVoxel_VoxelizeEmittance(CpuEmittanceGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelLighting* lighting, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats);
+
+// CpuVoxel_VoxelizeEmittance for the dirty bricks, with the same results since the bricks
+// already sum their own samples. The normals are written when the grid has them.
+void CpuVoxel_VoxelizeEmittanceBricks(CpuEmittanceGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelLighting* lighting, const CpuVoxelDirtyBricks* dirty, bool conservative, MemoryArena* scratch);
+
+// Mirrors VoxelizationFix_Run on a grid from CpuVoxel_VoxelizeEmittance. Every line along
+// each axis is scanned like the shader does: a voxel with only its + face set opens a gap,
+// and the next voxel with only its - face set closes it if it is at most maxGapDistance
+// further. The voxels in between get both faces and the two ends get their missing face,
+// all black and opaque. The lines are scanned 4 at a time and the 3 axes run in parallel,
+// each of them only touches its own 2 faces.
+// Grid widths that aren't a multiple of 8 make some of the shader's threads read and write
+// the next face, which races on the GPU; those lines are skipped.
+void CpuVoxel_FixVoxelization(CpuEmittanceGrid* grid, u32 maxGapDistance);
+
+// Brings grid up to date after the dirty bricks of raw were voxelized again, where raw is the
+// grid before CpuVoxel_FixVoxelization. A gap can start before the bricks and a changed one can
+// close another gap past them, so every line through a dirty brick is copied from raw and fixed
+// again as a whole. The bricks of grid that changed are marked in changed, the dirty ones
+// included, for the mip updates. changed can be dirty.
+void CpuVoxel_FixVoxelizationBricks(CpuEmittanceGrid* grid, const CpuEmittanceGrid* raw, u32 maxGapDistance, const CpuVoxelDirtyBricks* dirty, CpuVoxelDirtyBricks* changed);
+
+// The mip chains of the voxelShared textures. Level 0 is the voxelized grid itself
+// and level m is gridSize >> m, down to 1 voxel along the shortest side.
+struct CpuOpacityMips
+{
+    uint3_t gridSize;
+    u32 numLevels;
+    u8* levels[CPU_VOXEL_MAX_MIPS];
+};
+
+struct CpuEmittanceMips
+{
+    uint3_t gridSize;
+    u32 numLevels;
+    u16* levels[CPU_VOXEL_MAX_MIPS]; // 4 half floats per texel
+};
+
+// same count as CreateTexturesAndViews
+inline u32 CpuVoxel_NumMipLevels(uint3_t gridSize)
+{
+    return ComputeMipCount(MIN3(gridSize.w, gridSize.h, gridSize.d));
+}
+
+inline uint3_t CpuVoxel_MipSize(uint3_t gridSize, u32 level)
+{
+    const uint3_t size = { gridSize.w >> level, gridSize.h >> level, gridSize.d >> level };
+    return size;
+}
+
+// level 0 points at the grid's texels, the other levels come from the arena
+void CpuVoxel_AllocateOpacityMips(CpuOpacityMips* mips, MemoryArena* arena, const CpuOpacityGrid* grid);
+void CpuVoxel_AllocateEmittanceMips(CpuEmittanceMips* mips, MemoryArena* arena, const CpuEmittanceGrid* grid);
+
+// Mirror the opacity and emittance mip downsample passes: every face of a voxel composites
+// the same face of its 8 children front to back along the face's direction, with the same
+// float operations in the same order as the shaders, and writes the average of the 4 pairs.
+// Level 0 is read as UNORM (c / 255) or half floats, and the results are rounded to the
+// nearest UNORM value or half float.
+// The grid is cut into tiles of 64x16x16 level 0 voxels that build the next 4 levels on their
+// own, so a tile's coarser levels start as soon as its finer ones are done instead of
+// waiting for the whole level. The levels past that are built one after another.
+void CpuVoxel_BuildOpacityMips(CpuOpacityMips* mips);
+void CpuVoxel_BuildEmittanceMips(CpuEmittanceMips* mips);
+
+// The builds above for the texels over the dirty bricks of level 0 only: a brick of level m
+// is dirty when one of the 8 bricks of level m - 1 under it is. The texels come out the
+// same as rebuilding the whole chain.
+void CpuVoxel_UpdateOpacityMips(CpuOpacityMips* mips, const CpuVoxelDirtyBricks* dirty);
+void CpuVoxel_UpdateEmittanceMips(CpuEmittanceMips* mips, const CpuVoxelDirtyBricks* dirty);
+
+// A bit per voxel that is set when any face of the voxel isn't 0, and coarser levels where
+// a bit of level k is the OR of the 2^k voxels along every axis under it. Unlike the mips,
+// the levels round up so that every voxel is under a bit of every level, and they go on
+// until a level is a single bit. The cone tracers step over the samples whose texels are
+// all under cleared bits instead of fetching them, see CpuConeTraceSettings.
+struct CpuOccupancyLevel
+{
+    uint3_t size; // in bits
+    u32 rowWords; // a row along x is padded to whole words
+    u32* words;
+};
+
+struct CpuVoxelOccupancy
+{
+    uint3_t gridSize;
+    u32 numLevels;
+    CpuOccupancyLevel levels[CPU_VOXEL_MAX_MIPS];
+};
+
+inline bool CpuVoxel_IsOccupied(const CpuVoxelOccupancy* occupancy, u32 level, u32 x, u32 y, u32 z)
+{
+    const CpuOccupancyLevel* l = &occupancy->levels[level];
+    return ((l->words[((size_t)z * l->size.h + y) * l->rowWords + (x >> 5)] >> (x & 31)) & 1) != 0;
+}
+
+void CpuVoxel_AllocateOccupancy(CpuVoxelOccupancy* occupancy, MemoryArena* arena, uint3_t gridSize);
+
+// Level 0 is read from the grid's texels and every other level from the one below it,
+// the z slices of a level are built in parallel. Emittance texels count as occupied when
+// any bit of their half floats is set, so they match the grid the emittance cones trace.
+void CpuVoxel_BuildOccupancy(CpuVoxelOccupancy* occupancy, const CpuOpacityGrid* grid);
+void CpuVoxel_BuildOccupancy(CpuVoxelOccupancy* occupancy, const CpuEmittanceGrid* grid);
+
+// bytes used by the levels
+size_t CpuVoxel_OccupancyMemory(const CpuVoxelOccupancy* occupancy);
+
+// counted per cone and step, the steps that fetched no texels were skipped
+struct CpuConeTraceStats
+{
+    s64 numSteps;
+    s64 numSamples;
+};
+
+// the ConeTrace parameters that aren't per cone
+struct CpuConeTraceSettings
+{
+    f32 stepScale;
+    f32 mipBias;
+    f32 maxDiameter; // in level 0 voxels, emittance cones only
+    f32 opacityThreshold;
+    f32 distanceScale;
+    // Built from level 0 of the traced grid, NULL samples every step. A step is skipped when
+    // every texel its trilinear fetches could read is empty, which would sample 0 and leave
+    // the cone as is, so the results don't change. The clipmap tracers ignore it.
+    const CpuVoxelOccupancy* occupancy;
+    CpuConeTraceStats* stats; // NULL or where the counts are added, the clipmap tracers ignore it
+};
+
+// origin and dir are in grid space like the shaders' position01 and normal01: [0;1] across the AABB
+struct CpuCone
+{
+    vec3_t origin;
+    vec3_t dir; // normalized
+    f32 coneRatio; // diameter / distance
+};
+
+// Mirror SampleOpacity and SampleEmittance: the 3 faces facing away from dir are weighted
+// by dir^2, each face is sampled trilinearly with clamping and fractional lods blend the
+// two nearest levels. The GPU's filter weights are fixed-point, so results only match
+// the shaders up to that precision.
+f32 CpuVoxel_SampleOpacity(const CpuOpacityMips* mips, f32 lod, vec3_t position, vec3_t dir);
+vec4_t CpuVoxel_SampleEmittance(const CpuEmittanceMips* mips, f32 lod, vec3_t position, vec3_t dir);
+
+// Mirror TraceOpacityCone and TraceEmittanceCone with the same marching, opacity correction
+// and early out once opacityThreshold is reached. The cones are traced 4 at a time in SIMD
+// lanes that stop on their own, and the packets are spread across the job system.
+// occlusion can be NULL for emittance cones.
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuOpacityMips* mips, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings);
+void CpuVoxel_TraceEmittanceCones(vec3_t* emittance, f32* occlusion, const CpuEmittanceMips* mips, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings);
+
+// Mirror ComputeAmbientOcclusion (17 cones) and ComputeIndirectDiffuse (9 cones) for points
+// in grid space with their normals. A packet traces the same cone for 4 points.
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuOpacityMips* mips, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings);
+void CpuVoxel_ComputeIndirectDiffuse(vec3_t* emittance, f32* occlusion, const CpuEmittanceMips* mips, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings);
+
+// A sparse voxel octree of the opacity grid and its mips, for resolutions the dense grid
+// can't afford. The leaves are the voxelizer's bricks: a node at depth d covers
+// (gridSize >> d)^3 voxels and its brick holds them at mip level (depth - d), so the
+// bricks of the leaves are level 0 and the root's brick is level depth. Nodes without
+// anything under them get no brick and read as 0.
+#define CPU_SVO_NO_BRICK 0xFFFFFFFF
+
+// the children of a node are a tile of 8 nodes indexed x + y * 2 + z * 4
+struct CpuSvoNode
+{
+    u32 firstChild; // 0 for leaves and empty nodes
+    u32 brick; // CPU_SVO_NO_BRICK for empty nodes
+};
+
+struct CpuOpacitySvo
+{
+    u32 gridSize; // CPU_VOXEL_BRICK_SIZE << depth along every axis
+    u32 depth; // of the leaves, the root is at 0
+    u32 numLevels; // like CpuVoxel_NumMipLevels
+    CpuSvoNode* nodes; // the root is node 0
+    u32 numNodes;
+    u8* bricks; // CPU_VOXEL_BRICK_TEXELS each, laid out like a grid of CPU_VOXEL_BRICK_SIZE^3
+    u32 numBricks;
+    CpuOpacityMips rootMips; // level 0 is the root's brick, level m is the SVO's level depth + m
+};
+
+// Voxelizes the geometry like CpuVoxel_VoxelizeOpacity into a gridSize^3 SVO, without
+// going through a dense grid. gridSize is a power of 2 of at least CPU_VOXEL_BRICK_SIZE.
+// The bricks of the interior nodes are filtered bottom up from their 8 children with the
+// mip builder's compositing, so every texel matches the dense grid's mips.
+// The nodes and bricks come from arena, the temporary memory from scratch.
+void CpuVoxel_BuildOpacitySvo(CpuOpacitySvo* svo, MemoryArena* arena, const CpuVoxelGeometry* geometry, u32 gridSize, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats);
+
+// bytes used by the nodes, the bricks and the root's mips
+size_t CpuVoxel_SvoMemory(const CpuOpacitySvo* svo);
+
+// the brick holding voxel (x, y, z) of mip level, NULL when it's empty,
+// for levels below svo->depth only
+const u8* CpuVoxel_FindSvoBrick(const CpuOpacitySvo* svo, u32 level, u32 x, u32 y, u32 z);
+
+// the texel of the dense mip level's texture, 0 in empty space
+u8 CpuVoxel_GetSvoTexel(const CpuOpacitySvo* svo, u32 level, u32 x, u32 y, u32 z, u32 face);
+
+// the opacity sampling and tracing above, with the texels fetched from the SVO
+f32 CpuVoxel_SampleOpacity(const CpuOpacitySvo* svo, f32 lod, vec3_t position, vec3_t dir);
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuOpacitySvo* svo, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings);
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuOpacitySvo* svo, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings);
+
+// Brick paging, a lighter alternative to the SVO: every mip level is cut into bricks of
+// CPU_VOXEL_BRICK_SIZE^3 voxels and only the bricks with something in them get a slot in a
+// shared pool. A flat indirection table per level maps a brick cell to its slot, so a
+// lookup is a single read instead of a walk down the tree, and the memory follows the
+// surfaces instead of the volume.
+#define CPU_PAGED_NO_BRICK 0xFFFFFFFF
+
+struct CpuPagedOpacityLevel
+{
+    uint3_t numCells; // the level's size in bricks
+    u32* indirection; // per cell x + y * w + z * w * h, its slot in the pool or CPU_PAGED_NO_BRICK
+    u32 firstBrick; // the level's slots are [firstBrick; firstBrick + numBricks[
+    u32 numBricks;
+};
+
+struct CpuPagedOpacityGrid
+{
+    uint3_t gridSize;
+    u32 numLevels; // like CpuVoxel_NumMipLevels
+    u32 numPagedLevels; // the levels whose size is a multiple of CPU_VOXEL_BRICK_SIZE
+    CpuPagedOpacityLevel levels[CPU_VOXEL_MAX_MIPS];
+    u8* bricks; // the pool, CPU_VOXEL_BRICK_TEXELS each laid out like a grid of CPU_VOXEL_BRICK_SIZE^3
+    u32 numBricks;
+    CpuOpacityMips tailMips; // level 0 is the last paged level made dense, level m is level numPagedLevels - 1 + m
+};
+
+// Voxelizes the geometry like CpuVoxel_VoxelizeOpacity into paged bricks and builds their mips
+// like CpuVoxel_BuildOpacityMips, so every texel matches the dense grid's. The sides of
+// gridSize are multiples of CPU_VOXEL_BRICK_SIZE, powers of 2 keep the most levels paged.
+// The binning gives the occupied bricks of level 0, a parent is occupied when one of its 8
+// children is, and the slots are handed out level by level with a parallel prefix sum.
+// The tables, the pool and the tail mips come from arena, the temporary memory from scratch.
+void CpuVoxel_BuildPagedOpacityGrid(CpuPagedOpacityGrid* grid, MemoryArena* arena, const CpuVoxelGeometry* geometry, uint3_t gridSize, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats);
+
+// bytes used by the indirection tables, the pool and the tail mips
+size_t CpuVoxel_PagedOpacityMemory(const CpuPagedOpacityGrid* grid);
+
+// the brick holding voxel (x, y, z) of a paged level, NULL when it's empty
+const u8* CpuVoxel_FindPagedBrick(const CpuPagedOpacityGrid* grid, u32 level, u32 x, u32 y, u32 z);
+
+// the texel of the dense mip level's texture, 0 in empty space
+u8 CpuVoxel_GetPagedTexel(const CpuPagedOpacityGrid* grid, u32 level, u32 x, u32 y, u32 z, u32 face);
+
+// the opacity sampling and tracing above, with the texels fetched through the indirection
+f32 CpuVoxel_SampleOpacity(const CpuPagedOpacityGrid* grid, f32 lod, vec3_t position, vec3_t dir);
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuPagedOpacityGrid* grid, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings);
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuPagedOpacityGrid* grid, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings);
+
+// Cascaded clipmaps of the opacity around the camera, for scenes larger than one grid.
+// Every cascade is resolution^3 voxels and cascade c has voxels of voxelSize << c, so each one
+// covers twice the extent of the previous one. The cascades are addressed toroidally: world
+// voxel w is stored at w % resolution, so when the camera moves only the slabs that enter a
+// cascade are voxelized again and the rest stays where it is.
+#define CPU_CLIPMAP_MAX_CASCADES 8
+
+struct CpuClipmapCascade
+{
+    s32 origin[3]; // world voxel at the cascade's min corner
+    f32 voxelSize;
+    CpuOpacityGrid grid; // toroidal, see CpuVoxel_ClipmapTexelIndex
+    bool valid; // false until the first update voxelizes the whole cascade
+};
+
+struct CpuVoxelClipmap
+{
+    u32 resolution; // a multiple of CPU_VOXEL_BRICK_SIZE
+    u32 numCascades;
+    f32 voxelSize; // of cascade 0, in world units
+    CpuClipmapCascade cascades[CPU_CLIPMAP_MAX_CASCADES];
+};
+
+// the texel of world voxel (x, y, z) in a cascade
+inline size_t CpuVoxel_ClipmapTexelIndex(const CpuClipmapCascade* cascade, s32 x, s32 y, s32 z, u32 face)
+{
+    const s32 size = (s32)cascade->grid.gridSize.w;
+    const u32 wrappedX = (u32)(((x % size) + size) % size);
+    const u32 wrappedY = (u32)(((y % size) + size) % size);
+    const u32 wrappedZ = (u32)(((z % size) + size) % size);
+    return CpuVoxel_TexelIndex(cascade->grid.gridSize, wrappedX, wrappedY, wrappedZ, face);
+}
+
+void CpuVoxel_AllocateClipmap(CpuVoxelClipmap* clipmap, MemoryArena* arena, u32 resolution, u32 numCascades, f32 voxelSize);
+
+// The origin of cascade c that centers it on the camera, snapped to its voxels.
+void CpuVoxel_GetClipmapOrigin(const CpuVoxelClipmap* clipmap, u32 cascade, vec3_t camera, s32* origin);
+
+// The regions of a cascade moving from oldOrigin to newOrigin that it didn't cover before,
+// in voxels relative to newOrigin. They're disjoint slabs, at most one per axis, and the
+// whole cascade when it moved by resolution or more. Returns the number of regions.
+u32 CpuVoxel_GetClipmapDirtyRegions(const CpuVoxelClipmap* clipmap, const s32* oldOrigin, const s32* newOrigin, CpuVoxelRegion* regions);
+
+// Recenters the cascades on the camera and voxelizes their dirty regions with
+// CpuVoxel_VoxelizeOpacityRegions. The geometry's AABB is ignored.
+// Returns the number of voxels voxelized again, the temporary memory comes from scratch.
+u64 CpuVoxel_UpdateClipmap(CpuVoxelClipmap* clipmap, const CpuVoxelGeometry* geometry, vec3_t camera, bool conservative, MemoryArena* scratch);
+
+// CpuVoxel_SampleOpacity with the cascades as the mip chain: lod is relative to cascade 0 and
+// the finest cascade holding the footprint at position (in world units) is sampled, blended with
+// the next one for fractional lods. Returns a negative value outside of the last cascade.
+f32 CpuVoxel_SampleClipmapOpacity(const CpuVoxelClipmap* clipmap, f32 lod, vec3_t position, vec3_t dir);
+
+// CpuVoxel_TraceOpacityCones and CpuVoxel_ComputeAmbientOcclusion in world space through the
+// clipmap. The cones stop when they leave the last cascade and distanceScale applies to
+// distances in cascade 0 extents, like it does to [0;1] for the dense grid.
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuVoxelClipmap* clipmap, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings);
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuVoxelClipmap* clipmap, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings);
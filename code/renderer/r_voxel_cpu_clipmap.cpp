@@ -0,0 +1,364 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+// the cascades' texels hold world voxels, so a cascade keeps everything it still covers
+// after moving and the new slabs overwrite what it no longer does
+
+struct ClipmapTracer
+{
+    const CpuVoxelClipmap* clipmap;
+    const CpuConeTraceSettings* settings;
+    const CpuCone* cones;
+    const vec3_t* positions;
+    const vec3_t* normals;
+    f32* occlusion;
+    u32 count; // cones or points
+};
+
+static u64 GetRegionVolume(const CpuVoxelRegion* region)
+{
+    return (u64)(region->max[0] - region->min[0]) * (u64)(region->max[1] - region->min[1]) * (u64)(region->max[2] - region->min[2]);
+}
+
+static f32 GetCascadeVoxelSize(const CpuVoxelClipmap* clipmap, u32 cascade)
+{
+    return clipmap->voxelSize * (f32)(1 << cascade);
+}
+
+// position in the cascade's voxels, relative to its min corner
+static vec3_t GetCascadePosition(const CpuClipmapCascade* cascade, vec3_t position)
+{
+    const f32 scale = 1.0f / cascade->voxelSize;
+    const vec3_t result =
+    {
+        position.x * scale - (f32)cascade->origin[0],
+        position.y * scale - (f32)cascade->origin[1],
+        position.z * scale - (f32)cascade->origin[2]
+    };
+    return result;
+}
+
+static bool IsInCascade(vec3_t voxel, f32 size, f32 margin)
+{
+    return voxel.x >= margin && voxel.x <= size - margin &&
+           voxel.y >= margin && voxel.y <= size - margin &&
+           voxel.z >= margin && voxel.z <= size - margin;
+}
+
+// MIN_MAG_LINEAR clamped to the cascade, whose edges needn't be the texture's
+static f32 SampleCascadeFace(const CpuClipmapCascade* cascade, vec3_t voxel, u32 face)
+{
+    const s32 size = (s32)cascade->grid.gridSize.w;
+    const f32 coords[3] = { voxel.x - 0.5f, voxel.y - 0.5f, voxel.z - 0.5f };
+    s32 texel[3][2];
+    f32 frac[3];
+    for (u32 a = 0; a < 3; ++a)
+    {
+        const f32 low = floorf(coords[a]);
+        const s32 index = (s32)low;
+        frac[a] = coords[a] - low;
+        texel[a][0] = cascade->origin[a] + CLAMP_MAX(CLAMP_MIN(index, 0), size - 1);
+        texel[a][1] = cascade->origin[a] + CLAMP_MAX(CLAMP_MIN(index + 1, 0), size - 1);
+    }
+
+    // corner c is x + y * 2 + z * 4
+    f32 corners[8];
+    for (u32 c = 0; c < 8; ++c)
+    {
+        const size_t index = CpuVoxel_ClipmapTexelIndex(cascade, texel[0][c & 1], texel[1][(c >> 1) & 1], texel[2][c >> 2], face);
+        corners[c] = (f32)cascade->grid.texels[index] / 255.0f;
+    }
+
+    const f32 x00 = corners[0] + (corners[1] - corners[0]) * frac[0];
+    const f32 x10 = corners[2] + (corners[3] - corners[2]) * frac[0];
+    const f32 x01 = corners[4] + (corners[5] - corners[4]) * frac[0];
+    const f32 x11 = corners[6] + (corners[7] - corners[6]) * frac[0];
+    const f32 y0 = x00 + (x10 - x00) * frac[1];
+    const f32 y1 = x01 + (x11 - x01) * frac[1];
+    return y0 + (y1 - y0) * frac[2];
+}
+
+// SampleOpacityOneMip
+static f32 SampleCascade(const CpuClipmapCascade* cascade, vec3_t position, vec3_t dir)
+{
+    const vec3_t voxel = GetCascadePosition(cascade, position);
+    f32 result = 0.0f;
+    for (u32 a = 0; a < 3; ++a)
+    {
+        const u32 face = a * 2 + (dir[a] >= 0.0f ? 0 : 1);
+        result += SampleCascadeFace(cascade, voxel, face) * dir[a] * dir[a];
+    }
+    return result;
+}
+
+// TraceOpacityCone with the cascades in place of the mips
+static f32 TraceClipmapOpacityCone(const CpuVoxelClipmap* clipmap, const CpuCone* cone, const CpuConeTraceSettings* settings)
+{
+    // VoxelSizeMip0
+    const f32 epsilon = 1.0f / (f32)(1 << 20);
+    const f32 maxDir = MAX3(fabsf(cone->dir.x), fabsf(cone->dir.y), fabsf(cone->dir.z));
+    const f32 normalStepSize = clipmap->voxelSize / MAX(maxDir, epsilon);
+    const f32 minDist = normalStepSize * 1.0625f;
+    const f32 distanceScale = settings->distanceScale / (clipmap->voxelSize * (f32)clipmap->resolution);
+
+    f32 dist = minDist;
+    vec3_t position = cone->origin + cone->dir * minDist;
+    f32 stepLength = normalStepSize; // so we don't correct the first voxel fetch
+    f32 accOpacity = 0.0f;
+    f32 occlusion = 0.0f;
+    while (accOpacity < settings->opacityThreshold)
+    {
+        const f32 sphereDiameter = MAX(dist * cone->coneRatio, minDist);
+        const f32 step = sphereDiameter * settings->stepScale;
+        const f32 lod = log2f(sphereDiameter / normalStepSize) + settings->mipBias;
+        f32 vxlOpacity = CpuVoxel_SampleClipmapOpacity(clipmap, lod, position, cone->dir);
+        if (vxlOpacity < 0.0f)
+        {
+            break;
+        }
+
+        // CorrectOpacity
+        const f32 saturated = vxlOpacity > 0.0f ? MIN(vxlOpacity, 1.0f) : 0.0f;
+        vxlOpacity = 1.0f - powf(1.0f - saturated, stepLength / normalStepSize);
+        const f32 vxlOcclusion = vxlOpacity / (1.0f + dist * distanceScale);
+
+        accOpacity += (1.0f - accOpacity) * vxlOpacity;
+        occlusion += (1.0f - occlusion) * vxlOcclusion;
+        dist += step;
+        position = position + cone->dir * step;
+        stepLength = step;
+    }
+
+    return occlusion;
+}
+
+static void TraceClipmapOpacityCones(void* userData, u32 begin, u32 end)
+{
+    const ClipmapTracer* t = (const ClipmapTracer*)userData;
+    for (u32 i = begin; i < end; ++i)
+    {
+        t->occlusion[i] = TraceClipmapOpacityCone(t->clipmap, &t->cones[i], t->settings);
+    }
+}
+
+static void ComputeClipmapAmbientOcclusion(void* userData, u32 begin, u32 end)
+{
+    const ClipmapTracer* t = (const ClipmapTracer*)userData;
+    for (u32 p = begin; p < end; ++p)
+    {
+        f32 totalOcclusion = 0.0f;
+        for (u32 i = 0; i < AO_CONE_COUNT; ++i)
+        {
+            f32 weight;
+            const CpuCone cone = GetAmbientOcclusionCone(t->positions[p], t->normals[p], i, &weight);
+            totalOcclusion += weight * TraceClipmapOpacityCone(t->clipmap, &cone, t->settings);
+        }
+        t->occlusion[p] = totalOcclusion;
+    }
+}
+
+void CpuVoxel_AllocateClipmap(CpuVoxelClipmap* clipmap, MemoryArena* arena, u32 resolution, u32 numCascades, f32 voxelSize)
+{
+    assert(resolution % CPU_VOXEL_BRICK_SIZE == 0);
+    assert(numCascades >= 1 && numCascades <= CPU_CLIPMAP_MAX_CASCADES);
+
+    memset(clipmap, 0, sizeof(*clipmap));
+    clipmap->resolution = resolution;
+    clipmap->numCascades = numCascades;
+    clipmap->voxelSize = voxelSize;
+    const uint3_t gridSize = { resolution, resolution, resolution };
+    for (u32 c = 0; c < numCascades; ++c)
+    {
+        CpuClipmapCascade* cascade = &clipmap->cascades[c];
+        cascade->voxelSize = GetCascadeVoxelSize(clipmap, c);
+        cascade->valid = false;
+        CpuVoxel_AllocateOpacityGrid(&cascade->grid, arena, gridSize);
+    }
+}
+
+void CpuVoxel_GetClipmapOrigin(const CpuVoxelClipmap* clipmap, u32 cascade, vec3_t camera, s32* origin)
+{
+    const f32 voxelSize = GetCascadeVoxelSize(clipmap, cascade);
+    const s32 halfSize = (s32)clipmap->resolution / 2;
+    for (u32 a = 0; a < 3; ++a)
+    {
+        origin[a] = (s32)floorf(camera[a] / voxelSize) - halfSize;
+    }
+}
+
+u32 CpuVoxel_GetClipmapDirtyRegions(const CpuVoxelClipmap* clipmap, const s32* oldOrigin, const s32* newOrigin, CpuVoxelRegion* regions)
+{
+    const s32 size = (s32)clipmap->resolution;
+
+    // what's left of the cascade shrinks axis by axis, so the slabs don't overlap
+    CpuVoxelRegion kept;
+    for (u32 a = 0; a < 3; ++a)
+    {
+        if (abs(newOrigin[a] - oldOrigin[a]) >= size)
+        {
+            for (u32 b = 0; b < 3; ++b)
+            {
+                regions[0].min[b] = 0;
+                regions[0].max[b] = size;
+            }
+            return 1;
+        }
+        kept.min[a] = 0;
+        kept.max[a] = size;
+    }
+
+    u32 numRegions = 0;
+    for (u32 a = 0; a < 3; ++a)
+    {
+        const s32 delta = newOrigin[a] - oldOrigin[a];
+        if (delta == 0)
+        {
+            continue;
+        }
+
+        CpuVoxelRegion* region = &regions[numRegions++];
+        *region = kept;
+        if (delta > 0)
+        {
+            region->min[a] = size - delta;
+            kept.max[a] = size - delta;
+        }
+        else
+        {
+            region->max[a] = -delta;
+            kept.min[a] = -delta;
+        }
+    }
+
+    return numRegions;
+}
+
+u64 CpuVoxel_UpdateClipmap(CpuVoxelClipmap* clipmap, const CpuVoxelGeometry* geometry, vec3_t camera, bool conservative, MemoryArena* scratch)
+{
+    const s32 size = (s32)clipmap->resolution;
+    const size_t scratchUsed = scratch->mem_used;
+    u64 numVoxels = 0;
+    for (u32 c = 0; c < clipmap->numCascades; ++c)
+    {
+        CpuClipmapCascade* cascade = &clipmap->cascades[c];
+        s32 origin[3];
+        CpuVoxel_GetClipmapOrigin(clipmap, c, camera, origin);
+
+        CpuVoxelRegion regions[3];
+        u32 numRegions;
+        if (cascade->valid)
+        {
+            numRegions = CpuVoxel_GetClipmapDirtyRegions(clipmap, cascade->origin, origin, regions);
+        }
+        else
+        {
+            for (u32 a = 0; a < 3; ++a)
+            {
+                regions[0].min[a] = 0;
+                regions[0].max[a] = size;
+            }
+            numRegions = 1;
+        }
+
+        // voxel v lands in the texel of world voxel origin + v, rasterized the same for every origin
+        for (u32 a = 0; a < 3; ++a)
+        {
+            cascade->origin[a] = origin[a];
+        }
+        CpuVoxel_VoxelizeOpacityRegions(&cascade->grid, geometry, regions, numRegions, origin, cascade->voxelSize, conservative, scratch);
+        scratch->mem_used = scratchUsed;
+        cascade->valid = true;
+
+        for (u32 r = 0; r < numRegions; ++r)
+        {
+            numVoxels += GetRegionVolume(&regions[r]);
+        }
+    }
+
+    return numVoxels;
+}
+
+f32 CpuVoxel_SampleClipmapOpacity(const CpuVoxelClipmap* clipmap, f32 lod, vec3_t position, vec3_t dir)
+{
+    const f32 size = (f32)clipmap->resolution;
+    const u32 lastCascade = clipmap->numCascades - 1;
+    lod = CLAMP_MIN(lod, 0.0f);
+
+    // the cascade the lod asks for, or the first one further out that holds the trilinear footprint
+    u32 c = (u32)MIN(lod, (f32)lastCascade);
+    while (c < lastCascade && !IsInCascade(GetCascadePosition(&clipmap->cascades[c], position), size, 0.5f))
+    {
+        c++;
+    }
+    if (!IsInCascade(GetCascadePosition(&clipmap->cascades[c], position), size, 0.0f))
+    {
+        return -1.0f;
+    }
+
+    const f32 low = SampleCascade(&clipmap->cascades[c], position, dir);
+    const f32 frac = lod - (f32)c;
+    if (frac <= 0.0f || c == lastCascade)
+    {
+        return low;
+    }
+
+    const f32 high = SampleCascade(&clipmap->cascades[c + 1], position, dir);
+    return low + (high - low) * frac;
+}
+
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuVoxelClipmap* clipmap, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings)
+{
+    ClipmapTracer t = {};
+    t.clipmap = clipmap;
+    t.settings = settings;
+    t.cones = cones;
+    t.occlusion = occlusion;
+    t.count = numCones;
+    Job_ParallelFor(numCones, &TraceClipmapOpacityCones, &t, 16);
+}
+
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuVoxelClipmap* clipmap, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings)
+{
+    ClipmapTracer t = {};
+    t.clipmap = clipmap;
+    t.settings = settings;
+    t.positions = positions;
+    t.normals = normals;
+    t.occlusion = occlusion;
+    t.count = numPoints;
+    Job_ParallelFor(numPoints, &ComputeClipmapAmbientOcclusion, &t, 4);
+}
@@ -0,0 +1,1159 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+// ComputeAmbientOcclusion's cones, xyz in tangent space and w the cone ratio
+static const vec4_t aoCones[AO_CONE_COUNT] =
+{
+    { 0.955278f, 0.000000f, 0.295708f, 0.619103f },
+    { 0.772836f, 0.561499f, 0.295708f, 0.619103f },
+    { 0.295197f, 0.908524f, 0.295708f, 0.619103f },
+    { -0.295197f, 0.908524f, 0.295708f, 0.619103f },
+    { -0.772836f, 0.561498f, 0.295708f, 0.619103f },
+    { -0.955278f, -0.000000f, 0.295708f, 0.619103f },
+    { -0.772836f, -0.561499f, 0.295708f, 0.619103f },
+    { -0.295197f, -0.908524f, 0.295708f, 0.619103f },
+    { 0.295197f, -0.908524f, 0.295708f, 0.619103f },
+    { 0.772837f, -0.561498f, 0.295708f, 0.619103f },
+    { 0.609550f, 0.064066f, 0.790155f, 0.642130f },
+    { 0.249292f, 0.559918f, 0.790155f, 0.642130f },
+    { -0.360258f, 0.495852f, 0.790155f, 0.642130f },
+    { -0.609550f, -0.064066f, 0.790155f, 0.642130f },
+    { -0.249292f, -0.559918f, 0.790155f, 0.642130f },
+    { 0.360258f, -0.495852f, 0.790155f, 0.642130f },
+    { -0.000000f, -0.000000f, 1.000000f, 0.727940f }
+};
+
+static const f32 aoWeights[AO_CONE_COUNT] =
+{
+    0.033997f, 0.033997f, 0.033997f, 0.033997f,
+    0.033997f, 0.033997f, 0.033997f, 0.033997f,
+    0.033997f, 0.033997f, 0.090843f, 0.090843f,
+    0.090843f, 0.090843f, 0.090843f, 0.090843f,
+    0.114969f
+};
+
+// ComputeIndirectDiffuse's cones with CONE_COUNT 9, what deferred_shading.hlsl and emittance_bounce.hlsl use
+static const vec4_t diffuseCones[] =
+{
+    { 0.0f, 0.0f, 1.0f, 2.0f },
+    { 0.70710678118f, 0.0f, 0.70710678118f, 2.0f },
+    { -0.70710678118f, 0.0f, 0.70710678118f, 2.0f },
+    { 0.0f, 0.70710678118f, 0.70710678118f, 2.0f },
+    { 0.0f, -0.70710678118f, 0.70710678118f, 2.0f },
+    { 0.57735026919f, 0.57735026919f, 0.57735026919f, 2.0f },
+    { 0.57735026919f, -0.57735026919f, 0.57735026919f, 2.0f },
+    { -0.57735026919f, 0.57735026919f, 0.57735026919f, 2.0f },
+    { -0.57735026919f, -0.57735026919f, 0.57735026919f, 2.0f }
+};
+
+static const f32 diffuseWeights[] =
+{
+    0.15022110482f, 0.10622236190f, 0.10622236190f,
+    0.10622236190f, 0.10622236190f, 0.10622236190f,
+    0.10622236190f, 0.10622236190f, 0.10622236190f
+};
+
+// the mips of either grid
+struct TraceGrid
+{
+    uint3_t gridSize;
+    u32 numLevels;
+    const void* const* levels;
+    const CpuOpacitySvo* svo; // fetches the opacity from the SVO instead of levels
+    const CpuPagedOpacityGrid* paged; // or through the paged grid's indirection
+};
+
+// 4 cones traced together, one per lane
+struct ConePacket
+{
+    vec4 originX, originY, originZ;
+    vec4 dirX, dirY, dirZ;
+    vec4 coneRatio;
+    u32 lanes; // bit i is set when lane i holds a cone
+};
+
+// what SampleOpacityOneMip and SampleEmittanceOneMip derive from the direction
+struct FaceSampling
+{
+    vec4 weightX, weightY, weightZ;
+    vec4 offsetX, offsetY, offsetZ; // tcOffsets
+    f32 halfVoxelSizeX;
+};
+
+// the mip level each lane samples, the textures are 6 faces wide
+struct LaneMips
+{
+    const CpuOpacitySvo* svo;
+    const CpuPagedOpacityGrid* paged;
+    u32 level[4];
+    const void* texels[4];
+    s32 width[4];
+    s32 height[4];
+    s32 depth[4];
+    vec4 sizeX, sizeY, sizeZ;
+};
+
+// the 2 texels per axis of a trilinear fetch per lane, clamped to the texture
+struct Trilinear
+{
+    s32 x[4][2];
+    s32 y[4][2];
+    s32 z[4][2];
+    vec4 fracX, fracY, fracZ;
+};
+
+struct Rgba
+{
+    vec4 r, g, b, a;
+};
+
+// What each lane last learned from the occupancy: the empty block it was in or an occupied
+// voxel in its footprint. It's only read again when the footprint leaves the block or the voxel.
+// Only the lanes whose last sample was 0 are tested, the others are rarely in empty space and
+// wide cones would pay for the queries without ever skipping.
+struct EmptySpaceSkipping
+{
+    const CpuVoxelOccupancy* occupancy; // NULL when not skipping
+    uint3_t gridSize;
+    s32 maxLevel;
+    s32 blockMin[4][3];
+    s32 blockMax[4][3];
+    s32 occupiedVoxel[4][3];
+    u32 blockLanes; // the lanes with a block
+    u32 voxelLanes; // the lanes with an occupied voxel
+    u32 testLanes; // the lanes that skipped or sampled 0 last step
+};
+
+struct CpuConeTracer
+{
+    TraceGrid grid;
+    const CpuConeTraceSettings* settings;
+    const CpuCone* cones;
+    const vec3_t* positions;
+    const vec3_t* normals;
+    f32* occlusion;
+    vec3_t* emittance;
+    u32 count; // cones or points
+};
+
+// lerp()
+static vec4 Lerp(vec4 a, vec4 b, vec4 t)
+{
+    return a + (b - a) * t;
+}
+
+static vec4 LaneMask(u32 lanes)
+{
+    return Vec4Bits((lanes & 1) ? ~0u : 0, (lanes & 2) ? ~0u : 0, (lanes & 4) ? ~0u : 0, (lanes & 8) ? ~0u : 0);
+}
+
+static u32 LanesInBox(vec4 x, vec4 y, vec4 z)
+{
+    const vec4 zero = Vec4Zero();
+    const vec4 one = Vec4Splat(1.0f);
+    return LessEqualMask(zero, x) & LessEqualMask(x, one) &
+           LessEqualMask(zero, y) & LessEqualMask(y, one) &
+           LessEqualMask(zero, z) & LessEqualMask(z, one);
+}
+
+static u32 CountLanes(u32 lanes)
+{
+    return (lanes & 1) + ((lanes >> 1) & 1) + ((lanes >> 2) & 1) + ((lanes >> 3) & 1);
+}
+
+static TraceGrid GetTraceGrid(const CpuOpacityMips* mips)
+{
+    TraceGrid grid;
+    grid.gridSize = mips->gridSize;
+    grid.numLevels = mips->numLevels;
+    grid.levels = (const void* const*)mips->levels;
+    grid.svo = NULL;
+    grid.paged = NULL;
+    return grid;
+}
+
+static TraceGrid GetTraceGrid(const CpuEmittanceMips* mips)
+{
+    TraceGrid grid;
+    grid.gridSize = mips->gridSize;
+    grid.numLevels = mips->numLevels;
+    grid.levels = (const void* const*)mips->levels;
+    grid.svo = NULL;
+    grid.paged = NULL;
+    return grid;
+}
+
+static TraceGrid GetTraceGrid(const CpuOpacitySvo* svo)
+{
+    TraceGrid grid;
+    grid.gridSize.w = grid.gridSize.h = grid.gridSize.d = svo->gridSize;
+    grid.numLevels = svo->numLevels;
+    grid.levels = NULL;
+    grid.svo = svo;
+    grid.paged = NULL;
+    return grid;
+}
+
+static TraceGrid GetTraceGrid(const CpuPagedOpacityGrid* paged)
+{
+    TraceGrid grid;
+    grid.gridSize = paged->gridSize;
+    grid.numLevels = paged->numLevels;
+    grid.levels = NULL;
+    grid.svo = NULL;
+    grid.paged = paged;
+    return grid;
+}
+
+static void SetupFaceSampling(FaceSampling* s, const TraceGrid* grid, const ConePacket* c)
+{
+    s->weightX = c->dirX * c->dirX;
+    s->weightY = c->dirY * c->dirY;
+    s->weightZ = c->dirZ * c->dirZ;
+
+    f32 dir[3][4];
+    StoreVec4(dir[0], c->dirX);
+    StoreVec4(dir[1], c->dirY);
+    StoreVec4(dir[2], c->dirZ);
+    f32 offsets[3][4];
+    for (u32 a = 0; a < 3; ++a)
+    {
+        for (u32 l = 0; l < 4; ++l)
+        {
+            const f32 faceOffset = dir[a][l] >= 0.0f ? 0.0f : 1.0f;
+            offsets[a][l] = ((f32)(a * 2) + faceOffset) / 6.0f;
+        }
+    }
+    s->offsetX = LoadVec4(offsets[0]);
+    s->offsetY = LoadVec4(offsets[1]);
+    s->offsetZ = LoadVec4(offsets[2]);
+    s->halfVoxelSizeX = 0.5f / (f32)grid->gridSize.w;
+}
+
+// SampleLevel with an integer lod clamps it to the mip chain
+static void SelectMips(LaneMips* m, const TraceGrid* grid, vec4 level)
+{
+    f32 levels[4];
+    StoreVec4(levels, level);
+    f32 sizes[3][4];
+    m->svo = grid->svo;
+    m->paged = grid->paged;
+    for (u32 l = 0; l < 4; ++l)
+    {
+        const s32 index = CLAMP_MAX(CLAMP_MIN((s32)levels[l], 0), (s32)grid->numLevels - 1);
+        const uint3_t size = CpuVoxel_MipSize(grid->gridSize, (u32)index);
+        m->level[l] = (u32)index;
+        m->texels[l] = grid->levels != NULL ? grid->levels[index] : NULL;
+        m->width[l] = (s32)size.w * VoxelFace::Count;
+        m->height[l] = (s32)size.h;
+        m->depth[l] = (s32)size.d;
+        sizes[0][l] = (f32)m->width[l];
+        sizes[1][l] = (f32)m->height[l];
+        sizes[2][l] = (f32)m->depth[l];
+    }
+    m->sizeX = LoadVec4(sizes[0]);
+    m->sizeY = LoadVec4(sizes[1]);
+    m->sizeZ = LoadVec4(sizes[2]);
+}
+
+// MIN_MAG_LINEAR with clamped addressing
+static void SetupTrilinear(Trilinear* t, const LaneMips* m, vec4 tcX, vec4 tcY, vec4 tcZ)
+{
+    const vec4 half = Vec4Splat(0.5f);
+    const vec4 x = tcX * m->sizeX - half;
+    const vec4 y = tcY * m->sizeY - half;
+    const vec4 z = tcZ * m->sizeZ - half;
+    const vec4 x0 = Floor(x);
+    const vec4 y0 = Floor(y);
+    const vec4 z0 = Floor(z);
+    t->fracX = x - x0;
+    t->fracY = y - y0;
+    t->fracZ = z - z0;
+
+    f32 base[3][4];
+    StoreVec4(base[0], x0);
+    StoreVec4(base[1], y0);
+    StoreVec4(base[2], z0);
+    for (u32 l = 0; l < 4; ++l)
+    {
+        const s32 xi = (s32)base[0][l];
+        const s32 yi = (s32)base[1][l];
+        const s32 zi = (s32)base[2][l];
+        for (s32 i = 0; i < 2; ++i)
+        {
+            t->x[l][i] = CLAMP_MAX(CLAMP_MIN(xi + i, 0), m->width[l] - 1);
+            t->y[l][i] = CLAMP_MAX(CLAMP_MIN(yi + i, 0), m->height[l] - 1);
+            t->z[l][i] = CLAMP_MAX(CLAMP_MIN(zi + i, 0), m->depth[l] - 1);
+        }
+    }
+}
+
+// corner c is x + y * 2 + z * 4
+static size_t GetTexelIndex(const LaneMips* m, const Trilinear* t, u32 lane, u32 c)
+{
+    return ((size_t)t->z[lane][c >> 2] * m->height[lane] + t->y[lane][(c >> 1) & 1]) * m->width[lane] + t->x[lane][c & 1];
+}
+
+// the levels of the SVO and the paged grid past their bricks are dense
+static bool IsDenseLevel(const LaneMips* m, u32 level)
+{
+    return m->svo != NULL ? level >= m->svo->depth : level >= m->paged->numPagedLevels;
+}
+
+static u8 GetSparseTexel(const LaneMips* m, u32 level, u32 x, u32 y, u32 z, u32 face)
+{
+    return m->svo != NULL ? CpuVoxel_GetSvoTexel(m->svo, level, x, y, z, face) : CpuVoxel_GetPagedTexel(m->paged, level, x, y, z, face);
+}
+
+static const u8* FindSparseBrick(const LaneMips* m, u32 level, u32 x, u32 y, u32 z)
+{
+    return m->svo != NULL ? CpuVoxel_FindSvoBrick(m->svo, level, x, y, z) : CpuVoxel_FindPagedBrick(m->paged, level, x, y, z);
+}
+
+// the 8 corners of a lane, they're mostly in one brick so it's only looked up when it changes
+static void GatherSparseOpacity(const LaneMips* m, const Trilinear* t, u32 lane, f32* corners)
+{
+    const u32 level = m->level[lane];
+    const u32 faceWidth = (u32)m->width[lane] / VoxelFace::Count;
+    if (IsDenseLevel(m, level))
+    {
+        for (u32 c = 0; c < 8; ++c)
+        {
+            const u32 x = (u32)t->x[lane][c & 1];
+            corners[c] = (f32)GetSparseTexel(m, level, x % faceWidth, (u32)t->y[lane][(c >> 1) & 1], (u32)t->z[lane][c >> 2], x / faceWidth);
+        }
+        return;
+    }
+
+    const uint3_t brickSize = { CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE };
+    const u32 mask = CPU_VOXEL_BRICK_SIZE - 1;
+    u32 cachedKey = 0xFFFFFFFF;
+    const u8* brick = NULL;
+    for (u32 c = 0; c < 8; ++c)
+    {
+        const u32 texelX = (u32)t->x[lane][c & 1];
+        const u32 face = texelX / faceWidth;
+        const u32 x = texelX % faceWidth;
+        const u32 y = (u32)t->y[lane][(c >> 1) & 1];
+        const u32 z = (u32)t->z[lane][c >> 2];
+        const u32 key = (x / CPU_VOXEL_BRICK_SIZE) | ((y / CPU_VOXEL_BRICK_SIZE) << 10) | ((z / CPU_VOXEL_BRICK_SIZE) << 20);
+        if (key != cachedKey)
+        {
+            brick = FindSparseBrick(m, level, x, y, z);
+            cachedKey = key;
+        }
+        corners[c] = brick != NULL ? (f32)brick[CpuVoxel_TexelIndex(brickSize, x & mask, y & mask, z & mask, face)] : 0.0f;
+    }
+}
+
+static vec4 BlendTrilinear(const Trilinear* t, const vec4* corners)
+{
+    const vec4 x00 = Lerp(corners[0], corners[1], t->fracX);
+    const vec4 x10 = Lerp(corners[2], corners[3], t->fracX);
+    const vec4 x01 = Lerp(corners[4], corners[5], t->fracX);
+    const vec4 x11 = Lerp(corners[6], corners[7], t->fracX);
+    const vec4 y0 = Lerp(x00, x10, t->fracY);
+    const vec4 y1 = Lerp(x01, x11, t->fracY);
+    return Lerp(y0, y1, t->fracZ);
+}
+
+static vec4 SampleOpacityFace(const LaneMips* m, vec4 tcX, vec4 tcY, vec4 tcZ)
+{
+    Trilinear t;
+    SetupTrilinear(&t, m, tcX, tcY, tcZ);
+
+    f32 values[8][4];
+    for (u32 l = 0; l < 4; ++l)
+    {
+        if (m->svo != NULL || m->paged != NULL)
+        {
+            f32 lane[8];
+            GatherSparseOpacity(m, &t, l, lane);
+            for (u32 c = 0; c < 8; ++c)
+            {
+                values[c][l] = lane[c];
+            }
+            continue;
+        }
+
+        for (u32 c = 0; c < 8; ++c)
+        {
+            values[c][l] = (f32)((const u8*)m->texels[l])[GetTexelIndex(m, &t, l, c)];
+        }
+    }
+
+    const vec4 unormScale = Vec4Splat(255.0f);
+    vec4 corners[8];
+    for (u32 c = 0; c < 8; ++c)
+    {
+        corners[c] = LoadVec4(values[c]) / unormScale;
+    }
+
+    return BlendTrilinear(&t, corners);
+}
+
+static Rgba SampleEmittanceFace(const LaneMips* m, vec4 tcX, vec4 tcY, vec4 tcZ)
+{
+    Trilinear t;
+    SetupTrilinear(&t, m, tcX, tcY, tcZ);
+
+    // a texel is one lane's RGBA, transposed into one channel per register
+    vec4 corners[4][8];
+    for (u32 c = 0; c < 8; ++c)
+    {
+        vec4 r = LoadHalf4((const u16*)m->texels[0] + GetTexelIndex(m, &t, 0, c) * 4);
+        vec4 g = LoadHalf4((const u16*)m->texels[1] + GetTexelIndex(m, &t, 1, c) * 4);
+        vec4 b = LoadHalf4((const u16*)m->texels[2] + GetTexelIndex(m, &t, 2, c) * 4);
+        vec4 a = LoadHalf4((const u16*)m->texels[3] + GetTexelIndex(m, &t, 3, c) * 4);
+        Transpose(&r, &g, &b, &a);
+        corners[0][c] = r;
+        corners[1][c] = g;
+        corners[2][c] = b;
+        corners[3][c] = a;
+    }
+
+    Rgba result;
+    result.r = BlendTrilinear(&t, corners[0]);
+    result.g = BlendTrilinear(&t, corners[1]);
+    result.b = BlendTrilinear(&t, corners[2]);
+    result.a = BlendTrilinear(&t, corners[3]);
+    return result;
+}
+
+static void GetFaceCoordinates(const FaceSampling* s, vec4 posX, vec4* tcX)
+{
+    const vec4 clamped = Min(Max(posX, Vec4Splat(s->halfVoxelSizeX)), Vec4Splat(1.0f - s->halfVoxelSizeX));
+    *tcX = clamped / Vec4Splat(6.0f);
+}
+
+static vec4 SampleOpacityOneMip(const TraceGrid* grid, const FaceSampling* s, vec4 level, vec4 posX, vec4 posY, vec4 posZ)
+{
+    LaneMips m;
+    SelectMips(&m, grid, level);
+    vec4 tcX;
+    GetFaceCoordinates(s, posX, &tcX);
+    const vec4 x = SampleOpacityFace(&m, tcX + s->offsetX, posY, posZ);
+    const vec4 y = SampleOpacityFace(&m, tcX + s->offsetY, posY, posZ);
+    const vec4 z = SampleOpacityFace(&m, tcX + s->offsetZ, posY, posZ);
+    return x * s->weightX + y * s->weightY + z * s->weightZ;
+}
+
+static Rgba SampleEmittanceOneMip(const TraceGrid* grid, const FaceSampling* s, vec4 level, vec4 posX, vec4 posY, vec4 posZ)
+{
+    LaneMips m;
+    SelectMips(&m, grid, level);
+    vec4 tcX;
+    GetFaceCoordinates(s, posX, &tcX);
+    const Rgba x = SampleEmittanceFace(&m, tcX + s->offsetX, posY, posZ);
+    const Rgba y = SampleEmittanceFace(&m, tcX + s->offsetY, posY, posZ);
+    const Rgba z = SampleEmittanceFace(&m, tcX + s->offsetZ, posY, posZ);
+
+    Rgba result;
+    result.r = x.r * s->weightX + y.r * s->weightY + z.r * s->weightZ;
+    result.g = x.g * s->weightX + y.g * s->weightY + z.g * s->weightZ;
+    result.b = x.b * s->weightX + y.b * s->weightY + z.b * s->weightZ;
+    result.a = x.a * s->weightX + y.a * s->weightY + z.a * s->weightZ;
+    return result;
+}
+
+// the lanes whose lod isn't a whole number need the next mip
+static u32 GetFractionalLanes(vec4 lod, vec4 lowMip)
+{
+    return (~(LessEqualMask(lod, lowMip) & LessEqualMask(lowMip, lod))) & 15;
+}
+
+static vec4 SampleOpacity(const TraceGrid* grid, const FaceSampling* s, vec4 lod, vec4 posX, vec4 posY, vec4 posZ)
+{
+    const vec4 lowMip = Floor(lod);
+    const vec4 low = SampleOpacityOneMip(grid, s, lowMip, posX, posY, posZ);
+    const u32 fractional = GetFractionalLanes(lod, lowMip);
+    if (fractional == 0)
+    {
+        return low;
+    }
+
+    // ceil(lod) where it matters
+    const vec4 high = SampleOpacityOneMip(grid, s, lowMip + Vec4Splat(1.0f), posX, posY, posZ);
+    return Select(low, Lerp(low, high, lod - lowMip), LaneMask(fractional));
+}
+
+static Rgba SampleEmittance(const TraceGrid* grid, const FaceSampling* s, vec4 lod, vec4 posX, vec4 posY, vec4 posZ)
+{
+    const vec4 lowMip = Floor(lod);
+    const Rgba low = SampleEmittanceOneMip(grid, s, lowMip, posX, posY, posZ);
+    const u32 fractional = GetFractionalLanes(lod, lowMip);
+    if (fractional == 0)
+    {
+        return low;
+    }
+
+    const Rgba high = SampleEmittanceOneMip(grid, s, lowMip + Vec4Splat(1.0f), posX, posY, posZ);
+    const vec4 t = lod - lowMip;
+    const vec4 mask = LaneMask(fractional);
+    Rgba result;
+    result.r = Select(low.r, Lerp(low.r, high.r, t), mask);
+    result.g = Select(low.g, Lerp(low.g, high.g, t), mask);
+    result.b = Select(low.b, Lerp(low.b, high.b, t), mask);
+    result.a = Select(low.a, Lerp(low.a, high.a, t), mask);
+    return result;
+}
+
+static vec4 ComputeLod(vec4 lodLinear, f32 mipBias)
+{
+    f32 lods[4];
+    StoreVec4(lods, lodLinear);
+    for (u32 l = 0; l < 4; ++l)
+    {
+        lods[l] = log2f(lods[l]) + mipBias;
+    }
+    return LoadVec4(lods);
+}
+
+// CorrectOpacity
+static vec4 CorrectOpacity(vec4 opacity, vec4 factor)
+{
+    f32 opacities[4], factors[4];
+    StoreVec4(opacities, opacity);
+    StoreVec4(factors, factor);
+    for (u32 l = 0; l < 4; ++l)
+    {
+        const f32 saturated = opacities[l] > 0.0f ? MIN(opacities[l], 1.0f) : 0.0f;
+        opacities[l] = 1.0f - powf(1.0f - saturated, factors[l]);
+    }
+    return LoadVec4(opacities);
+}
+
+// VoxelSizeMip0
+static vec4 GetNormalStepSize(const TraceGrid* grid, const ConePacket* c)
+{
+    const vec4 epsilon = Vec4Splat(1.0f / (f32)(1 << 20));
+    const vec4 one = Vec4Splat(1.0f);
+    const vec4 x = one / (Vec4Splat((f32)grid->gridSize.w) * Max(Abs(c->dirX), epsilon));
+    const vec4 y = one / (Vec4Splat((f32)grid->gridSize.h) * Max(Abs(c->dirY), epsilon));
+    const vec4 z = one / (Vec4Splat((f32)grid->gridSize.d) * Max(Abs(c->dirZ), epsilon));
+    return Min(Min(x, y), z);
+}
+
+static void SetupEmptySpaceSkipping(EmptySpaceSkipping* e, const TraceGrid* grid, const CpuVoxelOccupancy* occupancy)
+{
+    assert(occupancy == NULL || (occupancy->gridSize.w == grid->gridSize.w && occupancy->gridSize.h == grid->gridSize.h && occupancy->gridSize.d == grid->gridSize.d));
+    e->occupancy = occupancy;
+    e->gridSize = grid->gridSize;
+    e->maxLevel = (s32)grid->numLevels - 1;
+    e->blockLanes = 0;
+    e->voxelLanes = 0;
+    e->testLanes = 0;
+}
+
+static bool IsInVoxels(const s32* voxel, const s32* min, const s32* max)
+{
+    return voxel[0] >= min[0] && voxel[0] <= max[0] &&
+           voxel[1] >= min[1] && voxel[1] <= max[1] &&
+           voxel[2] >= min[2] && voxel[2] <= max[2];
+}
+
+// The lanes whose step can only fetch zeros. A trilinear fetch at position t in the texels
+// of a mip reads texels floor(t - 0.5) and the next one, where GetFaceCoordinates moves t
+// along x by up to half a level 0 voxel. Texel i of mip m is the voxels [i; i + 1[ << m,
+// and the fetches past the x sides read the next face.
+static u32 FindEmptyLanes(EmptySpaceSkipping* e, u32 lanes, vec4 lod, vec4 posX, vec4 posY, vec4 posZ)
+{
+    lanes &= e->testLanes;
+    if (e->occupancy == NULL || lanes == 0)
+    {
+        return 0;
+    }
+
+    // the voxels under the texels of both mips, per axis and lane
+    const u32 gridSize[3] = { e->gridSize.w, e->gridSize.h, e->gridSize.d };
+    const vec4 positions[3] = { posX, posY, posZ };
+    const vec4 half = Vec4Splat(0.5f);
+    const vec4 epsilon = Vec4Splat(1.0f / 64.0f); // for the rounding of the texture coordinates
+    f32 lowMips[4];
+    StoreVec4(lowMips, Floor(lod));
+    s32 min[4][3], max[4][3];
+    u32 nextFace = 0;
+    for (s32 i = 0; i < 2; ++i)
+    {
+        s32 levels[4];
+        f32 sizes[3][4];
+        for (u32 l = 0; l < 4; ++l)
+        {
+            levels[l] = CLAMP_MAX(CLAMP_MIN((s32)lowMips[l] + i, 0), e->maxLevel);
+            for (u32 a = 0; a < 3; ++a)
+            {
+                sizes[a][l] = (f32)(gridSize[a] >> levels[l]);
+            }
+        }
+
+        for (u32 a = 0; a < 3; ++a)
+        {
+            const vec4 size = LoadVec4(sizes[a]);
+            const vec4 shift = a == 0 ? size * Vec4Splat(0.5f / (f32)gridSize[0]) + epsilon : epsilon;
+            const vec4 t = positions[a] * size - half;
+            f32 first[4], last[4];
+            StoreVec4(first, Floor(t - shift));
+            StoreVec4(last, Floor(t + shift));
+            for (u32 l = 0; l < 4; ++l)
+            {
+                const s32 texelMin = (s32)first[l];
+                const s32 texelMax = (s32)last[l] + 1;
+                if (a == 0 && (texelMin < 0 || texelMax >= (s32)sizes[0][l]))
+                {
+                    nextFace |= 1 << l;
+                }
+
+                const s32 voxelMin = texelMin * (1 << levels[l]);
+                const s32 voxelMax = (texelMax + 1) * (1 << levels[l]) - 1;
+                min[l][a] = i == 0 ? voxelMin : MIN(min[l][a], voxelMin);
+                max[l][a] = i == 0 ? voxelMax : MAX(max[l][a], voxelMax);
+            }
+        }
+    }
+
+    u32 empty = 0;
+    for (u32 l = 0; l < 4; ++l)
+    {
+        const u32 lane = 1 << l;
+        if ((lanes & lane) == 0)
+        {
+            continue;
+        }
+
+        if ((nextFace & lane) != 0 || ((e->voxelLanes & lane) != 0 && IsInVoxels(e->occupiedVoxel[l], min[l], max[l])))
+        {
+            e->testLanes &= ~lane;
+            continue;
+        }
+
+        if ((e->blockLanes & lane) != 0 &&
+            min[l][0] >= e->blockMin[l][0] && max[l][0] < e->blockMax[l][0] &&
+            min[l][1] >= e->blockMin[l][1] && max[l][1] < e->blockMax[l][1] &&
+            min[l][2] >= e->blockMin[l][2] && max[l][2] < e->blockMax[l][2])
+        {
+            empty |= lane;
+            continue;
+        }
+
+        if (FindEmptyBlock(e->occupancy, min[l], max[l], e->blockMin[l], e->blockMax[l], e->occupiedVoxel[l]))
+        {
+            e->blockLanes |= lane;
+            empty |= lane;
+        }
+        else
+        {
+            e->blockLanes &= ~lane;
+            e->voxelLanes |= lane;
+            e->testLanes &= ~lane;
+        }
+    }
+
+    return empty;
+}
+
+// TraceOpacityCone, the lanes stop on their own and the packet stops with its last lane
+static vec4 TraceOpacityPacket(const TraceGrid* grid, const ConePacket* c, const CpuConeTraceSettings* settings, CpuConeTraceStats* stats)
+{
+    FaceSampling s;
+    SetupFaceSampling(&s, grid, c);
+    EmptySpaceSkipping skip;
+    SetupEmptySpaceSkipping(&skip, grid, settings->occupancy);
+
+    const vec4 one = Vec4Splat(1.0f);
+    const vec4 normalStepSize = GetNormalStepSize(grid, c);
+    const vec4 invNormalStepSize = one / normalStepSize;
+    const vec4 minDist = normalStepSize * Vec4Splat(1.0625f);
+    const vec4 stepScale = Vec4Splat(settings->stepScale);
+    const vec4 opacityThreshold = Vec4Splat(settings->opacityThreshold);
+    const vec4 distanceScale = Vec4Splat(settings->distanceScale);
+    vec4 dist = minDist;
+    vec4 posX = c->originX + c->dirX * minDist;
+    vec4 posY = c->originY + c->dirY * minDist;
+    vec4 posZ = c->originZ + c->dirZ * minDist;
+    vec4 stepLength = normalStepSize; // so we don't correct the first voxel fetch
+
+    vec4 accOpacity = Vec4Zero();
+    vec4 occlusion = Vec4Zero();
+    for (;;)
+    {
+        const u32 active = c->lanes & LanesInBox(posX, posY, posZ) & LessMask(accOpacity, opacityThreshold);
+        if (active == 0)
+        {
+            break;
+        }
+
+        const vec4 sphereDiameter = Max(dist * c->coneRatio, minDist);
+        const vec4 step = sphereDiameter * stepScale;
+        const vec4 lodLinear = sphereDiameter * invNormalStepSize;
+        const vec4 lod = ComputeLod(lodLinear, settings->mipBias);
+
+        // they'd sample 0 and leave the cone as is, so they move on and the others wait for them
+        const u32 empty = FindEmptyLanes(&skip, active, lod, posX, posY, posZ);
+        stats->numSteps += CountLanes(empty != 0 ? empty : active);
+        if (empty != 0)
+        {
+            const vec4 mask = LaneMask(empty);
+            dist = Select(dist, dist + step, mask);
+            posX = Select(posX, posX + c->dirX * step, mask);
+            posY = Select(posY, posY + c->dirY * step, mask);
+            posZ = Select(posZ, posZ + c->dirZ * step, mask);
+            stepLength = Select(stepLength, step, mask);
+            continue;
+        }
+
+        stats->numSamples += CountLanes(active);
+        vec4 vxlOpacity = SampleOpacity(grid, &s, lod, posX, posY, posZ);
+        skip.testLanes = LessEqualMask(vxlOpacity, Vec4Zero());
+
+        const vec4 correctionFactor = stepLength / normalStepSize;
+        vxlOpacity = CorrectOpacity(vxlOpacity, correctionFactor);
+        const vec4 vxlOcclusion = vxlOpacity / (one + dist * distanceScale);
+
+        const vec4 mask = LaneMask(active);
+        accOpacity = Select(accOpacity, accOpacity + (one - accOpacity) * vxlOpacity, mask);
+        occlusion = Select(occlusion, occlusion + (one - occlusion) * vxlOcclusion, mask);
+        dist = Select(dist, dist + step, mask);
+        posX = Select(posX, posX + c->dirX * step, mask);
+        posY = Select(posY, posY + c->dirY * step, mask);
+        posZ = Select(posZ, posZ + c->dirZ * step, mask);
+        stepLength = Select(stepLength, step, mask);
+    }
+
+    return occlusion;
+}
+
+// TraceEmittanceCone
+static Rgba TraceEmittancePacket(const TraceGrid* grid, const ConePacket* c, const CpuConeTraceSettings* settings, vec4* occlusionOut, CpuConeTraceStats* stats)
+{
+    FaceSampling s;
+    SetupFaceSampling(&s, grid, c);
+    EmptySpaceSkipping skip;
+    SetupEmptySpaceSkipping(&skip, grid, settings->occupancy);
+
+    const vec4 one = Vec4Splat(1.0f);
+    const vec4 normalStepSize = GetNormalStepSize(grid, c);
+    const vec4 invNormalStepSize = one / normalStepSize;
+    const vec4 minDist = normalStepSize * Vec4Splat(1.0625f);
+    const vec4 maxDiameter = Vec4Splat(settings->maxDiameter) * normalStepSize;
+    const vec4 coneRatio = Min(Max(c->coneRatio, Vec4Splat(0.08f)), Vec4Splat(2.0f));
+    const vec4 stepScale = Vec4Splat(settings->stepScale);
+    const vec4 opacityThreshold = Vec4Splat(settings->opacityThreshold);
+    const vec4 distanceScale = Vec4Splat(settings->distanceScale);
+    vec4 dist = minDist;
+    vec4 posX = c->originX + c->dirX * minDist;
+    vec4 posY = c->originY + c->dirY * minDist;
+    vec4 posZ = c->originZ + c->dirZ * minDist;
+    vec4 stepLength = normalStepSize; // so we don't correct the first voxel fetch
+
+    Rgba acc; // accumulated light + opacity
+    acc.r = acc.g = acc.b = acc.a = Vec4Zero();
+    vec4 occlusion = Vec4Zero();
+    for (;;)
+    {
+        const u32 active = c->lanes & LanesInBox(posX, posY, posZ) & LessMask(acc.a, opacityThreshold);
+        if (active == 0)
+        {
+            break;
+        }
+
+        const vec4 sphereDiameter = Min(Max(dist * coneRatio, normalStepSize), maxDiameter);
+        const vec4 step = sphereDiameter * stepScale;
+        const vec4 lodLinear = sphereDiameter * invNormalStepSize;
+        const vec4 lod = ComputeLod(lodLinear, settings->mipBias);
+
+        const u32 empty = FindEmptyLanes(&skip, active, lod, posX, posY, posZ);
+        stats->numSteps += CountLanes(empty != 0 ? empty : active);
+        if (empty != 0)
+        {
+            const vec4 mask = LaneMask(empty);
+            dist = Select(dist, dist + step, mask);
+            posX = Select(posX, posX + c->dirX * step, mask);
+            posY = Select(posY, posY + c->dirY * step, mask);
+            posZ = Select(posZ, posZ + c->dirZ * step, mask);
+            stepLength = Select(stepLength, step, mask);
+            continue;
+        }
+
+        stats->numSamples += CountLanes(active);
+        Rgba vxlData = SampleEmittance(grid, &s, lod, posX, posY, posZ);
+        skip.testLanes = LessEqualMask(vxlData.a, Vec4Zero());
+
+        const vec4 correctionFactor = stepLength / normalStepSize;
+        vxlData.r = vxlData.r * correctionFactor;
+        vxlData.g = vxlData.g * correctionFactor;
+        vxlData.b = vxlData.b * correctionFactor;
+        vxlData.a = CorrectOpacity(vxlData.a, correctionFactor);
+
+        const vec4 accVis = one - acc.a;
+        const vec4 vxlOcclusion = vxlData.a / (one + dist * distanceScale);
+
+        const vec4 mask = LaneMask(active);
+        acc.r = Select(acc.r, acc.r + accVis * vxlData.r, mask);
+        acc.g = Select(acc.g, acc.g + accVis * vxlData.g, mask);
+        acc.b = Select(acc.b, acc.b + accVis * vxlData.b, mask);
+        acc.a = Select(acc.a, acc.a + accVis * vxlData.a, mask);
+        occlusion = Select(occlusion, occlusion + (one - occlusion) * vxlOcclusion, mask);
+        dist = Select(dist, dist + step, mask);
+        posX = Select(posX, posX + c->dirX * step, mask);
+        posY = Select(posY, posY + c->dirY * step, mask);
+        posZ = Select(posZ, posZ + c->dirZ * step, mask);
+        stepLength = Select(stepLength, step, mask);
+    }
+
+    *occlusionOut = occlusion;
+    return acc;
+}
+
+// the unused lanes repeat the first cone and are masked out
+static void LoadCones(ConePacket* c, const CpuCone* cones, u32 numCones)
+{
+    f32 values[7][4];
+    for (u32 l = 0; l < 4; ++l)
+    {
+        const CpuCone* cone = &cones[l < numCones ? l : 0];
+        values[0][l] = cone->origin.x;
+        values[1][l] = cone->origin.y;
+        values[2][l] = cone->origin.z;
+        values[3][l] = cone->dir.x;
+        values[4][l] = cone->dir.y;
+        values[5][l] = cone->dir.z;
+        values[6][l] = cone->coneRatio;
+    }
+    c->originX = LoadVec4(values[0]);
+    c->originY = LoadVec4(values[1]);
+    c->originZ = LoadVec4(values[2]);
+    c->dirX = LoadVec4(values[3]);
+    c->dirY = LoadVec4(values[4]);
+    c->dirZ = LoadVec4(values[5]);
+    c->coneRatio = LoadVec4(values[6]);
+    c->lanes = (1 << MIN(numCones, 4)) - 1;
+}
+
+// the cone in the tangent frame of ComputeAmbientOcclusion and ComputeIndirectDiffuse
+static CpuCone GetSurfaceCone(vec3_t position, vec3_t normal, vec4_t cone)
+{
+    // Orthogonal
+    const vec3_t unitX = { 1.0f, 0.0f, 0.0f };
+    const vec3_t unitY = { 0.0f, 1.0f, 0.0f };
+    const vec3_t orthogonal = fabsf(dot(normal, unitX)) > 0.75f ? cross(normal, unitY) : cross(normal, unitX);
+    const vec3_t tangent = norm(orthogonal);
+    const vec3_t bitangent = cross(normal, tangent);
+
+    CpuCone result;
+    result.origin = position;
+    result.dir = norm(tangent * cone.x + bitangent * cone.y + normal * cone.z);
+    result.coneRatio = cone.w;
+    return result;
+}
+
+CpuCone GetAmbientOcclusionCone(vec3_t position, vec3_t normal, u32 cone, f32* weight)
+{
+    assert(cone < ARRAY_LEN(aoCones));
+    *weight = aoWeights[cone];
+    return GetSurfaceCone(position, normal, aoCones[cone]);
+}
+
+static void LoadSurfaceCones(ConePacket* c, const vec3_t* positions, const vec3_t* normals, u32 numPoints, vec4_t cone)
+{
+    CpuCone cones[4];
+    for (u32 l = 0; l < MIN(numPoints, 4); ++l)
+    {
+        cones[l] = GetSurfaceCone(positions[l], normals[l], cone);
+    }
+    LoadCones(c, cones, numPoints);
+}
+
+static void StoreLanes(f32* output, vec4 values, u32 count)
+{
+    f32 lanes[4];
+    StoreVec4(lanes, values);
+    memcpy(output, lanes, MIN(count, 4) * sizeof(f32));
+}
+
+static void StoreLanes(vec3_t* output, const Rgba* values, u32 count)
+{
+    f32 r[4], g[4], b[4];
+    StoreVec4(r, values->r);
+    StoreVec4(g, values->g);
+    StoreVec4(b, values->b);
+    for (u32 l = 0; l < MIN(count, 4); ++l)
+    {
+        output[l].x = r[l];
+        output[l].y = g[l];
+        output[l].z = b[l];
+    }
+}
+
+// the counts of a range of packets
+static void AddStats(const CpuConeTraceSettings* settings, const CpuConeTraceStats* stats)
+{
+    if (settings->stats != NULL)
+    {
+        Sys_AtomicAdd64(&settings->stats->numSteps, stats->numSteps);
+        Sys_AtomicAdd64(&settings->stats->numSamples, stats->numSamples);
+    }
+}
+
+static void TraceOpacityCones(void* userData, u32 begin, u32 end)
+{
+    const CpuConeTracer* t = (const CpuConeTracer*)userData;
+    CpuConeTraceStats stats = {};
+    for (u32 p = begin; p < end; ++p)
+    {
+        const u32 first = p * 4;
+        ConePacket c;
+        LoadCones(&c, t->cones + first, t->count - first);
+        StoreLanes(t->occlusion + first, TraceOpacityPacket(&t->grid, &c, t->settings, &stats), t->count - first);
+    }
+    AddStats(t->settings, &stats);
+}
+
+static void TraceEmittanceCones(void* userData, u32 begin, u32 end)
+{
+    const CpuConeTracer* t = (const CpuConeTracer*)userData;
+    CpuConeTraceStats stats = {};
+    for (u32 p = begin; p < end; ++p)
+    {
+        const u32 first = p * 4;
+        ConePacket c;
+        LoadCones(&c, t->cones + first, t->count - first);
+        vec4 occlusion;
+        const Rgba emittance = TraceEmittancePacket(&t->grid, &c, t->settings, &occlusion, &stats);
+        StoreLanes(t->emittance + first, &emittance, t->count - first);
+        if (t->occlusion != NULL)
+        {
+            StoreLanes(t->occlusion + first, occlusion, t->count - first);
+        }
+    }
+    AddStats(t->settings, &stats);
+}
+
+// a packet holds the same cone for 4 points
+static void ComputeAmbientOcclusion(void* userData, u32 begin, u32 end)
+{
+    const CpuConeTracer* t = (const CpuConeTracer*)userData;
+    CpuConeTraceStats stats = {};
+    for (u32 p = begin; p < end; ++p)
+    {
+        const u32 first = p * 4;
+        vec4 totalOcclusion = Vec4Zero();
+        for (u32 i = 0; i < ARRAY_LEN(aoCones); ++i)
+        {
+            ConePacket c;
+            LoadSurfaceCones(&c, t->positions + first, t->normals + first, t->count - first, aoCones[i]);
+            totalOcclusion = totalOcclusion + Vec4Splat(aoWeights[i]) * TraceOpacityPacket(&t->grid, &c, t->settings, &stats);
+        }
+        StoreLanes(t->occlusion + first, totalOcclusion, t->count - first);
+    }
+    AddStats(t->settings, &stats);
+}
+
+static void ComputeIndirectDiffuse(void* userData, u32 begin, u32 end)
+{
+    const CpuConeTracer* t = (const CpuConeTracer*)userData;
+    CpuConeTraceStats stats = {};
+    for (u32 p = begin; p < end; ++p)
+    {
+        const u32 first = p * 4;
+        Rgba totalEmittance;
+        totalEmittance.r = totalEmittance.g = totalEmittance.b = totalEmittance.a = Vec4Zero();
+        vec4 totalOcclusion = Vec4Zero();
+        for (u32 i = 0; i < ARRAY_LEN(diffuseCones); ++i)
+        {
+            ConePacket c;
+            LoadSurfaceCones(&c, t->positions + first, t->normals + first, t->count - first, diffuseCones[i]);
+            vec4 occlusion;
+            const Rgba emittance = TraceEmittancePacket(&t->grid, &c, t->settings, &occlusion, &stats);
+            const vec4 weight = Vec4Splat(diffuseWeights[i]);
+            totalEmittance.r = totalEmittance.r + weight * emittance.r;
+            totalEmittance.g = totalEmittance.g + weight * emittance.g;
+            totalEmittance.b = totalEmittance.b + weight * emittance.b;
+            totalOcclusion = totalOcclusion + weight * occlusion;
+        }
+        StoreLanes(t->emittance + first, &totalEmittance, t->count - first);
+        if (t->occlusion != NULL)
+        {
+            StoreLanes(t->occlusion + first, totalOcclusion, t->count - first);
+        }
+    }
+    AddStats(t->settings, &stats);
+}
+
+static u32 NumPackets(u32 count)
+{
+    return (count + 3) / 4;
+}
+
+f32 CpuVoxel_SampleOpacity(const CpuOpacityMips* mips, f32 lod, vec3_t position, vec3_t dir)
+{
+    const TraceGrid grid = GetTraceGrid(mips);
+    CpuCone cone = { position, dir, 0.0f };
+    ConePacket c;
+    LoadCones(&c, &cone, 1);
+    FaceSampling s;
+    SetupFaceSampling(&s, &grid, &c);
+    return GetX(SampleOpacity(&grid, &s, Vec4Splat(lod), c.originX, c.originY, c.originZ));
+}
+
+vec4_t CpuVoxel_SampleEmittance(const CpuEmittanceMips* mips, f32 lod, vec3_t position, vec3_t dir)
+{
+    const TraceGrid grid = GetTraceGrid(mips);
+    CpuCone cone = { position, dir, 0.0f };
+    ConePacket c;
+    LoadCones(&c, &cone, 1);
+    FaceSampling s;
+    SetupFaceSampling(&s, &grid, &c);
+    const Rgba sample = SampleEmittance(&grid, &s, Vec4Splat(lod), c.originX, c.originY, c.originZ);
+    const vec4_t result = { GetX(sample.r), GetX(sample.g), GetX(sample.b), GetX(sample.a) };
+    return result;
+}
+
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuOpacityMips* mips, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(mips);
+    t.settings = settings;
+    t.cones = cones;
+    t.occlusion = occlusion;
+    t.count = numCones;
+    Job_ParallelFor(NumPackets(numCones), &TraceOpacityCones, &t, 0);
+}
+
+void CpuVoxel_TraceEmittanceCones(vec3_t* emittance, f32* occlusion, const CpuEmittanceMips* mips, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(mips);
+    t.settings = settings;
+    t.cones = cones;
+    t.emittance = emittance;
+    t.occlusion = occlusion;
+    t.count = numCones;
+    Job_ParallelFor(NumPackets(numCones), &TraceEmittanceCones, &t, 0);
+}
+
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuOpacityMips* mips, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(mips);
+    t.settings = settings;
+    t.positions = positions;
+    t.normals = normals;
+    t.occlusion = occlusion;
+    t.count = numPoints;
+    Job_ParallelFor(NumPackets(numPoints), &ComputeAmbientOcclusion, &t, 0);
+}
+
+void CpuVoxel_ComputeIndirectDiffuse(vec3_t* emittance, f32* occlusion, const CpuEmittanceMips* mips, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(mips);
+    t.settings = settings;
+    t.positions = positions;
+    t.normals = normals;
+    t.emittance = emittance;
+    t.occlusion = occlusion;
+    t.count = numPoints;
+    Job_ParallelFor(NumPackets(numPoints), &ComputeIndirectDiffuse, &t, 0);
+}
+
+f32 CpuVoxel_SampleOpacity(const CpuOpacitySvo* svo, f32 lod, vec3_t position, vec3_t dir)
+{
+    const TraceGrid grid = GetTraceGrid(svo);
+    CpuCone cone = { position, dir, 0.0f };
+    ConePacket c;
+    LoadCones(&c, &cone, 1);
+    FaceSampling s;
+    SetupFaceSampling(&s, &grid, &c);
+    return GetX(SampleOpacity(&grid, &s, Vec4Splat(lod), c.originX, c.originY, c.originZ));
+}
+
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuOpacitySvo* svo, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(svo);
+    t.settings = settings;
+    t.cones = cones;
+    t.occlusion = occlusion;
+    t.count = numCones;
+    Job_ParallelFor(NumPackets(numCones), &TraceOpacityCones, &t, 0);
+}
+
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuOpacitySvo* svo, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(svo);
+    t.settings = settings;
+    t.positions = positions;
+    t.normals = normals;
+    t.occlusion = occlusion;
+    t.count = numPoints;
+    Job_ParallelFor(NumPackets(numPoints), &ComputeAmbientOcclusion, &t, 0);
+}
+
+f32 CpuVoxel_SampleOpacity(const CpuPagedOpacityGrid* paged, f32 lod, vec3_t position, vec3_t dir)
+{
+    const TraceGrid grid = GetTraceGrid(paged);
+    CpuCone cone = { position, dir, 0.0f };
+    ConePacket c;
+    LoadCones(&c, &cone, 1);
+    FaceSampling s;
+    SetupFaceSampling(&s, &grid, &c);
+    return GetX(SampleOpacity(&grid, &s, Vec4Splat(lod), c.originX, c.originY, c.originZ));
+}
+
+void CpuVoxel_TraceOpacityCones(f32* occlusion, const CpuPagedOpacityGrid* paged, const CpuCone* cones, u32 numCones, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(paged);
+    t.settings = settings;
+    t.cones = cones;
+    t.occlusion = occlusion;
+    t.count = numCones;
+    Job_ParallelFor(NumPackets(numCones), &TraceOpacityCones, &t, 0);
+}
+
+void CpuVoxel_ComputeAmbientOcclusion(f32* occlusion, const CpuPagedOpacityGrid* paged, const vec3_t* positions, const vec3_t* normals, u32 numPoints, const CpuConeTraceSettings* settings)
+{
+    CpuConeTracer t = {};
+    t.grid = GetTraceGrid(paged);
+    t.settings = settings;
+    t.positions = positions;
+    t.normals = normals;
+    t.occlusion = occlusion;
+    t.count = numPoints;
+    Job_ParallelFor(NumPackets(numPoints), &ComputeAmbientOcclusion, &t, 0);
+}
@@ -0,0 +1,198 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+
+// the voxels of a world space position in a grid mapped to aabb
+static vec3_t GetVoxelPosition(const RenderAABB* aabb, uint3_t gridSize, vec3_t position)
+{
+    const vec3_t position01 = (position - aabb->min) / (aabb->max - aabb->min);
+    const vec3_t result = { position01.x * (f32)gridSize.w, position01.y * (f32)gridSize.h, position01.z * (f32)gridSize.d };
+    return result;
+}
+
+void CpuVoxel_AllocateDirtyBricks(CpuVoxelDirtyBricks* dirty, MemoryArena* arena, uint3_t gridSize)
+{
+    dirty->gridSize = gridSize;
+    dirty->numBricks.w = (gridSize.w + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+    dirty->numBricks.h = (gridSize.h + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+    dirty->numBricks.d = (gridSize.d + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+    dirty->bricks = PushArray(arena, dirty->numBricks.w * dirty->numBricks.h * dirty->numBricks.d, u8);
+    CpuVoxel_ClearDirtyBricks(dirty);
+}
+
+void CpuVoxel_ClearDirtyBricks(CpuVoxelDirtyBricks* dirty)
+{
+    memset(dirty->bricks, 0, dirty->numBricks.w * dirty->numBricks.h * dirty->numBricks.d);
+}
+
+u32 CpuVoxel_CountDirtyBricks(const CpuVoxelDirtyBricks* dirty)
+{
+    const u32 numBricks = dirty->numBricks.w * dirty->numBricks.h * dirty->numBricks.d;
+    u32 count = 0;
+    for (u32 b = 0; b < numBricks; ++b)
+    {
+        count += dirty->bricks[b];
+    }
+    return count;
+}
+
+void CpuVoxel_MarkDirtyBounds(CpuVoxelDirtyBricks* dirty, const RenderAABB* aabb, vec3_t min, vec3_t max)
+{
+    const vec3_t voxelMin = GetVoxelPosition(aabb, dirty->gridSize, min);
+    const vec3_t voxelMax = GetVoxelPosition(aabb, dirty->gridSize, max);
+    const s32 gridSize[3] = { (s32)dirty->gridSize.w, (s32)dirty->gridSize.h, (s32)dirty->gridSize.d };
+    s32 first[3], last[3];
+    for (u32 a = 0; a < 3; ++a)
+    {
+        // grown by a voxel and clamped as floats, the bounds of a far away light don't fit in an s32
+        const f32 lo = MAX(floorf(voxelMin[a]) - 1.0f, 0.0f);
+        const f32 hi = MIN(floorf(voxelMax[a]) + 1.0f, (f32)(gridSize[a] - 1));
+        if (!(lo <= hi))
+        {
+            return;
+        }
+        first[a] = (s32)lo / CPU_VOXEL_BRICK_SIZE;
+        last[a] = (s32)hi / CPU_VOXEL_BRICK_SIZE;
+    }
+
+    for (s32 z = first[2]; z <= last[2]; ++z)
+    {
+        for (s32 y = first[1]; y <= last[1]; ++y)
+        {
+            u8* row = dirty->bricks + ((u32)z * dirty->numBricks.h + (u32)y) * dirty->numBricks.w;
+            memset(row + first[0], 1, (size_t)(last[0] - first[0] + 1));
+        }
+    }
+}
+
+void CpuVoxel_MarkDirtyLight(CpuVoxelDirtyBricks* dirty, const RenderAABB* aabb, const Light* light)
+{
+    const vec3_t radius = { light->radius, light->radius, light->radius };
+    CpuVoxel_MarkDirtyBounds(dirty, aabb, light->position - radius, light->position + radius);
+}
+
+void CpuVoxel_ComputeMeshBounds(RenderAABB* bounds, const CpuVoxelGeometry* geometry)
+{
+    for (u32 m = 0; m < geometry->numMeshes; ++m)
+    {
+        const MeshFileMesh* mesh = &geometry->meshes[m];
+        RenderAABB* b = &bounds[m];
+        b->min = { FLT_MAX, FLT_MAX, FLT_MAX };
+        b->max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (u32 i = 0; i < mesh->numIndexes; ++i)
+        {
+            const vec3_t p = geometry->xyz[geometry->indexes[mesh->firstIndex + i]];
+            for (u32 a = 0; a < 3; ++a)
+            {
+                b->min[a] = MIN(b->min[a], p[a]);
+                b->max[a] = MAX(b->max[a], p[a]);
+            }
+        }
+    }
+}
+
+void CpuVoxel_MarkDirtyMaterial(CpuVoxelDirtyBricks* dirty, const CpuVoxelGeometry* geometry, const RenderAABB* meshBounds, u32 materialIndex)
+{
+    for (u32 m = 0; m < geometry->numMeshes; ++m)
+    {
+        if (geometry->meshes[m].materialIndex == materialIndex && geometry->meshes[m].numIndexes > 0)
+        {
+            CpuVoxel_MarkDirtyBounds(dirty, &geometry->aabb, meshBounds[m].min, meshBounds[m].max);
+        }
+    }
+}
+
+u32 GetDirtyBrickList(const CpuVoxelDirtyBricks* dirty, u32* bricks)
+{
+    const u32 numBricks = dirty->numBricks.w * dirty->numBricks.h * dirty->numBricks.d;
+    u32 count = 0;
+    for (u32 b = 0; b < numBricks; ++b)
+    {
+        if (dirty->bricks[b])
+        {
+            bricks[count++] = b;
+        }
+    }
+    return count;
+}
+
+bool GetDirtyBounds(const CpuVoxelDirtyBricks* dirty, u32* boundsMin, u32* boundsMax)
+{
+    const u32 gridSize[3] = { dirty->gridSize.w, dirty->gridSize.h, dirty->gridSize.d };
+    u32 first[3] = { dirty->numBricks.w, dirty->numBricks.h, dirty->numBricks.d };
+    u32 last[3] = { 0, 0, 0 };
+    bool found = false;
+    for (u32 z = 0; z < dirty->numBricks.d; ++z)
+    {
+        for (u32 y = 0; y < dirty->numBricks.h; ++y)
+        {
+            const u8* row = dirty->bricks + (z * dirty->numBricks.h + y) * dirty->numBricks.w;
+            for (u32 x = 0; x < dirty->numBricks.w; ++x)
+            {
+                if (row[x])
+                {
+                    const u32 coords[3] = { x, y, z };
+                    for (u32 a = 0; a < 3; ++a)
+                    {
+                        first[a] = MIN(first[a], coords[a]);
+                        last[a] = MAX(last[a], coords[a]);
+                    }
+                    found = true;
+                }
+            }
+        }
+    }
+
+    for (u32 a = 0; a < 3; ++a)
+    {
+        boundsMin[a] = first[a] * CPU_VOXEL_BRICK_SIZE;
+        boundsMax[a] = MIN((last[a] + 1) * CPU_VOXEL_BRICK_SIZE, gridSize[a]);
+    }
+    return found;
+}
+
+void KeepDirtyBricks(VoxelBins* bins, const CpuVoxelDirtyBricks* dirty)
+{
+    assert(bins->numBricks.w == dirty->numBricks.w && bins->numBricks.h == dirty->numBricks.h && bins->numBricks.d == dirty->numBricks.d);
+    u32 count = 0;
+    for (u32 i = 0; i < bins->numActiveBricks; ++i)
+    {
+        if (dirty->bricks[bins->activeBricks[i]])
+        {
+            bins->activeBricks[count++] = bins->activeBricks[i];
+        }
+    }
+    bins->numActiveBricks = count;
+}
@@ -0,0 +1,526 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+#include "../shaders/material_flags.hlsli"
+
+// a texel of the R32_UINT maps of the emittance voxelization pass
+struct EmittanceTexel
+{
+    u32 rg; // PackHDR
+    u32 ba; // PackHDR
+    u32 count;
+    u32 normal; // PackUnorm4x8U, the sample count in alpha
+};
+
+// LightEntity
+struct VoxelLight
+{
+    vec3_t position;
+    f32 radius;
+    vec3_t dir;
+    f32 cosUmbra;
+    vec3_t color;
+    f32 cosPenumbra;
+    m4x4 viewMatrix;
+    m4x4 projMatrix;
+};
+
+struct EmittanceVoxelizer
+{
+    VoxelBins bins;
+    CpuEmittanceGrid* grid;
+    const CpuVoxelLighting* lighting;
+    VoxelLight* lights;
+    vec3_t* normals; // per triangle, like the geometry shader's outputNormal
+    const u32* dirtyBricks; // for ClearEmittanceBricks
+};
+
+static u32 PackHDR(f32 x, f32 y)
+{
+    return (u32)F32ToF16(x) | ((u32)F32ToF16(y) << 16);
+}
+
+static void UnpackHDR(u32 packed, f32* x, f32* y)
+{
+    *x = F16ToF32((u16)(packed & 0xFFFF));
+    *y = F16ToF32((u16)(packed >> 16));
+}
+
+// without contention, the compare-exchange loop of AtomicAddHDR comes down to this
+static void AddHDR(EmittanceTexel* texel, vec4_t value)
+{
+    f32 r, g, b, a;
+    UnpackHDR(texel->rg, &r, &g);
+    UnpackHDR(texel->ba, &b, &a);
+    texel->rg = PackHDR(r + value.x, g + value.y);
+    texel->ba = PackHDR(b + value.z, a + value.w);
+    texel->count++;
+}
+
+// AtomicAverage: value is in [0;255], the average stops changing after 255 samples
+static void AddAverage(EmittanceTexel* texel, vec3_t value)
+{
+    const u32 old = texel->normal;
+    if (old == 0)
+    {
+        texel->normal = (u32)value.x | ((u32)value.y << 8) | ((u32)value.z << 16) | (1u << 24);
+        return;
+    }
+
+    const f32 count = (f32)(old >> 24);
+    if (old >> 24 == 255)
+    {
+        return;
+    }
+
+    const f32 r = ((f32)(old & 0xFF) * count + value.x) / (count + 1.0f);
+    const f32 g = ((f32)((old >> 8) & 0xFF) * count + value.y) / (count + 1.0f);
+    const f32 b = ((f32)((old >> 16) & 0xFF) * count + value.z) / (count + 1.0f);
+    texel->normal = (u32)r | ((u32)g << 8) | ((u32)b << 16) | ((u32)(count + 1.0f) << 24);
+}
+
+static vec4_t Transform4(const m4x4* m, vec4_t p)
+{
+    vec4_t r;
+    for (u32 i = 0; i < 4; ++i)
+    {
+        r.v[i] = m->E[i][0] * p.x + m->E[i][1] * p.y + m->E[i][2] * p.z + m->E[i][3] * p.w;
+    }
+    return r;
+}
+
+// PCF_Visibility: SampleCmpLevelZero with a linear filter, a GREATER comparison and a border of 0
+static f32 ShadowVisibility(const EmittanceVoxelizer* v, const VoxelLight* light, u32 slice, vec3_t positionWS)
+{
+    const CpuVoxelLighting* lighting = v->lighting;
+    if (lighting->shadowMaps == NULL)
+    {
+        return 1.0f;
+    }
+
+    vec4_t p = { positionWS.x, positionWS.y, positionWS.z, 1.0f };
+    p = Transform4(&light->viewMatrix, p);
+    p = Transform4(&light->projMatrix, p);
+    const vec3_t ndc = { p.x / p.w, p.y / p.w, p.z / p.w };
+    if (!(ndc.x >= -1.0f && ndc.x <= 1.0f && ndc.y >= -1.0f && ndc.y <= 1.0f && ndc.z >= 0.0f && ndc.z <= 1.0f))
+    {
+        return 1.0f;
+    }
+
+    const s32 size = (s32)lighting->shadowMapSize;
+    const f32* depths = lighting->shadowMaps + (size_t)slice * size * size;
+    const f32 reference = ndc.z + lighting->fixedBias;
+    const f32 x = (ndc.x * 0.5f + 0.5f) * (f32)size - 0.5f;
+    const f32 y = (1.0f - (ndc.y * 0.5f + 0.5f)) * (f32)size - 0.5f;
+    const s32 x0 = (s32)floorf(x);
+    const s32 y0 = (s32)floorf(y);
+    const f32 fx = x - (f32)x0;
+    const f32 fy = y - (f32)y0;
+
+    f32 passed[4];
+    for (u32 i = 0; i < 4; ++i)
+    {
+        const s32 tx = x0 + (s32)(i & 1);
+        const s32 ty = y0 + (s32)(i >> 1);
+        const bool inside = tx >= 0 && tx < size && ty >= 0 && ty < size;
+        const f32 depth = inside ? depths[ty * size + tx] : 0.0f;
+        passed[i] = reference > depth ? 1.0f : 0.0f;
+    }
+
+    const f32 top = passed[0] + (passed[1] - passed[0]) * fx;
+    const f32 bottom = passed[2] + (passed[3] - passed[2]) * fx;
+    return top + (bottom - top) * fy;
+}
+
+// ShadeDiffuse
+static vec3_t ShadeDiffuse(const VoxelLight* light, vec3_t positionWS, vec3_t N, vec3_t albedo, f32 vis)
+{
+    const vec3_t toLight = light->position - positionWS;
+    const f32 d = length(toLight);
+    const vec3_t L = toLight / d;
+
+    // PointLightFalloff
+    f32 distFalloff = light->radius / MAX(d, 0.01f);
+    distFalloff *= distFalloff;
+    f32 window = d / light->radius;
+    window *= window;
+    window *= window;
+    window = MAX(1.0f - window, 0.0f);
+    window *= window;
+
+    // SpotLightDirectionalFalloff
+    const f32 cosThetaS = -dot(light->dir, L);
+    f32 dirFalloff = CLAMP_MIN(CLAMP_MAX((cosThetaS - light->cosUmbra) / (light->cosPenumbra - light->cosUmbra), 1.0f), 0.0f);
+    dirFalloff *= dirFalloff;
+
+    const f32 NL = MAX(0.0f, dot(N, L));
+    const f32 scale = vis * distFalloff * window * dirFalloff * NL;
+    const vec3_t result = { albedo.x * light->color.x * scale, albedo.y * light->color.y * scale, albedo.z * light->color.z * scale };
+    return result;
+}
+
+static vec3_t SampleAlbedo(const CpuAlbedoTexture* texture, vec2_t tc)
+{
+    const f32 x = tc.u * (f32)texture->width - 0.5f;
+    const f32 y = tc.v * (f32)texture->height - 0.5f;
+    const f32 fx0 = floorf(x);
+    const f32 fy0 = floorf(y);
+    const f32 fx = x - fx0;
+    const f32 fy = y - fy0;
+    const s32 w = (s32)texture->width;
+    const s32 h = (s32)texture->height;
+    const s32 x0 = (((s32)fmodf(fx0, (f32)w)) + w) % w;
+    const s32 y0 = (((s32)fmodf(fy0, (f32)h)) + h) % h;
+    const s32 x1 = (x0 + 1) % w;
+    const s32 y1 = (y0 + 1) % h;
+
+    const u8* t00 = texture->texels + ((size_t)y0 * w + x0) * 4;
+    const u8* t10 = texture->texels + ((size_t)y0 * w + x1) * 4;
+    const u8* t01 = texture->texels + ((size_t)y1 * w + x0) * 4;
+    const u8* t11 = texture->texels + ((size_t)y1 * w + x1) * 4;
+    vec3_t result;
+    for (u32 c = 0; c < 3; ++c)
+    {
+        const f32 top = (f32)t00[c] + ((f32)t10[c] - (f32)t00[c]) * fx;
+        const f32 bottom = (f32)t01[c] + ((f32)t11[c] - (f32)t01[c]) * fx;
+        result.v[c] = (top + (bottom - top) * fy) / 255.0f;
+    }
+    return result;
+}
+
+// the pixel shader of the emittance voxelization pass
+struct ShadeSample
+{
+    const EmittanceVoxelizer* v;
+    const VoxelTriangle* tri;
+    const Material* material;
+    const CpuAlbedoTexture* texture; // NULL uses alphaTestedColor.rgb
+    vec3_t normal;
+    vec3_t normal01; // normal * 0.5 + 0.5 in [0;255]
+    EmittanceTexel* texels; // the brick's
+    const u32* brickMin;
+    u32 faces[3];
+
+    void operator()(const u32* voxel, f32 u, f32 w)
+    {
+        // the vertex attributes are interpolated over the rasterized triangle, which the
+        // conservative mode grew: E_k / sum(E) is the weight of the vertex facing edge k
+        f32 E[3];
+        for (u32 k = 0; k < 3; ++k)
+        {
+            E[k] = tri->edgeA[k] * u + tri->edgeB[k] * w + tri->edgeC[k];
+        }
+        const f32 invSum = 1.0f / (E[0] + E[1] + E[2]);
+        const f32 weights[3] = { E[1] * invSum, E[2] * invSum, E[0] * invSum };
+
+        const CpuVoxelGeometry* geometry = v->bins.geometry;
+        vec3_t positionWS = { 0.0f, 0.0f, 0.0f };
+        for (u32 i = 0; i < 3; ++i)
+        {
+            positionWS = positionWS + geometry->xyz[tri->indexes[i]] * weights[i];
+        }
+
+        vec3_t albedo;
+        if (texture != NULL)
+        {
+            vec2_t tc = { 0.0f, 0.0f };
+            for (u32 i = 0; i < 3; ++i)
+            {
+                const vec2_t vertexTC = geometry->tc[tri->indexes[i]];
+                tc.u += vertexTC.u * weights[i];
+                tc.v += vertexTC.v * weights[i];
+            }
+            albedo = SampleAlbedo(texture, tc);
+        }
+        else
+        {
+            albedo = { material->alphaTestedColor.x, material->alphaTestedColor.y, material->alphaTestedColor.z };
+        }
+
+        vec3_t color = { 0.0f, 0.0f, 0.0f };
+        if (material->flags & IS_EMISSIVE)
+        {
+            color = albedo;
+        }
+        else
+        {
+            for (u32 l = 0; l < v->lighting->numLights; ++l)
+            {
+                const f32 vis = ShadowVisibility(v, &v->lights[l], l, positionWS);
+                color = color + ShadeDiffuse(&v->lights[l], positionWS, normal, albedo, vis);
+            }
+        }
+
+        const vec4_t value = { color.x, color.y, color.z, material->alphaTestedColor.w };
+        const u32 x = voxel[0] - brickMin[0];
+        const u32 y = voxel[1] - brickMin[1];
+        const u32 z = voxel[2] - brickMin[2];
+        for (u32 f = 0; f < 3; ++f)
+        {
+            EmittanceTexel* texel = &texels[((z * CPU_VOXEL_BRICK_SIZE + y) * VoxelFace::Count + faces[f]) * CPU_VOXEL_BRICK_SIZE + x];
+            AddHDR(texel, value);
+            AddAverage(texel, normal01);
+        }
+    }
+};
+
+static void SetupLights(EmittanceVoxelizer* v)
+{
+    const CpuVoxelLighting* lighting = v->lighting;
+    for (u32 l = 0; l < lighting->numLights; ++l)
+    {
+        const Light* e = &lighting->lights[l];
+        VoxelLight* light = &v->lights[l];
+        light->position = e->position;
+        light->radius = e->radius;
+        light->dir = e->dir;
+        light->cosUmbra = cos(TO_RADIANS(e->umbraAngle));
+        light->color = { e->color.x, e->color.y, e->color.z };
+        light->cosPenumbra = cos(TO_RADIANS(e->penumbraAngle));
+        light->viewMatrix = e->viewMatrix;
+        light->projMatrix = e->projMatrix;
+    }
+}
+
+static void SetupNormals(void* userData, u32 begin, u32 end)
+{
+    EmittanceVoxelizer* v = (EmittanceVoxelizer*)userData;
+    const CpuVoxelGeometry* geometry = v->bins.geometry;
+    const vec3_t extent = geometry->aabb.max - geometry->aabb.min;
+    for (u32 t = begin; t < end; ++t)
+    {
+        const VoxelTriangle* tri = &v->bins.triangles[t];
+        if (tri->axis != 0xFF)
+        {
+            vec3_t pos01[3];
+            for (u32 k = 0; k < 3; ++k)
+            {
+                pos01[k] = (geometry->xyz[tri->indexes[k]] - geometry->aabb.min) / extent;
+            }
+            v->normals[t] = norm(cross(pos01[1] - pos01[0], pos01[2] - pos01[0]) / extent);
+        }
+    }
+}
+
+static int CompareTriangles(const void* a, const void* b)
+{
+    const u32 x = *(const u32*)a;
+    const u32 y = *(const u32*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// the format fix: the average of the samples, stored as half floats
+static void ResolveBrick(const EmittanceVoxelizer* v, const EmittanceTexel* texels, const u32* brickMin, const u32* brickMax)
+{
+    CpuEmittanceGrid* grid = v->grid;
+    for (u32 z = brickMin[2]; z < brickMax[2]; ++z)
+    {
+        for (u32 y = brickMin[1]; y < brickMax[1]; ++y)
+        {
+            for (u32 f = 0; f < VoxelFace::Count; ++f)
+            {
+                const size_t row = CpuVoxel_TexelIndex(grid->gridSize, brickMin[0], y, z, f);
+                const EmittanceTexel* src = &texels[(((z - brickMin[2]) * CPU_VOXEL_BRICK_SIZE + (y - brickMin[1])) * VoxelFace::Count + f) * CPU_VOXEL_BRICK_SIZE];
+                for (u32 x = 0; x < brickMax[0] - brickMin[0]; ++x)
+                {
+                    u16* dst = &grid->texels[(row + x) * 4];
+                    if (src[x].count == 0)
+                    {
+                        dst[0] = dst[1] = dst[2] = dst[3] = 0;
+                    }
+                    else
+                    {
+                        f32 rgba[4];
+                        UnpackHDR(src[x].rg, &rgba[0], &rgba[1]);
+                        UnpackHDR(src[x].ba, &rgba[2], &rgba[3]);
+                        const f32 count = (f32)src[x].count;
+                        for (u32 c = 0; c < 4; ++c)
+                        {
+                            dst[c] = F32ToF16(rgba[c] / count);
+                        }
+                    }
+                    if (grid->normals != NULL)
+                    {
+                        grid->normals[row + x] = src[x].normal;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void RasterizeEmittanceBricks(void* userData, u32 begin, u32 end)
+{
+    EmittanceVoxelizer* v = (EmittanceVoxelizer*)userData;
+    VoxelBins* bins = &v->bins;
+    const CpuVoxelGeometry* geometry = bins->geometry;
+
+    ScratchMemory scratch;
+    EmittanceTexel* texels = PushArray(scratch.arena, CPU_VOXEL_BRICK_TEXELS, EmittanceTexel);
+
+    for (u32 i = begin; i < end; ++i)
+    {
+        const u32 brick = bins->activeBricks[i];
+        u32 brickMin[3], brickMax[3];
+        GetBrickBounds(bins, brick, brickMin, brickMax);
+        memset(texels, 0, CPU_VOXEL_BRICK_TEXELS * sizeof(EmittanceTexel));
+
+        // the sums are rounded to half floats after every sample, so the order matters:
+        // the brick's list is ours alone, sort it back into draw order
+        u32* triangles = bins->brickTriangles + bins->brickOffsets[brick];
+        const u32 numTriangles = bins->brickOffsets[brick + 1] - bins->brickOffsets[brick];
+        qsort(triangles, numTriangles, sizeof(u32), &CompareTriangles);
+
+        for (u32 t = 0; t < numTriangles; ++t)
+        {
+            const VoxelTriangle* tri = &bins->triangles[triangles[t]];
+            const u32 materialIndex = geometry->meshes[tri->mesh].materialIndex;
+
+            ShadeSample shade;
+            shade.v = v;
+            shade.tri = tri;
+            shade.material = &geometry->materials[materialIndex];
+            shade.texture = NULL;
+            if (!(shade.material->flags & IS_ALPHA_TESTED) &&
+                geometry->albedoTextures != NULL &&
+                geometry->albedoTextures[materialIndex].texels != NULL)
+            {
+                shade.texture = &geometry->albedoTextures[materialIndex];
+            }
+            shade.normal = v->normals[triangles[t]];
+            for (u32 c = 0; c < 3; ++c)
+            {
+                shade.normal01.v[c] = CLAMP_MIN(CLAMP_MAX(shade.normal.v[c] * 0.5f + 0.5f, 1.0f), 0.0f) * 255.0f;
+            }
+            shade.texels = texels;
+            shade.brickMin = brickMin;
+            shade.faces[0] = VoxelFace::PosX + (tri->faceOffsets & 1);
+            shade.faces[1] = VoxelFace::PosY + ((tri->faceOffsets >> 1) & 1);
+            shade.faces[2] = VoxelFace::PosZ + ((tri->faceOffsets >> 2) & 1);
+            RasterizeTriangle(tri, brickMin, brickMax, &shade);
+        }
+
+        ResolveBrick(v, texels, brickMin, brickMax);
+    }
+}
+
+static void ClearEmittanceSlices(void* userData, u32 begin, u32 end)
+{
+    CpuEmittanceGrid* grid = (CpuEmittanceGrid*)userData;
+    ClearGridSlices(grid->texels, sizeof(u16) * 4, grid->gridSize, begin, end);
+    if (grid->normals != NULL)
+    {
+        ClearGridSlices(grid->normals, sizeof(u32), grid->gridSize, begin, end);
+    }
+}
+
+static void ClearEmittanceBricks(void* userData, u32 begin, u32 end)
+{
+    const EmittanceVoxelizer* v = (const EmittanceVoxelizer*)userData;
+    CpuEmittanceGrid* grid = v->grid;
+    for (u32 i = begin; i < end; ++i)
+    {
+        u32 brickMin[3], brickMax[3];
+        GetBrickBounds(&v->bins, v->dirtyBricks[i], brickMin, brickMax);
+        ClearGridBrick(grid->texels, sizeof(u16) * 4, grid->gridSize, brickMin, brickMax);
+        if (grid->normals != NULL)
+        {
+            ClearGridBrick(grid->normals, sizeof(u32), grid->gridSize, brickMin, brickMax);
+        }
+    }
+}
+
+// the lights, and the triangles touching the voxels [boundsMin; boundsMax[ with their normals
+static void SetupVoxelizer(EmittanceVoxelizer* v, CpuEmittanceGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelLighting* lighting, const u32* boundsMin, const u32* boundsMax, bool conservative, MemoryArena* scratch)
+{
+    assert(lighting->shadowMaps == NULL || lighting->shadowMapSize > 0);
+
+    v->grid = grid;
+    v->lighting = lighting;
+    v->lights = PushArray(scratch, MAX(lighting->numLights, 1), VoxelLight);
+    SetupLights(v);
+    BinTrianglesInBounds(&v->bins, geometry, grid->gridSize, boundsMin, boundsMax, conservative, scratch);
+    v->normals = PushArray(scratch, MAX(v->bins.numTriangles, 1), vec3_t);
+    Job_ParallelFor(v->bins.numTriangles, &SetupNormals, v, 0);
+}
+
+void CpuVoxel_AllocateEmittanceGrid(CpuEmittanceGrid* grid, MemoryArena* arena, uint3_t gridSize, bool normals)
+{
+    grid->gridSize = gridSize;
+    grid->texels = PushArray(arena, CpuVoxel_NumTexels(gridSize) * 4, u16);
+    grid->normals = normals ? PushArray(arena, CpuVoxel_NumTexels(gridSize), u32) : NULL;
+}
+
+void CpuVoxel_VoxelizeEmittance(CpuEmittanceGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelLighting* lighting, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats)
+{
+    const u32 boundsMin[3] = { 0, 0, 0 };
+    const u32 boundsMax[3] = { grid->gridSize.w, grid->gridSize.h, grid->gridSize.d };
+    EmittanceVoxelizer v;
+    SetupVoxelizer(&v, grid, geometry, lighting, boundsMin, boundsMax, conservative, scratch);
+
+    Job_ParallelFor(grid->gridSize.d, &ClearEmittanceSlices, grid, 1);
+    // bricks vary a lot in cost, small ranges keep the threads busy
+    Job_ParallelFor(v.bins.numActiveBricks, &RasterizeEmittanceBricks, &v, 1);
+
+    if (stats != NULL)
+    {
+        stats->numTriangles = v.bins.numTriangles;
+        stats->numBrickTriangles = v.bins.brickOffsets[v.bins.numBricks.w * v.bins.numBricks.h * v.bins.numBricks.d];
+        stats->numBricks = v.bins.numActiveBricks;
+    }
+}
+
+void CpuVoxel_VoxelizeEmittanceBricks(CpuEmittanceGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelLighting* lighting, const CpuVoxelDirtyBricks* dirty, bool conservative, MemoryArena* scratch)
+{
+    assert(dirty->gridSize.w == grid->gridSize.w && dirty->gridSize.h == grid->gridSize.h && dirty->gridSize.d == grid->gridSize.d);
+
+    u32 boundsMin[3], boundsMax[3];
+    if (!GetDirtyBounds(dirty, boundsMin, boundsMax))
+    {
+        return;
+    }
+
+    EmittanceVoxelizer v;
+    SetupVoxelizer(&v, grid, geometry, lighting, boundsMin, boundsMax, conservative, scratch);
+    KeepDirtyBricks(&v.bins, dirty);
+    u32* dirtyBricks = PushArray(scratch, v.bins.numBricks.w * v.bins.numBricks.h * v.bins.numBricks.d, u32);
+    const u32 numDirtyBricks = GetDirtyBrickList(dirty, dirtyBricks);
+    v.dirtyBricks = dirtyBricks;
+
+    // the bricks without triangles are only cleared, ResolveBrick overwrites the others
+    Job_ParallelFor(numDirtyBricks, &ClearEmittanceBricks, &v, 0);
+    Job_ParallelFor(v.bins.numActiveBricks, &RasterizeEmittanceBricks, &v, 1);
+}
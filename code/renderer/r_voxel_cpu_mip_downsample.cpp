@@ -0,0 +1,450 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+// powers of 2, a tile builds log2(MIP_TILE_SIZE) levels on its own
+// the tiles are wider along x, the rows of a face are the only contiguous texels
+#define MIP_TILE_WIDTH 64
+#define MIP_TILE_SIZE 16
+#define MIP_TILE_LEVELS 4
+
+struct MipBuilder;
+typedef void (*DownsampleFunc)(const MipBuilder* b, u32 level, const u32* dstMin, const u32* dstMax);
+
+struct MipBuilder
+{
+    uint3_t gridSize;
+    u32 numLevels;
+    u32 numTileLevels;
+    uint3_t numTiles;
+    void* const* levels;
+    DownsampleFunc downsample;
+    u32 level; // for BuildSlices and UpdateBricks
+    const u32* dirtyBricks; // for UpdateBricks, the bricks of CPU_VOXEL_BRICK_SIZE^3 texels of the level
+    uint3_t numBricks;
+};
+
+// the children of a voxel are indexed x * 4 + y * 2 + z,
+// these are the (front, back) pairs of each face in the order the shaders add them
+static const u8 compositePairs[VoxelFace::Count][4][2] =
+{
+    { { 1, 5 }, { 0, 4 }, { 3, 7 }, { 2, 6 } }, // +x
+    { { 4, 0 }, { 5, 1 }, { 6, 2 }, { 7, 3 } }, // -x
+    { { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 } }, // +y
+    { { 2, 0 }, { 3, 1 }, { 7, 5 }, { 6, 4 } }, // -y
+    { { 0, 1 }, { 4, 5 }, { 2, 3 }, { 6, 7 } }, // +z
+    { { 1, 0 }, { 5, 4 }, { 3, 2 }, { 7, 6 } }  // -z
+};
+
+// front + (1 - front opacity) * back
+struct OpacityOver
+{
+    static vec4 Over(vec4 front, vec4 back)
+    {
+        return front + (Vec4Splat(1.0f) - front) * back;
+    }
+};
+
+struct EmittanceOver
+{
+    static vec4 Over(vec4 front, vec4 back)
+    {
+        return front + (Vec4Splat(1.0f) - Shuffle<3, 3, 3, 3>(front)) * back;
+    }
+};
+
+template <typename T>
+static vec4 Composite(const vec4* children, u32 face)
+{
+    vec4 result = Vec4Zero();
+    for (u32 p = 0; p < 4; ++p)
+    {
+        const u8* pair = compositePairs[face][p];
+        result = result + T::Over(children[pair[0]], children[pair[1]]);
+    }
+
+    return result * Vec4Splat(0.25f);
+}
+
+// the lanes are 4 voxels along x, the rows of 8 children are split into even and odd x
+static void DownsampleOpacity(const MipBuilder* b, u32 level, const u32* dstMin, const u32* dstMax)
+{
+    const uint3_t srcSize = CpuVoxel_MipSize(b->gridSize, level - 1);
+    const uint3_t dstSize = CpuVoxel_MipSize(b->gridSize, level);
+    const u8* src = (const u8*)b->levels[level - 1];
+    u8* dst = (u8*)b->levels[level];
+    const vec4 unormScale = Vec4Splat(255.0f);
+    const vec4 half = Vec4Splat(0.5f);
+
+    for (u32 z = dstMin[2]; z < dstMax[2]; ++z)
+    {
+        for (u32 y = dstMin[1]; y < dstMax[1]; ++y)
+        {
+            for (u32 face = 0; face < VoxelFace::Count; ++face)
+            {
+                const u8* rows[4]; // y * 2 + z
+                for (u32 r = 0; r < 4; ++r)
+                {
+                    rows[r] = src + CpuVoxel_TexelIndex(srcSize, 0, y * 2 + (r >> 1), z * 2 + (r & 1), face);
+                }
+                u8* dstRow = dst + CpuVoxel_TexelIndex(dstSize, 0, y, z, face);
+
+                for (u32 x = dstMin[0]; x < dstMax[0]; x += 4)
+                {
+                    // the last voxels of a row go through zero padded copies, the next bytes belong to another face
+                    const u32 count = MIN(dstMax[0] - x, 4);
+                    vec4 children[8];
+                    for (u32 r = 0; r < 4; ++r)
+                    {
+                        const u8* texels = rows[r] + x * 2;
+                        u8 padded[8];
+                        if (count < 4)
+                        {
+                            memset(padded, 0, sizeof(padded));
+                            memcpy(padded, texels, count * 2);
+                            texels = padded;
+                        }
+                        const vec4 lo = LoadBytes(texels) / unormScale;
+                        const vec4 hi = LoadBytes(texels + 4) / unormScale;
+                        children[r] = Shuffle2<0, 2, 0, 2>(lo, hi);
+                        children[4 + r] = Shuffle2<1, 3, 1, 3>(lo, hi);
+                    }
+
+                    const vec4 result = Composite<OpacityOver>(children, face) * unormScale + half;
+                    if (count == 4)
+                    {
+                        StoreBytes(dstRow + x, result);
+                    }
+                    else
+                    {
+                        u8 texels[4];
+                        StoreBytes(texels, result);
+                        memcpy(dstRow + x, texels, count);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// the lanes are the 4 channels of a texel
+static void DownsampleEmittance(const MipBuilder* b, u32 level, const u32* dstMin, const u32* dstMax)
+{
+    const uint3_t srcSize = CpuVoxel_MipSize(b->gridSize, level - 1);
+    const uint3_t dstSize = CpuVoxel_MipSize(b->gridSize, level);
+    const u16* src = (const u16*)b->levels[level - 1];
+    u16* dst = (u16*)b->levels[level];
+
+    for (u32 z = dstMin[2]; z < dstMax[2]; ++z)
+    {
+        for (u32 y = dstMin[1]; y < dstMax[1]; ++y)
+        {
+            for (u32 face = 0; face < VoxelFace::Count; ++face)
+            {
+                const u16* rows[4]; // y * 2 + z
+                for (u32 r = 0; r < 4; ++r)
+                {
+                    rows[r] = src + CpuVoxel_TexelIndex(srcSize, 0, y * 2 + (r >> 1), z * 2 + (r & 1), face) * 4;
+                }
+                u16* dstRow = dst + CpuVoxel_TexelIndex(dstSize, 0, y, z, face) * 4;
+
+                for (u32 x = dstMin[0]; x < dstMax[0]; ++x)
+                {
+                    vec4 children[8];
+                    for (u32 r = 0; r < 4; ++r)
+                    {
+                        children[r] = LoadHalf4(rows[r] + x * 8);
+                        children[4 + r] = LoadHalf4(rows[r] + x * 8 + 4);
+                    }
+                    StoreHalf4(dstRow + x * 4, Composite<EmittanceOver>(children, face));
+                }
+            }
+        }
+    }
+}
+
+static void BuildTiles(void* userData, u32 begin, u32 end)
+{
+    const MipBuilder* b = (const MipBuilder*)userData;
+    for (u32 t = begin; t < end; ++t)
+    {
+        const u32 origin[3] =
+        {
+            (t % b->numTiles.w) * MIP_TILE_WIDTH,
+            ((t / b->numTiles.w) % b->numTiles.h) * MIP_TILE_SIZE,
+            (t / (b->numTiles.w * b->numTiles.h)) * MIP_TILE_SIZE
+        };
+
+        // the children of a tile's voxels are all in the tile, whatever the grid size
+        for (u32 level = 1; level <= b->numTileLevels; ++level)
+        {
+            const uint3_t size = CpuVoxel_MipSize(b->gridSize, level);
+            const u32 dstMin[3] = { origin[0] >> level, origin[1] >> level, origin[2] >> level };
+            const u32 dstMax[3] =
+            {
+                MIN((origin[0] + MIP_TILE_WIDTH) >> level, size.w),
+                MIN((origin[1] + MIP_TILE_SIZE) >> level, size.h),
+                MIN((origin[2] + MIP_TILE_SIZE) >> level, size.d)
+            };
+            if (dstMin[0] >= dstMax[0] || dstMin[1] >= dstMax[1] || dstMin[2] >= dstMax[2])
+            {
+                break;
+            }
+            b->downsample(b, level, dstMin, dstMax);
+        }
+    }
+}
+
+static void BuildSlices(void* userData, u32 begin, u32 end)
+{
+    const MipBuilder* b = (const MipBuilder*)userData;
+    const uint3_t size = CpuVoxel_MipSize(b->gridSize, b->level);
+    const u32 dstMin[3] = { 0, 0, begin };
+    const u32 dstMax[3] = { size.w, size.h, end };
+    b->downsample(b, b->level, dstMin, dstMax);
+}
+
+static void BuildMips(MipBuilder* b)
+{
+    if (b->numLevels < 2)
+    {
+        return;
+    }
+
+    b->numTileLevels = MIN(b->numLevels - 1, MIP_TILE_LEVELS);
+    b->numTiles.w = (b->gridSize.w + MIP_TILE_WIDTH - 1) / MIP_TILE_WIDTH;
+    b->numTiles.h = (b->gridSize.h + MIP_TILE_SIZE - 1) / MIP_TILE_SIZE;
+    b->numTiles.d = (b->gridSize.d + MIP_TILE_SIZE - 1) / MIP_TILE_SIZE;
+    Job_ParallelFor(b->numTiles.w * b->numTiles.h * b->numTiles.d, &BuildTiles, b, 1);
+
+    for (b->level = b->numTileLevels + 1; b->level < b->numLevels; ++b->level)
+    {
+        Job_ParallelFor(CpuVoxel_MipSize(b->gridSize, b->level).d, &BuildSlices, b, 1);
+    }
+}
+
+static void UpdateBricks(void* userData, u32 begin, u32 end)
+{
+    const MipBuilder* b = (const MipBuilder*)userData;
+    const uint3_t size = CpuVoxel_MipSize(b->gridSize, b->level);
+    const u32 levelSize[3] = { size.w, size.h, size.d };
+    for (u32 i = begin; i < end; ++i)
+    {
+        const u32 brick = b->dirtyBricks[i];
+        const u32 coords[3] = { brick % b->numBricks.w, (brick / b->numBricks.w) % b->numBricks.h, brick / (b->numBricks.w * b->numBricks.h) };
+        u32 dstMin[3], dstMax[3];
+        for (u32 a = 0; a < 3; ++a)
+        {
+            dstMin[a] = coords[a] * CPU_VOXEL_BRICK_SIZE;
+            dstMax[a] = MIN(dstMin[a] + CPU_VOXEL_BRICK_SIZE, levelSize[a]);
+        }
+        b->downsample(b, b->level, dstMin, dstMax);
+    }
+}
+
+// the dirty bricks are carried up the chain one level at a time, every texel is written the
+// same way as BuildMips does so only the range changes
+static void UpdateMips(MipBuilder* b, const CpuVoxelDirtyBricks* dirty)
+{
+    assert(dirty->gridSize.w == b->gridSize.w && dirty->gridSize.h == b->gridSize.h && dirty->gridSize.d == b->gridSize.d);
+
+    ScratchMemory scratch;
+    const uint3_t numBricks0 = dirty->numBricks;
+    const u32 maxBricks = numBricks0.w * numBricks0.h * numBricks0.d;
+    const u8* childBricks = dirty->bricks;
+    uint3_t numChildBricks = numBricks0;
+    u8* bricks[2] = { PushArray(scratch.arena, maxBricks, u8), PushArray(scratch.arena, maxBricks, u8) };
+    u32* dirtyBricks = PushArray(scratch.arena, maxBricks, u32);
+    b->dirtyBricks = dirtyBricks;
+
+    for (b->level = 1; b->level < b->numLevels; ++b->level)
+    {
+        const uint3_t size = CpuVoxel_MipSize(b->gridSize, b->level);
+        b->numBricks.w = (size.w + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+        b->numBricks.h = (size.h + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+        b->numBricks.d = (size.d + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+
+        // the texels of brick (x, y, z) are over the texels of bricks (2x, 2y, 2z) to (2x + 1, 2y + 1, 2z + 1) of the level below
+        u8* levelBricks = bricks[b->level & 1];
+        u32 numDirtyBricks = 0;
+        for (u32 z = 0; z < b->numBricks.d; ++z)
+        {
+            for (u32 y = 0; y < b->numBricks.h; ++y)
+            {
+                for (u32 x = 0; x < b->numBricks.w; ++x)
+                {
+                    u8 isDirty = 0;
+                    for (u32 c = 0; c < 8; ++c)
+                    {
+                        const u32 cx = x * 2 + (c & 1);
+                        const u32 cy = y * 2 + ((c >> 1) & 1);
+                        const u32 cz = z * 2 + (c >> 2);
+                        if (cx < numChildBricks.w && cy < numChildBricks.h && cz < numChildBricks.d)
+                        {
+                            isDirty |= childBricks[(cz * numChildBricks.h + cy) * numChildBricks.w + cx];
+                        }
+                    }
+
+                    const u32 brick = (z * b->numBricks.h + y) * b->numBricks.w + x;
+                    levelBricks[brick] = isDirty;
+                    if (isDirty)
+                    {
+                        dirtyBricks[numDirtyBricks++] = brick;
+                    }
+                }
+            }
+        }
+
+        if (numDirtyBricks == 0)
+        {
+            break;
+        }
+        Job_ParallelFor(numDirtyBricks, &UpdateBricks, b, 1);
+        childBricks = levelBricks;
+        numChildBricks = b->numBricks;
+    }
+}
+
+void DownsampleOpacityGrid(u8* dst, const u8* src, uint3_t srcSize)
+{
+    void* levels[2] = { (void*)src, dst };
+    MipBuilder b = {};
+    b.gridSize = srcSize;
+    b.numLevels = 2;
+    b.levels = levels;
+    const uint3_t dstSize = CpuVoxel_MipSize(srcSize, 1);
+    const u32 dstMin[3] = { 0, 0, 0 };
+    const u32 dstMax[3] = { dstSize.w, dstSize.h, dstSize.d };
+    DownsampleOpacity(&b, 1, dstMin, dstMax);
+}
+
+void DownsampleOpacityBricks(u8* dst, const u8* const* children)
+{
+    const uint3_t brickSize = { CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE };
+    const uint3_t tileSize = { CPU_VOXEL_BRICK_SIZE * 2, CPU_VOXEL_BRICK_SIZE * 2, CPU_VOXEL_BRICK_SIZE * 2 };
+    u8 tile[CPU_VOXEL_BRICK_TEXELS * 8];
+    for (u32 c = 0; c < 8; ++c)
+    {
+        const u8* texels = children[c];
+        const u32 x = (c & 1) * CPU_VOXEL_BRICK_SIZE;
+        const u32 y = ((c >> 1) & 1) * CPU_VOXEL_BRICK_SIZE;
+        const u32 z = (c >> 2) * CPU_VOXEL_BRICK_SIZE;
+        for (u32 bz = 0; bz < CPU_VOXEL_BRICK_SIZE; ++bz)
+        {
+            for (u32 by = 0; by < CPU_VOXEL_BRICK_SIZE; ++by)
+            {
+                for (u32 face = 0; face < VoxelFace::Count; ++face)
+                {
+                    u8* row = &tile[CpuVoxel_TexelIndex(tileSize, x, y + by, z + bz, face)];
+                    if (texels != NULL)
+                    {
+                        memcpy(row, &texels[CpuVoxel_TexelIndex(brickSize, 0, by, bz, face)], CPU_VOXEL_BRICK_SIZE);
+                    }
+                    else
+                    {
+                        memset(row, 0, CPU_VOXEL_BRICK_SIZE);
+                    }
+                }
+            }
+        }
+    }
+
+    DownsampleOpacityGrid(dst, tile, tileSize);
+}
+
+void CpuVoxel_AllocateOpacityMips(CpuOpacityMips* mips, MemoryArena* arena, const CpuOpacityGrid* grid)
+{
+    mips->gridSize = grid->gridSize;
+    mips->numLevels = CpuVoxel_NumMipLevels(grid->gridSize);
+    assert(mips->numLevels <= CPU_VOXEL_MAX_MIPS);
+    mips->levels[0] = grid->texels;
+    for (u32 m = 1; m < mips->numLevels; ++m)
+    {
+        mips->levels[m] = PushArray(arena, CpuVoxel_NumTexels(CpuVoxel_MipSize(grid->gridSize, m)), u8);
+    }
+}
+
+void CpuVoxel_AllocateEmittanceMips(CpuEmittanceMips* mips, MemoryArena* arena, const CpuEmittanceGrid* grid)
+{
+    mips->gridSize = grid->gridSize;
+    mips->numLevels = CpuVoxel_NumMipLevels(grid->gridSize);
+    assert(mips->numLevels <= CPU_VOXEL_MAX_MIPS);
+    mips->levels[0] = grid->texels;
+    for (u32 m = 1; m < mips->numLevels; ++m)
+    {
+        mips->levels[m] = PushArray(arena, CpuVoxel_NumTexels(CpuVoxel_MipSize(grid->gridSize, m)) * 4, u16);
+    }
+}
+
+void CpuVoxel_BuildOpacityMips(CpuOpacityMips* mips)
+{
+    MipBuilder b;
+    b.gridSize = mips->gridSize;
+    b.numLevels = mips->numLevels;
+    b.levels = (void* const*)mips->levels;
+    b.downsample = &DownsampleOpacity;
+    BuildMips(&b);
+}
+
+void CpuVoxel_BuildEmittanceMips(CpuEmittanceMips* mips)
+{
+    MipBuilder b;
+    b.gridSize = mips->gridSize;
+    b.numLevels = mips->numLevels;
+    b.levels = (void* const*)mips->levels;
+    b.downsample = &DownsampleEmittance;
+    BuildMips(&b);
+}
+
+void CpuVoxel_UpdateOpacityMips(CpuOpacityMips* mips, const CpuVoxelDirtyBricks* dirty)
+{
+    MipBuilder b;
+    b.gridSize = mips->gridSize;
+    b.numLevels = mips->numLevels;
+    b.levels = (void* const*)mips->levels;
+    b.downsample = &DownsampleOpacity;
+    UpdateMips(&b, dirty);
+}
+
+void CpuVoxel_UpdateEmittanceMips(CpuEmittanceMips* mips, const CpuVoxelDirtyBricks* dirty)
+{
+    MipBuilder b;
+    b.gridSize = mips->gridSize;
+    b.numLevels = mips->numLevels;
+    b.levels = (void* const*)mips->levels;
+    b.downsample = &DownsampleEmittance;
+    UpdateMips(&b, dirty);
+}
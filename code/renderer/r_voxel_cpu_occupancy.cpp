@@ -0,0 +1,371 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+struct OccupancyBuilder
+{
+    CpuVoxelOccupancy* occupancy;
+    const CpuOpacityGrid* opacity;
+    const CpuEmittanceGrid* emittance;
+    u32 level; // for ReduceOccupancy
+};
+
+static u32* GetRow(const CpuOccupancyLevel* level, u32 y, u32 z)
+{
+    return level->words + ((size_t)z * level->size.h + y) * level->rowWords;
+}
+
+// bit i of the result is bit 2 * i of value
+static u32 CompactEvenBits(u32 value)
+{
+    value &= 0x55555555;
+    value = (value | (value >> 1)) & 0x33333333;
+    value = (value | (value >> 2)) & 0x0F0F0F0F;
+    value = (value | (value >> 4)) & 0x00FF00FF;
+    value = (value | (value >> 8)) & 0x0000FFFF;
+    return value;
+}
+
+// floor(value / 2^shift)
+static s32 ShiftDown(s32 value, u32 shift)
+{
+    return value >= 0 ? value >> shift : -((-value + (1 << shift) - 1) >> shift);
+}
+
+// a voxel is occupied when one of its 6 faces isn't 0, one z slice at a time
+static void BuildOpacityOccupancy(void* userData, u32 begin, u32 end)
+{
+    const OccupancyBuilder* b = (const OccupancyBuilder*)userData;
+    const CpuOccupancyLevel* level = &b->occupancy->levels[0];
+    const uint3_t gridSize = b->opacity->gridSize;
+    for (u32 z = begin; z < end; ++z)
+    {
+        for (u32 y = 0; y < gridSize.h; ++y)
+        {
+            const u8* texels = b->opacity->texels + CpuVoxel_TexelIndex(gridSize, 0, y, z, 0);
+            u32* row = GetRow(level, y, z);
+            for (u32 w = 0; w < level->rowWords; ++w)
+            {
+                const u32 last = MIN((w + 1) * 32, gridSize.w);
+                u32 word = 0;
+                for (u32 x = w * 32; x < last; ++x)
+                {
+                    u8 value = 0;
+                    for (u32 f = 0; f < VoxelFace::Count; ++f)
+                    {
+                        value |= texels[f * gridSize.w + x];
+                    }
+                    word |= (value != 0 ? 1u : 0u) << (x & 31);
+                }
+                row[w] = word;
+            }
+        }
+    }
+}
+
+static void BuildEmittanceOccupancy(void* userData, u32 begin, u32 end)
+{
+    const OccupancyBuilder* b = (const OccupancyBuilder*)userData;
+    const CpuOccupancyLevel* level = &b->occupancy->levels[0];
+    const uint3_t gridSize = b->emittance->gridSize;
+    for (u32 z = begin; z < end; ++z)
+    {
+        for (u32 y = 0; y < gridSize.h; ++y)
+        {
+            const u16* texels = b->emittance->texels + CpuVoxel_TexelIndex(gridSize, 0, y, z, 0) * 4;
+            u32* row = GetRow(level, y, z);
+            for (u32 w = 0; w < level->rowWords; ++w)
+            {
+                const u32 last = MIN((w + 1) * 32, gridSize.w);
+                u32 word = 0;
+                for (u32 x = w * 32; x < last; ++x)
+                {
+                    u16 value = 0;
+                    for (u32 f = 0; f < VoxelFace::Count; ++f)
+                    {
+                        const u16* texel = texels + (f * gridSize.w + x) * 4;
+                        value |= texel[0] | texel[1] | texel[2] | texel[3];
+                    }
+                    word |= (value != 0 ? 1u : 0u) << (x & 31);
+                }
+                row[w] = word;
+            }
+        }
+    }
+}
+
+// a bit is the OR of the up to 8 bits under it, the 4 rows under a row are ORed together
+// first and then every pair of bits is folded into one
+static void ReduceOccupancy(void* userData, u32 begin, u32 end)
+{
+    const OccupancyBuilder* b = (const OccupancyBuilder*)userData;
+    const CpuOccupancyLevel* level = &b->occupancy->levels[b->level];
+    const CpuOccupancyLevel* children = &b->occupancy->levels[b->level - 1];
+    for (u32 z = begin; z < end; ++z)
+    {
+        for (u32 y = 0; y < level->size.h; ++y)
+        {
+            const u32* rows[4];
+            u32 numRows = 0;
+            for (u32 r = 0; r < 4; ++r)
+            {
+                const u32 childY = y * 2 + (r & 1);
+                const u32 childZ = z * 2 + (r >> 1);
+                if (childY < children->size.h && childZ < children->size.d)
+                {
+                    rows[numRows++] = GetRow(children, childY, childZ);
+                }
+            }
+
+            u32* row = GetRow(level, y, z);
+            for (u32 w = 0; w < level->rowWords; ++w)
+            {
+                u32 pairs[2] = { 0, 0 };
+                for (u32 i = 0; i < 2; ++i)
+                {
+                    const u32 childWord = w * 2 + i;
+                    if (childWord >= children->rowWords)
+                    {
+                        continue;
+                    }
+
+                    u32 word = 0;
+                    for (u32 r = 0; r < numRows; ++r)
+                    {
+                        word |= rows[r][childWord];
+                    }
+                    pairs[i] = CompactEvenBits(word | (word >> 1));
+                }
+                row[w] = pairs[0] | (pairs[1] << 16);
+            }
+        }
+    }
+}
+
+static void ReduceLevels(OccupancyBuilder* b)
+{
+    for (u32 l = 1; l < b->occupancy->numLevels; ++l)
+    {
+        b->level = l;
+        Job_ParallelFor(b->occupancy->levels[l].size.d, &ReduceOccupancy, b, 1);
+    }
+}
+
+static bool IsCellInLevel(const CpuOccupancyLevel* level, const s32* cell)
+{
+    return cell[0] >= 0 && cell[0] < (s32)level->size.w &&
+           cell[1] >= 0 && cell[1] < (s32)level->size.h &&
+           cell[2] >= 0 && cell[2] < (s32)level->size.d;
+}
+
+// the cells of a level overlapping the voxels [min; max]
+static void GetCellRange(u32 level, const s32* min, const s32* max, s32* cellMin, s32* cellMax)
+{
+    for (u32 a = 0; a < 3; ++a)
+    {
+        cellMin[a] = ShiftDown(min[a], level);
+        cellMax[a] = ShiftDown(max[a], level);
+    }
+}
+
+// the cells outside of the grid are empty
+static bool AreCellsEmpty(const CpuVoxelOccupancy* occupancy, u32 level, const s32* min, const s32* max)
+{
+    s32 cellMin[3], cellMax[3];
+    GetCellRange(level, min, max, cellMin, cellMax);
+    s32 cell[3];
+    for (cell[2] = cellMin[2]; cell[2] <= cellMax[2]; ++cell[2])
+    {
+        for (cell[1] = cellMin[1]; cell[1] <= cellMax[1]; ++cell[1])
+        {
+            for (cell[0] = cellMin[0]; cell[0] <= cellMax[0]; ++cell[0])
+            {
+                if (IsCellInLevel(&occupancy->levels[level], cell) &&
+                    CpuVoxel_IsOccupied(occupancy, level, (u32)cell[0], (u32)cell[1], (u32)cell[2]))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// an occupied voxel of [min; max] under a cell, only the children overlapping them are visited
+static bool FindOccupiedVoxel(const CpuVoxelOccupancy* occupancy, u32 level, const s32* cell, const s32* min, const s32* max, s32* voxel)
+{
+    if (!IsCellInLevel(&occupancy->levels[level], cell) ||
+        !CpuVoxel_IsOccupied(occupancy, level, (u32)cell[0], (u32)cell[1], (u32)cell[2]))
+    {
+        return false;
+    }
+
+    if (level == 0)
+    {
+        voxel[0] = cell[0];
+        voxel[1] = cell[1];
+        voxel[2] = cell[2];
+        return true;
+    }
+
+    s32 childMin[3], childMax[3];
+    GetCellRange(level - 1, min, max, childMin, childMax);
+    for (u32 c = 0; c < 8; ++c)
+    {
+        const s32 child[3] = { cell[0] * 2 + (s32)(c & 1), cell[1] * 2 + (s32)((c >> 1) & 1), cell[2] * 2 + (s32)(c >> 2) };
+        if (child[0] >= childMin[0] && child[0] <= childMax[0] &&
+            child[1] >= childMin[1] && child[1] <= childMax[1] &&
+            child[2] >= childMin[2] && child[2] <= childMax[2] &&
+            FindOccupiedVoxel(occupancy, level - 1, child, min, max, voxel))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool FindEmptyBlock(const CpuVoxelOccupancy* occupancy, const s32* min, const s32* max, s32* blockMin, s32* blockMax, s32* occupiedVoxel)
+{
+    // the first level where the voxels span at most 2 cells per axis
+    u32 level = 0;
+    while (level + 1 < occupancy->numLevels &&
+           ((1 << level) < max[0] - min[0] + 1 || (1 << level) < max[1] - min[1] + 1 || (1 << level) < max[2] - min[2] + 1))
+    {
+        level++;
+    }
+
+    s32 cellMin[3], cellMax[3];
+    GetCellRange(level, min, max, cellMin, cellMax);
+    s32 cell[3];
+    for (cell[2] = cellMin[2]; cell[2] <= cellMax[2]; ++cell[2])
+    {
+        for (cell[1] = cellMin[1]; cell[1] <= cellMax[1]; ++cell[1])
+        {
+            for (cell[0] = cellMin[0]; cell[0] <= cellMax[0]; ++cell[0])
+            {
+                if (FindOccupiedVoxel(occupancy, level, cell, min, max, occupiedVoxel))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    // the voxels alone when their cells aren't empty, or the largest block of empty cells around them
+    if (!AreCellsEmpty(occupancy, level, min, max))
+    {
+        for (u32 a = 0; a < 3; ++a)
+        {
+            blockMin[a] = min[a];
+            blockMax[a] = max[a] + 1;
+        }
+        return true;
+    }
+
+    while (level + 1 < occupancy->numLevels && AreCellsEmpty(occupancy, level + 1, min, max))
+    {
+        level++;
+    }
+
+    GetCellRange(level, min, max, cellMin, cellMax);
+    for (u32 a = 0; a < 3; ++a)
+    {
+        blockMin[a] = cellMin[a] * (1 << level);
+        blockMax[a] = (cellMax[a] + 1) * (1 << level);
+    }
+
+    return true;
+}
+
+void CpuVoxel_AllocateOccupancy(CpuVoxelOccupancy* occupancy, MemoryArena* arena, uint3_t gridSize)
+{
+    occupancy->gridSize = gridSize;
+    occupancy->numLevels = 0;
+    uint3_t size = gridSize;
+    for (;;)
+    {
+        assert(occupancy->numLevels < CPU_VOXEL_MAX_MIPS);
+        CpuOccupancyLevel* level = &occupancy->levels[occupancy->numLevels++];
+        level->size = size;
+        level->rowWords = (size.w + 31) / 32;
+        const size_t numWords = (size_t)level->rowWords * size.h * size.d;
+        level->words = PushArray(arena, numWords, u32);
+        memset(level->words, 0, numWords * sizeof(u32));
+        if (size.w == 1 && size.h == 1 && size.d == 1)
+        {
+            break;
+        }
+
+        size.w = (size.w + 1) / 2;
+        size.h = (size.h + 1) / 2;
+        size.d = (size.d + 1) / 2;
+    }
+}
+
+void CpuVoxel_BuildOccupancy(CpuVoxelOccupancy* occupancy, const CpuOpacityGrid* grid)
+{
+    assert(occupancy->gridSize.w == grid->gridSize.w && occupancy->gridSize.h == grid->gridSize.h && occupancy->gridSize.d == grid->gridSize.d);
+
+    OccupancyBuilder b = {};
+    b.occupancy = occupancy;
+    b.opacity = grid;
+    Job_ParallelFor(grid->gridSize.d, &BuildOpacityOccupancy, &b, 1);
+    ReduceLevels(&b);
+}
+
+void CpuVoxel_BuildOccupancy(CpuVoxelOccupancy* occupancy, const CpuEmittanceGrid* grid)
+{
+    assert(occupancy->gridSize.w == grid->gridSize.w && occupancy->gridSize.h == grid->gridSize.h && occupancy->gridSize.d == grid->gridSize.d);
+
+    OccupancyBuilder b = {};
+    b.occupancy = occupancy;
+    b.emittance = grid;
+    Job_ParallelFor(grid->gridSize.d, &BuildEmittanceOccupancy, &b, 1);
+    ReduceLevels(&b);
+}
+
+size_t CpuVoxel_OccupancyMemory(const CpuVoxelOccupancy* occupancy)
+{
+    size_t bytes = 0;
+    for (u32 l = 0; l < occupancy->numLevels; ++l)
+    {
+        const CpuOccupancyLevel* level = &occupancy->levels[l];
+        bytes += (size_t)level->rowWords * level->size.h * level->size.d * sizeof(u32);
+    }
+    return bytes;
+}
@@ -0,0 +1,355 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+// the slots of a level are handed out in chunks: every chunk counts its occupied cells,
+// the counts are scanned and then every chunk numbers its cells from its offset
+#define SLOT_CHUNK_SIZE 4096
+
+struct SlotAllocator
+{
+    const u8* occupancy;
+    u32* slots;
+    u32* chunkOffsets;
+    u32 numCells;
+};
+
+struct PagedBuilder
+{
+    VoxelBins bins;
+    CpuPagedOpacityGrid* grid;
+    u8* occupancy[CPU_VOXEL_MAX_MIPS];
+    u32 level; // for FindOccupiedParents, FilterBricks and MakeTailDense
+    CpuOpacityGrid tail;
+};
+
+static u8* GetBrick(const CpuPagedOpacityGrid* grid, u32 brick)
+{
+    return grid->bricks + (size_t)brick * CPU_VOXEL_BRICK_TEXELS;
+}
+
+static u32 GetNumCells(uint3_t numCells)
+{
+    return numCells.w * numCells.h * numCells.d;
+}
+
+static u32 GetCellIndex(uint3_t numCells, u32 x, u32 y, u32 z)
+{
+    return (z * numCells.h + y) * numCells.w + x;
+}
+
+static void CountChunkSlots(void* userData, u32 begin, u32 end)
+{
+    const SlotAllocator* a = (const SlotAllocator*)userData;
+    for (u32 c = begin; c < end; ++c)
+    {
+        const u32 last = MIN((c + 1) * SLOT_CHUNK_SIZE, a->numCells);
+        u32 count = 0;
+        for (u32 i = c * SLOT_CHUNK_SIZE; i < last; ++i)
+        {
+            count += a->occupancy[i];
+        }
+        a->chunkOffsets[c] = count;
+    }
+}
+
+static void WriteChunkSlots(void* userData, u32 begin, u32 end)
+{
+    const SlotAllocator* a = (const SlotAllocator*)userData;
+    for (u32 c = begin; c < end; ++c)
+    {
+        const u32 last = MIN((c + 1) * SLOT_CHUNK_SIZE, a->numCells);
+        u32 slot = a->chunkOffsets[c];
+        for (u32 i = c * SLOT_CHUNK_SIZE; i < last; ++i)
+        {
+            a->slots[i] = a->occupancy[i] ? slot++ : CPU_PAGED_NO_BRICK;
+        }
+    }
+}
+
+// the exclusive prefix sum of the occupancy, starting at firstSlot, returns the number of slots
+static u32 AllocateSlots(u32* slots, const u8* occupancy, u32 numCells, u32 firstSlot, MemoryArena* scratch)
+{
+    SlotAllocator a;
+    a.occupancy = occupancy;
+    a.slots = slots;
+    a.numCells = numCells;
+    const u32 numChunks = (numCells + SLOT_CHUNK_SIZE - 1) / SLOT_CHUNK_SIZE;
+    a.chunkOffsets = PushArray(scratch, numChunks, u32);
+    Job_ParallelFor(numChunks, &CountChunkSlots, &a, 1);
+
+    u32 offset = firstSlot;
+    for (u32 c = 0; c < numChunks; ++c)
+    {
+        const u32 count = a.chunkOffsets[c];
+        a.chunkOffsets[c] = offset;
+        offset += count;
+    }
+
+    Job_ParallelFor(numChunks, &WriteChunkSlots, &a, 1);
+    return offset - firstSlot;
+}
+
+// a cell is occupied when one of its 8 children is, one z slice of cells at a time
+static void FindOccupiedParents(void* userData, u32 begin, u32 end)
+{
+    const PagedBuilder* b = (const PagedBuilder*)userData;
+    const uint3_t numCells = b->grid->levels[b->level].numCells;
+    const uint3_t numChildren = b->grid->levels[b->level - 1].numCells;
+    const u8* children = b->occupancy[b->level - 1];
+    u8* occupancy = b->occupancy[b->level];
+    for (u32 z = begin; z < end; ++z)
+    {
+        for (u32 y = 0; y < numCells.h; ++y)
+        {
+            for (u32 x = 0; x < numCells.w; ++x)
+            {
+                u8 occupied = 0;
+                for (u32 c = 0; c < 8; ++c)
+                {
+                    occupied |= children[GetCellIndex(numChildren, x * 2 + (c & 1), y * 2 + ((c >> 1) & 1), z * 2 + (c >> 2))];
+                }
+                occupancy[GetCellIndex(numCells, x, y, z)] = occupied;
+            }
+        }
+    }
+}
+
+// the cells of level 0 are the bins' bricks
+static void RasterizeBricks(void* userData, u32 begin, u32 end)
+{
+    const PagedBuilder* b = (const PagedBuilder*)userData;
+    const VoxelBins* bins = &b->bins;
+    const CpuPagedOpacityLevel* level = &b->grid->levels[0];
+    for (u32 i = begin; i < end; ++i)
+    {
+        const u32 brick = bins->activeBricks[i];
+        u8* texels = GetBrick(b->grid, level->indirection[brick]);
+        memset(texels, 0, CPU_VOXEL_BRICK_TEXELS);
+        u32 brickMin[3], brickMax[3];
+        GetBrickBounds(bins, brick, brickMin, brickMax);
+        for (u32 t = bins->brickOffsets[brick]; t < bins->brickOffsets[brick + 1]; ++t)
+        {
+            const VoxelTriangle* tri = &bins->triangles[bins->brickTriangles[t]];
+            WriteBrickOpacity write;
+            write.texels = texels;
+            write.brickMin = brickMin;
+            write.faces[0] = VoxelFace::PosX + (tri->faceOffsets & 1);
+            write.faces[1] = VoxelFace::PosY + ((tri->faceOffsets >> 1) & 1);
+            write.faces[2] = VoxelFace::PosZ + ((tri->faceOffsets >> 2) & 1);
+            write.value = tri->value;
+            RasterizeTriangle(tri, brickMin, brickMax, &write);
+        }
+    }
+}
+
+// the bricks of a level from their 8 children in the previous one, one z slice of cells at a time
+static void FilterBricks(void* userData, u32 begin, u32 end)
+{
+    const PagedBuilder* b = (const PagedBuilder*)userData;
+    const CpuPagedOpacityGrid* grid = b->grid;
+    const CpuPagedOpacityLevel* level = &grid->levels[b->level];
+    const CpuPagedOpacityLevel* childLevel = &grid->levels[b->level - 1];
+    for (u32 z = begin; z < end; ++z)
+    {
+        for (u32 y = 0; y < level->numCells.h; ++y)
+        {
+            for (u32 x = 0; x < level->numCells.w; ++x)
+            {
+                const u32 brick = level->indirection[GetCellIndex(level->numCells, x, y, z)];
+                if (brick == CPU_PAGED_NO_BRICK)
+                {
+                    continue;
+                }
+
+                const u8* children[8];
+                for (u32 c = 0; c < 8; ++c)
+                {
+                    const u32 child = childLevel->indirection[GetCellIndex(childLevel->numCells, x * 2 + (c & 1), y * 2 + ((c >> 1) & 1), z * 2 + (c >> 2))];
+                    children[c] = child != CPU_PAGED_NO_BRICK ? GetBrick(grid, child) : NULL;
+                }
+                DownsampleOpacityBricks(GetBrick(grid, brick), children);
+            }
+        }
+    }
+}
+
+// copies the bricks of the last paged level into the tail's dense level 0, one z slice of cells at a time
+static void MakeTailDense(void* userData, u32 begin, u32 end)
+{
+    const PagedBuilder* b = (const PagedBuilder*)userData;
+    const CpuPagedOpacityLevel* level = &b->grid->levels[b->level];
+    const uint3_t brickSize = { CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE };
+    for (u32 z = begin; z < end; ++z)
+    {
+        for (u32 y = 0; y < level->numCells.h; ++y)
+        {
+            for (u32 x = 0; x < level->numCells.w; ++x)
+            {
+                const u32 brick = level->indirection[GetCellIndex(level->numCells, x, y, z)];
+                const u8* texels = brick != CPU_PAGED_NO_BRICK ? GetBrick(b->grid, brick) : NULL;
+                for (u32 bz = 0; bz < CPU_VOXEL_BRICK_SIZE; ++bz)
+                {
+                    for (u32 by = 0; by < CPU_VOXEL_BRICK_SIZE; ++by)
+                    {
+                        for (u32 face = 0; face < VoxelFace::Count; ++face)
+                        {
+                            u8* row = &b->tail.texels[CpuVoxel_TexelIndex(b->tail.gridSize, x * CPU_VOXEL_BRICK_SIZE, y * CPU_VOXEL_BRICK_SIZE + by, z * CPU_VOXEL_BRICK_SIZE + bz, face)];
+                            if (texels != NULL)
+                            {
+                                memcpy(row, &texels[CpuVoxel_TexelIndex(brickSize, 0, by, bz, face)], CPU_VOXEL_BRICK_SIZE);
+                            }
+                            else
+                            {
+                                memset(row, 0, CPU_VOXEL_BRICK_SIZE);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static bool IsPageable(uint3_t size)
+{
+    return size.w % CPU_VOXEL_BRICK_SIZE == 0 && size.h % CPU_VOXEL_BRICK_SIZE == 0 && size.d % CPU_VOXEL_BRICK_SIZE == 0;
+}
+
+void CpuVoxel_BuildPagedOpacityGrid(CpuPagedOpacityGrid* grid, MemoryArena* arena, const CpuVoxelGeometry* geometry, uint3_t gridSize, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats)
+{
+    assert(IsPageable(gridSize));
+    memset(grid, 0, sizeof(*grid));
+    grid->gridSize = gridSize;
+    grid->numLevels = CpuVoxel_NumMipLevels(gridSize);
+    while (grid->numPagedLevels < grid->numLevels && IsPageable(CpuVoxel_MipSize(gridSize, grid->numPagedLevels)))
+    {
+        grid->numPagedLevels++;
+    }
+
+    PagedBuilder b;
+    b.grid = grid;
+    BinTriangles(&b.bins, geometry, gridSize, conservative, scratch);
+
+    // the voxelizer's bricks are the cells of level 0
+    for (u32 m = 0; m < grid->numPagedLevels; ++m)
+    {
+        const uint3_t size = CpuVoxel_MipSize(gridSize, m);
+        CpuPagedOpacityLevel* level = &grid->levels[m];
+        level->numCells.w = size.w / CPU_VOXEL_BRICK_SIZE;
+        level->numCells.h = size.h / CPU_VOXEL_BRICK_SIZE;
+        level->numCells.d = size.d / CPU_VOXEL_BRICK_SIZE;
+        level->indirection = PushArray(arena, GetNumCells(level->numCells), u32);
+        b.occupancy[m] = PushArray(scratch, GetNumCells(level->numCells), u8);
+    }
+    GetBrickOccupancy(&b.bins, b.occupancy[0]);
+    for (b.level = 1; b.level < grid->numPagedLevels; ++b.level)
+    {
+        Job_ParallelFor(grid->levels[b.level].numCells.d, &FindOccupiedParents, &b, 1);
+    }
+
+    for (u32 m = 0; m < grid->numPagedLevels; ++m)
+    {
+        CpuPagedOpacityLevel* level = &grid->levels[m];
+        level->firstBrick = grid->numBricks;
+        level->numBricks = AllocateSlots(level->indirection, b.occupancy[m], GetNumCells(level->numCells), grid->numBricks, scratch);
+        grid->numBricks += level->numBricks;
+    }
+    grid->bricks = PushArray(arena, (size_t)grid->numBricks * CPU_VOXEL_BRICK_TEXELS, u8);
+
+    // bricks vary a lot in cost, small ranges keep the threads busy
+    Job_ParallelFor(b.bins.numActiveBricks, &RasterizeBricks, &b, 1);
+    for (b.level = 1; b.level < grid->numPagedLevels; ++b.level)
+    {
+        Job_ParallelFor(grid->levels[b.level].numCells.d, &FilterBricks, &b, 1);
+    }
+
+    b.level = grid->numPagedLevels - 1;
+    b.tail.gridSize = CpuVoxel_MipSize(gridSize, b.level);
+    b.tail.texels = PushArray(arena, CpuVoxel_NumTexels(b.tail.gridSize), u8);
+    Job_ParallelFor(grid->levels[b.level].numCells.d, &MakeTailDense, &b, 1);
+    CpuVoxel_AllocateOpacityMips(&grid->tailMips, arena, &b.tail);
+    CpuVoxel_BuildOpacityMips(&grid->tailMips);
+
+    if (stats != NULL)
+    {
+        stats->numTriangles = b.bins.numTriangles;
+        stats->numBrickTriangles = b.bins.brickOffsets[GetNumCells(b.bins.numBricks)];
+        stats->numBricks = b.bins.numActiveBricks;
+    }
+}
+
+size_t CpuVoxel_PagedOpacityMemory(const CpuPagedOpacityGrid* grid)
+{
+    size_t size = (size_t)grid->numBricks * CPU_VOXEL_BRICK_TEXELS;
+    for (u32 m = 0; m < grid->numPagedLevels; ++m)
+    {
+        size += GetNumCells(grid->levels[m].numCells) * sizeof(u32);
+    }
+    for (u32 m = 0; m < grid->tailMips.numLevels; ++m)
+    {
+        size += CpuVoxel_NumTexels(CpuVoxel_MipSize(grid->tailMips.gridSize, m));
+    }
+    return size;
+}
+
+const u8* CpuVoxel_FindPagedBrick(const CpuPagedOpacityGrid* grid, u32 level, u32 x, u32 y, u32 z)
+{
+    assert(level < grid->numPagedLevels);
+    const CpuPagedOpacityLevel* l = &grid->levels[level];
+    const u32 brick = l->indirection[GetCellIndex(l->numCells, x / CPU_VOXEL_BRICK_SIZE, y / CPU_VOXEL_BRICK_SIZE, z / CPU_VOXEL_BRICK_SIZE)];
+    return brick != CPU_PAGED_NO_BRICK ? GetBrick(grid, brick) : NULL;
+}
+
+u8 CpuVoxel_GetPagedTexel(const CpuPagedOpacityGrid* grid, u32 level, u32 x, u32 y, u32 z, u32 face)
+{
+    if (level >= grid->numPagedLevels)
+    {
+        const u32 tailLevel = level - (grid->numPagedLevels - 1);
+        const uint3_t size = CpuVoxel_MipSize(grid->tailMips.gridSize, tailLevel);
+        return grid->tailMips.levels[tailLevel][CpuVoxel_TexelIndex(size, x, y, z, face)];
+    }
+
+    const u8* brick = CpuVoxel_FindPagedBrick(grid, level, x, y, z);
+    if (brick == NULL)
+    {
+        return 0;
+    }
+
+    const uint3_t brickSize = { CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE };
+    const u32 mask = CPU_VOXEL_BRICK_SIZE - 1;
+    return brick[CpuVoxel_TexelIndex(brickSize, x & mask, y & mask, z & mask, face)];
+}
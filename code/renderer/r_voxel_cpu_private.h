@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "r_voxel_cpu.h"
+
+// Triangle setup, binning and rasterization shared by the CPU voxelization passes.
+
+// binning pads the bricks so that samples on their boundaries aren't lost to rounding
+#define BIN_PADDING 0.01f
+
+// A triangle set up for rasterization along its dominant axis, in voxel units.
+// u and v are the other two axes in the order of the geometry shader's swizzles.
+struct VoxelTriangle
+{
+    // E(u, v) = a * u + b * v + c, samples are inside when all 3 are >= 0
+    // or > 0 for the edges that don't own the samples exactly on them
+    f32 edgeA[3];
+    f32 edgeB[3];
+    f32 edgeC[3];
+    // position along the dominant axis = depthU * u + depthV * v + depthC
+    f32 depthU;
+    f32 depthV;
+    f32 depthC;
+    // sample range, inclusive
+    s32 minU;
+    s32 minV;
+    s32 maxU;
+    s32 maxV;
+    vec3_t position[3];
+    const u32* indexes; // the 3 vertexes
+    u32 mesh;
+    f32 binPadding; // how far from the triangle its samples can be
+    u8 axis; // 0xFF for triangles that don't cover any sample
+    u8 ownsEdges; // bit k: edge k owns its samples
+    u8 faceOffsets; // bit k: the normal's k component is >= 0, see ComputeTC
+    u8 value;
+};
+
+// voxel axis of u and v for each dominant axis
+static const u32 axisU[3] = { 1, 0, 0 };
+static const u32 axisV[3] = { 2, 2, 1 };
+
+// the triangles of a CpuVoxelGeometry and the bricks they touch
+struct VoxelBins
+{
+    const CpuVoxelGeometry* geometry;
+    uint3_t gridSize;
+    bool conservative;
+    u32 boundsMin[3]; // only the triangles touching the voxels [boundsMin; boundsMax[ are binned
+    u32 boundsMax[3];
+    // When worldScale isn't 0 the triangles are set up in world voxels, xyz * worldScale, instead
+    // of mapping the geometry's AABB to the grid, and voxel v of the grid is world voxel origin + v.
+    // The triangles' positions and samples then don't depend on where the grid is.
+    f32 worldScale;
+    s32 origin[3];
+
+    VoxelTriangle* triangles;
+    u32 numTriangles;
+    u32* meshFirstTriangle; // numMeshes + 1
+
+    uint3_t numBricks;
+    volatile s32* brickCounts; // then the write cursors
+    u32* brickOffsets; // numBricks + 1
+    u32* brickTriangles; // in no particular order
+    u32* activeBricks;
+    u32 numActiveBricks;
+};
+
+// sets up the triangles and bins them, the memory comes from scratch
+void BinTriangles(VoxelBins* bins, const CpuVoxelGeometry* geometry, uint3_t gridSize, bool conservative, MemoryArena* scratch);
+// BinTriangles for the bricks overlapping [boundsMin; boundsMax[, the other triangles are skipped early
+void BinTrianglesInBounds(VoxelBins* bins, const CpuVoxelGeometry* geometry, uint3_t gridSize, const u32* boundsMin, const u32* boundsMax, bool conservative, MemoryArena* scratch);
+// BinTrianglesInBounds for a grid whose voxel 0 is world voxel origin, see VoxelBins::worldScale
+void BinTrianglesInWorldBounds(VoxelBins* bins, const CpuVoxelGeometry* geometry, uint3_t gridSize, const s32* origin, f32 voxelSize, const u32* boundsMin, const u32* boundsMax, bool conservative, MemoryArena* scratch);
+// occupancy[brick] is 1 for the bricks with triangles binned to them and 0 for the others
+void GetBrickOccupancy(const VoxelBins* bins, u8* occupancy);
+// the voxels of a brick are [brickMin; brickMax[
+void GetBrickBounds(const VoxelBins* bins, u32 brick, u32* brickMin, u32* brickMax);
+// zeroes the z slices [begin; end[ of a grid with texelSize bytes per texel
+void ClearGridSlices(void* texels, size_t texelSize, uint3_t gridSize, u32 begin, u32 end);
+// zeroes the voxels [brickMin; brickMax[ of a grid with texelSize bytes per texel
+void ClearGridBrick(void* texels, size_t texelSize, uint3_t gridSize, const u32* brickMin, const u32* brickMax);
+// the dirty bricks in index order, returns how many there are
+u32 GetDirtyBrickList(const CpuVoxelDirtyBricks* dirty, u32* bricks);
+// the voxels of the box around the dirty bricks, false when there are none
+bool GetDirtyBounds(const CpuVoxelDirtyBricks* dirty, u32* boundsMin, u32* boundsMax);
+// drops the active bricks of the bins that aren't dirty
+void KeepDirtyBricks(VoxelBins* bins, const CpuVoxelDirtyBricks* dirty);
+// builds the next opacity mip of a grid on the calling thread, like CpuVoxel_BuildOpacityMips
+void DownsampleOpacityGrid(u8* dst, const u8* src, uint3_t srcSize);
+// the brick one mip up from 8 bricks side by side, indexed x + y * 2 + z * 4 and NULL when empty
+void DownsampleOpacityBricks(u8* dst, const u8* const* children);
+
+// Returns false with one of the voxels [min; max] in occupiedVoxel when any of them is occupied,
+// true otherwise with the largest block of empty cells of one level around them in voxels
+// [blockMin; blockMax[. Voxels outside of the grid are empty.
+bool FindEmptyBlock(const CpuVoxelOccupancy* occupancy, const s32* min, const s32* max, s32* blockMin, s32* blockMax, s32* occupiedVoxel);
+
+// cone i of ComputeAmbientOcclusion for a point and its normal, with its weight
+#define AO_CONE_COUNT 17
+CpuCone GetAmbientOcclusionCone(vec3_t position, vec3_t normal, u32 cone, f32* weight);
+
+// keeps the largest opacity of the triangles covering a texel of a brick of its own
+struct WriteBrickOpacity
+{
+    u8* texels;
+    const u32* brickMin;
+    u32 faces[3];
+    u8 value;
+
+    void operator()(const u32* voxel, f32, f32)
+    {
+        const uint3_t brickSize = { CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE };
+        for (u32 f = 0; f < 3; ++f)
+        {
+            u8* texel = &texels[CpuVoxel_TexelIndex(brickSize, voxel[0] - brickMin[0], voxel[1] - brickMin[1], voxel[2] - brickMin[2], faces[f])];
+            *texel = MAX(*texel, value);
+        }
+    }
+};
+
+// Calls (*onSample)(voxel, u, v) for every sample of the triangle that lands in the brick
+// [brickMin; brickMax[, with voxel the sample's voxel coordinates and (u, v) its center.
+// The triangle is set up in the voxels of the grid shifted by origin, see VoxelBins::origin,
+// the brick and the voxels passed to onSample are the grid's.
+template <typename T>
+void RasterizeTriangle(const VoxelTriangle* tri, const u32* brickMin, const u32* brickMax, const s32* origin, T* onSample)
+{
+    const u32 axis = tri->axis;
+    const u32 u = axisU[axis];
+    const u32 w = axisV[axis];
+    const s32 minU = MAX(tri->minU, (s32)brickMin[u] + origin[u]);
+    const s32 maxU = MIN(tri->maxU, (s32)brickMax[u] + origin[u] - 1);
+    const s32 minV = MAX(tri->minV, (s32)brickMin[w] + origin[w]);
+    const s32 maxV = MIN(tri->maxV, (s32)brickMax[w] + origin[w] - 1);
+    const f32 minDepth = (f32)((s32)brickMin[axis] + origin[axis]);
+    const f32 maxDepth = (f32)((s32)brickMax[axis] + origin[axis]);
+
+    vec4 edgeA[3];
+    u32 nonOwnerMask[3];
+    for (u32 k = 0; k < 3; ++k)
+    {
+        edgeA[k] = Vec4Splat(tri->edgeA[k]);
+        nonOwnerMask[k] = (tri->ownsEdges & (1 << k)) ? 0 : 0xF;
+    }
+
+    const vec4 laneOffsets = Vec4(0.5f, 1.5f, 2.5f, 3.5f);
+    const vec4 depthU = Vec4Splat(tri->depthU);
+
+    for (s32 sv = minV; sv <= maxV; ++sv)
+    {
+        const f32 centerV = (f32)sv + 0.5f;
+        vec4 rowC[3];
+        for (u32 k = 0; k < 3; ++k)
+        {
+            rowC[k] = Vec4Splat(tri->edgeB[k] * centerV + tri->edgeC[k]);
+        }
+        const vec4 rowDepth = Vec4Splat(tri->depthV * centerV + tri->depthC);
+
+        for (s32 su = minU; su <= maxU; su += 4)
+        {
+            const vec4 centerU = Vec4Splat((f32)su) + laneOffsets;
+            u32 outside = 0;
+            for (u32 k = 0; k < 3; ++k)
+            {
+                const vec4 E = edgeA[k] * centerU + rowC[k];
+                outside |= LessMask(E, Vec4Zero()) | (LessEqualMask(E, Vec4Zero()) & nonOwnerMask[k]);
+            }
+
+            const s32 numLanes = MIN(maxU - su + 1, 4);
+            const u32 inside = ~outside & ((1 << numLanes) - 1);
+            if (inside == 0)
+            {
+                continue;
+            }
+
+            f32 depth[4];
+            StoreVec4(depth, depthU * centerU + rowDepth);
+            for (s32 i = 0; i < numLanes; ++i)
+            {
+                if ((inside & (1 << i)) == 0 || !(depth[i] >= minDepth && depth[i] < maxDepth))
+                {
+                    continue;
+                }
+
+                u32 voxel[3];
+                voxel[axis] = (u32)((s32)floorf(depth[i]) - origin[axis]);
+                voxel[u] = (u32)(su + i - origin[u]);
+                voxel[w] = (u32)(sv - origin[w]);
+                (*onSample)(voxel, (f32)(su + i) + 0.5f, centerV);
+            }
+        }
+    }
+}
+
+// RasterizeTriangle for the triangles of a grid mapped to the geometry's AABB
+template <typename T>
+void RasterizeTriangle(const VoxelTriangle* tri, const u32* brickMin, const u32* brickMax, T* onSample)
+{
+    const s32 origin[3] = { 0, 0, 0 };
+    RasterizeTriangle(tri, brickMin, brickMax, origin, onSample);
+}
@@ -0,0 +1,301 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+struct SvoBuilder
+{
+    VoxelBins bins;
+    CpuOpacitySvo* svo;
+    u32* nodeCells; // per node, its cell in the grid of its depth
+    u32 levelFirstNode[CPU_VOXEL_MAX_MIPS + 1]; // the nodes of a depth are contiguous
+    u32 depth; // for FilterBricks
+};
+
+static u8* GetBrick(const CpuOpacitySvo* svo, u32 brick)
+{
+    return svo->bricks + (size_t)brick * CPU_VOXEL_BRICK_TEXELS;
+}
+
+static void GetCellCoordinates(u32 cell, u32 depth, u32* coords)
+{
+    const u32 mask = (1 << depth) - 1;
+    coords[0] = cell & mask;
+    coords[1] = (cell >> depth) & mask;
+    coords[2] = cell >> (depth * 2);
+}
+
+// the leaves' cells are the bins' bricks
+static void RasterizeLeaves(void* userData, u32 begin, u32 end)
+{
+    const SvoBuilder* b = (const SvoBuilder*)userData;
+    const VoxelBins* bins = &b->bins;
+    const u32 firstNode = b->levelFirstNode[b->svo->depth];
+    for (u32 n = firstNode + begin; n < firstNode + end; ++n)
+    {
+        const CpuSvoNode* node = &b->svo->nodes[n];
+        if (node->brick == CPU_SVO_NO_BRICK)
+        {
+            continue;
+        }
+
+        u8* texels = GetBrick(b->svo, node->brick);
+        memset(texels, 0, CPU_VOXEL_BRICK_TEXELS);
+        const u32 brick = b->nodeCells[n];
+        u32 brickMin[3], brickMax[3];
+        GetBrickBounds(bins, brick, brickMin, brickMax);
+        for (u32 t = bins->brickOffsets[brick]; t < bins->brickOffsets[brick + 1]; ++t)
+        {
+            const VoxelTriangle* tri = &bins->triangles[bins->brickTriangles[t]];
+            WriteBrickOpacity write;
+            write.texels = texels;
+            write.brickMin = brickMin;
+            write.faces[0] = VoxelFace::PosX + (tri->faceOffsets & 1);
+            write.faces[1] = VoxelFace::PosY + ((tri->faceOffsets >> 1) & 1);
+            write.faces[2] = VoxelFace::PosZ + ((tri->faceOffsets >> 2) & 1);
+            write.value = tri->value;
+            RasterizeTriangle(tri, brickMin, brickMax, &write);
+        }
+    }
+}
+
+// the 8 children side by side make the grid the parent's brick is the next mip of
+static void FilterBricks(void* userData, u32 begin, u32 end)
+{
+    const SvoBuilder* b = (const SvoBuilder*)userData;
+    const CpuOpacitySvo* svo = b->svo;
+    const u32 firstNode = b->levelFirstNode[b->depth];
+    for (u32 n = firstNode + begin; n < firstNode + end; ++n)
+    {
+        const CpuSvoNode* node = &svo->nodes[n];
+        if (node->brick == CPU_SVO_NO_BRICK)
+        {
+            continue;
+        }
+
+        const u8* children[8];
+        for (u32 c = 0; c < 8; ++c)
+        {
+            const u32 brick = svo->nodes[node->firstChild + c].brick;
+            children[c] = brick != CPU_SVO_NO_BRICK ? GetBrick(svo, brick) : NULL;
+        }
+        DownsampleOpacityBricks(GetBrick(svo, node->brick), children);
+    }
+}
+
+// Marks the cells of every depth that have something under them, then hands out the
+// nodes top down: each depth's nodes are the tiles of the previous depth's non-empty
+// nodes in order, which keeps the siblings together and the depths contiguous.
+static void BuildNodes(SvoBuilder* b, MemoryArena* arena, MemoryArena* scratch)
+{
+    CpuOpacitySvo* svo = b->svo;
+    const u32 depth = svo->depth;
+
+    u8* occupied[CPU_VOXEL_MAX_MIPS];
+    u32 numOccupied = 0;
+    for (u32 d = 0; d <= depth; ++d)
+    {
+        const u32 numCells = 1 << (d * 3);
+        occupied[d] = PushArray(scratch, numCells, u8);
+        memset(occupied[d], 0, numCells);
+    }
+    for (u32 i = 0; i < b->bins.numActiveBricks; ++i)
+    {
+        occupied[depth][b->bins.activeBricks[i]] = 1;
+    }
+    for (u32 d = depth; d > 0; --d)
+    {
+        const u32 numCells = 1 << (d * 3);
+        for (u32 cell = 0; cell < numCells; ++cell)
+        {
+            if (occupied[d][cell])
+            {
+                u32 coords[3];
+                GetCellCoordinates(cell, d, coords);
+                const u32 parent = (coords[0] >> 1) | ((coords[1] >> 1) << (d - 1)) | ((coords[2] >> 1) << ((d - 1) * 2));
+                occupied[d - 1][parent] = 1;
+            }
+        }
+    }
+    for (u32 d = 0; d < depth; ++d)
+    {
+        const u32 numCells = 1 << (d * 3);
+        for (u32 cell = 0; cell < numCells; ++cell)
+        {
+            numOccupied += occupied[d][cell];
+        }
+    }
+
+    // the root always gets a brick so that the coarse mips exist
+    occupied[0][0] = 1;
+    svo->numNodes = 1 + MAX(numOccupied, 1) * 8;
+    svo->nodes = PushArray(arena, svo->numNodes, CpuSvoNode);
+    b->nodeCells = PushArray(scratch, svo->numNodes, u32);
+
+    svo->nodes[0].firstChild = 0;
+    svo->nodes[0].brick = 0;
+    b->nodeCells[0] = 0;
+    b->levelFirstNode[0] = 0;
+    u32 numNodes = 1;
+    u32 numBricks = 1;
+    for (u32 d = 0; d < depth; ++d)
+    {
+        const u32 first = b->levelFirstNode[d];
+        const u32 end = numNodes;
+        b->levelFirstNode[d + 1] = end;
+        for (u32 n = first; n < end; ++n)
+        {
+            CpuSvoNode* node = &svo->nodes[n];
+            if (node->brick == CPU_SVO_NO_BRICK)
+            {
+                continue;
+            }
+
+            u32 coords[3];
+            GetCellCoordinates(b->nodeCells[n], d, coords);
+            node->firstChild = numNodes;
+            for (u32 c = 0; c < 8; ++c)
+            {
+                const u32 x = coords[0] * 2 + (c & 1);
+                const u32 y = coords[1] * 2 + ((c >> 1) & 1);
+                const u32 z = coords[2] * 2 + (c >> 2);
+                const u32 cell = x | (y << (d + 1)) | (z << ((d + 1) * 2));
+                CpuSvoNode* child = &svo->nodes[numNodes];
+                child->firstChild = 0;
+                child->brick = occupied[d + 1][cell] ? numBricks++ : CPU_SVO_NO_BRICK;
+                b->nodeCells[numNodes] = cell;
+                numNodes++;
+            }
+        }
+    }
+    b->levelFirstNode[depth + 1] = numNodes;
+    svo->numNodes = numNodes;
+    svo->numBricks = numBricks;
+    svo->bricks = PushArray(arena, (size_t)numBricks * CPU_VOXEL_BRICK_TEXELS, u8);
+}
+
+void CpuVoxel_BuildOpacitySvo(CpuOpacitySvo* svo, MemoryArena* arena, const CpuVoxelGeometry* geometry, u32 gridSize, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats)
+{
+    assert(gridSize >= CPU_VOXEL_BRICK_SIZE && (gridSize & (gridSize - 1)) == 0);
+    const uint3_t size = { gridSize, gridSize, gridSize };
+    memset(svo, 0, sizeof(*svo));
+    svo->gridSize = gridSize;
+    svo->numLevels = CpuVoxel_NumMipLevels(size);
+    while (((u32)CPU_VOXEL_BRICK_SIZE << svo->depth) < gridSize)
+    {
+        svo->depth++;
+    }
+
+    SvoBuilder b;
+    b.svo = svo;
+    BinTriangles(&b.bins, geometry, size, conservative, scratch);
+    BuildNodes(&b, arena, scratch);
+
+    // the root's brick stays empty when there's nothing to filter
+    memset(GetBrick(svo, 0), 0, CPU_VOXEL_BRICK_TEXELS);
+
+    // bricks vary a lot in cost, small ranges keep the threads busy
+    const u32 depth = svo->depth;
+    Job_ParallelFor(b.levelFirstNode[depth + 1] - b.levelFirstNode[depth], &RasterizeLeaves, &b, 1);
+    for (b.depth = depth; b.depth-- > 0;)
+    {
+        Job_ParallelFor(b.levelFirstNode[b.depth + 1] - b.levelFirstNode[b.depth], &FilterBricks, &b, 1);
+    }
+
+    CpuOpacityGrid root;
+    root.gridSize.w = root.gridSize.h = root.gridSize.d = CPU_VOXEL_BRICK_SIZE;
+    root.texels = GetBrick(svo, 0);
+    CpuVoxel_AllocateOpacityMips(&svo->rootMips, arena, &root);
+    CpuVoxel_BuildOpacityMips(&svo->rootMips);
+
+    if (stats != NULL)
+    {
+        stats->numTriangles = b.bins.numTriangles;
+        stats->numBrickTriangles = b.bins.brickOffsets[b.bins.numBricks.w * b.bins.numBricks.h * b.bins.numBricks.d];
+        stats->numBricks = b.bins.numActiveBricks;
+    }
+}
+
+size_t CpuVoxel_SvoMemory(const CpuOpacitySvo* svo)
+{
+    size_t size = svo->numNodes * sizeof(CpuSvoNode) + (size_t)svo->numBricks * CPU_VOXEL_BRICK_TEXELS;
+    for (u32 m = 1; m < svo->rootMips.numLevels; ++m)
+    {
+        size += CpuVoxel_NumTexels(CpuVoxel_MipSize(svo->rootMips.gridSize, m));
+    }
+    return size;
+}
+
+const u8* CpuVoxel_FindSvoBrick(const CpuOpacitySvo* svo, u32 level, u32 x, u32 y, u32 z)
+{
+    assert(level < svo->depth);
+    const u32 depth = svo->depth - level;
+    const u32 bx = x / CPU_VOXEL_BRICK_SIZE;
+    const u32 by = y / CPU_VOXEL_BRICK_SIZE;
+    const u32 bz = z / CPU_VOXEL_BRICK_SIZE;
+    u32 node = 0;
+    for (u32 shift = depth; shift-- > 0;)
+    {
+        const u32 firstChild = svo->nodes[node].firstChild;
+        if (firstChild == 0)
+        {
+            return NULL;
+        }
+        node = firstChild + (((bx >> shift) & 1) | (((by >> shift) & 1) << 1) | (((bz >> shift) & 1) << 2));
+    }
+
+    const u32 brick = svo->nodes[node].brick;
+    return brick != CPU_SVO_NO_BRICK ? GetBrick(svo, brick) : NULL;
+}
+
+u8 CpuVoxel_GetSvoTexel(const CpuOpacitySvo* svo, u32 level, u32 x, u32 y, u32 z, u32 face)
+{
+    if (level >= svo->depth)
+    {
+        const u32 rootLevel = level - svo->depth;
+        const uint3_t size = CpuVoxel_MipSize(svo->rootMips.gridSize, rootLevel);
+        return svo->rootMips.levels[rootLevel][CpuVoxel_TexelIndex(size, x, y, z, face)];
+    }
+
+    const u8* brick = CpuVoxel_FindSvoBrick(svo, level, x, y, z);
+    if (brick == NULL)
+    {
+        return 0;
+    }
+
+    const uint3_t brickSize = { CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE, CPU_VOXEL_BRICK_SIZE };
+    const u32 mask = CPU_VOXEL_BRICK_SIZE - 1;
+    return brick[CpuVoxel_TexelIndex(brickSize, x & mask, y & mask, z & mask, face)];
+}
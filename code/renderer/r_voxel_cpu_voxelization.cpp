@@ -0,0 +1,714 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+static u32 GetGridSize(uint3_t gridSize, u32 axis)
+{
+    return axis == 0 ? gridSize.w : (axis == 1 ? gridSize.h : gridSize.d);
+}
+
+// the same tests in the same order as VoxelizeGeometryShader,
+// the shader leaves the axis undefined on ties, we take z
+static u32 GetDominantAxis(vec3_t N)
+{
+    const vec3_t n = { fabsf(N.x), fabsf(N.y), fabsf(N.z) };
+    if (n.x > n.y && n.x > n.z)
+        return 0;
+    if (n.y > n.x && n.y > n.z)
+        return 1;
+    return 2;
+}
+
+static void SetupTriangle(VoxelBins* v, VoxelTriangle* tri, const u32* indexes, u32 mesh, u8 value)
+{
+    const CpuVoxelGeometry* geometry = v->geometry;
+    const uint3_t gridSize = v->gridSize;
+    const vec3_t gridScale = { (f32)gridSize.w, (f32)gridSize.h, (f32)gridSize.d };
+    const vec3_t extent = geometry->aabb.max - geometry->aabb.min;
+
+    vec3_t N;
+    f32 voxelRatio; // of the largest and smallest voxel sides
+    if (v->worldScale != 0.0f)
+    {
+        // world voxels are cubes, the positions don't depend on the grid's origin
+        for (u32 k = 0; k < 3; ++k)
+        {
+            tri->position[k] = geometry->xyz[indexes[k]] * v->worldScale;
+        }
+        N = cross(tri->position[1] - tri->position[0], tri->position[2] - tri->position[0]);
+        voxelRatio = 1.0f;
+    }
+    else
+    {
+        // world space -> [0;1] like the geometry shader, then voxels
+        vec3_t pos01[3];
+        for (u32 k = 0; k < 3; ++k)
+        {
+            pos01[k] = (geometry->xyz[indexes[k]] - geometry->aabb.min) / extent;
+            tri->position[k].x = pos01[k].x * gridScale.x;
+            tri->position[k].y = pos01[k].y * gridScale.y;
+            tri->position[k].z = pos01[k].z * gridScale.z;
+        }
+        N = cross(pos01[1] - pos01[0], pos01[2] - pos01[0]);
+        voxelRatio = MAX3(gridScale.x, gridScale.y, gridScale.z) / MIN3(gridScale.x, gridScale.y, gridScale.z);
+    }
+
+    // Triangles away from the bounds have no samples in them. Conservative samples are up to
+    // half a voxel away in u and v, and then up to the ratio of the voxel sizes along the
+    // dominant axis (see binPadding below).
+    f32 margin = BIN_PADDING;
+    if (v->conservative)
+    {
+        margin += 0.5f + voxelRatio;
+    }
+    tri->axis = 0xFF;
+    for (u32 a = 0; a < 3; ++a)
+    {
+        const f32 min = MIN3(tri->position[0][a], tri->position[1][a], tri->position[2][a]);
+        const f32 max = MAX3(tri->position[0][a], tri->position[1][a], tri->position[2][a]);
+        if (max + margin < (f32)((s32)v->boundsMin[a] + v->origin[a]) || min - margin > (f32)((s32)v->boundsMax[a] + v->origin[a]))
+        {
+            return;
+        }
+    }
+
+    const u32 axis = GetDominantAxis(N);
+    const u32 u = axisU[axis];
+    const u32 w = axisV[axis];
+    tri->indexes = indexes;
+    tri->mesh = mesh;
+    tri->faceOffsets = (N.x >= 0.0f ? 1 : 0) | (N.y >= 0.0f ? 2 : 0) | (N.z >= 0.0f ? 4 : 0);
+    tri->value = value;
+
+    const vec3_t* p = tri->position;
+    const f32 area = (p[1][u] - p[0][u]) * (p[2][w] - p[0][w]) - (p[2][u] - p[0][u]) * (p[1][w] - p[0][w]);
+    if (area == 0.0f)
+    {
+        // no area in the projection, the rasterizer drops these
+        return;
+    }
+
+    // edge k goes from vertex k to k + 1, flipped so that the inside is positive
+    const f32 orientation = area > 0.0f ? 1.0f : -1.0f;
+    tri->ownsEdges = 0;
+    for (u32 k = 0; k < 3; ++k)
+    {
+        const vec3_t p0 = p[k];
+        const vec3_t p1 = p[(k + 1) % 3];
+        const f32 a = -(p1[w] - p0[w]) * orientation;
+        const f32 b = (p1[u] - p0[u]) * orientation;
+        tri->edgeA[k] = a;
+        tri->edgeB[k] = b;
+        tri->edgeC[k] = -(a * p0[u] + b * p0[w]);
+        if (v->conservative)
+        {
+            // the geometry shader's plane push-back, by half a voxel along the edge normal
+            tri->edgeC[k] += 0.5f * (fabsf(a) + fabsf(b));
+        }
+
+        // shared edges are owned by exactly one of the two triangles, like the top-left rule
+        if (v->conservative || a > 0.0f || (a == 0.0f && b > 0.0f))
+        {
+            tri->ownsEdges |= 1 << k;
+        }
+    }
+
+    // sample centers are at i + 0.5, conservative samples are clipped to the bounds grown by
+    // half a voxel like IsPointInTriangle
+    const f32 grow = v->conservative ? 0.5f : 0.0f;
+    const f32 minU = MIN3(p[0][u], p[1][u], p[2][u]) - grow;
+    const f32 maxU = MAX3(p[0][u], p[1][u], p[2][u]) + grow;
+    const f32 minV = MIN3(p[0][w], p[1][w], p[2][w]) - grow;
+    const f32 maxV = MAX3(p[0][w], p[1][w], p[2][w]) + grow;
+    tri->minU = MAX((s32)ceilf(minU - 0.5f), v->origin[u]);
+    tri->minV = MAX((s32)ceilf(minV - 0.5f), v->origin[w]);
+    tri->maxU = MIN((s32)floorf(maxU - 0.5f), v->origin[u] + (s32)GetGridSize(gridSize, u) - 1);
+    tri->maxV = MIN((s32)floorf(maxV - 0.5f), v->origin[w] + (s32)GetGridSize(gridSize, w) - 1);
+    if (tri->minU > tri->maxU || tri->minV > tri->maxV)
+    {
+        return;
+    }
+
+    // the plane through the triangle, solved for the dominant axis
+    const vec3_t Nv = cross(p[1] - p[0], p[2] - p[0]);
+    tri->depthU = -Nv[u] / Nv[axis];
+    tri->depthV = -Nv[w] / Nv[axis];
+    tri->depthC = p[0][axis] + (Nv[u] * p[0][u] + Nv[w] * p[0][w]) / Nv[axis];
+    tri->axis = (u8)axis;
+
+    // conservative samples are up to half a voxel away in u and v, and the plane can be
+    // steeper than 1 along the dominant axis when the voxels aren't cubes in [0;1]
+    tri->binPadding = BIN_PADDING;
+    if (v->conservative)
+    {
+        tri->binPadding += MAX(0.5f, 0.5f * (fabsf(tri->depthU) + fabsf(tri->depthV)));
+    }
+}
+
+static void SetupTriangles(void* userData, u32 begin, u32 end)
+{
+    VoxelBins* v = (VoxelBins*)userData;
+    const CpuVoxelGeometry* geometry = v->geometry;
+
+    // the first mesh of the range, the others follow in order
+    u32 m = 0;
+    u32 last = geometry->numMeshes;
+    while (m < last)
+    {
+        const u32 mid = (m + last) / 2;
+        if (v->meshFirstTriangle[mid + 1] <= begin)
+            m = mid + 1;
+        else
+            last = mid;
+    }
+
+    for (u32 t = begin; t < end; ++t)
+    {
+        while (t >= v->meshFirstTriangle[m + 1])
+        {
+            ++m;
+        }
+
+        const MeshFileMesh* mesh = &geometry->meshes[m];
+        const f32 opacity = CLAMP_MIN(CLAMP_MAX(geometry->materials[mesh->materialIndex].alphaTestedColor.w, 1.0f), 0.0f);
+        const u32* indexes = geometry->indexes + mesh->firstIndex + (t - v->meshFirstTriangle[m]) * 3;
+        SetupTriangle(v, &v->triangles[t], indexes, m, (u8)(opacity * 255.0f + 0.5f));
+    }
+}
+
+// The separating axis test of a triangle against 4 bricks next to each other along x:
+// the box normals, the triangle's normal and the 9 edge cross products.
+struct BinTest
+{
+    vec3_t axes[10]; // [0] is the triangle normal
+    f32 min[10];
+    f32 max[10];
+    f32 radius[10];
+};
+
+static void SetupBinTest(BinTest* test, const vec3_t* p, f32 halfSize)
+{
+    const vec3_t edges[3] = { p[1] - p[0], p[2] - p[1], p[0] - p[2] };
+    test->axes[0] = cross(edges[0], edges[1]);
+    for (u32 e = 0; e < 3; ++e)
+    {
+        const vec3_t X = { 0.0f, -edges[e].z, edges[e].y };
+        const vec3_t Y = { edges[e].z, 0.0f, -edges[e].x };
+        const vec3_t Z = { -edges[e].y, edges[e].x, 0.0f };
+        test->axes[1 + e * 3 + 0] = X;
+        test->axes[1 + e * 3 + 1] = Y;
+        test->axes[1 + e * 3 + 2] = Z;
+    }
+
+    for (u32 a = 0; a < 10; ++a)
+    {
+        const vec3_t A = test->axes[a];
+        const f32 d0 = dot(A, p[0]);
+        const f32 d1 = dot(A, p[1]);
+        const f32 d2 = dot(A, p[2]);
+        test->min[a] = MIN3(d0, d1, d2);
+        test->max[a] = MAX3(d0, d1, d2);
+        test->radius[a] = halfSize * (fabsf(A.x) + fabsf(A.y) + fabsf(A.z));
+    }
+}
+
+// bit i is set when the brick centered at (centerX[i], centerY, centerZ) is separated
+static u32 SeparatedBricks(const BinTest* test, vec4 centerX, f32 centerY, f32 centerZ)
+{
+    u32 separated = 0;
+    for (u32 a = 0; a < 10; ++a)
+    {
+        const vec3_t A = test->axes[a];
+        const vec4 projectedCenter = centerX * Vec4Splat(A.x) + Vec4Splat(A.y * centerY + A.z * centerZ);
+        const vec4 radius = Vec4Splat(test->radius[a]);
+        separated |= LessMask(radius, Vec4Splat(test->min[a]) - projectedCenter);
+        separated |= LessMask(Vec4Splat(test->max[a]) - projectedCenter, -radius);
+    }
+    return separated;
+}
+
+// Calls onBrick for every brick the triangle touches.
+template <typename T>
+static void ForEachBrick(const VoxelBins* v, const VoxelTriangle* tri, T* onBrick)
+{
+    const f32 padding = tri->binPadding;
+    const f32 brickSize = (f32)CPU_VOXEL_BRICK_SIZE;
+    const vec3_t* p = tri->position;
+
+    // the positions are relative to the grid's origin, the rounding of that is well under the padding
+    s32 first[3], last[3];
+    const s32 numBricks[3] = { (s32)v->numBricks.w, (s32)v->numBricks.h, (s32)v->numBricks.d };
+    for (u32 a = 0; a < 3; ++a)
+    {
+        const f32 min = MIN3(p[0][a], p[1][a], p[2][a]) - padding - (f32)v->origin[a];
+        const f32 max = MAX3(p[0][a], p[1][a], p[2][a]) + padding - (f32)v->origin[a];
+        first[a] = MAX((s32)floorf(min / brickSize), (s32)(v->boundsMin[a] / CPU_VOXEL_BRICK_SIZE));
+        last[a] = MIN((s32)floorf(max / brickSize), MIN((s32)((v->boundsMax[a] - 1) / CPU_VOXEL_BRICK_SIZE), numBricks[a] - 1));
+        if (first[a] > last[a])
+        {
+            return;
+        }
+    }
+
+    // a single brick needs no test
+    if (first[0] == last[0] && first[1] == last[1] && first[2] == last[2])
+    {
+        (*onBrick)(((u32)first[2] * v->numBricks.h + (u32)first[1]) * v->numBricks.w + (u32)first[0]);
+        return;
+    }
+
+    BinTest test;
+    SetupBinTest(&test, p, brickSize * 0.5f + padding);
+    const vec4 laneOffsets = Vec4(0.0f, brickSize, brickSize * 2.0f, brickSize * 3.0f);
+    for (s32 z = first[2]; z <= last[2]; ++z)
+    {
+        const f32 centerZ = ((f32)z + 0.5f) * brickSize + (f32)v->origin[2];
+        for (s32 y = first[1]; y <= last[1]; ++y)
+        {
+            const f32 centerY = ((f32)y + 0.5f) * brickSize + (f32)v->origin[1];
+            const u32 rowStart = ((u32)z * v->numBricks.h + (u32)y) * v->numBricks.w;
+            for (s32 x = first[0]; x <= last[0]; x += 4)
+            {
+                const vec4 centerX = Vec4Splat(((f32)x + 0.5f) * brickSize + (f32)v->origin[0]) + laneOffsets;
+                u32 inside = ~SeparatedBricks(&test, centerX, centerY, centerZ) & 0xF;
+                const s32 numLanes = MIN(last[0] - x + 1, 4);
+                inside &= (1 << numLanes) - 1;
+                for (s32 i = 0; i < numLanes; ++i)
+                {
+                    if (inside & (1 << i))
+                    {
+                        (*onBrick)(rowStart + (u32)(x + i));
+                    }
+                }
+            }
+        }
+    }
+}
+
+struct CountBrick
+{
+    volatile s32* counts;
+    void operator()(u32 brick) { AtomicAdd32(&counts[brick], 1); }
+};
+
+struct FillBrick
+{
+    volatile s32* cursors;
+    const u32* offsets;
+    u32* triangles;
+    u32 triangle;
+    void operator()(u32 brick) { triangles[offsets[brick] + AtomicAdd32(&cursors[brick], 1) - 1] = triangle; }
+};
+
+struct BrickOccupancy
+{
+    const VoxelBins* bins;
+    u8* occupancy;
+};
+
+static void CountBricks(void* userData, u32 begin, u32 end)
+{
+    VoxelBins* v = (VoxelBins*)userData;
+    CountBrick count = { v->brickCounts };
+    for (u32 t = begin; t < end; ++t)
+    {
+        if (v->triangles[t].axis != 0xFF)
+        {
+            ForEachBrick(v, &v->triangles[t], &count);
+        }
+    }
+}
+
+static void FillBricks(void* userData, u32 begin, u32 end)
+{
+    VoxelBins* v = (VoxelBins*)userData;
+    FillBrick fill = { v->brickCounts, v->brickOffsets, v->brickTriangles, 0 };
+    for (u32 t = begin; t < end; ++t)
+    {
+        if (v->triangles[t].axis != 0xFF)
+        {
+            fill.triangle = t;
+            ForEachBrick(v, &v->triangles[t], &fill);
+        }
+    }
+}
+
+void BinTriangles(VoxelBins* bins, const CpuVoxelGeometry* geometry, uint3_t gridSize, bool conservative, MemoryArena* scratch)
+{
+    const u32 boundsMin[3] = { 0, 0, 0 };
+    const u32 boundsMax[3] = { gridSize.w, gridSize.h, gridSize.d };
+    BinTrianglesInBounds(bins, geometry, gridSize, boundsMin, boundsMax, conservative, scratch);
+}
+
+void BinTrianglesInBounds(VoxelBins* bins, const CpuVoxelGeometry* geometry, uint3_t gridSize, const u32* boundsMin, const u32* boundsMax, bool conservative, MemoryArena* scratch)
+{
+    BinTrianglesInWorldBounds(bins, geometry, gridSize, NULL, 0.0f, boundsMin, boundsMax, conservative, scratch);
+}
+
+void BinTrianglesInWorldBounds(VoxelBins* bins, const CpuVoxelGeometry* geometry, uint3_t gridSize, const s32* origin, f32 voxelSize, const u32* boundsMin, const u32* boundsMax, bool conservative, MemoryArena* scratch)
+{
+    VoxelBins* v = bins;
+    memset(v, 0, sizeof(*v));
+    v->geometry = geometry;
+    v->gridSize = gridSize;
+    v->conservative = conservative;
+    v->worldScale = origin != NULL ? 1.0f / voxelSize : 0.0f;
+    for (u32 a = 0; a < 3; ++a)
+    {
+        v->boundsMin[a] = boundsMin[a];
+        v->boundsMax[a] = boundsMax[a];
+        v->origin[a] = origin != NULL ? origin[a] : 0;
+    }
+
+    v->meshFirstTriangle = PushArray(scratch, geometry->numMeshes + 1, u32);
+    v->meshFirstTriangle[0] = 0;
+    for (u32 m = 0; m < geometry->numMeshes; ++m)
+    {
+        v->meshFirstTriangle[m + 1] = v->meshFirstTriangle[m] + geometry->meshes[m].numIndexes / 3;
+    }
+    v->numTriangles = v->meshFirstTriangle[geometry->numMeshes];
+    v->triangles = PushArray(scratch, v->numTriangles, VoxelTriangle);
+    Job_ParallelFor(v->numTriangles, &SetupTriangles, v, 0);
+
+    v->numBricks.w = (gridSize.w + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+    v->numBricks.h = (gridSize.h + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+    v->numBricks.d = (gridSize.d + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+    const u32 numBricks = v->numBricks.w * v->numBricks.h * v->numBricks.d;
+    v->brickCounts = PushArray(scratch, numBricks, s32);
+    v->brickOffsets = PushArray(scratch, numBricks + 1, u32);
+    v->activeBricks = PushArray(scratch, numBricks, u32);
+    memset((void*)v->brickCounts, 0, numBricks * sizeof(s32));
+    Job_ParallelFor(v->numTriangles, &CountBricks, v, 0);
+
+    // the counts become the write cursors of the fill pass
+    v->brickOffsets[0] = 0;
+    for (u32 b = 0; b < numBricks; ++b)
+    {
+        v->brickOffsets[b + 1] = v->brickOffsets[b] + (u32)v->brickCounts[b];
+        if (v->brickCounts[b] > 0)
+        {
+            v->activeBricks[v->numActiveBricks++] = b;
+        }
+        v->brickCounts[b] = 0;
+    }
+    v->brickTriangles = PushArray(scratch, v->brickOffsets[numBricks], u32);
+    Job_ParallelFor(v->numTriangles, &FillBricks, v, 0);
+}
+
+static void FindOccupiedBricks(void* userData, u32 begin, u32 end)
+{
+    const BrickOccupancy* o = (const BrickOccupancy*)userData;
+    for (u32 b = begin; b < end; ++b)
+    {
+        o->occupancy[b] = o->bins->brickOffsets[b + 1] != o->bins->brickOffsets[b] ? 1 : 0;
+    }
+}
+
+void GetBrickOccupancy(const VoxelBins* bins, u8* occupancy)
+{
+    BrickOccupancy o = { bins, occupancy };
+    Job_ParallelFor(bins->numBricks.w * bins->numBricks.h * bins->numBricks.d, &FindOccupiedBricks, &o, 0);
+}
+
+void GetBrickBounds(const VoxelBins* bins, u32 brick, u32* brickMin, u32* brickMax)
+{
+    const uint3_t numBricks = bins->numBricks;
+    const u32 coords[3] = {
+        brick % numBricks.w,
+        (brick / numBricks.w) % numBricks.h,
+        brick / (numBricks.w * numBricks.h)
+    };
+    const u32 gridMax[3] = { bins->gridSize.w, bins->gridSize.h, bins->gridSize.d };
+    for (u32 a = 0; a < 3; ++a)
+    {
+        brickMin[a] = coords[a] * CPU_VOXEL_BRICK_SIZE;
+        brickMax[a] = MIN(brickMin[a] + CPU_VOXEL_BRICK_SIZE, gridMax[a]);
+    }
+}
+
+void ClearGridSlices(void* texels, size_t texelSize, uint3_t gridSize, u32 begin, u32 end)
+{
+    const size_t sliceSize = (size_t)gridSize.w * VoxelFace::Count * gridSize.h * texelSize;
+    memset((u8*)texels + begin * sliceSize, 0, (end - begin) * sliceSize);
+}
+
+void ClearGridBrick(void* texels, size_t texelSize, uint3_t gridSize, const u32* brickMin, const u32* brickMax)
+{
+    const size_t rowSize = (brickMax[0] - brickMin[0]) * texelSize;
+    for (u32 z = brickMin[2]; z < brickMax[2]; ++z)
+    {
+        for (u32 y = brickMin[1]; y < brickMax[1]; ++y)
+        {
+            for (u32 face = 0; face < VoxelFace::Count; ++face)
+            {
+                memset((u8*)texels + CpuVoxel_TexelIndex(gridSize, brickMin[0], y, z, face) * texelSize, 0, rowSize);
+            }
+        }
+    }
+}
+
+//
+// opacity
+//
+
+struct OpacityVoxelizer
+{
+    VoxelBins bins;
+    CpuOpacityGrid* grid;
+    const CpuVoxelRegion* region; // for RasterizeOpacityRegion
+    u32 wrap[3];
+    const u32* dirtyBricks; // for ClearOpacityBricks
+};
+
+// keeps the largest opacity of the triangles covering a texel
+struct WriteOpacity
+{
+    u8* texels;
+    uint3_t gridSize;
+    u32 faces[3];
+    u8 value;
+
+    void operator()(const u32* voxel, f32, f32)
+    {
+        for (u32 f = 0; f < 3; ++f)
+        {
+            u8* texel = &texels[CpuVoxel_TexelIndex(gridSize, voxel[0], voxel[1], voxel[2], faces[f])];
+            *texel = MAX(*texel, value);
+        }
+    }
+};
+
+static void RasterizeOpacityBricks(void* userData, u32 begin, u32 end)
+{
+    OpacityVoxelizer* v = (OpacityVoxelizer*)userData;
+    const VoxelBins* bins = &v->bins;
+    for (u32 i = begin; i < end; ++i)
+    {
+        const u32 brick = bins->activeBricks[i];
+        u32 brickMin[3], brickMax[3];
+        GetBrickBounds(bins, brick, brickMin, brickMax);
+
+        for (u32 t = bins->brickOffsets[brick]; t < bins->brickOffsets[brick + 1]; ++t)
+        {
+            const VoxelTriangle* tri = &bins->triangles[bins->brickTriangles[t]];
+            WriteOpacity write;
+            write.texels = v->grid->texels;
+            write.gridSize = v->grid->gridSize;
+            write.faces[0] = VoxelFace::PosX + (tri->faceOffsets & 1);
+            write.faces[1] = VoxelFace::PosY + ((tri->faceOffsets >> 1) & 1);
+            write.faces[2] = VoxelFace::PosZ + ((tri->faceOffsets >> 2) & 1);
+            write.value = tri->value;
+            RasterizeTriangle(tri, brickMin, brickMax, &write);
+        }
+    }
+}
+
+// WriteOpacity for toroidally addressed grids, voxels are stored at (voxel + wrap) % gridSize
+struct WriteWrappedOpacity
+{
+    u8* texels;
+    uint3_t gridSize;
+    u32 wrap[3];
+    u32 faces[3];
+    u8 value;
+
+    void operator()(const u32* voxel, f32, f32)
+    {
+        const u32 size[3] = { gridSize.w, gridSize.h, gridSize.d };
+        u32 stored[3];
+        for (u32 a = 0; a < 3; ++a)
+        {
+            stored[a] = voxel[a] + wrap[a];
+            stored[a] -= stored[a] >= size[a] ? size[a] : 0;
+        }
+        for (u32 f = 0; f < 3; ++f)
+        {
+            u8* texel = &texels[CpuVoxel_TexelIndex(gridSize, stored[0], stored[1], stored[2], faces[f])];
+            *texel = MAX(*texel, value);
+        }
+    }
+};
+
+// the bricks were binned for the region only, its part of each one is clipped to it
+static void RasterizeOpacityRegion(void* userData, u32 begin, u32 end)
+{
+    OpacityVoxelizer* v = (OpacityVoxelizer*)userData;
+    const VoxelBins* bins = &v->bins;
+    const CpuVoxelRegion* region = v->region;
+    for (u32 i = begin; i < end; ++i)
+    {
+        const u32 brick = bins->activeBricks[i];
+        u32 brickMin[3], brickMax[3];
+        GetBrickBounds(bins, brick, brickMin, brickMax);
+        for (u32 a = 0; a < 3; ++a)
+        {
+            brickMin[a] = MAX(brickMin[a], (u32)region->min[a]);
+            brickMax[a] = MIN(brickMax[a], (u32)region->max[a]);
+        }
+
+        for (u32 t = bins->brickOffsets[brick]; t < bins->brickOffsets[brick + 1]; ++t)
+        {
+            const VoxelTriangle* tri = &bins->triangles[bins->brickTriangles[t]];
+            WriteWrappedOpacity write;
+            write.texels = v->grid->texels;
+            write.gridSize = v->grid->gridSize;
+            write.wrap[0] = v->wrap[0];
+            write.wrap[1] = v->wrap[1];
+            write.wrap[2] = v->wrap[2];
+            write.faces[0] = VoxelFace::PosX + (tri->faceOffsets & 1);
+            write.faces[1] = VoxelFace::PosY + ((tri->faceOffsets >> 1) & 1);
+            write.faces[2] = VoxelFace::PosZ + ((tri->faceOffsets >> 2) & 1);
+            write.value = tri->value;
+            RasterizeTriangle(tri, brickMin, brickMax, bins->origin, &write);
+        }
+    }
+}
+
+// zeroes the region's texels, a row can wrap around into 2 runs
+static void ClearOpacityRegion(const OpacityVoxelizer* v)
+{
+    const CpuOpacityGrid* grid = v->grid;
+    const CpuVoxelRegion* region = v->region;
+    const uint3_t size = grid->gridSize;
+    const u32 width = (u32)(region->max[0] - region->min[0]);
+    const u32 x = ((u32)region->min[0] + v->wrap[0]) % size.w;
+    const u32 firstRun = MIN(width, size.w - x);
+    for (s32 rz = region->min[2]; rz < region->max[2]; ++rz)
+    {
+        const u32 z = ((u32)rz + v->wrap[2]) % size.d;
+        for (s32 ry = region->min[1]; ry < region->max[1]; ++ry)
+        {
+            const u32 y = ((u32)ry + v->wrap[1]) % size.h;
+            for (u32 face = 0; face < VoxelFace::Count; ++face)
+            {
+                memset(&grid->texels[CpuVoxel_TexelIndex(size, x, y, z, face)], 0, firstRun);
+                if (firstRun < width)
+                {
+                    memset(&grid->texels[CpuVoxel_TexelIndex(size, 0, y, z, face)], 0, width - firstRun);
+                }
+            }
+        }
+    }
+}
+
+static void ClearOpacitySlices(void* userData, u32 begin, u32 end)
+{
+    CpuOpacityGrid* grid = (CpuOpacityGrid*)userData;
+    ClearGridSlices(grid->texels, sizeof(u8), grid->gridSize, begin, end);
+}
+
+static void ClearOpacityBricks(void* userData, u32 begin, u32 end)
+{
+    const OpacityVoxelizer* v = (const OpacityVoxelizer*)userData;
+    for (u32 i = begin; i < end; ++i)
+    {
+        u32 brickMin[3], brickMax[3];
+        GetBrickBounds(&v->bins, v->dirtyBricks[i], brickMin, brickMax);
+        ClearGridBrick(v->grid->texels, sizeof(u8), v->grid->gridSize, brickMin, brickMax);
+    }
+}
+
+void CpuVoxel_AllocateOpacityGrid(CpuOpacityGrid* grid, MemoryArena* arena, uint3_t gridSize)
+{
+    grid->gridSize = gridSize;
+    grid->texels = (u8*)PushSize(arena, CpuVoxel_NumTexels(gridSize));
+}
+
+void CpuVoxel_VoxelizeOpacity(CpuOpacityGrid* grid, const CpuVoxelGeometry* geometry, bool conservative, MemoryArena* scratch, CpuVoxelStats* stats)
+{
+    OpacityVoxelizer v;
+    v.grid = grid;
+    BinTriangles(&v.bins, geometry, grid->gridSize, conservative, scratch);
+
+    Job_ParallelFor(grid->gridSize.d, &ClearOpacitySlices, grid, 1);
+    // bricks vary a lot in cost, small ranges keep the threads busy
+    Job_ParallelFor(v.bins.numActiveBricks, &RasterizeOpacityBricks, &v, 1);
+
+    if (stats != NULL)
+    {
+        stats->numTriangles = v.bins.numTriangles;
+        stats->numBrickTriangles = v.bins.brickOffsets[v.bins.numBricks.w * v.bins.numBricks.h * v.bins.numBricks.d];
+        stats->numBricks = v.bins.numActiveBricks;
+    }
+}
+
+void CpuVoxel_VoxelizeOpacityRegions(CpuOpacityGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelRegion* regions, u32 numRegions, const s32* origin, f32 voxelSize, bool conservative, MemoryArena* scratch)
+{
+    OpacityVoxelizer v;
+    v.grid = grid;
+    const s32 size[3] = { (s32)grid->gridSize.w, (s32)grid->gridSize.h, (s32)grid->gridSize.d };
+    for (u32 a = 0; a < 3; ++a)
+    {
+        v.wrap[a] = origin != NULL ? (u32)(((origin[a] % size[a]) + size[a]) % size[a]) : 0;
+    }
+
+    // binning only the triangles near a region is what makes thin regions cheap
+    const size_t scratchUsed = scratch->mem_used;
+    for (u32 r = 0; r < numRegions; ++r)
+    {
+        v.region = &regions[r];
+        const u32 regionMin[3] = { (u32)regions[r].min[0], (u32)regions[r].min[1], (u32)regions[r].min[2] };
+        const u32 regionMax[3] = { (u32)regions[r].max[0], (u32)regions[r].max[1], (u32)regions[r].max[2] };
+        BinTrianglesInWorldBounds(&v.bins, geometry, grid->gridSize, origin, voxelSize, regionMin, regionMax, conservative, scratch);
+
+        ClearOpacityRegion(&v);
+        Job_ParallelFor(v.bins.numActiveBricks, &RasterizeOpacityRegion, &v, 1);
+        scratch->mem_used = scratchUsed;
+    }
+}
+
+void CpuVoxel_VoxelizeOpacityBricks(CpuOpacityGrid* grid, const CpuVoxelGeometry* geometry, const CpuVoxelDirtyBricks* dirty, bool conservative, MemoryArena* scratch)
+{
+    assert(dirty->gridSize.w == grid->gridSize.w && dirty->gridSize.h == grid->gridSize.h && dirty->gridSize.d == grid->gridSize.d);
+
+    u32 boundsMin[3], boundsMax[3];
+    if (!GetDirtyBounds(dirty, boundsMin, boundsMax))
+    {
+        return;
+    }
+
+    // the triangles are binned to the box around the dirty bricks and the clean ones are dropped
+    OpacityVoxelizer v;
+    v.grid = grid;
+    BinTrianglesInBounds(&v.bins, geometry, grid->gridSize, boundsMin, boundsMax, conservative, scratch);
+    KeepDirtyBricks(&v.bins, dirty);
+    u32* dirtyBricks = PushArray(scratch, v.bins.numBricks.w * v.bins.numBricks.h * v.bins.numBricks.d, u32);
+    const u32 numDirtyBricks = GetDirtyBrickList(dirty, dirtyBricks);
+    v.dirtyBricks = dirtyBricks;
+
+    Job_ParallelFor(numDirtyBricks, &ClearOpacityBricks, &v, 0);
+    Job_ParallelFor(v.bins.numActiveBricks, &RasterizeOpacityBricks, &v, 1);
+}
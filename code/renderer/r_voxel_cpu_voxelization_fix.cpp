@@ -0,0 +1,421 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "r_voxel_cpu_private.h"
+#include "../common/job_system.h"
+
+// the threads of one dispatch in VoxelizationFix_Run, 8x8 groups
+#define FIX_GROUP_SIZE 8
+
+// the lines of one axis that share a coordinate: at every step along the axis
+// the lines are read side by side, 4 per vec4
+struct LinePlane
+{
+    u16* texels; // the + face of the first line's first voxel
+    size_t faceOffset; // from the + face to the - face, in texels
+    size_t lineStride;
+    size_t stepStride;
+    u32 numLines;
+    u32 length;
+};
+
+struct VoxelizationFix
+{
+    CpuEmittanceGrid* grid;
+    u32 maxGapDistance;
+    u32 numPlanes[3];
+    u32 numLines[3];
+
+    // for FixDirtyPlanes, the bricks of lines and planes are indexed like the bricks of the grid
+    const CpuEmittanceGrid* raw;
+    const u32* dirtyBricks; // for CopyDirtyBricks
+    uint3_t numBricks;
+    u32 numPlaneBricks[3];
+    u8* dirtyLines[3]; // per brick of lines and brick of planes, set when a brick along them is dirty
+    u8* changed[3]; // per brick of the grid, set when the axis changed one of its texels
+};
+
+// the voxel axes of the lines of an axis and of its planes, see GetPlane
+static const u32 lineAxes[3] = { 1, 0, 0 };
+static const u32 planeAxes[3] = { 2, 2, 1 };
+
+// float4(0.0, 0.0, 0.0, 1.0)
+static const u16 filledTexel[4] = { 0, 0, 0, 0x3C00 };
+
+static u32 RoundUpToGroups(u32 x)
+{
+    return (x + FIX_GROUP_SIZE - 1) / FIX_GROUP_SIZE * FIX_GROUP_SIZE;
+}
+
+static void GetPlane(const VoxelizationFix* f, u32 axis, u32 plane, LinePlane* p)
+{
+    const uint3_t gridSize = f->grid->gridSize;
+    const size_t rowStride = (size_t)gridSize.w * VoxelFace::Count;
+    p->faceOffset = gridSize.w;
+    p->numLines = f->numLines[axis];
+    if (axis == 0)
+    {
+        p->texels = f->grid->texels + CpuVoxel_TexelIndex(gridSize, 0, 0, plane, VoxelFace::PosX) * 4;
+        p->lineStride = rowStride;
+        p->stepStride = 1;
+        p->length = gridSize.w;
+    }
+    else if (axis == 1)
+    {
+        p->texels = f->grid->texels + CpuVoxel_TexelIndex(gridSize, 0, 0, plane, VoxelFace::PosY) * 4;
+        p->lineStride = 1;
+        p->stepStride = rowStride;
+        p->length = gridSize.h;
+    }
+    else
+    {
+        p->texels = f->grid->texels + CpuVoxel_TexelIndex(gridSize, 0, plane, 0, VoxelFace::PosZ) * 4;
+        p->lineStride = 1;
+        p->stepStride = rowStride * gridSize.h;
+        p->length = gridSize.d;
+    }
+}
+
+static void FillGap(const LinePlane* p, u32 line, u32 start, u32 end)
+{
+    u16* texels = p->texels + line * p->lineStride * 4;
+    for (u32 i = start + 1; i < end; ++i)
+    {
+        u16* texel = texels + i * p->stepStride * 4;
+        memcpy(texel, filledTexel, sizeof(filledTexel));
+        memcpy(texel + p->faceOffset * 4, filledTexel, sizeof(filledTexel));
+    }
+    memcpy(texels + (start * p->stepStride + p->faceOffset) * 4, filledTexel, sizeof(filledTexel));
+    memcpy(texels + end * p->stepStride * 4, filledTexel, sizeof(filledTexel));
+}
+
+// The shader's loop for 4 lines at a time, with the lines' states as lane bits.
+// A gap only writes to voxels the scan has passed, so the lines' alphas are read as we go.
+static void ScanPlane(const LinePlane* p, u32 maxGapDistance)
+{
+    ScratchMemory scratch;
+    const u32 numBatches = (p->numLines + 3) / 4;
+    f32* starts = PushArray(scratch.arena, numBatches * 4, f32);
+    u32* filling = PushArray(scratch.arena, numBatches, u32);
+    memset(starts, 0, numBatches * 4 * sizeof(f32));
+    memset(filling, 0, numBatches * sizeof(u32));
+
+    const vec4 zero = Vec4Zero();
+    const vec4 maxDistance = Vec4Splat((f32)maxGapDistance);
+    for (u32 i = 0; i < p->length; ++i)
+    {
+        const u16* step = p->texels + i * p->stepStride * 4;
+        const vec4 position = Vec4Splat((f32)i);
+        for (u32 b = 0; b < numBatches; ++b)
+        {
+            // the missing lines of the last batch are empty and never start a gap
+            u16 alphaPos[4] = { 0, 0, 0, 0 };
+            u16 alphaNeg[4] = { 0, 0, 0, 0 };
+            const u32 numLanes = MIN(p->numLines - b * 4, 4);
+            for (u32 l = 0; l < numLanes; ++l)
+            {
+                const u16* texel = step + (b * 4 + l) * p->lineStride * 4;
+                alphaPos[l] = texel[3];
+                alphaNeg[l] = texel[p->faceOffset * 4 + 3];
+            }
+
+            // a > 0.0 and a == 0.0 like the shader, NaNs are neither
+            const vec4 pos = LoadHalf4(alphaPos);
+            const vec4 neg = LoadHalf4(alphaNeg);
+            const u32 posSet = LessMask(zero, pos);
+            const u32 negSet = LessMask(zero, neg);
+            const u32 posEmpty = LessEqualMask(pos, zero) & ~LessMask(pos, zero);
+            const u32 negEmpty = LessEqualMask(neg, zero) & ~LessMask(neg, zero);
+
+            f32* batchStarts = starts + b * 4;
+            const u32 wasFilling = filling[b];
+            const u32 expired = wasFilling & LessMask(maxDistance, position - LoadVec4(batchStarts));
+            const u32 closed = wasFilling & ~expired & negSet & posEmpty;
+            const u32 opened = ~wasFilling & posSet & negEmpty;
+            filling[b] = (wasFilling & ~expired & ~closed) | opened;
+
+            for (u32 l = 0; l < numLanes; ++l)
+            {
+                if (opened & (1 << l))
+                {
+                    batchStarts[l] = (f32)i;
+                }
+                else if (closed & (1 << l))
+                {
+                    FillGap(p, b * 4 + l, (u32)batchStarts[l], i);
+                }
+            }
+        }
+    }
+}
+
+static void FixPlanes(void* userData, u32 begin, u32 end)
+{
+    const VoxelizationFix* f = (const VoxelizationFix*)userData;
+    for (u32 t = begin; t < end; ++t)
+    {
+        u32 axis = 0;
+        u32 plane = t;
+        while (plane >= f->numPlanes[axis])
+        {
+            plane -= f->numPlanes[axis];
+            ++axis;
+        }
+
+        LinePlane p;
+        GetPlane(f, axis, plane, &p);
+        ScanPlane(&p, f->maxGapDistance);
+    }
+}
+
+static void SetupFix(VoxelizationFix* f, CpuEmittanceGrid* grid, u32 maxGapDistance)
+{
+    // the lines the dispatches cover: the thread ids go up to the width and height rounded up
+    // to whole groups whatever the axis, the lines past the grid's edges read and write nothing
+    const uint3_t gridSize = grid->gridSize;
+    const u32 maxIdX = RoundUpToGroups(gridSize.w);
+    const u32 maxIdY = RoundUpToGroups(gridSize.h);
+
+    f->grid = grid;
+    f->maxGapDistance = maxGapDistance;
+    f->numLines[0] = MIN(maxIdX, gridSize.h);
+    f->numPlanes[0] = MIN(maxIdY, gridSize.d);
+    f->numLines[1] = gridSize.w;
+    f->numPlanes[1] = MIN(maxIdY, gridSize.d);
+    f->numLines[2] = gridSize.w;
+    f->numPlanes[2] = gridSize.h;
+}
+
+// the dirty bricks of the grid are the raw ones, whatever lines the dispatches skip
+static void CopyDirtyBricks(void* userData, u32 begin, u32 end)
+{
+    const VoxelizationFix* f = (const VoxelizationFix*)userData;
+    const uint3_t gridSize = f->grid->gridSize;
+    for (u32 i = begin; i < end; ++i)
+    {
+        const u32 brick = f->dirtyBricks[i];
+        const u32 coords[3] = { brick % f->numBricks.w, (brick / f->numBricks.w) % f->numBricks.h, brick / (f->numBricks.w * f->numBricks.h) };
+        const u32 gridMax[3] = { gridSize.w, gridSize.h, gridSize.d };
+        u32 brickMin[3], brickMax[3];
+        for (u32 a = 0; a < 3; ++a)
+        {
+            brickMin[a] = coords[a] * CPU_VOXEL_BRICK_SIZE;
+            brickMax[a] = MIN(brickMin[a] + CPU_VOXEL_BRICK_SIZE, gridMax[a]);
+        }
+
+        const u32 width = brickMax[0] - brickMin[0];
+        for (u32 z = brickMin[2]; z < brickMax[2]; ++z)
+        {
+            for (u32 y = brickMin[1]; y < brickMax[1]; ++y)
+            {
+                for (u32 face = 0; face < VoxelFace::Count; ++face)
+                {
+                    const size_t row = CpuVoxel_TexelIndex(gridSize, brickMin[0], y, z, face);
+                    memcpy(f->grid->texels + row * 4, f->raw->texels + row * 4, width * 4 * sizeof(u16));
+                    if (f->grid->normals != NULL && f->raw->normals != NULL)
+                    {
+                        memcpy(f->grid->normals + row, f->raw->normals + row, width * sizeof(u32));
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void MarkChanged(const VoxelizationFix* f, u32 axis, u32 line, u32 plane, u32 step)
+{
+    u32 voxel[3];
+    voxel[axis] = step;
+    voxel[lineAxes[axis]] = line;
+    voxel[planeAxes[axis]] = plane;
+    const u32 brick = ((voxel[2] / CPU_VOXEL_BRICK_SIZE) * f->numBricks.h + voxel[1] / CPU_VOXEL_BRICK_SIZE) * f->numBricks.w + voxel[0] / CPU_VOXEL_BRICK_SIZE;
+    f->changed[axis][brick] = 1;
+}
+
+// Lines [firstLine; firstLine + p->numLines[ of a plane are copied from raw and scanned again.
+// Their old texels are kept to find the bricks that changed.
+static void FixDirtyLines(const VoxelizationFix* f, u32 axis, u32 plane, const LinePlane* p, u32 firstLine)
+{
+    ScratchMemory scratch;
+    const size_t numTexels = (size_t)p->numLines * p->length * 2;
+    u16* old = PushArray(scratch.arena, numTexels * 4, u16);
+    const size_t rawOffset = f->raw->texels - f->grid->texels;
+
+    u16* saved = old;
+    for (u32 l = 0; l < p->numLines; ++l)
+    {
+        for (u32 i = 0; i < p->length; ++i)
+        {
+            u16* texel = p->texels + (l * p->lineStride + i * p->stepStride) * 4;
+            for (u32 face = 0; face < 2; ++face)
+            {
+                u16* faceTexel = texel + face * p->faceOffset * 4;
+                memcpy(saved, faceTexel, 4 * sizeof(u16));
+                memcpy(faceTexel, faceTexel + rawOffset, 4 * sizeof(u16));
+                saved += 4;
+            }
+        }
+    }
+
+    ScanPlane(p, f->maxGapDistance);
+
+    saved = old;
+    for (u32 l = 0; l < p->numLines; ++l)
+    {
+        for (u32 i = 0; i < p->length; ++i)
+        {
+            const u16* texel = p->texels + (l * p->lineStride + i * p->stepStride) * 4;
+            if (memcmp(saved, texel, 4 * sizeof(u16)) != 0 || memcmp(saved + 4, texel + p->faceOffset * 4, 4 * sizeof(u16)) != 0)
+            {
+                MarkChanged(f, axis, firstLine + l, plane, i);
+            }
+            saved += 8;
+        }
+    }
+}
+
+// one brick of planes of an axis at a time, so the threads mark different bricks
+static void FixDirtyPlanes(void* userData, u32 begin, u32 end)
+{
+    const VoxelizationFix* f = (const VoxelizationFix*)userData;
+    const u32 numLineBricks[3] = { f->numBricks.h, f->numBricks.w, f->numBricks.w };
+    for (u32 t = begin; t < end; ++t)
+    {
+        u32 axis = 0;
+        u32 planeBrick = t;
+        while (planeBrick >= f->numPlaneBricks[axis])
+        {
+            planeBrick -= f->numPlaneBricks[axis];
+            ++axis;
+        }
+
+        const u8* dirtyLines = f->dirtyLines[axis] + planeBrick * numLineBricks[axis];
+        const u32 lastPlane = MIN((planeBrick + 1) * CPU_VOXEL_BRICK_SIZE, f->numPlanes[axis]);
+        for (u32 plane = planeBrick * CPU_VOXEL_BRICK_SIZE; plane < lastPlane; ++plane)
+        {
+            LinePlane p;
+            GetPlane(f, axis, plane, &p);
+
+            // the runs of dirty bricks of lines
+            for (u32 b = 0; b < numLineBricks[axis]; ++b)
+            {
+                if (!dirtyLines[b])
+                {
+                    continue;
+                }
+
+                u32 last = b;
+                while (last + 1 < numLineBricks[axis] && dirtyLines[last + 1])
+                {
+                    ++last;
+                }
+
+                const u32 firstLine = b * CPU_VOXEL_BRICK_SIZE;
+                const u32 endLine = MIN((last + 1) * CPU_VOXEL_BRICK_SIZE, f->numLines[axis]);
+                if (firstLine < endLine)
+                {
+                    LinePlane lines = p;
+                    lines.texels += firstLine * p.lineStride * 4;
+                    lines.numLines = endLine - firstLine;
+                    FixDirtyLines(f, axis, plane, &lines, firstLine);
+                }
+                b = last;
+            }
+        }
+    }
+}
+
+void CpuVoxel_FixVoxelization(CpuEmittanceGrid* grid, u32 maxGapDistance)
+{
+    VoxelizationFix f;
+    SetupFix(&f, grid, maxGapDistance);
+
+    // every axis reads and writes its own 2 faces, so the 3 dispatches can run at the same time
+    Job_ParallelFor(f.numPlanes[0] + f.numPlanes[1] + f.numPlanes[2], &FixPlanes, &f, 1);
+}
+
+void CpuVoxel_FixVoxelizationBricks(CpuEmittanceGrid* grid, const CpuEmittanceGrid* raw, u32 maxGapDistance, const CpuVoxelDirtyBricks* dirty, CpuVoxelDirtyBricks* changed)
+{
+    const uint3_t gridSize = grid->gridSize;
+    assert(raw->gridSize.w == gridSize.w && raw->gridSize.h == gridSize.h && raw->gridSize.d == gridSize.d);
+    assert(dirty->gridSize.w == gridSize.w && dirty->gridSize.h == gridSize.h && dirty->gridSize.d == gridSize.d);
+    assert(changed->gridSize.w == gridSize.w && changed->gridSize.h == gridSize.h && changed->gridSize.d == gridSize.d);
+    assert(grid->texels != raw->texels);
+
+    ScratchMemory scratch;
+    VoxelizationFix f;
+    SetupFix(&f, grid, maxGapDistance);
+    f.raw = raw;
+    f.numBricks = dirty->numBricks;
+    const u32 numBricks[3] = { f.numBricks.w, f.numBricks.h, f.numBricks.d };
+    const u32 totalBricks = numBricks[0] * numBricks[1] * numBricks[2];
+
+    u32* dirtyBricks = PushArray(scratch.arena, totalBricks, u32);
+    const u32 numDirtyBricks = GetDirtyBrickList(dirty, dirtyBricks);
+    if (numDirtyBricks == 0)
+    {
+        return;
+    }
+    f.dirtyBricks = dirtyBricks;
+
+    // the dirty bricks projected along each axis
+    u32 numTasks = 0;
+    for (u32 axis = 0; axis < 3; ++axis)
+    {
+        const u32 lineAxis = lineAxes[axis];
+        const u32 planeAxis = planeAxes[axis];
+        f.dirtyLines[axis] = PushArray(scratch.arena, numBricks[lineAxis] * numBricks[planeAxis], u8);
+        f.changed[axis] = PushArray(scratch.arena, totalBricks, u8);
+        memset(f.dirtyLines[axis], 0, numBricks[lineAxis] * numBricks[planeAxis]);
+        memset(f.changed[axis], 0, totalBricks);
+        for (u32 i = 0; i < numDirtyBricks; ++i)
+        {
+            const u32 brick = dirtyBricks[i];
+            const u32 coords[3] = { brick % numBricks[0], (brick / numBricks[0]) % numBricks[1], brick / (numBricks[0] * numBricks[1]) };
+            f.dirtyLines[axis][coords[planeAxis] * numBricks[lineAxis] + coords[lineAxis]] = 1;
+        }
+
+        f.numPlaneBricks[axis] = (f.numPlanes[axis] + CPU_VOXEL_BRICK_SIZE - 1) / CPU_VOXEL_BRICK_SIZE;
+        numTasks += f.numPlaneBricks[axis];
+    }
+
+    Job_ParallelFor(numDirtyBricks, &CopyDirtyBricks, &f, 0);
+    // the axes read and write their own 2 faces like in CpuVoxel_FixVoxelization
+    Job_ParallelFor(numTasks, &FixDirtyPlanes, &f, 1);
+
+    for (u32 b = 0; b < totalBricks; ++b)
+    {
+        changed->bricks[b] |= dirty->bricks[b] | f.changed[0][b] | f.changed[1][b] | f.changed[2][b];
+    }
+}
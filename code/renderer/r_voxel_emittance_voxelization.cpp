@@ -174,7 +174,7 @@ void VoxelizeEmittance_Draw(RenderCommandQueue* cmdQueue, DrawBuffer* drawBuffer
         psData.cst_flags = material->flags;
         SetShaderData(p->ps.buffers[0], psData);
  
-        p->ps.srvs[0] = assetsShared.textureViews[material->textureIndex[TextureId::Albedo]];
+        p->ps.srvs[0] = GetMaterialTextureView(material, TextureId::Albedo);
         p->ps.srvs[1] = shadowShared.srvs;
         p->ps.numSRVs = 2;
 
@@ -33,6 +33,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "../renderer/r_public.h"
+#include "../common/asset_pack.h"
 #include "s_private.h"
 
 Image defaultTextures[TextureId::Count];
@@ -78,35 +79,74 @@ static void AllocateDefaultTextures()
     }
 }
 
+// Copies the next size bytes of the asset to output.
+static void ReadAssetBytes(void* output, u64 size, const AssetFile* file, u64* offset, const char* path)
+{
+    if (size > file->size - *offset)
+        Sys_FatalError("%s is truncated.", path);
+
+    memcpy(output, (const u8*)file->data + *offset, size);
+    *offset += size;
+}
+
+// offset 0 means no string
+static const char* InternMaterialString(const char* strings, u32 numStringBytes, u32 offset, const char* path)
+{
+    if (offset == 0)
+        return NULL;
+
+    if (offset >= numStringBytes)
+        Sys_FatalError("%s has an invalid string offset.", path);
+
+    return Intern(strings + offset);
+}
+
 static void ReadBinaryMaterialFromFile(Scene* mesh, const char* filePath)
 {
-    FILE* file = fopen(filePath, "rb");
-    if (!file)
-        Sys_FatalError("Couldn't read binary file.");
+    AssetFile file;
+    if (!Asset_Open(&file, filePath))
+        Sys_FatalError("Couldn't read binary file %s.", filePath);
 
-    fseek(file, 0, SEEK_SET);
+    u64 offset = 0;
     MaterialFileHeader header;
-    fread(&header, sizeof(header), 1, file);
+    ReadAssetBytes(&header, sizeof(header), &file, &offset, filePath);
+    if (header.magic != MATERIAL_FILE_MAGIC || header.version != MATERIAL_FILE_VERSION)
+        Sys_FatalError("%s is outdated, re-run MeshBaker.", filePath);
 
     mesh->fileMaterials.Reserve(header.numMaterials);
-    AllocateArena(&mesh->strings, header.numStringBytes + 1, malloc(header.numStringBytes + 1), "string arena");
+    ReadAssetBytes(mesh->fileMaterials.GetStart(), sizeof(MeshFileMaterial) * header.numMaterials, &file, &offset, filePath);
+
+    // the strings are interned, the offsets in fileMaterials are only used again when saving
+    if (header.numStringBytes > file.size - offset)
+        Sys_FatalError("%s is truncated.", filePath);
+    const char* strings = (const char*)file.data + offset;
+    if (header.numStringBytes > 0 && strings[header.numStringBytes - 1] != '\0')
+        Sys_FatalError("%s has an unterminated string table.", filePath);
 
-    fread(mesh->fileMaterials.GetStart(), sizeof(MeshFileMaterial) * header.numMaterials, 1, file);
-    fread(PushSize(&mesh->strings, header.numStringBytes), header.numStringBytes, 1, file);
+    mesh->materialNames.Reserve(header.numMaterials);
+    for (u32 m = 0; m < header.numMaterials; ++m)
+    {
+        const MeshFileMaterial* material = &mesh->fileMaterials[m];
+        SceneMaterialNames* names = &mesh->materialNames[m];
+        memset(names, 0, sizeof(*names));
+        names->name = InternMaterialString(strings, header.numStringBytes, material->materialOffset, filePath);
+        names->textures[TextureId::Albedo] = InternMaterialString(strings, header.numStringBytes, material->albedoOffset, filePath);
+        names->textures[TextureId::Bump] = InternMaterialString(strings, header.numStringBytes, material->normalOffset, filePath);
+        names->textures[TextureId::Specular] = InternMaterialString(strings, header.numStringBytes, material->specularOffset, filePath);
+    }
 
-    fclose(file);
+    Asset_Close(&file);
 }
 
 static void ReadBinaryMeshFromFile(Scene* mesh, const char* filePath)
 {
-    FILE* file = fopen(filePath, "rb");
-    if (!file)
-        Sys_FatalError("Couldn't read binary file.");
+    AssetFile file;
+    if (!Asset_Open(&file, filePath))
+        Sys_FatalError("Couldn't read binary file %s.", filePath);
 
-    fseek(file, 0, SEEK_SET);
+    u64 offset = 0;
     MeshFileHeader header;
-
-    fread(&header, sizeof(header), 1, file);
+    ReadAssetBytes(&header, sizeof(header), &file, &offset, filePath);
 
     mesh->aabb.min = header.aabbMin;
     mesh->aabb.max = header.aabbMax;
@@ -117,67 +157,44 @@ static void ReadBinaryMeshFromFile(Scene* mesh, const char* filePath)
     mesh->indexes.Reserve(header.numIndexes);
     mesh->meshes.Reserve(header.numMeshes);
 
-    fread(mesh->xyz.GetStart(), sizeof(vec3_t) * header.numVertexes, 1, file);
-    fread(mesh->normal.GetStart(), sizeof(vec3_t) * header.numVertexes, 1, file);
-    fread(mesh->tc.GetStart(), sizeof(vec2_t) * header.numVertexes, 1, file);
-    fread(mesh->indexes.GetStart(), sizeof(u32) * header.numIndexes, 1, file);
-    fread(mesh->meshes.GetStart(), sizeof(MeshFileMesh) * header.numMeshes, 1, file);
+    ReadAssetBytes(mesh->xyz.GetStart(), sizeof(vec3_t) * header.numVertexes, &file, &offset, filePath);
+    ReadAssetBytes(mesh->normal.GetStart(), sizeof(vec3_t) * header.numVertexes, &file, &offset, filePath);
+    ReadAssetBytes(mesh->tc.GetStart(), sizeof(vec2_t) * header.numVertexes, &file, &offset, filePath);
+    ReadAssetBytes(mesh->indexes.GetStart(), sizeof(u32) * header.numIndexes, &file, &offset, filePath);
+    ReadAssetBytes(mesh->meshes.GetStart(), sizeof(MeshFileMesh) * header.numMeshes, &file, &offset, filePath);
 
-    fclose(file);
-
-    return;
+    Asset_Close(&file);
 }
 
 SceneAssets* AllocateEditorAssets(MemoryArena* arena, SceneTransientState* tranState, size_t size)
 {
     SceneAssets* result = PushStruct(arena, SceneAssets);
     SubArena(&result->arena, arena, size, "Asset Arena");
+    TrackArena(&result->arena);
 
-    const char* fullPath = "../bachelor/assets/Sponza";
-
-    u32 numFiles = 0;
-    FolderScan* fs = Sys_FolderScan_Begin(fullPath, "*.scene");
-    while (Sys_FolderScan_Next(NULL, NULL, fs))
-    {
-        numFiles++;
-    }
-    Sys_FolderScan_End(fs);
-
-    result->numMeshes = numFiles;
+    // paths are relative to ASSET_DIR so that they resolve the same way with and without an asset pack
+    char scenePaths[MAX_LOAD_FILES][MAX_PATH];
+    result->numMeshes = Asset_FindFiles(scenePaths, MAX_LOAD_FILES, "Sponza", ".scene");
     result->meshes = PushArray(&result->arena, result->numMeshes, Scene);
 
 #if 1
     AllocateDefaultTextures();
 #endif
 
-    fs = Sys_FolderScan_Begin(fullPath, "*.scene");
     for (u32 fileIndex = 0; fileIndex < result->numMeshes; ++fileIndex)
     {
-        const char* fileName;
-        const char* filePath;
-        if (!Sys_FolderScan_Next(&fileName, &filePath, fs))
-        {
-            Sys_FatalError("AllocateEditorAssets: Sys_FolderScan_Next failed");
-        }
-
         Scene* scene = result->meshes + fileIndex;
-
-        ReadBinaryMeshFromFile(scene, filePath);
-
-        scene->meshId = 1 << fileIndex;
-        strcpy(scene->name, fileName);
         char filePathNX[MAX_PATH];
-        strcpy(filePathNX, filePath);
+        strcpy(filePathNX, scenePaths[fileIndex]);
         StripFileExtension(filePathNX);
-        
-        ReadBinaryMeshFromFile(scene, filePath);
+
+        ReadBinaryMeshFromFile(scene, scenePaths[fileIndex]);
         ReadBinaryMaterialFromFile(scene, fmt("%s.material", filePathNX));
 
         scene->meshId = 1 << fileIndex;
         strcpy(scene->name, filePathNX);
         scene->valid = true;
     }
-    Sys_FolderScan_End(fs);
 
     Scene* m = &result->meshes[0];
     Light e = {};
@@ -198,7 +215,7 @@ SceneAssets* AllocateEditorAssets(MemoryArena* arena, SceneTransientState* tranS
     e.dir.z = cos(TO_RADIANS(e.inclination));
     e.umbraAngle = TO_DEGREES(1.334f);
     e.penumbraAngle = TO_DEGREES(0.175f);
-    result->lights.Push(e);
+    *result->lights.Get(result->lights.Alloc()) = e;
 
     e.position.x = -500.0f;
     e.position.y = 720;
@@ -209,7 +226,7 @@ SceneAssets* AllocateEditorAssets(MemoryArena* arena, SceneTransientState* tranS
     e.dir.x = cos(TO_RADIANS(e.azimuth)) * sin(TO_RADIANS(e.inclination));
     e.dir.y = sin(TO_RADIANS(e.azimuth)) * sin(TO_RADIANS(e.inclination));
     e.dir.z = cos(TO_RADIANS(e.inclination));
-    result->lights.Push(e);
+    *result->lights.Get(result->lights.Alloc()) = e;
 
     return result;
 }
@@ -75,12 +75,16 @@ void UpdateCamera(Scene* mesh, RenderCommandQueue* cmdQueue, CameraState* cam)
     cmdQueue->ab.u = cmdQueue->projectionMatrix.E[2][2];
     cmdQueue->ab.v = cmdQueue->projectionMatrix.E[2][3];
 
+    const mat4 view = LoadMat4(&viewMatrix);
+    const mat4 projection = LoadMat4(&cmdQueue->projectionMatrix);
+    const mat4 viewProjection = projection * view;
+
     cmdQueue->viewVector = norm(cam->at - cam->eye);
     cmdQueue->cameraPosition = cam->eye;
-    cmdQueue->invViewMatrix = Invert(&viewMatrix);
-    cmdQueue->modelViewMatrix = Identity() * viewMatrix;
-    cmdQueue->invProjectionMatrix = Invert(&cmdQueue->projectionMatrix);
-    cmdQueue->invViewProjectionMatrix = Invert(&(cmdQueue->projectionMatrix * cmdQueue->modelViewMatrix));
+    cmdQueue->invViewMatrix = StoreMat4(InvertAffine(&view));
+    cmdQueue->modelViewMatrix = viewMatrix;
+    cmdQueue->invProjectionMatrix = StoreMat4(Invert(&projection));
+    cmdQueue->invViewProjectionMatrix = StoreMat4(Invert(&viewProjection));
 }
 
 static MemoryPools sceneMemory;
@@ -91,6 +95,8 @@ void S_Init(MemoryPools* memory)
 {
     SubArena(&sceneMemory.persistent, &memory->persistent, Megabytes(20), "persistent scene arena");
     SubArena(&sceneMemory.transient, &memory->transient, Megabytes(30), "transient scene arena");
+    TrackArena(&sceneMemory.persistent);
+    TrackArena(&sceneMemory.transient);
 
     sceneState = PushStruct(&sceneMemory.persistent, ScenePersistentState);
     tranState = PushStruct(&sceneMemory.persistent, SceneTransientState);
@@ -163,10 +169,10 @@ void S_Update(ClientInput* input, RenderCommandQueue* cmdQueue)
 
     // Lights
     R_PushBeginDebugRegion(cmdQueue, L"Debug");
-    for (u32 i = 0; i < cmdQueue->assets->lights.Length(); ++i)
+    Pool<Light, MAX_LIGHTS>* lights = &cmdQueue->assets->lights;
+    for (u32 i = 0; i < lights->Length(); ++i)
     {
-        assert(i <= ARRAY_LEN(cmdQueue->lights));
-        cmdQueue->lights[i] = cmdQueue->assets->lights[i];
+        cmdQueue->lights[i] = (*lights)[lights->GetLiveIndex(i)];
 
         Light* e = &cmdQueue->lights[i];
         if (r_backendFlags.drawLights)
@@ -177,7 +183,7 @@ void S_Update(ClientInput* input, RenderCommandQueue* cmdQueue)
         }
     }
 
-    cmdQueue->lightCount = cmdQueue->assets->lights.Length();
+    cmdQueue->lightCount = lights->Length();
 
     if (r_backendFlags.drawAABB)
     {
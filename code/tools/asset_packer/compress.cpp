@@ -0,0 +1,135 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define HASH_BITS 16
+#define MAX_OFFSET 65535
+
+static u32 ReadU32(const u8* data)
+{
+    u32 result;
+    memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+static u32 HashSequence(u32 sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static u8* WriteLength(u8* output, u64 length)
+{
+    while (length >= 255)
+    {
+        *output++ = 255;
+        length -= 255;
+    }
+    *output++ = (u8)length;
+    return output;
+}
+
+// matchLength is 0 for the last sequence
+static u8* WriteSequence(u8* output, const u8* literals, u64 numLiterals, u32 offset, u64 matchLength)
+{
+    const u64 matchCode = matchLength > 0 ? matchLength - ASSET_LZ_MIN_MATCH : 0;
+    *output++ = (u8)((MIN(numLiterals, 15) << 4) | MIN(matchCode, 15));
+    if (numLiterals >= 15)
+    {
+        output = WriteLength(output, numLiterals - 15);
+    }
+    memcpy(output, literals, numLiterals);
+    output += numLiterals;
+
+    if (matchLength > 0)
+    {
+        *output++ = (u8)(offset & 0xFF);
+        *output++ = (u8)(offset >> 8);
+        if (matchCode >= 15)
+        {
+            output = WriteLength(output, matchCode - 15);
+        }
+    }
+
+    return output;
+}
+
+u64 GetCompressBoundLZ(u64 size)
+{
+    return size + size / 255 + 16;
+}
+
+// Greedy parse with a single-entry hash table, fast rather than tight.
+u64 CompressLZ(u8* output, const u8* input, u64 size)
+{
+    u32* table = (u32*)calloc(1 << HASH_BITS, sizeof(u32)); // position + 1, 0 when empty
+    if (table == NULL)
+    {
+        Sys_FatalError("CompressLZ: failed to allocate the hash table");
+    }
+
+    u8* out = output;
+    u64 anchor = 0;
+    u64 i = 0;
+    while (i + ASSET_LZ_MIN_MATCH <= size)
+    {
+        const u32 sequence = ReadU32(input + i);
+        const u32 hash = HashSequence(sequence);
+        const u64 candidate = (u64)table[hash] - 1;
+        const bool valid = table[hash] != 0 && i - candidate <= MAX_OFFSET;
+        table[hash] = (u32)(i + 1);
+
+        if (!valid || ReadU32(input + candidate) != sequence)
+        {
+            i++;
+            continue;
+        }
+
+        u64 matchLength = ASSET_LZ_MIN_MATCH;
+        while (i + matchLength < size && input[candidate + matchLength] == input[i + matchLength])
+        {
+            matchLength++;
+        }
+
+        out = WriteSequence(out, input + anchor, i - anchor, (u32)(i - candidate), matchLength);
+        i += matchLength;
+        anchor = i;
+    }
+
+    out = WriteSequence(out, input + anchor, size - anchor, 0, 0);
+    free(table);
+
+    assert((u64)(out - output) <= GetCompressBoundLZ(size));
+    return (u64)(out - output);
+}
@@ -0,0 +1,409 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define MAX_PACK_FILES 4096
+#define DEFAULT_ALIGNMENT 4096 // page aligned, so every asset starts on its own page in the mapping
+
+struct PackFile
+{
+    char path[MAX_PATH]; // relative to the asset directory
+    void* data;
+    u64 size;
+    u64 contentHash;
+    u8* stored;
+    u64 storedSize;
+    u32 compression;
+    s32 duplicateOf; // index of an earlier file with the same content, -1 if unique
+    u64 offset;
+    void* handle; // open while the file is read
+    IoRequest read;
+};
+
+struct Options
+{
+    bool compress;
+    u64 alignment;
+};
+
+static PackFile files[MAX_PACK_FILES];
+static u32 numFiles;
+
+static const char* packedExtensions[] = { ".scene", ".material", ".dds" };
+
+static void PrintHelp()
+{
+    printf("usage: AssetPacker [options] <asset dir> <output file>\n");
+    printf("packs the .scene, .material and .dds files of the asset dir and its sub-directories\n\n");
+    printf("  -compress  compress entries that get at least 1/8 smaller\n");
+    printf("  -align N   entry alignment in bytes, a power of 2 (default %d)\n", DEFAULT_ALIGNMENT);
+}
+
+static bool HasPackedExtension(const char* fileName)
+{
+    const size_t length = strlen(fileName);
+    for (u32 i = 0; i < ARRAY_LEN(packedExtensions); ++i)
+    {
+        const size_t extensionLength = strlen(packedExtensions[i]);
+        if (length > extensionLength && strcmp(fileName + length - extensionLength, packedExtensions[i]) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void CollectFiles(const char* rootDir, const char* relativeDir)
+{
+    char dir[MAX_PATH];
+    if (relativeDir[0] != '\0')
+    {
+        PathCombine(dir, rootDir, relativeDir);
+    }
+    else
+    {
+        strcpy(dir, rootDir);
+    }
+
+    const char* fileName;
+    const char* filePath;
+    FolderScan* fs = Sys_FolderScan_Begin(dir, "*");
+    while (Sys_FolderScan_Next(&fileName, &filePath, fs))
+    {
+        if (strcmp(fileName, ".") == 0 || strcmp(fileName, "..") == 0)
+        {
+            continue;
+        }
+
+        char relativePath[MAX_PATH];
+        if (relativeDir[0] != '\0')
+        {
+            PathCombine(relativePath, relativeDir, fileName);
+        }
+        else
+        {
+            strcpy(relativePath, fileName);
+        }
+
+        if (Sys_IsDirectory(filePath))
+        {
+            CollectFiles(rootDir, relativePath);
+            continue;
+        }
+
+        if (!HasPackedExtension(fileName))
+        {
+            continue;
+        }
+
+        if (numFiles == MAX_PACK_FILES)
+        {
+            Sys_FatalError("too many files, the limit is %d", MAX_PACK_FILES);
+        }
+
+        PackFile* file = &files[numFiles++];
+        memset(file, 0, sizeof(PackFile));
+        strcpy(file->path, relativePath);
+        file->handle = Sys_OpenFileForReading(filePath, &file->size);
+        if (file->handle == NULL)
+        {
+            Sys_FatalError("can't open %s", filePath);
+        }
+    }
+    Sys_FolderScan_End(fs);
+}
+
+// All the reads are queued up-front, PrepareFiles hashes and compresses a file as soon as it's in memory.
+static void ReadFiles()
+{
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        PackFile* file = &files[f];
+        file->data = malloc(MAX(file->size, 1));
+        if (file->data == NULL)
+        {
+            Sys_FatalError("can't allocate %s for %s", FormatBytes(file->size), file->path);
+        }
+
+        file->read.file = file->handle;
+        file->read.offset = 0;
+        file->read.size = file->size;
+        file->read.buffer = file->data;
+        Io_Submit(NULL, &file->read, 1);
+    }
+}
+
+static int ComparePaths(const void* a, const void* b)
+{
+    return strcmp(((const PackFile*)a)->path, ((const PackFile*)b)->path);
+}
+
+static void PrepareFiles(const Options* options)
+{
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        PackFile* file = &files[f];
+        if (Io_Wait(&file->read) != IoStatus::Done)
+        {
+            Sys_FatalError("can't read %s", file->path);
+        }
+        Sys_CloseFile(file->handle);
+        file->handle = NULL;
+
+        file->contentHash = Asset_HashContent(file->data, file->size);
+        file->stored = (u8*)file->data;
+        file->storedSize = file->size;
+        file->compression = AssetCompression::None;
+        file->duplicateOf = -1;
+
+        for (u32 d = 0; d < f; ++d)
+        {
+            const PackFile* other = &files[d];
+            if (other->duplicateOf < 0 && other->contentHash == file->contentHash && other->size == file->size &&
+                memcmp(other->data, file->data, file->size) == 0)
+            {
+                file->duplicateOf = (s32)d;
+                break;
+            }
+        }
+
+        // the compressor's hash table stores 32-bit positions
+        if (!options->compress || file->duplicateOf >= 0 || file->size > 0xFFFFFFFF)
+        {
+            continue;
+        }
+
+        u8* compressed = (u8*)malloc(GetCompressBoundLZ(file->size));
+        const u64 compressedSize = CompressLZ(compressed, (const u8*)file->data, file->size);
+        if (compressedSize <= file->size - file->size / 8)
+        {
+            file->stored = compressed;
+            file->storedSize = compressedSize;
+            file->compression = AssetCompression::LZ;
+        }
+        else
+        {
+            free(compressed);
+        }
+    }
+}
+
+static void WritePadding(FILE* file, u64* offset, u64 alignment)
+{
+    static const u8 zeros[4096] = {};
+    u64 padding = ((*offset + alignment - 1) & ~(alignment - 1)) - *offset;
+    *offset += padding;
+    while (padding > 0)
+    {
+        const u64 count = MIN(padding, sizeof(zeros));
+        fwrite(zeros, count, 1, file);
+        padding -= count;
+    }
+}
+
+static void WritePack(const char* outputPath, const Options* options)
+{
+    FILE* file = fopen(outputPath, "wb");
+    if (file == NULL)
+    {
+        Sys_FatalError("can't open %s for writing", outputPath);
+    }
+
+    AssetPackHeader header = {};
+    fwrite(&header, sizeof(header), 1, file); // written again once the offsets are known
+    u64 offset = sizeof(header);
+
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        PackFile* packFile = &files[f];
+        if (packFile->duplicateOf >= 0)
+        {
+            packFile->offset = files[packFile->duplicateOf].offset;
+            continue;
+        }
+
+        WritePadding(file, &offset, options->alignment);
+        packFile->offset = offset;
+        fwrite(packFile->stored, packFile->storedSize, 1, file);
+        offset += packFile->storedSize;
+    }
+
+    // the files are sorted and unique, so every path is stored once
+    MemoryArena strings;
+    u64 numStringBytes = 1; // offset 0 is the empty string
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        numStringBytes += strlen(files[f].path) + 1;
+    }
+    AllocateArena(&strings, numStringBytes + 1, calloc(numStringBytes + 1, 1), "string arena");
+    strings.mem_used = 1;
+
+    WritePadding(file, &offset, 8);
+    header.tocOffset = offset;
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        const PackFile* packFile = &files[f];
+        AssetPackEntry entry = {};
+        entry.pathOffset = PushString(&strings, packFile->path);
+        entry.compression = packFile->compression;
+        entry.offset = packFile->offset;
+        entry.size = packFile->storedSize;
+        entry.uncompressedSize = packFile->size;
+        entry.contentHash = packFile->contentHash;
+        fwrite(&entry, sizeof(entry), 1, file);
+        offset += sizeof(entry);
+    }
+
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.numEntries = numFiles;
+    header.numStringBytes = (u32)strings.mem_used;
+    header.stringsOffset = offset;
+    fwrite(strings.base_ptr, strings.mem_used, 1, file);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fclose(file);
+    free(strings.base_ptr);
+}
+
+// Reads every entry back through the runtime code path.
+static void VerifyPack(const char* outputPath)
+{
+    if (!Asset_MountPack(outputPath))
+    {
+        Sys_FatalError("can't map %s", outputPath);
+    }
+
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        AssetFile asset;
+        if (!Asset_Open(&asset, files[f].path) || (asset.allocation == NULL && files[f].compression != AssetCompression::None) ||
+            asset.size != files[f].size || memcmp(asset.data, files[f].data, asset.size) != 0)
+        {
+            Sys_FatalError("verification failed for %s", files[f].path);
+        }
+        Asset_Close(&asset);
+    }
+
+    Asset_UnmountPack();
+}
+
+int main(int argc, char** argv)
+{
+    Options options = {};
+    options.alignment = DEFAULT_ALIGNMENT;
+
+    const char* inputDir = NULL;
+    const char* outputPath = NULL;
+    for (s32 i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-compress") == 0)
+        {
+            options.compress = true;
+        }
+        else if (strcmp(argv[i], "-align") == 0 && i + 1 < argc)
+        {
+            options.alignment = (u64)atoi(argv[++i]);
+        }
+        else if (inputDir == NULL)
+        {
+            inputDir = argv[i];
+        }
+        else if (outputPath == NULL)
+        {
+            outputPath = argv[i];
+        }
+        else
+        {
+            PrintHelp();
+            return 1;
+        }
+    }
+
+    if (inputDir == NULL || outputPath == NULL || options.alignment == 0 || (options.alignment & (options.alignment - 1)) != 0)
+    {
+        PrintHelp();
+        return 1;
+    }
+
+    const u64 timestampBegin = Sys_GetTimestamp();
+    CollectFiles(inputDir, "");
+    if (numFiles == 0)
+    {
+        fprintf(stderr, "no assets found in %s\n", inputDir);
+        return 1;
+    }
+
+    // the requests point into files, so the reads start once the files are sorted
+    qsort(files, numFiles, sizeof(PackFile), ComparePaths);
+    Io_Init(0);
+    ReadFiles();
+    PrepareFiles(&options);
+    Io_Shutdown();
+    WritePack(outputPath, &options);
+    VerifyPack(outputPath);
+
+    u64 inputBytes = 0;
+    u64 storedBytes = 0;
+    u32 numDuplicates = 0;
+    u32 numCompressed = 0;
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        inputBytes += files[f].size;
+        if (files[f].duplicateOf >= 0)
+        {
+            numDuplicates++;
+            continue;
+        }
+        storedBytes += files[f].storedSize;
+        numCompressed += files[f].compression != AssetCompression::None ? 1 : 0;
+    }
+
+    printf("%s: %u files (%u compressed, %u duplicates), %s -> ", outputPath, numFiles, numCompressed, numDuplicates, FormatBytes(inputBytes));
+    printf("%s in %u ms\n", FormatBytes(storedBytes), (u32)Sys_GetElapsedMilliseconds(timestampBegin));
+
+    for (u32 f = 0; f < numFiles; ++f)
+    {
+        if (files[f].stored != files[f].data)
+        {
+            free(files[f].stored);
+        }
+        free(files[f].data);
+    }
+
+    return 0;
+}
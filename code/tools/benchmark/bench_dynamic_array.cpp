@@ -0,0 +1,241 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include "legacy_dynamic_array.h"
+
+#define PUSH_COUNT (1 << 22)
+#define SMALL_ARRAY_COUNT (1 << 16)
+#define SMALL_ARRAY_LENGTH 6 // about what a group's smoothing group list holds
+
+struct ArrayBench
+{
+    u64 numItems;
+    u64 numArrays;
+    ArrayGrowth::Type growth;
+};
+
+static u64 PushLegacy(void* userData)
+{
+    const ArrayBench* bench = (const ArrayBench*)userData;
+    LegacyDynamicArray<u32> array;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        array.Push(i);
+    }
+
+    return array.Length();
+}
+
+static u64 PushHeap(void* userData)
+{
+    const ArrayBench* bench = (const ArrayBench*)userData;
+    DynamicArray<u32> array(NULL, bench->growth);
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        array.Push(i);
+    }
+
+    return array.Length();
+}
+
+static u64 PushArena(void* userData)
+{
+    const ArrayBench* bench = (const ArrayBench*)userData;
+    ArenaAllocator allocator;
+    InitArenaAllocator(&allocator, &benchSettings.arena);
+    DynamicArray<u32> array(&allocator.base, bench->growth);
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        array.Push(i);
+    }
+
+    return array.Length();
+}
+
+static u64 PushPool(void* userData)
+{
+    const ArrayBench* bench = (const ArrayBench*)userData;
+    PoolAllocator allocator;
+    InitPoolAllocator(&allocator, &benchSettings.arena);
+    DynamicArray<u32> array(&allocator.base, bench->growth);
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        array.Push(i);
+    }
+
+    return array.Length();
+}
+
+static LegacyDynamicArray<u32> legacyFilled;
+static DynamicArray<u32> filled;
+
+static u64 IterateLegacy(void* userData)
+{
+    u64 sum = 0;
+    const u32 count = (u32)legacyFilled.Length();
+    for (u32 i = 0; i < count; ++i)
+    {
+        sum += legacyFilled[i];
+    }
+
+    return sum;
+}
+
+static u64 IterateIndexed(void* userData)
+{
+    u64 sum = 0;
+    const u32 count = (u32)filled.Length();
+    for (u32 i = 0; i < count; ++i)
+    {
+        sum += filled[i];
+    }
+
+    return sum;
+}
+
+static u64 IteratePointer(void* userData)
+{
+    u64 sum = 0;
+    for (const u32* item = filled.GetStart(); item != filled.GetEnd(); ++item)
+    {
+        sum += *item;
+    }
+
+    return sum;
+}
+
+// many short arrays that are filled, read back and freed, like the smoothing group lists of the mesh baker
+static u64 SmallLegacy(void* userData)
+{
+    const ArrayBench* bench = (const ArrayBench*)userData;
+    LegacyDynamicArray<u32>* arrays = PushArray(&benchSettings.arena, bench->numArrays, LegacyDynamicArray<u32>);
+    u64 sum = 0;
+    for (u32 a = 0; a < bench->numArrays; ++a)
+    {
+        new (&arrays[a]) LegacyDynamicArray<u32>();
+        for (u32 i = 0; i < SMALL_ARRAY_LENGTH; ++i)
+        {
+            arrays[a].Push(a + i);
+        }
+        sum += arrays[a][SMALL_ARRAY_LENGTH - 1];
+    }
+    for (u32 a = 0; a < bench->numArrays; ++a)
+    {
+        arrays[a].~LegacyDynamicArray<u32>();
+    }
+
+    return sum;
+}
+
+template <u32 N>
+static u64 SmallArrays(const ArrayBench* bench, Allocator* allocator)
+{
+    typedef DynamicArray<u32, N> Array;
+    Array* arrays = PushArray(&benchSettings.arena, bench->numArrays, Array);
+    u64 sum = 0;
+    for (u32 a = 0; a < bench->numArrays; ++a)
+    {
+        new (&arrays[a]) Array(allocator);
+        for (u32 i = 0; i < SMALL_ARRAY_LENGTH; ++i)
+        {
+            arrays[a].Push(a + i);
+        }
+        sum += arrays[a][SMALL_ARRAY_LENGTH - 1];
+    }
+    for (u32 a = 0; a < bench->numArrays; ++a)
+    {
+        arrays[a].Free();
+    }
+
+    return sum;
+}
+
+static u64 SmallHeap(void* userData)
+{
+    return SmallArrays<0>((const ArrayBench*)userData, NULL);
+}
+
+static u64 SmallPool(void* userData)
+{
+    // the pool's blocks come from a sub-arena so that they don't interleave with the array headers
+    MemoryArena blocks;
+    SubArena(&blocks, &benchSettings.arena, Megabytes(64), "Pool");
+    PoolAllocator allocator;
+    InitPoolAllocator(&allocator, &blocks);
+
+    return SmallArrays<0>((const ArrayBench*)userData, &allocator.base);
+}
+
+static u64 SmallInline(void* userData)
+{
+    return SmallArrays<8>((const ArrayBench*)userData, NULL);
+}
+
+void Benchmark_DynamicArray()
+{
+    ArrayBench bench = {};
+    bench.numItems = (u64)PUSH_COUNT * benchSettings.scale;
+    bench.numArrays = (u64)SMALL_ARRAY_COUNT * benchSettings.scale;
+    bench.growth = ArrayGrowth::Double;
+
+    RunBenchmark("DynamicArray push: legacy", bench.numItems, &PushLegacy, &bench);
+    RunBenchmark("DynamicArray push: heap", bench.numItems, &PushHeap, &bench);
+    RunBenchmark("DynamicArray push: arena", bench.numItems, &PushArena, &bench);
+    RunBenchmark("DynamicArray push: pool", bench.numItems, &PushPool, &bench);
+    bench.growth = ArrayGrowth::OneAndHalf;
+    RunBenchmark("DynamicArray push: heap, 1.5x growth", bench.numItems, &PushHeap, &bench);
+    RunBenchmark("DynamicArray push: arena, 1.5x growth", bench.numItems, &PushArena, &bench);
+    bench.growth = ArrayGrowth::Double;
+
+    if (ShouldRunBenchmark("DynamicArray iterate"))
+    {
+        for (u32 i = 0; i < bench.numItems; ++i)
+        {
+            legacyFilled.Push(i);
+            filled.Push(i);
+        }
+        RunBenchmark("DynamicArray iterate: legacy", bench.numItems, &IterateLegacy, NULL);
+        RunBenchmark("DynamicArray iterate: operator[]", bench.numItems, &IterateIndexed, NULL);
+        RunBenchmark("DynamicArray iterate: pointers", bench.numItems, &IteratePointer, NULL);
+        legacyFilled.Clear();
+        filled.Free();
+    }
+
+    const u64 numSmallItems = bench.numArrays * SMALL_ARRAY_LENGTH;
+    RunBenchmark("DynamicArray small arrays: legacy", numSmallItems, &SmallLegacy, &bench);
+    RunBenchmark("DynamicArray small arrays: heap", numSmallItems, &SmallHeap, &bench);
+    RunBenchmark("DynamicArray small arrays: pool", numSmallItems, &SmallPool, &bench);
+    RunBenchmark("DynamicArray small arrays: 8 inline", numSmallItems, &SmallInline, &bench);
+}
@@ -0,0 +1,252 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include <unordered_map>
+
+#define MAP_COUNT (1 << 18)
+#define STATIC_MAP_BUCKETS 262147 // a prime close to MAP_COUNT, StaticHashMap indexes with hash % N
+
+struct StaticNode
+{
+    u32 hash;
+    u32 value;
+    StaticNode* next;
+};
+
+typedef StaticHashMap<u32, StaticNode, STATIC_MAP_BUCKETS> StaticMap;
+
+struct MapBench
+{
+    u64 numItems;
+    u32* keys; // unique, in insertion order
+    u32* missingKeys; // none of them are in the maps
+    HashMap<u32, u32>* hashMap;
+    StaticMap* staticMap;
+    StaticNode* staticNodes;
+    std::unordered_map<u32, u32>* stdMap;
+};
+
+// unique pseudo-random keys, the mix is a bijection
+static u32 MakeKey(u32 i, u32 salt)
+{
+    u32 x = i * 2 + salt;
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static u64 InsertHashMap(void* userData)
+{
+    MapBench* bench = (MapBench*)userData;
+    HashMap<u32, u32> map;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        map.Insert(bench->keys[i], i);
+    }
+
+    return map.Length();
+}
+
+static u64 InsertHashMapArena(void* userData)
+{
+    MapBench* bench = (MapBench*)userData;
+    ArenaAllocator allocator;
+    InitArenaAllocator(&allocator, &benchSettings.arena);
+    HashMap<u32, u32> map(&allocator.base);
+    map.Reserve((u32)bench->numItems);
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        map.Insert(bench->keys[i], i);
+    }
+
+    return map.Length();
+}
+
+static u64 InsertStaticMap(void* userData)
+{
+    MapBench* bench = (MapBench*)userData;
+    bench->staticMap->Clear();
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        bench->staticNodes[i].value = i;
+        bench->staticMap->Insert(bench->keys[i], &bench->staticNodes[i]);
+    }
+
+    return bench->numItems;
+}
+
+static u64 InsertStdMap(void* userData)
+{
+    MapBench* bench = (MapBench*)userData;
+    std::unordered_map<u32, u32> map;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        map[bench->keys[i]] = i;
+    }
+
+    return map.size();
+}
+
+static u64 FindHashMap(void* userData, const u32* keys)
+{
+    MapBench* bench = (MapBench*)userData;
+    u64 sum = 0;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        const u32* value = bench->hashMap->Find(keys[i]);
+        sum += value != NULL ? *value : 1;
+    }
+
+    return sum;
+}
+
+static u64 FindStaticMap(void* userData, const u32* keys)
+{
+    MapBench* bench = (MapBench*)userData;
+    u64 sum = 0;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        const StaticNode* node = bench->staticMap->TryGet(keys[i]);
+        sum += node != NULL ? node->value : 1;
+    }
+
+    return sum;
+}
+
+static u64 FindStdMap(void* userData, const u32* keys)
+{
+    MapBench* bench = (MapBench*)userData;
+    u64 sum = 0;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        std::unordered_map<u32, u32>::const_iterator it = bench->stdMap->find(keys[i]);
+        sum += it != bench->stdMap->end() ? it->second : 1;
+    }
+
+    return sum;
+}
+
+static u64 HitHashMap(void* userData) { return FindHashMap(userData, ((MapBench*)userData)->keys); }
+static u64 MissHashMap(void* userData) { return FindHashMap(userData, ((MapBench*)userData)->missingKeys); }
+static u64 HitStaticMap(void* userData) { return FindStaticMap(userData, ((MapBench*)userData)->keys); }
+static u64 MissStaticMap(void* userData) { return FindStaticMap(userData, ((MapBench*)userData)->missingKeys); }
+static u64 HitStdMap(void* userData) { return FindStdMap(userData, ((MapBench*)userData)->keys); }
+static u64 MissStdMap(void* userData) { return FindStdMap(userData, ((MapBench*)userData)->missingKeys); }
+
+// StaticHashMap can't remove
+static u64 InsertRemoveHashMap(void* userData)
+{
+    MapBench* bench = (MapBench*)userData;
+    HashMap<u32, u32> map;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        map.Insert(bench->keys[i], i);
+        if (i >= 1024)
+        {
+            map.Remove(bench->keys[i - 1024]);
+        }
+    }
+
+    return map.Length();
+}
+
+static u64 InsertRemoveStdMap(void* userData)
+{
+    MapBench* bench = (MapBench*)userData;
+    std::unordered_map<u32, u32> map;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        map[bench->keys[i]] = i;
+        if (i >= 1024)
+        {
+            map.erase(bench->keys[i - 1024]);
+        }
+    }
+
+    return map.size();
+}
+
+void Benchmark_HashMap()
+{
+    if (!ShouldRunBenchmark("HashMap"))
+    {
+        return;
+    }
+
+    MapBench bench = {};
+    bench.numItems = (u64)MAP_COUNT * benchSettings.scale;
+    bench.keys = (u32*)malloc(bench.numItems * sizeof(u32));
+    bench.missingKeys = (u32*)malloc(bench.numItems * sizeof(u32));
+    bench.staticNodes = (StaticNode*)malloc(bench.numItems * sizeof(StaticNode));
+    bench.staticMap = new StaticMap;
+    bench.hashMap = new HashMap<u32, u32>;
+    bench.stdMap = new std::unordered_map<u32, u32>;
+    for (u32 i = 0; i < bench.numItems; ++i)
+    {
+        bench.keys[i] = MakeKey(i, 0);
+        bench.missingKeys[i] = MakeKey(i, 1);
+    }
+
+    RunBenchmark("HashMap insert: HashMap", bench.numItems, &InsertHashMap, &bench);
+    RunBenchmark("HashMap insert: HashMap, arena, reserved", bench.numItems, &InsertHashMapArena, &bench);
+    RunBenchmark("HashMap insert: StaticHashMap", bench.numItems, &InsertStaticMap, &bench);
+    RunBenchmark("HashMap insert: std::unordered_map", bench.numItems, &InsertStdMap, &bench);
+
+    for (u32 i = 0; i < bench.numItems; ++i)
+    {
+        bench.hashMap->Insert(bench.keys[i], i);
+        (*bench.stdMap)[bench.keys[i]] = i;
+    }
+    InsertStaticMap(&bench);
+
+    RunBenchmark("HashMap find hit: HashMap", bench.numItems, &HitHashMap, &bench);
+    RunBenchmark("HashMap find hit: StaticHashMap", bench.numItems, &HitStaticMap, &bench);
+    RunBenchmark("HashMap find hit: std::unordered_map", bench.numItems, &HitStdMap, &bench);
+    RunBenchmark("HashMap find miss: HashMap", bench.numItems, &MissHashMap, &bench);
+    RunBenchmark("HashMap find miss: StaticHashMap", bench.numItems, &MissStaticMap, &bench);
+    RunBenchmark("HashMap find miss: std::unordered_map", bench.numItems, &MissStdMap, &bench);
+    RunBenchmark("HashMap insert+remove: HashMap", bench.numItems, &InsertRemoveHashMap, &bench);
+    RunBenchmark("HashMap insert+remove: std::unordered_map", bench.numItems, &InsertRemoveStdMap, &bench);
+
+    delete bench.stdMap;
+    delete bench.hashMap;
+    delete bench.staticMap;
+    free(bench.staticNodes);
+    free(bench.missingKeys);
+    free(bench.keys);
+}
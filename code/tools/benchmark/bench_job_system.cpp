@@ -0,0 +1,142 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include "../../common/job_system.h"
+
+#define JOB_ITEMS (1 << 20) // parallel-for items, a few hundred cycles each
+#define JOB_FORK_COUNT (1 << 14) // empty jobs for the spawn overhead
+
+struct JobBench
+{
+    u32 numItems;
+    u32 grain;
+    float* values;
+    volatile s64 checksum;
+};
+
+// a small amount of math per item, like shading a voxel
+static void ProcessRange(void* userData, u32 begin, u32 end)
+{
+    JobBench* bench = (JobBench*)userData;
+    s64 sum = 0;
+    for (u32 i = begin; i < end; ++i)
+    {
+        float x = bench->values[i];
+        for (u32 k = 0; k < 16; ++k)
+        {
+            x = x * 0.999f + 0.5f / (1.0f + x * x);
+        }
+        bench->values[i] = x;
+        sum += (s64)(x * 1000.0f);
+    }
+    AtomicAdd64(&bench->checksum, sum);
+}
+
+static u64 RunSerial(void* userData)
+{
+    JobBench* bench = (JobBench*)userData;
+    bench->checksum = 0;
+    ProcessRange(bench, 0, bench->numItems);
+    return (u64)bench->checksum;
+}
+
+static u64 RunParallelFor(void* userData)
+{
+    JobBench* bench = (JobBench*)userData;
+    bench->checksum = 0;
+    Job_ParallelFor(bench->numItems, &ProcessRange, bench, bench->grain);
+    return (u64)bench->checksum;
+}
+
+static void EmptyJob(void* userData)
+{
+    AtomicAdd64((volatile s64*)userData, 1);
+}
+
+static u64 RunForkJoin(void* userData)
+{
+    JobBench* bench = (JobBench*)userData;
+    bench->checksum = 0;
+    JobCounter counter = {};
+    for (u32 i = 0; i < JOB_FORK_COUNT; ++i)
+    {
+        Job_Run(&EmptyJob, (void*)&bench->checksum, &counter);
+        // keeps the deque from overflowing, jobs that don't fit would run inline
+        if ((i + 1) % (JOB_DEQUE_SIZE / 2) == 0)
+        {
+            Job_Wait(&counter);
+        }
+    }
+    Job_Wait(&counter);
+    return (u64)bench->checksum;
+}
+
+void Benchmark_JobSystem()
+{
+    if (!ShouldRunBenchmark("JobSystem"))
+    {
+        return;
+    }
+
+    JobBench bench = {};
+    bench.numItems = JOB_ITEMS * benchSettings.scale;
+    bench.values = (float*)PushSize(&benchSettings.arena, bench.numItems * sizeof(float));
+    for (u32 i = 0; i < bench.numItems; ++i)
+    {
+        bench.values[i] = (float)(i & 1023) / 1024.0f;
+    }
+
+    RunBenchmark("JobSystem parallel for: serial loop", bench.numItems, &RunSerial, &bench);
+
+    // scaling with the thread count, the workers are restarted for every count
+    const u32 maxThreads = Sys_GetCoreCount();
+    for (u32 numThreads = 1;; numThreads *= 2)
+    {
+        numThreads = MIN(numThreads, maxThreads);
+        Job_Init(numThreads - 1);
+
+        bench.grain = 0;
+        RunBenchmark(fmt("JobSystem parallel for: %u threads, adaptive grain", numThreads), bench.numItems, &RunParallelFor, &bench);
+        bench.grain = 64;
+        RunBenchmark(fmt("JobSystem parallel for: %u threads, 64 item grain", numThreads), bench.numItems, &RunParallelFor, &bench);
+        RunBenchmark(fmt("JobSystem fork-join: %u threads, empty jobs", numThreads), JOB_FORK_COUNT, &RunForkJoin, &bench);
+
+        Job_Shutdown();
+        if (numThreads == maxThreads)
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,409 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define MATH_MATRICES (1 << 16)
+#define MATH_POINTS (1 << 20)
+#define MATH_BOXES (1 << 18)
+#define MATH_PLANES 6
+
+// The SIMD results must be bit-identical to the scalar ones,
+// every scalar/SIMD pair is compared after it ran.
+struct MathBench
+{
+    u32 numMatrices;
+    m4x4* a;
+    m4x4* b;
+    m4x4* matrices;
+    m4x4* reference;
+
+    u32 numPoints;
+    vec3_t* points;
+    vec3_t* transformed;
+    vec3_t* referencePoints;
+    vec3_soa_t soa;
+    vec3_soa_t soa2;
+    vec3_soa_t soaOut;
+    f32* dots;
+    f32* referenceDots;
+
+    u32 numBoxes;
+    vec3_soa_t centers;
+    vec3_soa_t extents;
+    vec4_t planes[MATH_PLANES];
+    u8* visible;
+    u8* referenceVisible;
+
+    vec3_t min;
+    vec3_t max;
+};
+
+static u32 randomState = 0x9E3779B9;
+
+static f32 RandomFloat(f32 range)
+{
+    randomState = randomState * 1664525 + 1013904223;
+    return ((f32)(randomState >> 8) / (f32)(1 << 24) * 2.0f - 1.0f) * range;
+}
+
+static f32* PushFloats(u32 count)
+{
+    return (f32*)PushSize(&benchSettings.arena, count * sizeof(f32));
+}
+
+static vec3_soa_t PushSoa(u32 count)
+{
+    vec3_soa_t R = { PushFloats(count), PushFloats(count), PushFloats(count) };
+    return R;
+}
+
+static u64 Bits(f32 value)
+{
+    u32 R;
+    memcpy(&R, &value, sizeof(R));
+    return R;
+}
+
+static void Compare(const void* simd, const void* scalar, size_t size, const char* name)
+{
+    if (memcmp(simd, scalar, size) != 0)
+    {
+        Sys_FatalError("SIMD results differ from the scalar ones: %s", name);
+    }
+}
+
+static u64 RunMultiplyScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numMatrices; ++i)
+    {
+        bench->matrices[i] = bench->a[i] * bench->b[i];
+    }
+    return Bits(bench->matrices[bench->numMatrices - 1].E[3][3]);
+}
+
+static u64 RunMultiplySimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numMatrices; ++i)
+    {
+        bench->matrices[i] = StoreMat4(LoadMat4(&bench->a[i]) * LoadMat4(&bench->b[i]));
+    }
+    return Bits(bench->matrices[bench->numMatrices - 1].E[3][3]);
+}
+
+static u64 RunInvertScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numMatrices; ++i)
+    {
+        bench->matrices[i] = Invert(&bench->a[i]);
+    }
+    return Bits(bench->matrices[bench->numMatrices - 1].E[3][3]);
+}
+
+static u64 RunInvertSimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numMatrices; ++i)
+    {
+        const mat4 m = LoadMat4(&bench->a[i]);
+        bench->matrices[i] = StoreMat4(Invert(&m));
+    }
+    return Bits(bench->matrices[bench->numMatrices - 1].E[3][3]);
+}
+
+// 'b' holds rigid transforms
+static u64 RunInvertAffineScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numMatrices; ++i)
+    {
+        bench->matrices[i] = InvertAffine(&bench->b[i]);
+    }
+    return Bits(bench->matrices[bench->numMatrices - 1].E[2][3]);
+}
+
+static u64 RunInvertAffineSimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numMatrices; ++i)
+    {
+        const mat4 m = LoadMat4(&bench->b[i]);
+        bench->matrices[i] = StoreMat4(InvertAffine(&m));
+    }
+    return Bits(bench->matrices[bench->numMatrices - 1].E[2][3]);
+}
+
+static u64 RunTransformScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    const m4x4 m = bench->b[0];
+    for (u32 i = 0; i < bench->numPoints; ++i)
+    {
+        bench->transformed[i] = Transform(m, bench->points[i]);
+    }
+    return Bits(bench->transformed[bench->numPoints - 1].z);
+}
+
+static u64 RunTransformSimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    TransformPoints(&bench->b[0], bench->points, bench->transformed, bench->numPoints);
+    return Bits(bench->transformed[bench->numPoints - 1].z);
+}
+
+static u64 RunTransformSoa(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    TransformPoints(&bench->b[0], bench->soa, bench->soaOut, bench->numPoints);
+    return Bits(bench->soaOut.z[bench->numPoints - 1]);
+}
+
+static u64 RunDotScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numPoints; ++i)
+    {
+        const vec3_t a = { bench->soa.x[i], bench->soa.y[i], bench->soa.z[i] };
+        const vec3_t b = { bench->soa2.x[i], bench->soa2.y[i], bench->soa2.z[i] };
+        bench->dots[i] = dot(a, b);
+    }
+    return Bits(bench->dots[bench->numPoints - 1]);
+}
+
+static u64 RunDotSimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    DotProducts(bench->soa, bench->soa2, bench->dots, bench->numPoints);
+    return Bits(bench->dots[bench->numPoints - 1]);
+}
+
+static u64 RunCrossScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    for (u32 i = 0; i < bench->numPoints; ++i)
+    {
+        const vec3_t a = { bench->soa.x[i], bench->soa.y[i], bench->soa.z[i] };
+        const vec3_t b = { bench->soa2.x[i], bench->soa2.y[i], bench->soa2.z[i] };
+        const vec3_t c = cross(a, b);
+        bench->soaOut.x[i] = c.x;
+        bench->soaOut.y[i] = c.y;
+        bench->soaOut.z[i] = c.z;
+    }
+    return Bits(bench->soaOut.z[bench->numPoints - 1]);
+}
+
+static u64 RunCrossSimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    CrossProducts(bench->soa, bench->soa2, bench->soaOut, bench->numPoints);
+    return Bits(bench->soaOut.z[bench->numPoints - 1]);
+}
+
+static u64 RunCullScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    u64 numVisible = 0;
+    for (u32 i = 0; i < bench->numBoxes; ++i)
+    {
+        const vec3_t center = { bench->centers.x[i], bench->centers.y[i], bench->centers.z[i] };
+        const vec3_t extent = { bench->extents.x[i], bench->extents.y[i], bench->extents.z[i] };
+        bench->visible[i] = AABBVisible(bench->planes, MATH_PLANES, center, extent);
+        numVisible += bench->visible[i];
+    }
+    return numVisible;
+}
+
+static u64 RunCullSimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    CullAABBs(bench->planes, MATH_PLANES, bench->centers, bench->extents, bench->visible, bench->numBoxes);
+    u64 numVisible = 0;
+    for (u32 i = 0; i < bench->numBoxes; ++i)
+    {
+        numVisible += bench->visible[i];
+    }
+    return numVisible;
+}
+
+static u64 RunBoundsScalar(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    vec3_t min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    vec3_t max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (u32 i = 0; i < bench->numPoints; ++i)
+    {
+        const vec3_t v = bench->points[i];
+        for (u32 c = 0; c < 3; ++c)
+        {
+            if (v[c] < min[c])
+                min[c] = v[c];
+            if (v[c] > max[c])
+                max[c] = v[c];
+        }
+    }
+    bench->min = min;
+    bench->max = max;
+    return Bits(min.x) + Bits(max.z);
+}
+
+static u64 RunBoundsSimd(void* userData)
+{
+    MathBench* bench = (MathBench*)userData;
+    ComputeBounds(bench->points, bench->numPoints, &bench->min, &bench->max);
+    return Bits(bench->min.x) + Bits(bench->max.z);
+}
+
+void Benchmark_Math()
+{
+    if (!ShouldRunBenchmark("Math"))
+    {
+        return;
+    }
+
+    MathBench bench = {};
+    bench.numMatrices = MATH_MATRICES * benchSettings.scale;
+    bench.a = PushArray(&benchSettings.arena, bench.numMatrices, m4x4);
+    bench.b = PushArray(&benchSettings.arena, bench.numMatrices, m4x4);
+    bench.matrices = PushArray(&benchSettings.arena, bench.numMatrices, m4x4);
+    bench.reference = PushArray(&benchSettings.arena, bench.numMatrices, m4x4);
+    for (u32 i = 0; i < bench.numMatrices; ++i)
+    {
+        for (u32 r = 0; r < 4; ++r)
+        {
+            for (u32 c = 0; c < 4; ++c)
+            {
+                bench.a[i].E[r][c] = RandomFloat(10.0f);
+            }
+        }
+        bench.b[i] = Translate(YRotation(RandomFloat(3.0f)) * XRotation(RandomFloat(3.0f)), { RandomFloat(100.0f), RandomFloat(100.0f), RandomFloat(100.0f) });
+    }
+
+    bench.numPoints = MATH_POINTS * benchSettings.scale;
+    bench.points = PushArray(&benchSettings.arena, bench.numPoints, vec3_t);
+    bench.transformed = PushArray(&benchSettings.arena, bench.numPoints, vec3_t);
+    bench.referencePoints = PushArray(&benchSettings.arena, bench.numPoints, vec3_t);
+    bench.soa = PushSoa(bench.numPoints);
+    bench.soa2 = PushSoa(bench.numPoints);
+    bench.soaOut = PushSoa(bench.numPoints);
+    bench.dots = PushFloats(bench.numPoints);
+    bench.referenceDots = PushFloats(bench.numPoints);
+    for (u32 i = 0; i < bench.numPoints; ++i)
+    {
+        const vec3_t p = { RandomFloat(1000.0f), RandomFloat(1000.0f), RandomFloat(1000.0f) };
+        bench.points[i] = p;
+        bench.soa.x[i] = p.x;
+        bench.soa.y[i] = p.y;
+        bench.soa.z[i] = p.z;
+        bench.soa2.x[i] = RandomFloat(1.0f);
+        bench.soa2.y[i] = RandomFloat(1.0f);
+        bench.soa2.z[i] = RandomFloat(1.0f);
+    }
+
+    // boxes spread around a view frustum-sized volume, roughly half of them pass
+    bench.numBoxes = MATH_BOXES * benchSettings.scale;
+    bench.centers = PushSoa(bench.numBoxes);
+    bench.extents = PushSoa(bench.numBoxes);
+    bench.visible = (u8*)PushSize(&benchSettings.arena, bench.numBoxes);
+    bench.referenceVisible = (u8*)PushSize(&benchSettings.arena, bench.numBoxes);
+    for (u32 i = 0; i < bench.numBoxes; ++i)
+    {
+        bench.centers.x[i] = RandomFloat(150.0f);
+        bench.centers.y[i] = RandomFloat(150.0f);
+        bench.centers.z[i] = RandomFloat(150.0f);
+        bench.extents.x[i] = fabsf(RandomFloat(5.0f));
+        bench.extents.y[i] = fabsf(RandomFloat(5.0f));
+        bench.extents.z[i] = fabsf(RandomFloat(5.0f));
+    }
+    for (u32 p = 0; p < MATH_PLANES; ++p)
+    {
+        const vec3_t n = norm({ RandomFloat(1.0f), RandomFloat(1.0f), RandomFloat(1.0f) });
+        const vec4_t plane = { n.x, n.y, n.z, 100.0f };
+        bench.planes[p] = plane;
+    }
+
+    const size_t matricesSize = bench.numMatrices * sizeof(m4x4);
+    RunBenchmark("Math m4x4 multiply: scalar", bench.numMatrices, &RunMultiplyScalar, &bench);
+    memcpy(bench.reference, bench.matrices, matricesSize);
+    RunBenchmark("Math m4x4 multiply: SIMD", bench.numMatrices, &RunMultiplySimd, &bench);
+    Compare(bench.matrices, bench.reference, matricesSize, "m4x4 multiply");
+
+    RunBenchmark("Math m4x4 invert: scalar", bench.numMatrices, &RunInvertScalar, &bench);
+    memcpy(bench.reference, bench.matrices, matricesSize);
+    RunBenchmark("Math m4x4 invert: SIMD", bench.numMatrices, &RunInvertSimd, &bench);
+    Compare(bench.matrices, bench.reference, matricesSize, "m4x4 invert");
+
+    RunBenchmark("Math m4x4 affine invert: scalar", bench.numMatrices, &RunInvertAffineScalar, &bench);
+    memcpy(bench.reference, bench.matrices, matricesSize);
+    RunBenchmark("Math m4x4 affine invert: SIMD", bench.numMatrices, &RunInvertAffineSimd, &bench);
+    Compare(bench.matrices, bench.reference, matricesSize, "m4x4 affine invert");
+
+    const size_t pointsSize = bench.numPoints * sizeof(vec3_t);
+    RunBenchmark("Math transform points: scalar", bench.numPoints, &RunTransformScalar, &bench);
+    memcpy(bench.referencePoints, bench.transformed, pointsSize);
+    RunBenchmark("Math transform points: SIMD", bench.numPoints, &RunTransformSimd, &bench);
+    Compare(bench.transformed, bench.referencePoints, pointsSize, "transform points");
+    RunBenchmark("Math transform points: SIMD, SoA", bench.numPoints, &RunTransformSoa, &bench);
+    for (u32 i = 0; i < bench.numPoints; ++i)
+    {
+        const vec3_t p = { bench.soaOut.x[i], bench.soaOut.y[i], bench.soaOut.z[i] };
+        Compare(&p, &bench.referencePoints[i], sizeof(p), "transform points, SoA");
+    }
+
+    const size_t dotsSize = bench.numPoints * sizeof(f32);
+    RunBenchmark("Math dot products: scalar", bench.numPoints, &RunDotScalar, &bench);
+    memcpy(bench.referenceDots, bench.dots, dotsSize);
+    RunBenchmark("Math dot products: SIMD", bench.numPoints, &RunDotSimd, &bench);
+    Compare(bench.dots, bench.referenceDots, dotsSize, "dot products");
+
+    // the z results of the scalar run stand in for all three
+    RunBenchmark("Math cross products: scalar", bench.numPoints, &RunCrossScalar, &bench);
+    memcpy(bench.referenceDots, bench.soaOut.z, dotsSize);
+    RunBenchmark("Math cross products: SIMD", bench.numPoints, &RunCrossSimd, &bench);
+    Compare(bench.soaOut.z, bench.referenceDots, dotsSize, "cross products");
+
+    RunBenchmark(fmt("Math AABB vs %d planes: scalar", MATH_PLANES), bench.numBoxes, &RunCullScalar, &bench);
+    memcpy(bench.referenceVisible, bench.visible, bench.numBoxes);
+    RunBenchmark(fmt("Math AABB vs %d planes: SIMD", MATH_PLANES), bench.numBoxes, &RunCullSimd, &bench);
+    Compare(bench.visible, bench.referenceVisible, bench.numBoxes, "AABB culling");
+
+    RunBenchmark("Math bounds: scalar", bench.numPoints, &RunBoundsScalar, &bench);
+    const vec3_t min = bench.min;
+    const vec3_t max = bench.max;
+    RunBenchmark("Math bounds: SIMD", bench.numPoints, &RunBoundsSimd, &bench);
+    Compare(&bench.min, &min, sizeof(min), "bounds");
+    Compare(&bench.max, &max, sizeof(max), "bounds");
+}
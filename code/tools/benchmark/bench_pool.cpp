@@ -0,0 +1,360 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define POOL_SIZE 4096
+#define POOL_OPERATIONS (1 << 20)
+
+typedef Pool<u32, POOL_SIZE> TestPool;
+
+struct PoolBench
+{
+    TestPool pool;
+    Handle<u32> handles[POOL_SIZE]; // live ones first, in no particular order
+    u32 numHandles;
+    bool live[POOL_SIZE]; // reference, by slot
+};
+
+static void Fail(const char* message)
+{
+    Sys_FatalError("pool check failed: %s", message);
+}
+
+static u32 randomState = 0x9E3779B9;
+
+static u32 RandomU32()
+{
+    randomState = randomState * 1664525 + 1013904223;
+    return randomState >> 8;
+}
+
+static void FreeAll(PoolBench* bench)
+{
+    bench->pool.Clear();
+    bench->numHandles = 0;
+    memset(bench->live, 0, sizeof(bench->live));
+}
+
+static void AllocTracked(PoolBench* bench)
+{
+    const Handle<u32> handle = bench->pool.Alloc();
+    if (handle.IsNull())
+    {
+        Fail("Alloc failed with free slots left");
+    }
+    const u32 index = bench->pool.GetIndex(handle);
+    if (bench->live[index])
+    {
+        Fail("Alloc returned a live slot");
+    }
+    bench->live[index] = true;
+    bench->pool[index] = handle.value;
+    bench->handles[bench->numHandles++] = handle;
+}
+
+static void FreeTracked(PoolBench* bench, u32 h)
+{
+    const Handle<u32> handle = bench->handles[h];
+    const u32 index = bench->pool.GetIndex(handle);
+    if (bench->pool[index] != handle.value)
+    {
+        Fail("an object was overwritten while it was live");
+    }
+    bench->pool.Free(handle);
+    bench->live[index] = false;
+    bench->handles[h] = bench->handles[--bench->numHandles];
+}
+
+// the pool against the reference: every live slot is visited exactly once, nothing else is live
+static void CheckLive(const PoolBench* bench)
+{
+    const TestPool& pool = bench->pool;
+    if (pool.Length() != bench->numHandles)
+    {
+        Fail(fmt("%u live objects instead of %u", pool.Length(), bench->numHandles));
+    }
+
+    bool visited[POOL_SIZE] = {};
+    for (u32 i = 0; i < pool.Length(); ++i)
+    {
+        const u32 index = pool.GetLiveIndex(i);
+        if (index >= POOL_SIZE || !bench->live[index] || visited[index])
+        {
+            Fail("GetLiveIndex visited a freed slot or a live one twice");
+        }
+        visited[index] = true;
+    }
+
+    for (u32 index = 0; index < POOL_SIZE; ++index)
+    {
+        if (pool.IsLive(index) != bench->live[index])
+        {
+            Fail(fmt("IsLive(%u) is %d", index, (int)pool.IsLive(index)));
+        }
+    }
+
+    for (u32 h = 0; h < bench->numHandles; ++h)
+    {
+        if (!pool.IsValid(bench->handles[h]) || *pool.Get(bench->handles[h]) != bench->handles[h].value)
+        {
+            Fail("a live handle doesn't resolve to its object");
+        }
+    }
+}
+
+static void CheckFull(PoolBench* bench)
+{
+    FreeAll(bench);
+    while (bench->numHandles < POOL_SIZE)
+    {
+        AllocTracked(bench);
+    }
+    if (!bench->pool.IsFull() || !bench->pool.Alloc().IsNull() || bench->pool.Length() != POOL_SIZE)
+    {
+        Fail("Alloc on a full pool didn't return a null handle");
+    }
+    CheckLive(bench);
+}
+
+static void CheckStaleHandles(PoolBench* bench)
+{
+    FreeAll(bench);
+    TestPool& pool = bench->pool;
+    const Handle<u32> a = pool.Alloc();
+    const Handle<u32> b = pool.Alloc();
+    pool.Free(a);
+    if (pool.IsValid(a) || pool.Get(a) != NULL)
+    {
+        Fail("a freed handle still resolves");
+    }
+
+    // the slot is reused, the old handle must not resolve to the new object
+    const Handle<u32> c = pool.Alloc();
+    if (pool.GetIndex(c) != (a.value & HANDLE_INDEX_MASK) || c == a)
+    {
+        Fail("the freed slot wasn't reused with a new handle");
+    }
+    if (pool.IsValid(a) || pool.Get(a) != NULL)
+    {
+        Fail("a freed handle resolves once its slot is reused");
+    }
+
+    // freeing it again or freeing null doesn't touch the new object
+    Handle<u32> null = {};
+    pool.Free(a);
+    pool.Free(null);
+    if (pool.Length() != 2 || !pool.IsValid(b) || !pool.IsValid(c) || !null.IsNull() || pool.IsValid(null))
+    {
+        Fail("freeing a stale or null handle changed the pool");
+    }
+    pool.Free(b);
+    pool.Free(c);
+    pool.Free(c);
+    if (pool.Length() != 0)
+    {
+        Fail("a double free changed the pool");
+    }
+}
+
+static void CheckGenerationWrap()
+{
+    static Pool<u32, 1> pool;
+    Handle<u32> first = pool.Alloc();
+    Handle<u32> previous = first;
+    pool.Free(previous);
+    for (u32 i = 1; i <= 2 * HANDLE_MAX_GENERATIONS; ++i)
+    {
+        const Handle<u32> handle = pool.Alloc();
+        const u32 generation = handle.value >> HANDLE_INDEX_BITS;
+        if (handle.IsNull() || generation == 0 || generation > HANDLE_MAX_GENERATIONS)
+        {
+            Fail(fmt("allocation %u got handle %08X", i, handle.value));
+        }
+        if (handle == previous || pool.IsValid(previous))
+        {
+            Fail(fmt("allocation %u got the handle of the previous one", i));
+        }
+        if ((i % HANDLE_MAX_GENERATIONS == 0) != (handle == first))
+        {
+            Fail("the generation didn't wrap after HANDLE_MAX_GENERATIONS frees");
+        }
+        pool.Free(handle);
+        previous = handle;
+    }
+}
+
+// interleaved frees in random order and allocations that refill the holes
+static void CheckOutOfOrderFrees(PoolBench* bench)
+{
+    FreeAll(bench);
+    for (u32 i = 0; i < POOL_SIZE; ++i)
+    {
+        AllocTracked(bench);
+    }
+    for (u32 round = 0; round < 64; ++round)
+    {
+        const u32 numFrees = RandomU32() % (bench->numHandles + 1);
+        for (u32 i = 0; i < numFrees; ++i)
+        {
+            FreeTracked(bench, RandomU32() % bench->numHandles);
+        }
+        CheckLive(bench);
+
+        const u32 numAllocs = RandomU32() % (POOL_SIZE - bench->numHandles + 1);
+        for (u32 i = 0; i < numAllocs; ++i)
+        {
+            AllocTracked(bench);
+        }
+        CheckLive(bench);
+    }
+}
+
+static void FreeSlot(PoolBench* bench, u32 index)
+{
+    for (u32 h = 0; h < bench->numHandles; ++h)
+    {
+        if (bench->pool.GetIndex(bench->handles[h]) == index)
+        {
+            FreeTracked(bench, h);
+            return;
+        }
+    }
+    Fail("freeing a slot that isn't live");
+}
+
+// A freed slot keeps the free list link in slotToLive, which can be below Length():
+// freeing slot 1 and then slot 2 of a full pool links 2 to slot 1.
+static void CheckFreeListLinks(PoolBench* bench)
+{
+    CheckFull(bench);
+    FreeSlot(bench, 1);
+    FreeSlot(bench, 2);
+    if (bench->pool.IsLive(1) || bench->pool.IsLive(2))
+    {
+        Fail("a freed slot whose free list link is below Length() is live");
+    }
+    CheckLive(bench);
+}
+
+static void CheckClear(PoolBench* bench)
+{
+    FreeAll(bench);
+    Handle<u32> handles[64];
+    for (u32 i = 0; i < ARRAY_LEN(handles); ++i)
+    {
+        handles[i] = bench->pool.Alloc();
+    }
+    bench->pool.Free(handles[7]);
+    bench->pool.Clear();
+    if (bench->pool.Length() != 0)
+    {
+        Fail("Clear left live objects");
+    }
+    for (u32 i = 0; i < ARRAY_LEN(handles); ++i)
+    {
+        if (bench->pool.IsValid(handles[i]) || bench->pool.IsLive(i))
+        {
+            Fail("a handle resolves after Clear");
+        }
+    }
+
+    // every slot can be used again
+    CheckFull(bench);
+}
+
+static u64 RunChurn(void* userData)
+{
+    PoolBench* bench = (PoolBench*)userData;
+    TestPool& pool = bench->pool;
+    FreeAll(bench);
+
+    u64 sum = 0;
+    for (u32 i = 0; i < POOL_OPERATIONS; ++i)
+    {
+        // frees get likelier as the pool fills up, it hovers around half full
+        const u32 random = RandomU32();
+        if (random % POOL_SIZE < bench->numHandles)
+        {
+            const u32 h = RandomU32() % bench->numHandles;
+            sum += *pool.Get(bench->handles[h]);
+            pool.Free(bench->handles[h]);
+            bench->handles[h] = bench->handles[--bench->numHandles];
+        }
+        else
+        {
+            const Handle<u32> handle = pool.Alloc();
+            *pool.Get(handle) = i;
+            bench->handles[bench->numHandles++] = handle;
+        }
+    }
+
+    return sum;
+}
+
+static u64 RunIterate(void* userData)
+{
+    const TestPool& pool = ((PoolBench*)userData)->pool;
+    u64 sum = 0;
+    for (u32 r = 0; r < POOL_OPERATIONS / POOL_SIZE; ++r)
+    {
+        for (u32 i = 0; i < pool.Length(); ++i)
+        {
+            sum += pool[pool.GetLiveIndex(i)];
+        }
+    }
+
+    return sum;
+}
+
+void Benchmark_Pool()
+{
+    if (!ShouldRunBenchmark("Pool"))
+    {
+        return;
+    }
+
+    // the pool is constructed, so it can't come from the arena
+    static PoolBench poolBench;
+    PoolBench* bench = &poolBench;
+    CheckFull(bench);
+    CheckStaleHandles(bench);
+    CheckGenerationWrap();
+    CheckOutOfOrderFrees(bench);
+    CheckFreeListLinks(bench);
+    CheckClear(bench);
+
+    RunBenchmark("Pool random Alloc/Free", POOL_OPERATIONS, &RunChurn, bench);
+    RunBenchmark(fmt("Pool live iteration, %u of %u live", bench->pool.Length(), POOL_SIZE), POOL_OPERATIONS / POOL_SIZE * bench->pool.Length(), &RunIterate, bench);
+}
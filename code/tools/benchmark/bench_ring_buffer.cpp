@@ -0,0 +1,335 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define RING_SIZE 1024
+#define RING_ITEMS (1 << 20)
+#define RING_BATCH 32
+#define RING_PRODUCERS 2
+#define RING_CONSUMERS 2
+#define RING_ROUND_TRIPS (1 << 14)
+
+// The consumers check what they received, so every run is also a stress test:
+// SPSC must keep the order, MPMC must deliver every item exactly once.
+struct RingBench
+{
+    u64 numItems;
+    bool batched;
+    SpscRing<u64, RING_SIZE> spsc;
+    MpmcRing<u64, RING_SIZE> mpmc;
+    BlockingRing<u64, SpscRing<u64, RING_SIZE> > ping;
+    BlockingRing<u64, SpscRing<u64, RING_SIZE> > pong;
+
+    // mutex + ring baseline
+    Mutex lock;
+    u64 lockedItems[RING_SIZE];
+    u64 lockedHead;
+    u64 lockedTail;
+
+    volatile s64 sum;
+    volatile s32 numProducersDone;
+};
+
+static void Fail(const char* message)
+{
+    Sys_FatalError("ring buffer stress test failed: %s", message);
+}
+
+// full or empty: spin a little, then give the other side the core
+static void Backoff(u32* numFailures)
+{
+    if (++*numFailures % 256 == 0)
+    {
+        Sys_YieldThread();
+    }
+    else
+    {
+        CpuPause();
+    }
+}
+
+static void SpscProducer(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    u64 batch[RING_BATCH];
+    u32 numFailures = 0;
+    for (u64 i = 0; i < bench->numItems;)
+    {
+        if (!bench->batched)
+        {
+            if (bench->spsc.TryPush(i))
+            {
+                ++i;
+            }
+            else
+            {
+                Backoff(&numFailures);
+            }
+            continue;
+        }
+
+        const u32 count = (u32)MIN((u64)RING_BATCH, bench->numItems - i);
+        for (u32 b = 0; b < count; ++b)
+        {
+            batch[b] = i + b;
+        }
+        u32 numPushed = 0;
+        while (numPushed < count)
+        {
+            const u32 numNew = bench->spsc.PushBatch(batch + numPushed, count - numPushed);
+            if (numNew == 0)
+            {
+                Backoff(&numFailures);
+            }
+            numPushed += numNew;
+        }
+        i += count;
+    }
+}
+
+static u64 RunSpsc(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    Thread* producer = Sys_CreateThread(&SpscProducer, bench);
+
+    u64 expected = 0;
+    u64 batch[RING_BATCH];
+    u32 numFailures = 0;
+    while (expected < bench->numItems)
+    {
+        const u32 count = bench->spsc.PopBatch(batch, bench->batched ? RING_BATCH : 1);
+        if (count == 0)
+        {
+            Backoff(&numFailures);
+        }
+        for (u32 b = 0; b < count; ++b)
+        {
+            if (batch[b] != expected++)
+            {
+                Fail("SPSC items out of order");
+            }
+        }
+    }
+
+    Sys_JoinThread(producer);
+    return expected;
+}
+
+static void MpmcProducer(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    const u64 numItems = bench->numItems / RING_PRODUCERS;
+    u64 batch[RING_BATCH];
+    u32 numFailures = 0;
+    for (u64 i = 0; i < numItems;)
+    {
+        const u32 count = bench->batched ? (u32)MIN((u64)RING_BATCH, numItems - i) : 1;
+        for (u32 b = 0; b < count; ++b)
+        {
+            batch[b] = i + b + 1;
+        }
+        const u32 numPushed = bench->mpmc.PushBatch(batch, count);
+        if (numPushed == 0)
+        {
+            Backoff(&numFailures);
+        }
+        i += numPushed;
+    }
+    AtomicAdd32(&bench->numProducersDone, 1);
+}
+
+static void MpmcConsumer(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    s64 sum = 0;
+    u64 batch[RING_BATCH];
+    u32 numFailures = 0;
+    for (;;)
+    {
+        const bool producersDone = AtomicLoad32(&bench->numProducersDone) == RING_PRODUCERS;
+        const u32 count = bench->mpmc.PopBatch(batch, bench->batched ? RING_BATCH : 1);
+        for (u32 b = 0; b < count; ++b)
+        {
+            sum += (s64)batch[b];
+        }
+        if (count == 0)
+        {
+            if (producersDone)
+            {
+                break;
+            }
+            Backoff(&numFailures);
+        }
+    }
+    AtomicAdd64(&bench->sum, sum);
+}
+
+static u64 RunMpmc(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    bench->sum = 0;
+    bench->numProducersDone = 0;
+
+    Thread* threads[RING_PRODUCERS + RING_CONSUMERS];
+    for (u32 t = 0; t < RING_PRODUCERS; ++t)
+    {
+        threads[t] = Sys_CreateThread(&MpmcProducer, bench);
+    }
+    for (u32 t = 0; t < RING_CONSUMERS; ++t)
+    {
+        threads[RING_PRODUCERS + t] = Sys_CreateThread(&MpmcConsumer, bench);
+    }
+    for (u32 t = 0; t < RING_PRODUCERS + RING_CONSUMERS; ++t)
+    {
+        Sys_JoinThread(threads[t]);
+    }
+
+    // every producer pushes 1 .. n
+    const u64 n = bench->numItems / RING_PRODUCERS;
+    if ((u64)bench->sum != RING_PRODUCERS * (n * (n + 1) / 2) || bench->mpmc.Length() != 0)
+    {
+        Fail("MPMC items lost or duplicated");
+    }
+
+    return (u64)bench->sum;
+}
+
+static void LockedProducer(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    u32 numFailures = 0;
+    for (u64 i = 0; i < bench->numItems;)
+    {
+        Sys_LockMutex(&bench->lock);
+        const bool full = bench->lockedTail - bench->lockedHead == RING_SIZE;
+        if (!full)
+        {
+            bench->lockedItems[bench->lockedTail++ % RING_SIZE] = i++;
+        }
+        Sys_UnlockMutex(&bench->lock);
+        if (full)
+        {
+            Backoff(&numFailures);
+        }
+    }
+}
+
+static u64 RunLocked(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    bench->lockedHead = 0;
+    bench->lockedTail = 0;
+    Thread* producer = Sys_CreateThread(&LockedProducer, bench);
+
+    u64 expected = 0;
+    u32 numFailures = 0;
+    while (expected < bench->numItems)
+    {
+        Sys_LockMutex(&bench->lock);
+        const bool empty = bench->lockedHead == bench->lockedTail;
+        if (!empty && bench->lockedItems[bench->lockedHead++ % RING_SIZE] != expected++)
+        {
+            Fail("locked queue items out of order");
+        }
+        Sys_UnlockMutex(&bench->lock);
+        if (empty)
+        {
+            Backoff(&numFailures);
+        }
+    }
+
+    Sys_JoinThread(producer);
+    return expected;
+}
+
+static void PongThread(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    for (u32 i = 0; i < RING_ROUND_TRIPS; ++i)
+    {
+        u64 value;
+        bench->ping.Pop(&value);
+        bench->pong.Push(value + 1);
+    }
+}
+
+// latency: one item goes back and forth, both threads sleep when the other is slow
+static u64 RunPingPong(void* userData)
+{
+    RingBench* bench = (RingBench*)userData;
+    Thread* thread = Sys_CreateThread(&PongThread, bench);
+
+    u64 value = 0;
+    for (u32 i = 0; i < RING_ROUND_TRIPS; ++i)
+    {
+        bench->ping.Push(value);
+        bench->pong.Pop(&value);
+    }
+
+    Sys_JoinThread(thread);
+    if (value != RING_ROUND_TRIPS)
+    {
+        Fail("ping-pong value mismatch");
+    }
+
+    return value;
+}
+
+void Benchmark_RingBuffer()
+{
+    if (!ShouldRunBenchmark("RingBuffer"))
+    {
+        return;
+    }
+
+    // the rings are constructed, so they can't come from the arena
+    static RingBench ringBench;
+    RingBench* bench = &ringBench;
+    bench->numItems = (u64)RING_ITEMS * benchSettings.scale;
+    bench->ping.Init();
+    bench->pong.Init();
+
+    bench->batched = false;
+    RunBenchmark("RingBuffer 1 -> 1: mutex + ring", bench->numItems, &RunLocked, bench);
+    RunBenchmark("RingBuffer 1 -> 1: SpscRing", bench->numItems, &RunSpsc, bench);
+    RunBenchmark(fmt("RingBuffer %d -> %d: MpmcRing", RING_PRODUCERS, RING_CONSUMERS), bench->numItems, &RunMpmc, bench);
+    bench->batched = true;
+    RunBenchmark(fmt("RingBuffer 1 -> 1: SpscRing, batches of %d", RING_BATCH), bench->numItems, &RunSpsc, bench);
+    RunBenchmark(fmt("RingBuffer %d -> %d: MpmcRing, batches of %d", RING_PRODUCERS, RING_CONSUMERS, RING_BATCH), bench->numItems, &RunMpmc, bench);
+    RunBenchmark("RingBuffer round trip: BlockingRing", RING_ROUND_TRIPS, &RunPingPong, bench);
+
+    bench->ping.Destroy();
+    bench->pong.Destroy();
+}
@@ -0,0 +1,131 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define INTERN_NAME_COUNT 4096 // unique names, about what a big scene has in texture and material names
+#define INTERN_LOOKUP_COUNT (1 << 18)
+
+struct InternBench
+{
+    u64 numItems;
+    char (*names)[64];
+    const char** lookups; // copies of the names, in random order, like paths coming out of a parser
+    const char** internedLookups;
+    HashMap<const char*, u32, HashMapStringHash, HashMapStringEqual>* stringMap;
+    HashMap<const char*, u32, InternedStringHash>* internedMap;
+};
+
+static u64 InternExisting(void* userData)
+{
+    InternBench* bench = (InternBench*)userData;
+    u64 sum = 0;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        sum += (uintptr_t)Intern(bench->lookups[i]);
+    }
+
+    return sum;
+}
+
+static u64 FindStringKeys(void* userData)
+{
+    InternBench* bench = (InternBench*)userData;
+    u64 sum = 0;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        sum += *bench->stringMap->Find(bench->lookups[i]);
+    }
+
+    return sum;
+}
+
+static u64 FindInternedKeys(void* userData)
+{
+    InternBench* bench = (InternBench*)userData;
+    u64 sum = 0;
+    for (u32 i = 0; i < bench->numItems; ++i)
+    {
+        sum += *bench->internedMap->Find(bench->internedLookups[i]);
+    }
+
+    return sum;
+}
+
+void Benchmark_StringIntern()
+{
+    if (!ShouldRunBenchmark("StringIntern"))
+    {
+        return;
+    }
+
+    InternBench bench = {};
+    bench.numItems = (u64)INTERN_LOOKUP_COUNT * benchSettings.scale;
+    bench.names = (char(*)[64])malloc(INTERN_NAME_COUNT * sizeof(*bench.names));
+    bench.lookups = (const char**)malloc(bench.numItems * sizeof(const char*));
+    bench.internedLookups = (const char**)malloc(bench.numItems * sizeof(const char*));
+    bench.stringMap = new HashMap<const char*, u32, HashMapStringHash, HashMapStringEqual>;
+    bench.internedMap = new HashMap<const char*, u32, InternedStringHash>;
+
+    // each lookup has its own copy so that the string comparisons can't stop at equal pointers
+    char* copies = (char*)malloc(bench.numItems * sizeof(*bench.names));
+    u32 random = 0x9E3779B9u;
+    for (u32 n = 0; n < INTERN_NAME_COUNT; ++n)
+    {
+        sprintf(bench.names[n], "textures/sponza_material_%04u_diffuse", n);
+        bench.stringMap->Insert(bench.names[n], n);
+        bench.internedMap->Insert(Intern(bench.names[n]), n);
+    }
+    for (u32 i = 0; i < bench.numItems; ++i)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        char* copy = copies + (size_t)i * sizeof(*bench.names);
+        strcpy(copy, bench.names[random % INTERN_NAME_COUNT]);
+        bench.lookups[i] = copy;
+        bench.internedLookups[i] = Intern(copy);
+    }
+
+    RunBenchmark("StringIntern intern: existing string", bench.numItems, &InternExisting, &bench);
+    RunBenchmark("StringIntern find: HashMap, string keys", bench.numItems, &FindStringKeys, &bench);
+    RunBenchmark("StringIntern find: HashMap, interned keys", bench.numItems, &FindInternedKeys, &bench);
+
+    delete bench.internedMap;
+    delete bench.stringMap;
+    free(copies);
+    free(bench.internedLookups);
+    free(bench.lookups);
+    free(bench.names);
+}
@@ -0,0 +1,397 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include "../../renderer/r_texture_residency.h"
+
+#define RESIDENCY_BENCH_TEXTURES 256
+#define RESIDENCY_BENCH_FRAMES 64
+
+// The update only ever sees the requests, so the checks drive it like r_assets.cpp does:
+// BeginFrame, a Request per texture and then Update.
+
+static void Fail(const char* message)
+{
+    Sys_FatalError("texture residency check failed: %s", message);
+}
+
+// puts a texture at a mip without going through an update, to set up a scenario
+static void SetResidentMip(TextureResidency* r, u32 textureIndex, u32 mip)
+{
+    ResidentTexture* t = &r->textures[textureIndex];
+    r->residentBytes -= Residency_GetChainBytes(t, t->residentMip);
+    t->residentMip = mip;
+    r->residentBytes += Residency_GetChainBytes(t, mip);
+}
+
+// one frame with projectedSizes[i] requested for texture i, 0 for no request
+static u32 RunFrame(TextureResidency* r, const f32* projectedSizes, ResidencyChange* changes)
+{
+    Residency_BeginFrame(r);
+    for (u32 i = 0; i < r->numTextures; ++i)
+    {
+        if (projectedSizes[i] > 0.0f)
+        {
+            Residency_Request(r, i, projectedSizes[i]);
+        }
+    }
+    return Residency_Update(r, changes, RESIDENCY_MAX_TEXTURES);
+}
+
+static const ResidencyChange* FindChange(const ResidencyChange* changes, u32 numChanges, u32 textureIndex)
+{
+    for (u32 c = 0; c < numChanges; ++c)
+    {
+        if (changes[c].textureIndex == textureIndex)
+        {
+            return &changes[c];
+        }
+    }
+    return NULL;
+}
+
+static void CheckTailMips(TextureResidency* r)
+{
+    struct TailCase
+    {
+        u32 width;
+        u32 height;
+        u32 numMips;
+        u32 tailMip;
+    };
+    const TailCase cases[] =
+    {
+        { 1024, 1024, 11, 4 }, // 64x64
+        { 1024, 256, 11, 4 }, // 64x16
+        { 256, 1024, 11, 4 }, // 16x64
+        { 96, 96, 7, 1 }, // 48x48
+        { 64, 64, 7, 0 }, // small enough already
+        { 1024, 1024, 3, 2 }, // not enough mips to get down to the tail size
+        { 1000, 600, 10, 1 }, // 62x37, 125x75 and 250x150 aren't multiples of 4, 500x300 is
+        { 2048, 8, 12, 1 }, // 64x1 isn't a multiple of 4 either, 1024x4 is
+        { 100, 100, 7, 0 }, // 50x50 isn't, so everything is the tail
+    };
+
+    Residency_Init(r, Megabytes(64), Megabytes(4));
+    for (u32 i = 0; i < ARRAY_LEN(cases); ++i)
+    {
+        const u32 index = Residency_AddTexture(r, cases[i].width, cases[i].height, cases[i].numMips, 16);
+        if (r->textures[index].tailMip != cases[i].tailMip)
+        {
+            Fail(fmt("the tail of a %ux%u texture with %u mips is mip %u instead of %u",
+                cases[i].width, cases[i].height, cases[i].numMips, r->textures[index].tailMip, cases[i].tailMip));
+        }
+        if (r->textures[index].residentMip != cases[i].tailMip)
+        {
+            Fail("a new texture doesn't start with only its tail resident");
+        }
+    }
+}
+
+static void CheckWantedMips(TextureResidency* r)
+{
+    struct WantedCase
+    {
+        f32 projectedSize;
+        f32 mipBias;
+        u32 wantedMip;
+    };
+    const WantedCase cases[] =
+    {
+        { 0.0f, 0.0f, 4 }, // not visible
+        { -1.0f, 0.0f, 4 },
+        { 1.0f, 0.0f, 4 }, // mip 10, clamped to the tail
+        { 100.0f, 0.0f, 3 }, // 10.24 texels per pixel
+        { 512.0f, 0.0f, 1 },
+        { 1024.0f, 0.0f, 0 },
+        { 4096.0f, 0.0f, 0 }, // magnified, clamped to mip 0
+        { FLT_MAX, 0.0f, 0 }, // inside the bounds
+        { 1024.0f, 1.0f, 1 },
+        { 100.0f, -8.0f, 0 },
+        { 100.0f, 8.0f, 4 },
+    };
+
+    Residency_Init(r, Megabytes(64), Megabytes(4));
+    const ResidentTexture* t = &r->textures[Residency_AddTexture(r, 1024, 1024, 11, 16)];
+    for (u32 i = 0; i < ARRAY_LEN(cases); ++i)
+    {
+        const u32 mip = Residency_ComputeWantedMip(t, cases[i].projectedSize, cases[i].mipBias);
+        if (mip != cases[i].wantedMip)
+        {
+            Fail(fmt("%g pixels with a bias of %g want mip %u instead of %u", cases[i].projectedSize, cases[i].mipBias, mip, cases[i].wantedMip));
+        }
+    }
+}
+
+static void CheckUploadCap(TextureResidency* r, ResidencyChange* changes)
+{
+    // 8 textures of 1024^2 BC1 that want everything, mip 3 is 8 KB and mip 2 is 32 KB
+    f32 sizes[8];
+    Residency_Init(r, Megabytes(64), 1);
+    for (u32 i = 0; i < ARRAY_LEN(sizes); ++i)
+    {
+        Residency_AddTexture(r, 1024, 1024, 11, 8);
+        sizes[i] = 2000.0f + (f32)i;
+    }
+
+    // a single promotion always goes through, even when it's larger than the cap
+    u32 numChanges = RunFrame(r, sizes, changes);
+    if (numChanges != 1 || r->numPromoted != 1 || changes[0].textureIndex != ARRAY_LEN(sizes) - 1 || changes[0].newMip != 3)
+    {
+        Fail("a 1 byte upload cap doesn't promote exactly one mip of the most important texture");
+    }
+
+    // one finer mip per texture and frame, as long as the cap allows: mip 2 of the first one
+    // and mip 3 of the next two
+    r->maxUploadBytesPerFrame = Kilobytes(32 + 2 * 8);
+    numChanges = RunFrame(r, sizes, changes);
+    if (r->numPromoted != 3 || r->uploadedBytes > r->maxUploadBytesPerFrame)
+    {
+        Fail(fmt("%u promotions and %llu bytes uploaded with a cap of 3 mips", r->numPromoted, (unsigned long long)r->uploadedBytes));
+    }
+    for (u32 c = 0; c < numChanges; ++c)
+    {
+        if (changes[c].oldMip != changes[c].newMip + 1)
+        {
+            Fail("a texture was promoted by more than one mip in a frame");
+        }
+    }
+
+    // the frames keep going until everything is resident, never over the cap
+    r->maxUploadBytesPerFrame = Megabytes(1);
+    for (u32 f = 0; f < 64 && RunFrame(r, sizes, changes) > 0; ++f)
+    {
+        if (r->uploadedBytes > r->maxUploadBytesPerFrame && r->numPromoted > 1)
+        {
+            Fail("more than the upload cap was promoted in a frame");
+        }
+    }
+    for (u32 i = 0; i < r->numTextures; ++i)
+    {
+        if (r->textures[i].residentMip != 0)
+        {
+            Fail("the textures didn't all get to mip 0 with enough budget");
+        }
+    }
+}
+
+static void CheckEvictionOrder(TextureResidency* r, ResidencyChange* changes)
+{
+    // 256^2 BC1 has 8 KB in mip 1 and 32 KB in mip 0, 2048^2 BC1 has 128 KB in mip 2
+    Residency_Init(r, Megabytes(64), Megabytes(4));
+    const u32 surplus = Residency_AddTexture(r, 2048, 2048, 12, 8);
+    const u32 low = Residency_AddTexture(r, 256, 256, 9, 8);
+    const u32 lowest = Residency_AddTexture(r, 256, 256, 9, 8);
+    const u32 high = Residency_AddTexture(r, 256, 256, 9, 8);
+    const u32 medium = Residency_AddTexture(r, 256, 256, 9, 8);
+    SetResidentMip(r, surplus, 2);
+    SetResidentMip(r, low, 1);
+    SetResidentMip(r, lowest, 1);
+    SetResidentMip(r, high, 1);
+    r->budgetBytes = r->residentBytes;
+
+    // The surplus texture wants mip 3 but has mip 2, which goes before the mips that are wanted,
+    // even though its priority of 256 is higher than the others'.
+    f32 sizes[5];
+    sizes[surplus] = 256.0f;
+    sizes[low] = 128.0f;
+    sizes[lowest] = 100.0f;
+    sizes[high] = 1000.0f;
+    sizes[medium] = 0.0f;
+    u32 numChanges = RunFrame(r, sizes, changes);
+    const ResidencyChange* surplusChange = FindChange(changes, numChanges, surplus);
+    const ResidencyChange* highChange = FindChange(changes, numChanges, high);
+    if (numChanges != 2 || surplusChange == NULL || surplusChange->newMip != 3 || highChange == NULL || highChange->newMip != 0)
+    {
+        Fail("the surplus mip wasn't the one evicted for a promotion");
+    }
+
+    // Without surplus, the lowest priority below the promoted texture's goes first: 100 for 120,
+    // the texture at 128 isn't touched.
+    r->budgetBytes = r->residentBytes;
+    sizes[medium] = 120.0f;
+    numChanges = RunFrame(r, sizes, changes);
+    const ResidencyChange* lowestChange = FindChange(changes, numChanges, lowest);
+    const ResidencyChange* mediumChange = FindChange(changes, numChanges, medium);
+    if (numChanges != 2 || lowestChange == NULL || lowestChange->newMip != 2 || mediumChange == NULL || mediumChange->newMip != 1)
+    {
+        Fail("the lowest priority texture wasn't the one evicted for a promotion");
+    }
+    if (r->residentBytes > r->budgetBytes)
+    {
+        Fail("a promotion went over the budget");
+    }
+}
+
+static void CheckShrinkingBudget(TextureResidency* r, ResidencyChange* changes)
+{
+    f32 sizes[8];
+    Residency_Init(r, Megabytes(64), Megabytes(64));
+    for (u32 i = 0; i < ARRAY_LEN(sizes); ++i)
+    {
+        Residency_AddTexture(r, 1024, 1024, 11, 16);
+        sizes[i] = 1100.0f + 100.0f * (f32)i;
+    }
+    for (u32 f = 0; f < 8; ++f)
+    {
+        RunFrame(r, sizes, changes);
+    }
+    const u64 tailBytes = (u64)ARRAY_LEN(sizes) * Residency_GetChainBytes(&r->textures[0], r->textures[0].tailMip);
+
+    // half of the detail goes, from the lowest priority up
+    r->budgetBytes = tailBytes + (r->residentBytes - tailBytes) / 2;
+    const u32 numChanges = RunFrame(r, sizes, changes);
+    if (numChanges == 0 || r->residentBytes > r->budgetBytes || r->numPromoted != 0)
+    {
+        Fail("a smaller budget didn't evict down to it");
+    }
+    for (u32 c = 0; c < numChanges; ++c)
+    {
+        if (changes[c].newMip <= changes[c].oldMip)
+        {
+            Fail("a smaller budget promoted a texture");
+        }
+    }
+    for (u32 i = 1; i < r->numTextures; ++i)
+    {
+        if (r->textures[i].residentMip > r->textures[i - 1].residentMip)
+        {
+            Fail("a smaller budget evicted a higher priority texture first");
+        }
+    }
+
+    // the tails stay even when they don't fit
+    r->budgetBytes = tailBytes / 2;
+    RunFrame(r, sizes, changes);
+    if (r->residentBytes != tailBytes)
+    {
+        Fail("a budget below the tails didn't evict down to exactly the tails");
+    }
+}
+
+static void CheckNoPingPong(TextureResidency* r, ResidencyChange* changes)
+{
+    // 256^2 BC7 needs 16 KB for mip 1, 128^2 BC4 needs 8 KB for mip 0, and there's 10 KB free.
+    // The first one can't fit even with the second one evicted, so it must not evict it.
+    Residency_Init(r, Megabytes(64), Megabytes(4));
+    const u32 high = Residency_AddTexture(r, 256, 256, 9, 16);
+    const u32 low = Residency_AddTexture(r, 128, 128, 8, 8);
+    r->budgetBytes = r->residentBytes + Kilobytes(10);
+
+    f32 sizes[2];
+    sizes[high] = 1000.0f;
+    sizes[low] = 200.0f;
+    u32 numChanges = RunFrame(r, sizes, changes);
+    if (numChanges != 1 || changes[0].textureIndex != low || changes[0].newMip != 0)
+    {
+        Fail("the texture that fits wasn't promoted");
+    }
+
+    for (u32 f = 0; f < 16; ++f)
+    {
+        numChanges = RunFrame(r, sizes, changes);
+        if (numChanges != 0)
+        {
+            Fail(fmt("frame %u changed %u textures, a promotion that can't fit ping-pongs with its victims", f + 1, numChanges));
+        }
+    }
+}
+
+struct ResidencyBench
+{
+    TextureResidency* residency;
+    ResidencyChange* changes;
+    f32* sizes; // RESIDENCY_BENCH_FRAMES x RESIDENCY_BENCH_TEXTURES
+};
+
+// a camera flying through a scene, the budget holds about a third of everything
+static u64 RunResidencyFrames(void* userData)
+{
+    ResidencyBench* bench = (ResidencyBench*)userData;
+    TextureResidency* r = bench->residency;
+    Residency_Init(r, Megabytes(96), Megabytes(4));
+    for (u32 i = 0; i < RESIDENCY_BENCH_TEXTURES; ++i)
+    {
+        const u32 size = 256 << (i % 4);
+        Residency_AddTexture(r, size, size, 9 + (i % 4), (i & 1) ? 16 : 8);
+    }
+
+    u64 sum = 0;
+    for (u32 f = 0; f < RESIDENCY_BENCH_FRAMES; ++f)
+    {
+        sum += RunFrame(r, &bench->sizes[f * RESIDENCY_BENCH_TEXTURES], bench->changes);
+        if (r->residentBytes > r->budgetBytes)
+        {
+            Fail("a frame ended over the budget");
+        }
+    }
+    return sum;
+}
+
+void Benchmark_TextureResidency()
+{
+    if (!ShouldRunBenchmark("TextureResidency"))
+    {
+        return;
+    }
+
+    // the state is about 10 KB, too large for the stack of the checks
+    TextureResidency* r = PushStruct(&benchSettings.arena, TextureResidency);
+    ResidencyChange* changes = PushArray(&benchSettings.arena, RESIDENCY_MAX_TEXTURES, ResidencyChange);
+    CheckTailMips(r);
+    CheckWantedMips(r);
+    CheckUploadCap(r, changes);
+    CheckEvictionOrder(r, changes);
+    CheckShrinkingBudget(r, changes);
+    CheckNoPingPong(r, changes);
+
+    ResidencyBench bench;
+    bench.residency = r;
+    bench.changes = changes;
+    bench.sizes = PushArray(&benchSettings.arena, RESIDENCY_BENCH_FRAMES * RESIDENCY_BENCH_TEXTURES, f32);
+    u32 randomState = 0x9E3779B9;
+    for (u32 i = 0; i < RESIDENCY_BENCH_TEXTURES; ++i)
+    {
+        randomState = randomState * 1664525 + 1013904223;
+        const f32 phase = (f32)(randomState >> 8) / (f32)(1 << 24) * 6.2831853f;
+        for (u32 f = 0; f < RESIDENCY_BENCH_FRAMES; ++f)
+        {
+            // most textures far away, some close, drifting as the camera moves
+            const f32 wave = sinf(phase + (f32)f * 0.1f);
+            bench.sizes[f * RESIDENCY_BENCH_TEXTURES + i] = wave > 0.0f ? 32.0f + 2000.0f * wave * wave * wave : 0.0f;
+        }
+    }
+    RunBenchmark(fmt("TextureResidency update: %u textures, %u frames", RESIDENCY_BENCH_TEXTURES, RESIDENCY_BENCH_FRAMES),
+        RESIDENCY_BENCH_FRAMES, &RunResidencyFrames, &bench);
+}
@@ -0,0 +1,252 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define ARENA_THREADS 4
+#define ARENA_ITEMS_PER_THREAD (1 << 16)
+
+// Every item is a scope with a few small temporary allocations, like a worker processing a triangle or a block.
+struct ArenaBench
+{
+    u64 itemsPerThread;
+    AtomicArena atomicArena;
+    MemoryArena lockedArena;
+    Mutex lockedMutex;
+    volatile s32 checksum;
+};
+
+typedef void (*ArenaWorker)(void* userData);
+
+static void Fail(const char* message)
+{
+    Sys_FatalError("arena check failed: %s", message);
+}
+
+// one frame of R_DrawFrame: the command queue and whatever else the frame needs in a temporary scope
+static void RunTransientFrame(MemoryArena* arena, size_t frameSize)
+{
+    TemporaryMemory frameMemory = BeginTemporaryMemory(arena);
+    PushSize(arena, Megabytes(4));
+    PushSize(arena, frameSize - Megabytes(4));
+    EndTemporaryMemory(frameMemory);
+    CheckArena(arena);
+}
+
+// A virtual arena that is filled and emptied every frame must not decommit and commit its pages
+// every frame, but a peak that doesn't come back has to be given back.
+static void CheckTransientArenaCommit()
+{
+    MemoryArena arena;
+    AllocateVirtualArena(&arena, Megabytes(256), "transient check arena");
+
+    const size_t frameSize = Megabytes(4) + Kilobytes(64);
+    RunTransientFrame(&arena, frameSize);
+    for (u32 f = 1; f < 4 * ARENA_DECOMMIT_WINDOW; ++f)
+    {
+        RunTransientFrame(&arena, frameSize);
+        if (arena.committed < frameSize)
+        {
+            Fail(fmt("the transient arena decommitted its pages at frame %u", f));
+        }
+    }
+
+    // a frame that needs a lot more every now and then keeps its pages after the first time
+    for (u32 f = 0; f < 2 * ARENA_DECOMMIT_WINDOW; ++f)
+    {
+        RunTransientFrame(&arena, f % 16 == 0 ? Megabytes(64) : frameSize);
+        if (f >= 16 && arena.committed < Megabytes(64))
+        {
+            Fail(fmt("a recurring peak was decommitted at frame %u", f));
+        }
+    }
+    // and gives them back once it stops
+    for (u32 f = 0; f < 2 * ARENA_DECOMMIT_WINDOW; ++f)
+    {
+        RunTransientFrame(&arena, frameSize);
+    }
+    if (arena.committed > frameSize + ARENA_DECOMMIT_THRESHOLD)
+    {
+        Fail(fmt("%s are still committed long after the peak", FormatBytes(arena.committed)));
+    }
+
+    // a one-off scope far above the recent ones is given back right away
+    TemporaryMemory loadMemory = BeginTemporaryMemory(&arena);
+    PushSize(&arena, Megabytes(128));
+    EndTemporaryMemory(loadMemory);
+    if (arena.committed > frameSize + ARENA_DECOMMIT_THRESHOLD)
+    {
+        Fail("a one-off scope stayed committed");
+    }
+
+    FreeVirtualArena(&arena);
+}
+
+// the blocks escape so that the compiler can't remove the allocations
+static THREAD_LOCAL u8* volatile blockSink;
+
+static u64 TouchBlocks(u8* a, u8* b, u8* c)
+{
+    blockSink = a;
+    blockSink = b;
+    blockSink = c;
+    a[0] = 1;
+    b[0] = 2;
+    c[0] = 3;
+    return a[0] + b[0] + c[0];
+}
+
+static void MallocWorker(void* userData)
+{
+    ArenaBench* bench = (ArenaBench*)userData;
+    u64 sum = 0;
+    for (u64 i = 0; i < bench->itemsPerThread; ++i)
+    {
+        u8* a = (u8*)malloc(64);
+        u8* b = (u8*)malloc(256);
+        u8* c = (u8*)malloc(1024);
+        sum += TouchBlocks(a, b, c);
+        free(c);
+        free(b);
+        free(a);
+    }
+    Sys_AtomicIncrement(&bench->checksum);
+    (void)sum;
+}
+
+static void ScratchWorker(void* userData)
+{
+    ArenaBench* bench = (ArenaBench*)userData;
+    u64 sum = 0;
+    for (u64 i = 0; i < bench->itemsPerThread; ++i)
+    {
+        ScratchMemory scratch;
+        u8* a = (u8*)PushSize(scratch.arena, 64);
+        u8* b = (u8*)PushSize(scratch.arena, 256);
+        u8* c = (u8*)PushSize(scratch.arena, 1024);
+        sum += TouchBlocks(a, b, c);
+    }
+    Sys_AtomicIncrement(&bench->checksum);
+    (void)sum;
+}
+
+// shared frame arena: blocks are kept until the reset
+static void AtomicWorker(void* userData)
+{
+    ArenaBench* bench = (ArenaBench*)userData;
+    u64 sum = 0;
+    for (u64 i = 0; i < bench->itemsPerThread; ++i)
+    {
+        u8* a = (u8*)AtomicPushSize(&bench->atomicArena, 16);
+        u8* b = (u8*)AtomicPushSize(&bench->atomicArena, 32);
+        u8* c = (u8*)AtomicPushSize(&bench->atomicArena, 48);
+        sum += TouchBlocks(a, b, c);
+    }
+    Sys_AtomicIncrement(&bench->checksum);
+    (void)sum;
+}
+
+static u8* LockedPush(ArenaBench* bench, size_t size)
+{
+    Sys_LockMutex(&bench->lockedMutex);
+    u8* result = (u8*)PushSize(&bench->lockedArena, size);
+    Sys_UnlockMutex(&bench->lockedMutex);
+    return result;
+}
+
+static void LockedWorker(void* userData)
+{
+    ArenaBench* bench = (ArenaBench*)userData;
+    u64 sum = 0;
+    for (u64 i = 0; i < bench->itemsPerThread; ++i)
+    {
+        u8* a = LockedPush(bench, 16);
+        u8* b = LockedPush(bench, 32);
+        u8* c = LockedPush(bench, 48);
+        sum += TouchBlocks(a, b, c);
+    }
+    Sys_AtomicIncrement(&bench->checksum);
+    (void)sum;
+}
+
+static u64 RunWorkers(ArenaBench* bench, ArenaWorker worker)
+{
+    bench->checksum = 0;
+    bench->atomicArena.mem_used = 0;
+    bench->lockedArena.mem_used = 0;
+
+    Thread* threads[ARENA_THREADS];
+    for (u32 t = 1; t < ARENA_THREADS; ++t)
+    {
+        threads[t] = Sys_CreateThread(worker, bench);
+    }
+    worker(bench);
+    for (u32 t = 1; t < ARENA_THREADS; ++t)
+    {
+        Sys_JoinThread(threads[t]);
+    }
+
+    return (u64)bench->checksum;
+}
+
+static u64 RunMalloc(void* userData) { return RunWorkers((ArenaBench*)userData, &MallocWorker); }
+static u64 RunScratch(void* userData) { return RunWorkers((ArenaBench*)userData, &ScratchWorker); }
+static u64 RunAtomic(void* userData) { return RunWorkers((ArenaBench*)userData, &AtomicWorker); }
+static u64 RunLocked(void* userData) { return RunWorkers((ArenaBench*)userData, &LockedWorker); }
+
+void Benchmark_ThreadArena()
+{
+    if (!ShouldRunBenchmark("ThreadArena"))
+    {
+        return;
+    }
+
+    CheckTransientArenaCommit();
+
+    ArenaBench bench = {};
+    bench.itemsPerThread = (u64)ARENA_ITEMS_PER_THREAD * benchSettings.scale;
+
+    // 3 blocks of at most 48 bytes plus the debug header and guard per item
+    const size_t frameSize = (size_t)(bench.itemsPerThread * ARENA_THREADS * 3 * 96);
+    AllocateAtomicArena(&bench.atomicArena, frameSize, PushSize(&benchSettings.arena, frameSize), "atomic frame arena");
+    SubArena(&bench.lockedArena, &benchSettings.arena, frameSize, "locked frame arena");
+
+    const u64 numItems = bench.itemsPerThread * ARENA_THREADS;
+    RunBenchmark("ThreadArena scoped temporaries: malloc/free", numItems, &RunMalloc, &bench);
+    RunBenchmark("ThreadArena scoped temporaries: ScratchMemory", numItems, &RunScratch, &bench);
+    RunBenchmark("ThreadArena shared frame arena: mutex + PushSize", numItems, &RunLocked, &bench);
+    RunBenchmark("ThreadArena shared frame arena: AtomicArena", numItems, &RunAtomic, &bench);
+
+    CheckAtomicArena(&bench.atomicArena);
+}
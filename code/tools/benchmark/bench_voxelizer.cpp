@@ -0,0 +1,1505 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include "../../common/asset_pack.h"
+#include "../../common/job_system.h"
+#include "../../renderer/r_voxel_cpu.h"
+
+#define VOXELIZER_SCENE "Sponza/sponza_low"
+#define VOXELIZER_SCRATCH_SIZE Megabytes(128)
+#define VOXELIZER_MAX_GAP_DISTANCE 5 // Voxel_Init's
+#define CONE_TRACING_GRID_SIZE 128
+#define CONE_TRACING_MAX_POINTS 16384
+#define SVO_MAX_GRID_SIZE 512
+#define CLIPMAP_RESOLUTION 64
+#define CLIPMAP_CASCADES 4
+#define CLIPMAP_FRAMES 64 // the camera path goes there and back
+#define SPECULAR_CONE_RATIO 0.1f
+#define REVOXELIZATION_LIGHT_RADIUS 400.0f // SetupLights' lights reach across the atrium
+
+struct VoxelizerBench
+{
+    void* sceneData;
+    void* materialData;
+    CpuVoxelGeometry geometry;
+    Material* materials;
+
+    MemoryArena scratch; // reset before every run
+    CpuOpacityGrid grid;
+    u8* reference;
+    bool conservative;
+    CpuVoxelStats stats;
+
+    Light lights[2];
+    CpuVoxelLighting lighting;
+    CpuEmittanceGrid emittance;
+    CpuEmittanceGrid emittanceReference;
+
+    MemoryArena mipArena; // reset for every grid size
+    CpuOpacityMips mips;
+    CpuEmittanceMips emittanceMips;
+
+    CpuConeTraceSettings traceSettings;
+    vec3_t* tracePositions;
+    vec3_t* traceNormals;
+    u32 numTracePoints;
+    f32* traceOcclusion;
+    vec3_t* traceEmittance;
+
+    MemoryArena svoArena; // reset before every run, also used by the paged grid
+    CpuOpacitySvo svo;
+    u32 svoGridSize;
+    CpuPagedOpacityGrid paged;
+
+    CpuVoxelClipmap clipmap;
+    vec3_t cameraPath[CLIPMAP_FRAMES];
+    u64 clipmapVoxels; // voxelized by the last run
+
+    CpuVoxelOccupancy occupancy;
+    CpuCone* traceCones;
+
+    CpuEmittanceGrid fixedEmittance; // emittance after the gap fix, emittance stays as voxelized
+    CpuVoxelDirtyBricks dirty;
+    CpuVoxelDirtyBricks changed; // by the gap fix
+    bool revoxelizeOpacity;
+};
+
+// the .scene and .material files as written by MeshBaker, see ReadBinaryMeshFromFile
+static bool LoadScene(VoxelizerBench* bench)
+{
+    size_t sceneSize, materialSize;
+    if (!ReadEntireFile(&bench->sceneData, &sceneSize, fmt("%s/%s.scene", ASSET_DIR, VOXELIZER_SCENE)))
+    {
+        return false;
+    }
+    if (!ReadEntireFile(&bench->materialData, &materialSize, fmt("%s/%s.material", ASSET_DIR, VOXELIZER_SCENE)))
+    {
+        free(bench->sceneData);
+        return false;
+    }
+
+    const MeshFileHeader* header = (const MeshFileHeader*)bench->sceneData;
+    const u8* data = (const u8*)(header + 1);
+    bench->geometry.xyz = (const vec3_t*)data;
+    bench->geometry.tc = (const vec2_t*)(data + header->numVertexes * sizeof(vec3_t) * 2);
+    data += header->numVertexes * (sizeof(vec3_t) * 2 + sizeof(vec2_t)); // xyz, normal, tc
+    bench->geometry.indexes = (const u32*)data;
+    data += header->numIndexes * sizeof(u32);
+    bench->geometry.meshes = (const MeshFileMesh*)data;
+    bench->geometry.numMeshes = header->numMeshes;
+    bench->geometry.aabb.min = header->aabbMin;
+    bench->geometry.aabb.max = header->aabbMax;
+
+    // no albedo textures, the materials' average colors are used
+    const MaterialFileHeader* materialHeader = (const MaterialFileHeader*)bench->materialData;
+    const MeshFileMaterial* fileMaterials = (const MeshFileMaterial*)(materialHeader + 1);
+    bench->materials = PushArray(&benchSettings.arena, materialHeader->numMaterials, Material);
+    memset(bench->materials, 0, materialHeader->numMaterials * sizeof(Material));
+    for (u32 m = 0; m < materialHeader->numMaterials; ++m)
+    {
+        bench->materials[m].alphaTestedColor = fileMaterials[m].alphaTestedColor;
+        bench->materials[m].flags = fileMaterials[m].flags;
+    }
+    bench->geometry.materials = bench->materials;
+
+    return true;
+}
+
+static u64 RunVoxelizer(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    CpuVoxel_VoxelizeOpacity(&bench->grid, &bench->geometry, bench->conservative, &bench->scratch, &bench->stats);
+    return bench->stats.numBrickTriangles;
+}
+
+static u64 RunEmittanceVoxelizer(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    CpuVoxel_VoxelizeEmittance(&bench->emittance, &bench->geometry, &bench->lighting, bench->conservative, &bench->scratch, &bench->stats);
+    return bench->stats.numBrickTriangles;
+}
+
+static u64 RunOpacityMips(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_BuildOpacityMips(&bench->mips);
+    return bench->mips.levels[bench->mips.numLevels - 1][0];
+}
+
+static u64 RunVoxelizationFix(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_FixVoxelization(&bench->emittance, VOXELIZER_MAX_GAP_DISTANCE);
+    return bench->emittance.texels[3];
+}
+
+static u64 RunEmittanceMips(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_BuildEmittanceMips(&bench->emittanceMips);
+    return bench->emittanceMips.levels[bench->emittanceMips.numLevels - 1][0];
+}
+
+static u64 RunAmbientOcclusion(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_ComputeAmbientOcclusion(bench->traceOcclusion, &bench->mips, bench->tracePositions, bench->traceNormals, bench->numTracePoints, &bench->traceSettings);
+    return (u64)(bench->traceOcclusion[0] * 1000.0f);
+}
+
+static u64 RunIndirectDiffuse(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_ComputeIndirectDiffuse(bench->traceEmittance, bench->traceOcclusion, &bench->emittanceMips, bench->tracePositions, bench->traceNormals, bench->numTracePoints, &bench->traceSettings);
+    return (u64)(bench->traceEmittance[0].x * 1000.0f);
+}
+
+static u64 RunSvoBuilder(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    bench->svoArena.mem_used = 0;
+    CpuVoxel_BuildOpacitySvo(&bench->svo, &bench->svoArena, &bench->geometry, bench->svoGridSize, false, &bench->scratch, &bench->stats);
+    return bench->svo.numBricks;
+}
+
+static u64 RunSvoAmbientOcclusion(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_ComputeAmbientOcclusion(bench->traceOcclusion, &bench->svo, bench->tracePositions, bench->traceNormals, bench->numTracePoints, &bench->traceSettings);
+    return (u64)(bench->traceOcclusion[0] * 1000.0f);
+}
+
+static u64 RunPagedBuilder(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    bench->svoArena.mem_used = 0;
+    const uint3_t gridSize = { bench->svoGridSize, bench->svoGridSize, bench->svoGridSize };
+    CpuVoxel_BuildPagedOpacityGrid(&bench->paged, &bench->svoArena, &bench->geometry, gridSize, false, &bench->scratch, &bench->stats);
+    return bench->paged.numBricks;
+}
+
+static u64 RunPagedAmbientOcclusion(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_ComputeAmbientOcclusion(bench->traceOcclusion, &bench->paged, bench->tracePositions, bench->traceNormals, bench->numTracePoints, &bench->traceSettings);
+    return (u64)(bench->traceOcclusion[0] * 1000.0f);
+}
+
+static u64 RunOccupancyBuilder(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_BuildOccupancy(&bench->occupancy, &bench->grid);
+    return bench->occupancy.levels[bench->occupancy.numLevels - 1].words[0];
+}
+
+static u64 RunSpecularCones(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_TraceEmittanceCones(bench->traceEmittance, bench->traceOcclusion, &bench->emittanceMips, bench->traceCones, bench->numTracePoints, &bench->traceSettings);
+    return (u64)(bench->traceEmittance[0].x * 1000.0f);
+}
+
+static u64 RunFullRevoxelization(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    if (bench->revoxelizeOpacity)
+    {
+        CpuVoxel_VoxelizeOpacity(&bench->grid, &bench->geometry, false, &bench->scratch, NULL);
+        CpuVoxel_BuildOpacityMips(&bench->mips);
+    }
+    CpuVoxel_VoxelizeEmittance(&bench->emittance, &bench->geometry, &bench->lighting, false, &bench->scratch, NULL);
+    memcpy(bench->fixedEmittance.texels, bench->emittance.texels, CpuVoxel_NumTexels(bench->emittance.gridSize) * 4 * sizeof(u16));
+    CpuVoxel_FixVoxelization(&bench->fixedEmittance, VOXELIZER_MAX_GAP_DISTANCE);
+    CpuVoxel_BuildEmittanceMips(&bench->emittanceMips);
+    return bench->emittanceMips.levels[bench->emittanceMips.numLevels - 1][0];
+}
+
+static u64 RunIncrementalRevoxelization(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    if (bench->revoxelizeOpacity)
+    {
+        CpuVoxel_VoxelizeOpacityBricks(&bench->grid, &bench->geometry, &bench->dirty, false, &bench->scratch);
+        CpuVoxel_UpdateOpacityMips(&bench->mips, &bench->dirty);
+    }
+    CpuVoxel_VoxelizeEmittanceBricks(&bench->emittance, &bench->geometry, &bench->lighting, &bench->dirty, false, &bench->scratch);
+    CpuVoxel_ClearDirtyBricks(&bench->changed);
+    CpuVoxel_FixVoxelizationBricks(&bench->fixedEmittance, &bench->emittance, VOXELIZER_MAX_GAP_DISTANCE, &bench->dirty, &bench->changed);
+    CpuVoxel_UpdateEmittanceMips(&bench->emittanceMips, &bench->changed);
+    return bench->emittanceMips.levels[bench->emittanceMips.numLevels - 1][0];
+}
+
+static void InvalidateClipmap(CpuVoxelClipmap* clipmap)
+{
+    for (u32 c = 0; c < clipmap->numCascades; ++c)
+    {
+        clipmap->cascades[c].valid = false;
+    }
+}
+
+static u64 RunClipmapFullUpdate(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    InvalidateClipmap(&bench->clipmap);
+    bench->clipmapVoxels = CpuVoxel_UpdateClipmap(&bench->clipmap, &bench->geometry, bench->cameraPath[0], false, &bench->scratch);
+    return bench->clipmapVoxels;
+}
+
+// to the end of the path and back, so every run starts where the previous one stopped
+static u64 RunClipmapPath(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    bench->scratch.mem_used = 0;
+    bench->clipmapVoxels = 0;
+    for (u32 f = 1; f < CLIPMAP_FRAMES * 2 - 1; ++f)
+    {
+        const u32 frame = f < CLIPMAP_FRAMES ? f : CLIPMAP_FRAMES * 2 - 2 - f;
+        bench->clipmapVoxels += CpuVoxel_UpdateClipmap(&bench->clipmap, &bench->geometry, bench->cameraPath[frame], false, &bench->scratch);
+    }
+    return bench->clipmapVoxels;
+}
+
+static u64 RunClipmapAmbientOcclusion(void* userData)
+{
+    VoxelizerBench* bench = (VoxelizerBench*)userData;
+    CpuVoxel_ComputeAmbientOcclusion(bench->traceOcclusion, &bench->clipmap, bench->tracePositions, bench->traceNormals, bench->numTracePoints, &bench->traceSettings);
+    return (u64)(bench->traceOcclusion[0] * 1000.0f);
+}
+
+// the 2 spot lights that LoadSceneAssets starts with, without shadows
+static void SetupLights(VoxelizerBench* bench)
+{
+    const vec3_t extent = bench->geometry.aabb.max - bench->geometry.aabb.min;
+    Light e = {};
+    e.position = bench->geometry.aabb.min + extent / 2;
+    e.position.x = -190.0f;
+    e.color = { 1.0f, 1.0f, 1.0f, 1.0f };
+    e.radius = 1000.0f;
+    e.azimuth = 230.0f;
+    e.inclination = 60.0f;
+    e.dir.x = cos(TO_RADIANS(e.azimuth)) * sin(TO_RADIANS(e.inclination));
+    e.dir.y = sin(TO_RADIANS(e.azimuth)) * sin(TO_RADIANS(e.inclination));
+    e.dir.z = cos(TO_RADIANS(e.inclination));
+    e.umbraAngle = TO_DEGREES(1.334f);
+    e.penumbraAngle = TO_DEGREES(0.175f);
+    bench->lights[0] = e;
+
+    e.position = { -500.0f, 720.0f, -24.0f };
+    e.color = { 1.0f, 0.0f, 0.0f, 1.0f };
+    e.inclination = 135.0f;
+    e.dir.x = cos(TO_RADIANS(e.azimuth)) * sin(TO_RADIANS(e.inclination));
+    e.dir.y = sin(TO_RADIANS(e.azimuth)) * sin(TO_RADIANS(e.inclination));
+    e.dir.z = cos(TO_RADIANS(e.inclination));
+    bench->lights[1] = e;
+
+    bench->lighting.lights = bench->lights;
+    bench->lighting.numLights = ARRAY_LEN(bench->lights);
+}
+
+static u64 CountFilledTexels(const CpuOpacityGrid* grid)
+{
+    u64 count = 0;
+    const size_t numTexels = CpuVoxel_NumTexels(grid->gridSize);
+    for (size_t i = 0; i < numTexels; ++i)
+    {
+        count += grid->texels[i] != 0;
+    }
+    return count;
+}
+
+void Benchmark_Voxelizer()
+{
+    if (!ShouldRunBenchmark("Voxelizer"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Voxelizer: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+
+    // the runs only use the scratch arena, RunBenchmark resets the benchmark arena
+    const uint3_t maxGridSize = { 256, 256, 256 };
+    bench.reference = (u8*)PushSize(&benchSettings.arena, CpuVoxel_NumTexels(maxGridSize));
+    bench.grid.texels = (u8*)PushSize(&benchSettings.arena, CpuVoxel_NumTexels(maxGridSize));
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+
+    const u32 numThreads = Sys_GetCoreCount();
+    for (u32 size = 64; size <= 256; size *= 2)
+    {
+        const uint3_t gridSize = { size, size, size };
+        bench.grid.gridSize = gridSize;
+        const size_t numTexels = CpuVoxel_NumTexels(gridSize);
+        for (u32 c = 0; c < 2; ++c)
+        {
+            bench.conservative = c == 1;
+            const char* mode = bench.conservative ? "conservative" : "standard";
+
+            RunBenchmark(fmt("Voxelizer Sponza %u^3 %s: 1 thread", size, mode), size * size * size, &RunVoxelizer, &bench);
+            memcpy(bench.reference, bench.grid.texels, numTexels);
+
+            // the grid doesn't depend on the order the bricks and triangles were processed in
+            Job_Init(numThreads - 1);
+            RunBenchmark(fmt("Voxelizer Sponza %u^3 %s: %u threads", size, mode, numThreads), size * size * size, &RunVoxelizer, &bench);
+            Job_Shutdown();
+            if (memcmp(bench.reference, bench.grid.texels, numTexels) != 0)
+            {
+                Sys_FatalError("Voxelizer: the multi-threaded grid differs from the single-threaded one");
+            }
+
+            printf("    %u triangles, %u bricks, %u triangle/brick pairs, %llu filled texels\n",
+                bench.stats.numTriangles, bench.stats.numBricks, bench.stats.numBrickTriangles,
+                (unsigned long long)CountFilledTexels(&bench.grid));
+        }
+    }
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+void Benchmark_EmittanceVoxelizer()
+{
+    if (!ShouldRunBenchmark("Voxelizer"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Voxelizer: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+    SetupLights(&bench);
+
+    // 8 bytes per texel plus the normals, 128^3 is as far as the benchmark arena goes
+    const uint3_t maxGridSize = { 128, 128, 128 };
+    CpuVoxel_AllocateEmittanceGrid(&bench.emittance, &benchSettings.arena, maxGridSize, true);
+    CpuVoxel_AllocateEmittanceGrid(&bench.emittanceReference, &benchSettings.arena, maxGridSize, true);
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+
+    const u32 numThreads = Sys_GetCoreCount();
+    for (u32 size = 64; size <= 128; size *= 2)
+    {
+        const uint3_t gridSize = { size, size, size };
+        bench.emittance.gridSize = gridSize;
+        const size_t numTexels = CpuVoxel_NumTexels(gridSize);
+        for (u32 c = 0; c < 2; ++c)
+        {
+            bench.conservative = c == 1;
+            const char* mode = bench.conservative ? "conservative" : "standard";
+
+            RunBenchmark(fmt("Voxelizer emittance Sponza %u^3 %s: 1 thread", size, mode), size * size * size, &RunEmittanceVoxelizer, &bench);
+            memcpy(bench.emittanceReference.texels, bench.emittance.texels, numTexels * 4 * sizeof(u16));
+            memcpy(bench.emittanceReference.normals, bench.emittance.normals, numTexels * sizeof(u32));
+
+            // the bricks sum their samples in draw order, whichever thread gets them
+            Job_Init(numThreads - 1);
+            RunBenchmark(fmt("Voxelizer emittance Sponza %u^3 %s: %u threads", size, mode, numThreads), size * size * size, &RunEmittanceVoxelizer, &bench);
+            Job_Shutdown();
+            if (memcmp(bench.emittanceReference.texels, bench.emittance.texels, numTexels * 4 * sizeof(u16)) != 0 ||
+                memcmp(bench.emittanceReference.normals, bench.emittance.normals, numTexels * sizeof(u32)) != 0)
+            {
+                Sys_FatalError("Voxelizer: the multi-threaded emittance differs from the single-threaded one");
+            }
+
+            u64 numLit = 0;
+            for (size_t i = 0; i < numTexels; ++i)
+            {
+                const u16* rgba = &bench.emittance.texels[i * 4];
+                numLit += (rgba[0] | rgba[1] | rgba[2]) != 0;
+            }
+            printf("    %u triangles, %u bricks, %llu lit texels\n",
+                bench.stats.numTriangles, bench.stats.numBricks, (unsigned long long)numLit);
+        }
+    }
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+// the voxels written by the mip builders, levels 1 and up
+static u64 CountMipVoxels(uint3_t gridSize, u32 numLevels)
+{
+    u64 count = 0;
+    for (u32 m = 1; m < numLevels; ++m)
+    {
+        const uint3_t size = CpuVoxel_MipSize(gridSize, m);
+        count += (u64)size.w * size.h * size.d;
+    }
+    return count;
+}
+
+static void PrintMillionsPerSecond(u64 count, u64 microseconds, const char* unit)
+{
+    if (microseconds > 0)
+    {
+        printf("    %.1f M %s/s\n", (f64)count / (f64)microseconds, unit);
+    }
+}
+
+static void PrintVoxelsPerSecond(u64 numVoxels, u64 microseconds)
+{
+    PrintMillionsPerSecond(numVoxels, microseconds, "voxels");
+}
+
+void Benchmark_VoxelMips()
+{
+    if (!ShouldRunBenchmark("Voxel mips"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Voxel mips: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+    SetupLights(&bench);
+
+    // RunBenchmark resets the benchmark arena, everything is allocated up front
+    const uint3_t maxGridSize = { 256, 256, 256 };
+    const uint3_t maxEmittanceGridSize = { 128, 128, 128 };
+    bench.grid.texels = (u8*)PushSize(&benchSettings.arena, CpuVoxel_NumTexels(maxGridSize));
+    CpuVoxel_AllocateEmittanceGrid(&bench.emittance, &benchSettings.arena, maxEmittanceGridSize, false);
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+    SubArena(&bench.mipArena, &benchSettings.arena, Megabytes(40), "Voxel mips");
+
+    const u32 numThreads = Sys_GetCoreCount();
+    for (u32 size = 128; size <= 256; size *= 2)
+    {
+        const uint3_t gridSize = { size, size, size };
+        bench.grid.gridSize = gridSize;
+        bench.scratch.mem_used = 0;
+        CpuVoxel_VoxelizeOpacity(&bench.grid, &bench.geometry, false, &bench.scratch, NULL);
+
+        bench.mipArena.mem_used = 0;
+        CpuOpacityMips reference;
+        CpuVoxel_AllocateOpacityMips(&bench.mips, &bench.mipArena, &bench.grid);
+        CpuVoxel_AllocateOpacityMips(&reference, &bench.mipArena, &bench.grid);
+        const u64 numVoxels = CountMipVoxels(gridSize, bench.mips.numLevels);
+
+        PrintVoxelsPerSecond(numVoxels, RunBenchmark(fmt("Voxel mips opacity Sponza %u^3: 1 thread", size), numVoxels, &RunOpacityMips, &bench));
+        for (u32 m = 1; m < bench.mips.numLevels; ++m)
+        {
+            memcpy(reference.levels[m], bench.mips.levels[m], CpuVoxel_NumTexels(CpuVoxel_MipSize(gridSize, m)));
+        }
+
+        Job_Init(numThreads - 1);
+        PrintVoxelsPerSecond(numVoxels, RunBenchmark(fmt("Voxel mips opacity Sponza %u^3: %u threads", size, numThreads), numVoxels, &RunOpacityMips, &bench));
+        Job_Shutdown();
+        for (u32 m = 1; m < bench.mips.numLevels; ++m)
+        {
+            if (memcmp(reference.levels[m], bench.mips.levels[m], CpuVoxel_NumTexels(CpuVoxel_MipSize(gridSize, m))) != 0)
+            {
+                Sys_FatalError("Voxel mips: the multi-threaded opacity mips differ from the single-threaded ones");
+            }
+        }
+    }
+
+    {
+        const uint3_t gridSize = maxEmittanceGridSize;
+        bench.emittance.gridSize = gridSize;
+        bench.scratch.mem_used = 0;
+        CpuVoxel_VoxelizeEmittance(&bench.emittance, &bench.geometry, &bench.lighting, false, &bench.scratch, NULL);
+
+        // the gap filling comes before the mips like in Voxel_Run, the runs after the first
+        // one find nothing new to fill, so the timings are mostly the scanning
+        const u64 numGridVoxels = (u64)gridSize.w * gridSize.h * gridSize.d;
+        PrintVoxelsPerSecond(numGridVoxels, RunBenchmark(fmt("Voxel mips gap filling Sponza %u^3: 1 thread", gridSize.w), numGridVoxels, &RunVoxelizationFix, &bench));
+        Job_Init(numThreads - 1);
+        PrintVoxelsPerSecond(numGridVoxels, RunBenchmark(fmt("Voxel mips gap filling Sponza %u^3: %u threads", gridSize.w, numThreads), numGridVoxels, &RunVoxelizationFix, &bench));
+        Job_Shutdown();
+
+        bench.mipArena.mem_used = 0;
+        CpuEmittanceMips reference;
+        CpuVoxel_AllocateEmittanceMips(&bench.emittanceMips, &bench.mipArena, &bench.emittance);
+        CpuVoxel_AllocateEmittanceMips(&reference, &bench.mipArena, &bench.emittance);
+        const u64 numVoxels = CountMipVoxels(gridSize, bench.emittanceMips.numLevels);
+
+        PrintVoxelsPerSecond(numVoxels, RunBenchmark(fmt("Voxel mips emittance Sponza %u^3: 1 thread", gridSize.w), numVoxels, &RunEmittanceMips, &bench));
+        for (u32 m = 1; m < bench.emittanceMips.numLevels; ++m)
+        {
+            memcpy(reference.levels[m], bench.emittanceMips.levels[m], CpuVoxel_NumTexels(CpuVoxel_MipSize(gridSize, m)) * 4 * sizeof(u16));
+        }
+
+        Job_Init(numThreads - 1);
+        PrintVoxelsPerSecond(numVoxels, RunBenchmark(fmt("Voxel mips emittance Sponza %u^3: %u threads", gridSize.w, numThreads), numVoxels, &RunEmittanceMips, &bench));
+        Job_Shutdown();
+        for (u32 m = 1; m < bench.emittanceMips.numLevels; ++m)
+        {
+            if (memcmp(reference.levels[m], bench.emittanceMips.levels[m], CpuVoxel_NumTexels(CpuVoxel_MipSize(gridSize, m)) * 4 * sizeof(u16)) != 0)
+            {
+                Sys_FatalError("Voxel mips: the multi-threaded emittance mips differ from the single-threaded ones");
+            }
+        }
+    }
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+// a point at the centroid of every few triangles, in grid space like deferred_shading.hlsl's position01 and normal01
+static void SetupTracePoints(VoxelizerBench* bench)
+{
+    const MeshFileMesh* lastMesh = &bench->geometry.meshes[bench->geometry.numMeshes - 1];
+    const u32 numTriangles = (lastMesh->firstIndex + lastMesh->numIndexes) / 3;
+    const u32 triangleStep = MAX(numTriangles / CONE_TRACING_MAX_POINTS, 1);
+    const vec3_t extent = bench->geometry.aabb.max - bench->geometry.aabb.min;
+    const vec3_t normalScale = { 1.0f / extent.x, 1.0f / extent.y, 1.0f / extent.z };
+
+    bench->numTracePoints = 0;
+    for (u32 t = 0; t < numTriangles && bench->numTracePoints < CONE_TRACING_MAX_POINTS; t += triangleStep)
+    {
+        const u32* indexes = &bench->geometry.indexes[t * 3];
+        const vec3_t v0 = bench->geometry.xyz[indexes[0]];
+        const vec3_t v1 = bench->geometry.xyz[indexes[1]];
+        const vec3_t v2 = bench->geometry.xyz[indexes[2]];
+        const vec3_t normal = cross(v1 - v0, v2 - v0);
+        if (dot(normal, normal) == 0.0f)
+        {
+            continue;
+        }
+
+        const vec3_t position = (v0 + v1 + v2) / 3.0f - bench->geometry.aabb.min;
+        const vec3_t position01 = { position.x / extent.x, position.y / extent.y, position.z / extent.z };
+        const vec3_t normal01 = { normal.x * normalScale.x, normal.y * normalScale.y, normal.z * normalScale.z };
+        bench->tracePositions[bench->numTracePoints] = position01;
+        bench->traceNormals[bench->numTracePoints] = norm(normal01);
+        bench->numTracePoints++;
+    }
+}
+
+void Benchmark_ConeTracing()
+{
+    if (!ShouldRunBenchmark("Cone tracing"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Cone tracing: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+    SetupLights(&bench);
+
+    // RunBenchmark resets the benchmark arena, everything is allocated up front
+    const uint3_t gridSize = { CONE_TRACING_GRID_SIZE, CONE_TRACING_GRID_SIZE, CONE_TRACING_GRID_SIZE };
+    CpuVoxel_AllocateOpacityGrid(&bench.grid, &benchSettings.arena, gridSize);
+    CpuVoxel_AllocateEmittanceGrid(&bench.emittance, &benchSettings.arena, gridSize, false);
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+    SubArena(&bench.mipArena, &benchSettings.arena, Megabytes(40), "Voxel mips");
+    bench.tracePositions = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceNormals = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+    bench.traceEmittance = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    f32* referenceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+    vec3_t* referenceEmittance = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+
+    CpuVoxel_VoxelizeOpacity(&bench.grid, &bench.geometry, false, &bench.scratch, NULL);
+    CpuVoxel_AllocateOpacityMips(&bench.mips, &bench.mipArena, &bench.grid);
+    CpuVoxel_BuildOpacityMips(&bench.mips);
+    bench.scratch.mem_used = 0;
+    CpuVoxel_VoxelizeEmittance(&bench.emittance, &bench.geometry, &bench.lighting, false, &bench.scratch, NULL);
+    CpuVoxel_FixVoxelization(&bench.emittance, VOXELIZER_MAX_GAP_DISTANCE);
+    CpuVoxel_AllocateEmittanceMips(&bench.emittanceMips, &bench.mipArena, &bench.emittance);
+    CpuVoxel_BuildEmittanceMips(&bench.emittanceMips);
+    SetupTracePoints(&bench);
+
+    // the defaults of the tracing constants in r_imgui.cpp
+    bench.traceSettings.stepScale = 0.5f;
+    bench.traceSettings.mipBias = 0.0f;
+    bench.traceSettings.maxDiameter = 8.0f;
+    bench.traceSettings.opacityThreshold = 0.95f;
+    bench.traceSettings.distanceScale = 200.0f;
+
+    const u32 numThreads = Sys_GetCoreCount();
+    const u32 numPoints = bench.numTracePoints;
+    {
+        const u64 numCones = (u64)numPoints * 17;
+        PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Cone tracing ambient occlusion Sponza %u^3: 1 thread", gridSize.w), numCones, &RunAmbientOcclusion, &bench), "cones");
+        memcpy(referenceOcclusion, bench.traceOcclusion, numPoints * sizeof(f32));
+
+        // a point's cones are traced by one thread, the result doesn't depend on the split
+        Job_Init(numThreads - 1);
+        PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Cone tracing ambient occlusion Sponza %u^3: %u threads", gridSize.w, numThreads), numCones, &RunAmbientOcclusion, &bench), "cones");
+        Job_Shutdown();
+        if (memcmp(referenceOcclusion, bench.traceOcclusion, numPoints * sizeof(f32)) != 0)
+        {
+            Sys_FatalError("Cone tracing: the multi-threaded occlusion differs from the single-threaded one");
+        }
+
+        f64 totalOcclusion = 0.0;
+        for (u32 p = 0; p < numPoints; ++p)
+        {
+            totalOcclusion += bench.traceOcclusion[p];
+        }
+        printf("    %u points, average occlusion %.3f\n", numPoints, totalOcclusion / (f64)numPoints);
+    }
+
+    {
+        const u64 numCones = (u64)numPoints * 9;
+        PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Cone tracing indirect diffuse Sponza %u^3: 1 thread", gridSize.w), numCones, &RunIndirectDiffuse, &bench), "cones");
+        memcpy(referenceOcclusion, bench.traceOcclusion, numPoints * sizeof(f32));
+        memcpy(referenceEmittance, bench.traceEmittance, numPoints * sizeof(vec3_t));
+
+        Job_Init(numThreads - 1);
+        PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Cone tracing indirect diffuse Sponza %u^3: %u threads", gridSize.w, numThreads), numCones, &RunIndirectDiffuse, &bench), "cones");
+        Job_Shutdown();
+        if (memcmp(referenceOcclusion, bench.traceOcclusion, numPoints * sizeof(f32)) != 0 ||
+            memcmp(referenceEmittance, bench.traceEmittance, numPoints * sizeof(vec3_t)) != 0)
+        {
+            Sys_FatalError("Cone tracing: the multi-threaded indirect diffuse differs from the single-threaded one");
+        }
+    }
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+// FNV-1a
+static u64 HashBytes(const void* data, size_t size, u64 hash)
+{
+    const u8* bytes = (const u8*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static u64 HashSvo(const CpuOpacitySvo* svo)
+{
+    u64 hash = 14695981039346656037ull;
+    hash = HashBytes(svo->nodes, svo->numNodes * sizeof(CpuSvoNode), hash);
+    hash = HashBytes(svo->bricks, (size_t)svo->numBricks * CPU_VOXEL_BRICK_TEXELS, hash);
+    return hash;
+}
+
+// the dense grid and its mips at the same resolution
+static size_t GetDenseOpacityMemory(u32 gridSize)
+{
+    const uint3_t size = { gridSize, gridSize, gridSize };
+    size_t memory = 0;
+    for (u32 m = 0; m < CpuVoxel_NumMipLevels(size); ++m)
+    {
+        memory += CpuVoxel_NumTexels(CpuVoxel_MipSize(size, m));
+    }
+    return memory;
+}
+
+void Benchmark_Svo()
+{
+    if (!ShouldRunBenchmark("SVO"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("SVO: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+
+    // RunBenchmark resets the benchmark arena, everything is allocated up front
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+    SubArena(&bench.svoArena, &benchSettings.arena, Megabytes(352), "SVO");
+    bench.tracePositions = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceNormals = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+    f32* referenceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+
+    const u32 numThreads = Sys_GetCoreCount();
+    for (u32 size = 128; size <= SVO_MAX_GRID_SIZE; size *= 2)
+    {
+        bench.svoGridSize = size;
+        const u64 numVoxels = (u64)size * size * size;
+        RunBenchmark(fmt("SVO build Sponza %u^3: 1 thread", size), numVoxels, &RunSvoBuilder, &bench);
+        const u64 reference = HashSvo(&bench.svo);
+
+        // the nodes are handed out in a fixed order and every brick has a single writer
+        Job_Init(numThreads - 1);
+        RunBenchmark(fmt("SVO build Sponza %u^3: %u threads", size, numThreads), numVoxels, &RunSvoBuilder, &bench);
+        Job_Shutdown();
+        if (HashSvo(&bench.svo) != reference)
+        {
+            Sys_FatalError("SVO: the multi-threaded SVO differs from the single-threaded one");
+        }
+
+        const size_t svoMemory = CpuVoxel_SvoMemory(&bench.svo);
+        const size_t denseMemory = GetDenseOpacityMemory(size);
+        printf("    %u nodes, %u bricks, %.1f MB vs %.1f MB dense with mips (%.1f%%)\n",
+            bench.svo.numNodes, bench.svo.numBricks, (f64)svoMemory / (f64)Megabytes(1), (f64)denseMemory / (f64)Megabytes(1),
+            100.0 * (f64)svoMemory / (f64)denseMemory);
+    }
+
+    // the SVO's texels are the dense mips', so tracing through either gives the same occlusion
+    const u32 size = CONE_TRACING_GRID_SIZE;
+    const uint3_t gridSize = { size, size, size };
+    bench.svoGridSize = size;
+    RunSvoBuilder(&bench);
+    bench.scratch.mem_used = 0;
+    CpuVoxel_AllocateOpacityGrid(&bench.grid, &bench.scratch, gridSize);
+    CpuVoxel_VoxelizeOpacity(&bench.grid, &bench.geometry, false, &bench.scratch, NULL);
+    CpuVoxel_AllocateOpacityMips(&bench.mips, &bench.scratch, &bench.grid);
+    CpuVoxel_BuildOpacityMips(&bench.mips);
+
+    SetupTracePoints(&bench);
+    bench.traceSettings.stepScale = 0.5f;
+    bench.traceSettings.mipBias = 0.0f;
+    bench.traceSettings.maxDiameter = 8.0f;
+    bench.traceSettings.opacityThreshold = 0.95f;
+    bench.traceSettings.distanceScale = 200.0f;
+
+    const u64 numCones = (u64)bench.numTracePoints * 17;
+    PrintMillionsPerSecond(numCones, RunBenchmark(fmt("SVO ambient occlusion Sponza %u^3: dense", size), numCones, &RunAmbientOcclusion, &bench), "cones");
+    memcpy(referenceOcclusion, bench.traceOcclusion, bench.numTracePoints * sizeof(f32));
+    PrintMillionsPerSecond(numCones, RunBenchmark(fmt("SVO ambient occlusion Sponza %u^3: SVO", size), numCones, &RunSvoAmbientOcclusion, &bench), "cones");
+    if (memcmp(referenceOcclusion, bench.traceOcclusion, bench.numTracePoints * sizeof(f32)) != 0)
+    {
+        Sys_FatalError("SVO: the occlusion traced through the SVO differs from the dense grid's");
+    }
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+static u64 HashPagedGrid(const CpuPagedOpacityGrid* grid)
+{
+    u64 hash = 14695981039346656037ull;
+    for (u32 m = 0; m < grid->numPagedLevels; ++m)
+    {
+        const uint3_t numCells = grid->levels[m].numCells;
+        hash = HashBytes(grid->levels[m].indirection, numCells.w * numCells.h * numCells.d * sizeof(u32), hash);
+    }
+    hash = HashBytes(grid->bricks, (size_t)grid->numBricks * CPU_VOXEL_BRICK_TEXELS, hash);
+    return hash;
+}
+
+// texels of the dense mips that the paged grid doesn't have
+static u64 CountPagedDifferences(const CpuPagedOpacityGrid* grid, const CpuOpacityMips* mips)
+{
+    u64 count = 0;
+    for (u32 m = 0; m < mips->numLevels; ++m)
+    {
+        const uint3_t size = CpuVoxel_MipSize(mips->gridSize, m);
+        for (u32 z = 0; z < size.d; ++z)
+        {
+            for (u32 y = 0; y < size.h; ++y)
+            {
+                for (u32 face = 0; face < VoxelFace::Count; ++face)
+                {
+                    for (u32 x = 0; x < size.w; ++x)
+                    {
+                        count += mips->levels[m][CpuVoxel_TexelIndex(size, x, y, z, face)] != CpuVoxel_GetPagedTexel(grid, m, x, y, z, face);
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+void Benchmark_PagedGrid()
+{
+    if (!ShouldRunBenchmark("Paged grid"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Paged grid: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+
+    // RunBenchmark resets the benchmark arena, everything is allocated up front
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+    SubArena(&bench.svoArena, &benchSettings.arena, Megabytes(352), "Paged grid");
+    bench.tracePositions = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceNormals = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+    f32* referenceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+
+    const u32 numThreads = Sys_GetCoreCount();
+    for (u32 size = 128; size <= SVO_MAX_GRID_SIZE; size *= 2)
+    {
+        bench.svoGridSize = size;
+        const u64 numVoxels = (u64)size * size * size;
+        RunBenchmark(fmt("Paged grid build Sponza %u^3: 1 thread", size), numVoxels, &RunPagedBuilder, &bench);
+        const u64 reference = HashPagedGrid(&bench.paged);
+
+        // the slots come from a prefix sum in cell order and every brick has a single writer
+        Job_Init(numThreads - 1);
+        RunBenchmark(fmt("Paged grid build Sponza %u^3: %u threads", size, numThreads), numVoxels, &RunPagedBuilder, &bench);
+        Job_Shutdown();
+        if (HashPagedGrid(&bench.paged) != reference)
+        {
+            Sys_FatalError("Paged grid: the multi-threaded grid differs from the single-threaded one");
+        }
+
+        const size_t pagedMemory = CpuVoxel_PagedOpacityMemory(&bench.paged);
+        const size_t denseMemory = GetDenseOpacityMemory(size);
+        printf("    %u bricks in %u paged levels, %.1f MB vs %.1f MB dense with mips (%.1f%%)\n",
+            bench.paged.numBricks, bench.paged.numPagedLevels, (f64)pagedMemory / (f64)Megabytes(1), (f64)denseMemory / (f64)Megabytes(1),
+            100.0 * (f64)pagedMemory / (f64)denseMemory);
+    }
+
+    // every texel and every traced cone must match the dense grid's
+    const u32 size = CONE_TRACING_GRID_SIZE;
+    const uint3_t gridSize = { size, size, size };
+    bench.svoGridSize = size;
+    RunPagedBuilder(&bench);
+    bench.scratch.mem_used = 0;
+    CpuVoxel_AllocateOpacityGrid(&bench.grid, &bench.scratch, gridSize);
+    CpuVoxel_VoxelizeOpacity(&bench.grid, &bench.geometry, false, &bench.scratch, NULL);
+    CpuVoxel_AllocateOpacityMips(&bench.mips, &bench.scratch, &bench.grid);
+    CpuVoxel_BuildOpacityMips(&bench.mips);
+    const u64 numDifferences = CountPagedDifferences(&bench.paged, &bench.mips);
+    if (numDifferences != 0)
+    {
+        Sys_FatalError("Paged grid: %llu texels differ from the dense mips", (unsigned long long)numDifferences);
+    }
+
+    SetupTracePoints(&bench);
+    bench.traceSettings.stepScale = 0.5f;
+    bench.traceSettings.mipBias = 0.0f;
+    bench.traceSettings.maxDiameter = 8.0f;
+    bench.traceSettings.opacityThreshold = 0.95f;
+    bench.traceSettings.distanceScale = 200.0f;
+
+    const u64 numCones = (u64)bench.numTracePoints * 17;
+    PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Paged grid ambient occlusion Sponza %u^3: dense", size), numCones, &RunAmbientOcclusion, &bench), "cones");
+    memcpy(referenceOcclusion, bench.traceOcclusion, bench.numTracePoints * sizeof(f32));
+    PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Paged grid ambient occlusion Sponza %u^3: paged", size), numCones, &RunPagedAmbientOcclusion, &bench), "cones");
+    if (memcmp(referenceOcclusion, bench.traceOcclusion, bench.numTracePoints * sizeof(f32)) != 0)
+    {
+        Sys_FatalError("Paged grid: the occlusion traced through the paged grid differs from the dense grid's");
+    }
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+// the dirty regions of every move must tile the part of the cascade that it didn't cover before
+static void CheckClipmapDirtyRegions(const CpuVoxelClipmap* clipmap)
+{
+    const s32 size = (s32)clipmap->resolution;
+    const s32 moves[] = { 0, 1, -1, 3, -7, size / 2, -size / 2, size - 1, 1 - size, size, -size - 5 };
+    const s32 oldOrigin[3] = { -37, 5, 1000 };
+    for (u32 i = 0; i < ARRAY_LEN(moves) * ARRAY_LEN(moves) * ARRAY_LEN(moves); ++i)
+    {
+        const u32 n = ARRAY_LEN(moves);
+        const s32 newOrigin[3] = { oldOrigin[0] + moves[i % n], oldOrigin[1] + moves[(i / n) % n], oldOrigin[2] + moves[i / (n * n)] };
+        CpuVoxelRegion regions[3];
+        const u32 numRegions = CpuVoxel_GetClipmapDirtyRegions(clipmap, oldOrigin, newOrigin, regions);
+
+        // the old cascade in the new one's voxels
+        s32 keptVolume = 1;
+        for (u32 a = 0; a < 3; ++a)
+        {
+            keptVolume *= MAX(size - abs(newOrigin[a] - oldOrigin[a]), 0);
+        }
+
+        s64 dirtyVolume = 0;
+        for (u32 r = 0; r < numRegions; ++r)
+        {
+            bool overlapsOld = true;
+            for (u32 a = 0; a < 3; ++a)
+            {
+                const s32 oldMin = oldOrigin[a] - newOrigin[a];
+                if (regions[r].min[a] < 0 || regions[r].max[a] > size || regions[r].min[a] >= regions[r].max[a])
+                {
+                    Sys_FatalError("Clipmap: dirty region %u of move %u is empty or outside the cascade", r, i);
+                }
+                overlapsOld &= regions[r].min[a] < oldMin + size && oldMin < regions[r].max[a];
+            }
+            if (overlapsOld && keptVolume > 0)
+            {
+                Sys_FatalError("Clipmap: dirty region %u of move %u overlaps the voxels kept from the old cascade", r, i);
+            }
+            for (u32 q = 0; q < r; ++q)
+            {
+                bool overlaps = true;
+                for (u32 a = 0; a < 3; ++a)
+                {
+                    overlaps &= regions[r].min[a] < regions[q].max[a] && regions[q].min[a] < regions[r].max[a];
+                }
+                if (overlaps)
+                {
+                    Sys_FatalError("Clipmap: dirty regions %u and %u of move %u overlap", q, r, i);
+                }
+            }
+            dirtyVolume += (s64)(regions[r].max[0] - regions[r].min[0]) * (regions[r].max[1] - regions[r].min[1]) * (regions[r].max[2] - regions[r].min[2]);
+        }
+
+        if (dirtyVolume + keptVolume != (s64)size * size * size)
+        {
+            Sys_FatalError("Clipmap: the dirty regions of move %u don't cover the new voxels", i);
+        }
+    }
+
+    // any resolution consecutive world voxels, negative ones included, get distinct texels
+    // and the voxels a resolution apart share theirs
+    const CpuClipmapCascade* cascade = &clipmap->cascades[0];
+    bool used[CLIPMAP_RESOLUTION] = {};
+    const s32 first = -size - 3;
+    for (s32 x = first; x < first + size; ++x)
+    {
+        const size_t index = CpuVoxel_ClipmapTexelIndex(cascade, x, 0, 0, VoxelFace::PosX);
+        if (index >= (size_t)size || used[index] ||
+            CpuVoxel_ClipmapTexelIndex(cascade, x + size, x - size, x + size * 3, VoxelFace::NegZ) != CpuVoxel_ClipmapTexelIndex(cascade, x, x, x, VoxelFace::NegZ))
+        {
+            Sys_FatalError("Clipmap: world voxel %d isn't stored at its own toroidal texel", x);
+        }
+        used[index] = true;
+    }
+}
+
+// texels that differ between the cascades of 2 clipmaps at the same origins
+static u64 CountClipmapDifferences(const CpuVoxelClipmap* a, const CpuVoxelClipmap* b)
+{
+    u64 count = 0;
+    for (u32 c = 0; c < a->numCascades; ++c)
+    {
+        const CpuOpacityGrid* gridA = &a->cascades[c].grid;
+        const CpuOpacityGrid* gridB = &b->cascades[c].grid;
+        const size_t numTexels = CpuVoxel_NumTexels(gridA->gridSize);
+        for (size_t i = 0; i < numTexels; ++i)
+        {
+            count += gridA->texels[i] != gridB->texels[i];
+        }
+    }
+    return count;
+}
+
+void Benchmark_Clipmap()
+{
+    if (!ShouldRunBenchmark("Clipmap"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Clipmap: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+
+    // cascade 0 has the voxels of a 256^3 grid over the scene and the last one covers all of it
+    const vec3_t extent = bench.geometry.aabb.max - bench.geometry.aabb.min;
+    const f32 voxelSize = MAX3(extent.x, extent.y, extent.z) / 256.0f;
+
+    // RunBenchmark resets the benchmark arena, everything is allocated up front
+    CpuVoxelClipmap reference;
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+    CpuVoxel_AllocateClipmap(&bench.clipmap, &benchSettings.arena, CLIPMAP_RESOLUTION, CLIPMAP_CASCADES, voxelSize);
+    CpuVoxel_AllocateClipmap(&reference, &benchSettings.arena, CLIPMAP_RESOLUTION, CLIPMAP_CASCADES, voxelSize);
+    bench.tracePositions = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceNormals = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+    f32* referenceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+
+    CheckClipmapDirtyRegions(&bench.clipmap);
+
+    // a walk along the length of the atrium, at a person's height
+    for (u32 f = 0; f < CLIPMAP_FRAMES; ++f)
+    {
+        const f32 t = 0.1f + 0.8f * (f32)f / (f32)(CLIPMAP_FRAMES - 1);
+        const vec3_t offset = { extent.x * t, extent.y * 0.15f, extent.z * 0.5f };
+        bench.cameraPath[f] = bench.geometry.aabb.min + offset;
+    }
+
+    const u32 numThreads = Sys_GetCoreCount();
+    const u32 numFrames = CLIPMAP_FRAMES * 2 - 2;
+    const u64 cascadeVoxels = (u64)CLIPMAP_RESOLUTION * CLIPMAP_RESOLUTION * CLIPMAP_RESOLUTION;
+    for (u32 t = 0; t < 2; ++t)
+    {
+        const u32 threads = t == 0 ? 1 : numThreads;
+        if (threads > 1)
+        {
+            Job_Init(threads - 1);
+        }
+
+        const char* threadCount = threads == 1 ? "1 thread" : fmt("%u threads", threads);
+        const u64 fullTime = RunBenchmark(fmt("Clipmap full update Sponza %u^3 x %u: %s", CLIPMAP_RESOLUTION, CLIPMAP_CASCADES, threadCount),
+            cascadeVoxels * CLIPMAP_CASCADES, &RunClipmapFullUpdate, &bench);
+        const u64 pathTime = RunBenchmark(fmt("Clipmap incremental updates Sponza %u^3 x %u: %s", CLIPMAP_RESOLUTION, CLIPMAP_CASCADES, threadCount),
+            numFrames, &RunClipmapPath, &bench);
+        if (fullTime > 0 && pathTime > 0)
+        {
+            printf("    %.2f ms and %llu voxels per frame vs %.2f ms and %llu voxels for a full update\n",
+                (f64)pathTime / (f64)numFrames / 1000.0, (unsigned long long)(bench.clipmapVoxels / numFrames),
+                (f64)fullTime / 1000.0, (unsigned long long)(cascadeVoxels * CLIPMAP_CASCADES));
+        }
+
+        if (threads > 1)
+        {
+            Job_Shutdown();
+        }
+    }
+
+    // walking the path keeps most of every cascade, which has to end up as a full update at its end
+    RunClipmapFullUpdate(&bench);
+    for (u32 f = 1; f < CLIPMAP_FRAMES; ++f)
+    {
+        CpuVoxel_UpdateClipmap(&bench.clipmap, &bench.geometry, bench.cameraPath[f], false, &bench.scratch);
+    }
+    CpuVoxel_UpdateClipmap(&reference, &bench.geometry, bench.cameraPath[CLIPMAP_FRAMES - 1], false, &bench.scratch);
+    const u64 numDifferences = CountClipmapDifferences(&bench.clipmap, &reference);
+    printf("    %llu of %llu texels differ from a full update at the end of the path\n",
+        (unsigned long long)numDifferences, (unsigned long long)(cascadeVoxels * VoxelFace::Count * CLIPMAP_CASCADES));
+    if (numDifferences != 0)
+    {
+        Sys_FatalError("Clipmap: the incremental updates differ from a full update");
+    }
+
+    // world space points in the middle of the scene, the last cascade holds them all
+    SetupTracePoints(&bench);
+    for (u32 p = 0; p < bench.numTracePoints; ++p)
+    {
+        const vec3_t position = bench.tracePositions[p];
+        const vec3_t normal = bench.traceNormals[p];
+        const vec3_t worldPosition = { position.x * extent.x, position.y * extent.y, position.z * extent.z };
+        const vec3_t worldNormal = { normal.x * extent.x, normal.y * extent.y, normal.z * extent.z };
+        bench.tracePositions[p] = bench.geometry.aabb.min + worldPosition;
+        bench.traceNormals[p] = norm(worldNormal);
+    }
+    bench.traceSettings.stepScale = 0.5f;
+    bench.traceSettings.mipBias = 0.0f;
+    bench.traceSettings.maxDiameter = 8.0f;
+    bench.traceSettings.opacityThreshold = 0.95f;
+    bench.traceSettings.distanceScale = 200.0f;
+    bench.scratch.mem_used = 0;
+    CpuVoxel_UpdateClipmap(&bench.clipmap, &bench.geometry, (bench.geometry.aabb.min + bench.geometry.aabb.max) * 0.5f, false, &bench.scratch);
+
+    const u64 numCones = (u64)bench.numTracePoints * 17;
+    PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Clipmap ambient occlusion Sponza %u^3 x %u: 1 thread", CLIPMAP_RESOLUTION, CLIPMAP_CASCADES), numCones, &RunClipmapAmbientOcclusion, &bench), "cones");
+    memcpy(referenceOcclusion, bench.traceOcclusion, bench.numTracePoints * sizeof(f32));
+    Job_Init(numThreads - 1);
+    PrintMillionsPerSecond(numCones, RunBenchmark(fmt("Clipmap ambient occlusion Sponza %u^3 x %u: %u threads", CLIPMAP_RESOLUTION, CLIPMAP_CASCADES, numThreads), numCones, &RunClipmapAmbientOcclusion, &bench), "cones");
+    Job_Shutdown();
+    if (memcmp(referenceOcclusion, bench.traceOcclusion, bench.numTracePoints * sizeof(f32)) != 0)
+    {
+        Sys_FatalError("Clipmap: the multi-threaded occlusion differs from the single-threaded one");
+    }
+
+    f64 totalOcclusion = 0.0;
+    for (u32 p = 0; p < bench.numTracePoints; ++p)
+    {
+        totalOcclusion += bench.traceOcclusion[p];
+    }
+    printf("    %u points, average occlusion %.3f\n", bench.numTracePoints, totalOcclusion / (f64)bench.numTracePoints);
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+static u64 HashOccupancy(const CpuVoxelOccupancy* occupancy)
+{
+    u64 hash = 14695981039346656037ull;
+    for (u32 l = 0; l < occupancy->numLevels; ++l)
+    {
+        const CpuOccupancyLevel* level = &occupancy->levels[l];
+        hash = HashBytes(level->words, (size_t)level->rowWords * level->size.h * level->size.d * sizeof(u32), hash);
+    }
+    return hash;
+}
+
+// bits that aren't the OR of what's under them, level 0 is checked against the opacity grid
+static u64 CountOccupancyErrors(const CpuVoxelOccupancy* occupancy, const CpuOpacityGrid* grid)
+{
+    u64 count = 0;
+    const uint3_t gridSize = grid->gridSize;
+    for (u32 z = 0; z < gridSize.d; ++z)
+    {
+        for (u32 y = 0; y < gridSize.h; ++y)
+        {
+            for (u32 x = 0; x < gridSize.w; ++x)
+            {
+                bool occupied = false;
+                for (u32 face = 0; face < VoxelFace::Count; ++face)
+                {
+                    occupied |= grid->texels[CpuVoxel_TexelIndex(gridSize, x, y, z, face)] != 0;
+                }
+                count += CpuVoxel_IsOccupied(occupancy, 0, x, y, z) != occupied;
+            }
+        }
+    }
+
+    for (u32 l = 1; l < occupancy->numLevels; ++l)
+    {
+        const uint3_t size = occupancy->levels[l].size;
+        const uint3_t childSize = occupancy->levels[l - 1].size;
+        for (u32 z = 0; z < size.d; ++z)
+        {
+            for (u32 y = 0; y < size.h; ++y)
+            {
+                for (u32 x = 0; x < size.w; ++x)
+                {
+                    bool occupied = false;
+                    for (u32 c = 0; c < 8; ++c)
+                    {
+                        const u32 childX = x * 2 + (c & 1);
+                        const u32 childY = y * 2 + ((c >> 1) & 1);
+                        const u32 childZ = z * 2 + (c >> 2);
+                        if (childX < childSize.w && childY < childSize.h && childZ < childSize.d)
+                        {
+                            occupied |= CpuVoxel_IsOccupied(occupancy, l - 1, childX, childY, childZ);
+                        }
+                    }
+                    count += CpuVoxel_IsOccupied(occupancy, l, x, y, z) != occupied;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+// a narrow cone per point, the camera's view reflected off the surface like deferred_shading.hlsl's specular cone
+static void SetupSpecularCones(VoxelizerBench* bench)
+{
+    const vec3_t eye = { 0.5f, 0.3f, 0.5f };
+    for (u32 p = 0; p < bench->numTracePoints; ++p)
+    {
+        const vec3_t position = bench->tracePositions[p];
+        const vec3_t normal = bench->traceNormals[p];
+        const vec3_t view = norm(position - eye);
+        CpuCone* cone = &bench->traceCones[p];
+        cone->origin = position;
+        cone->dir = norm(view - normal * (2.0f * dot(view, normal)));
+        cone->coneRatio = SPECULAR_CONE_RATIO;
+    }
+}
+
+// Runs the tracer without and with the occupancy, counts its steps and samples once and
+// checks that skipping didn't change a thing.
+static void CompareEmptySpaceSkipping(VoxelizerBench* bench, const char* name, u64 numCones, BenchmarkFunc func, f32* referenceOcclusion, vec3_t* referenceEmittance, bool emittance)
+{
+    CpuConeTraceStats stats[2];
+    for (u32 i = 0; i < 2; ++i)
+    {
+        bench->traceSettings.occupancy = i == 0 ? NULL : &bench->occupancy;
+        memset(&stats[i], 0, sizeof(stats[i]));
+        bench->traceSettings.stats = &stats[i];
+        (*func)(bench);
+        bench->traceSettings.stats = NULL;
+        if (i == 0)
+        {
+            memcpy(referenceOcclusion, bench->traceOcclusion, bench->numTracePoints * sizeof(f32));
+            memcpy(referenceEmittance, bench->traceEmittance, bench->numTracePoints * sizeof(vec3_t));
+        }
+        else if (stats[0].numSteps != stats[1].numSteps ||
+                 memcmp(referenceOcclusion, bench->traceOcclusion, bench->numTracePoints * sizeof(f32)) != 0 ||
+                 (emittance && memcmp(referenceEmittance, bench->traceEmittance, bench->numTracePoints * sizeof(vec3_t)) != 0))
+        {
+            Sys_FatalError("Empty space skipping: %s differs from sampling every step", name);
+        }
+
+        PrintMillionsPerSecond(numCones, RunBenchmark(fmt("%s: %s", name, i == 0 ? "every step" : "skipping"), numCones, func, bench), "cones");
+    }
+    bench->traceSettings.occupancy = NULL;
+
+    printf("    %.1f steps per cone, %.1f samples per cone with skipping (%.1f%%)\n",
+        (f64)stats[0].numSteps / (f64)numCones, (f64)stats[1].numSamples / (f64)numCones, 100.0 * (f64)stats[1].numSamples / (f64)stats[0].numSamples);
+}
+
+void Benchmark_EmptySpaceSkipping()
+{
+    if (!ShouldRunBenchmark("Empty space skipping"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Empty space skipping: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+    SetupLights(&bench);
+
+    // RunBenchmark resets the benchmark arena, everything is allocated up front
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+    SubArena(&bench.mipArena, &benchSettings.arena, Megabytes(160), "Voxel grids");
+    bench.tracePositions = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceNormals = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+    bench.traceEmittance = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    bench.traceCones = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, CpuCone);
+    f32* referenceOcclusion = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, f32);
+    vec3_t* referenceEmittance = PushArray(&benchSettings.arena, CONE_TRACING_MAX_POINTS, vec3_t);
+    memset(bench.traceEmittance, 0, CONE_TRACING_MAX_POINTS * sizeof(vec3_t));
+
+    SetupTracePoints(&bench);
+    SetupSpecularCones(&bench);
+    bench.traceSettings.stepScale = 0.5f;
+    bench.traceSettings.mipBias = 0.0f;
+    bench.traceSettings.maxDiameter = 8.0f;
+    bench.traceSettings.opacityThreshold = 0.95f;
+    bench.traceSettings.distanceScale = 200.0f;
+
+    const u32 numThreads = Sys_GetCoreCount();
+    for (u32 size = CONE_TRACING_GRID_SIZE; size <= CONE_TRACING_GRID_SIZE * 2; size *= 2)
+    {
+        const uint3_t gridSize = { size, size, size };
+        bench.mipArena.mem_used = 0;
+        bench.scratch.mem_used = 0;
+        CpuVoxel_AllocateOpacityGrid(&bench.grid, &bench.mipArena, gridSize);
+        CpuVoxel_VoxelizeOpacity(&bench.grid, &bench.geometry, false, &bench.scratch, NULL);
+        CpuVoxel_AllocateOpacityMips(&bench.mips, &bench.mipArena, &bench.grid);
+        CpuVoxel_BuildOpacityMips(&bench.mips);
+        CpuVoxel_AllocateOccupancy(&bench.occupancy, &bench.mipArena, gridSize);
+
+        const u64 numVoxels = (u64)size * size * size;
+        RunBenchmark(fmt("Empty space skipping occupancy build Sponza %u^3: 1 thread", size), numVoxels, &RunOccupancyBuilder, &bench);
+        const size_t occupancyMemory = CpuVoxel_OccupancyMemory(&bench.occupancy);
+        const u64 reference = HashOccupancy(&bench.occupancy);
+        Job_Init(numThreads - 1);
+        RunBenchmark(fmt("Empty space skipping occupancy build Sponza %u^3: %u threads", size, numThreads), numVoxels, &RunOccupancyBuilder, &bench);
+        Job_Shutdown();
+        if (HashOccupancy(&bench.occupancy) != reference)
+        {
+            Sys_FatalError("Empty space skipping: the multi-threaded occupancy differs from the single-threaded one");
+        }
+
+        const u64 numErrors = CountOccupancyErrors(&bench.occupancy, &bench.grid);
+        if (numErrors != 0)
+        {
+            Sys_FatalError("Empty space skipping: %llu occupancy bits are wrong", (unsigned long long)numErrors);
+        }
+        printf("    %u levels, %.1f KB\n", bench.occupancy.numLevels, (f64)occupancyMemory / 1024.0);
+
+        CompareEmptySpaceSkipping(&bench, fmt("Empty space skipping ambient occlusion Sponza %u^3", size), (u64)bench.numTracePoints * 17, &RunAmbientOcclusion, referenceOcclusion, referenceEmittance, false);
+    }
+
+    // the emittance of every texel is 8 bytes, 128^3 is as far as the arena goes
+    const uint3_t gridSize = { CONE_TRACING_GRID_SIZE, CONE_TRACING_GRID_SIZE, CONE_TRACING_GRID_SIZE };
+    bench.mipArena.mem_used = 0;
+    bench.scratch.mem_used = 0;
+    CpuVoxel_AllocateEmittanceGrid(&bench.emittance, &bench.mipArena, gridSize, false);
+    CpuVoxel_VoxelizeEmittance(&bench.emittance, &bench.geometry, &bench.lighting, false, &bench.scratch, NULL);
+    CpuVoxel_FixVoxelization(&bench.emittance, VOXELIZER_MAX_GAP_DISTANCE);
+    CpuVoxel_AllocateEmittanceMips(&bench.emittanceMips, &bench.mipArena, &bench.emittance);
+    CpuVoxel_BuildEmittanceMips(&bench.emittanceMips);
+    CpuVoxel_AllocateOccupancy(&bench.occupancy, &bench.mipArena, gridSize);
+    CpuVoxel_BuildOccupancy(&bench.occupancy, &bench.emittance);
+
+    CompareEmptySpaceSkipping(&bench, fmt("Empty space skipping indirect diffuse Sponza %u^3", gridSize.w), (u64)bench.numTracePoints * 9, &RunIndirectDiffuse, referenceOcclusion, referenceEmittance, true);
+    CompareEmptySpaceSkipping(&bench, fmt("Empty space skipping specular cones Sponza %u^3", gridSize.w), bench.numTracePoints, &RunSpecularCones, referenceOcclusion, referenceEmittance, true);
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
+
+// everything RunFullRevoxelization writes
+static u64 HashRevoxelization(const VoxelizerBench* bench)
+{
+    const size_t numTexels = CpuVoxel_NumTexels(bench->emittance.gridSize);
+    u64 hash = 14695981039346656037ull;
+    hash = HashBytes(bench->emittance.texels, numTexels * 4 * sizeof(u16), hash);
+    hash = HashBytes(bench->emittance.normals, numTexels * sizeof(u32), hash);
+    hash = HashBytes(bench->grid.texels, numTexels, hash);
+    for (u32 m = 0; m < bench->emittanceMips.numLevels; ++m)
+    {
+        const size_t numMipTexels = CpuVoxel_NumTexels(CpuVoxel_MipSize(bench->emittance.gridSize, m));
+        hash = HashBytes(bench->emittanceMips.levels[m], numMipTexels * 4 * sizeof(u16), hash);
+        hash = HashBytes(bench->mips.levels[m], numMipTexels, hash);
+    }
+    return hash;
+}
+
+// The change was made and its bricks marked, the grids are still as they were before it.
+// The incremental runs after the first one have nothing left to change but do the same work.
+static void CompareRevoxelization(VoxelizerBench* bench, const char* name)
+{
+    const u32 numBricks = bench->dirty.numBricks.w * bench->dirty.numBricks.h * bench->dirty.numBricks.d;
+    const u32 numDirty = CpuVoxel_CountDirtyBricks(&bench->dirty);
+    const u64 incrementalTime = RunBenchmark(fmt("%s: incremental", name), numDirty, &RunIncrementalRevoxelization, bench);
+    RunIncrementalRevoxelization(bench); // when the run above was filtered out
+    const u32 numChanged = CpuVoxel_CountDirtyBricks(&bench->changed);
+    const u64 incremental = HashRevoxelization(bench);
+
+    const u64 fullTime = RunBenchmark(fmt("%s: full", name), numBricks, &RunFullRevoxelization, bench);
+    RunFullRevoxelization(bench);
+    if (HashRevoxelization(bench) != incremental)
+    {
+        Sys_FatalError("%s: differs from a full update", name);
+    }
+
+    printf("    %u of %u bricks dirty, the emittance mips updated over %u\n", numDirty, numBricks, numChanged);
+    if (incrementalTime > 0 && fullTime > 0)
+    {
+        printf("    %.2f ms vs %.2f ms for a full update\n", (f64)incrementalTime / 1000.0, (f64)fullTime / 1000.0);
+    }
+}
+
+// a mesh of a few voxels: the one whose bounds' longest side is closest to 8 voxels of the grid
+static u32 FindPropMesh(const VoxelizerBench* bench, const RenderAABB* meshBounds, uint3_t gridSize)
+{
+    const vec3_t extent = bench->geometry.aabb.max - bench->geometry.aabb.min;
+    const f32 voxelSize = MAX3(extent.x / (f32)gridSize.w, extent.y / (f32)gridSize.h, extent.z / (f32)gridSize.d);
+    u32 best = 0;
+    f32 bestDistance = FLT_MAX;
+    for (u32 m = 0; m < bench->geometry.numMeshes; ++m)
+    {
+        if (bench->geometry.meshes[m].numIndexes == 0)
+        {
+            continue;
+        }
+        const vec3_t size = meshBounds[m].max - meshBounds[m].min;
+        const f32 distance = fabsf(MAX3(size.x, size.y, size.z) / voxelSize - 8.0f);
+        if (distance < bestDistance)
+        {
+            best = m;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+void Benchmark_IncrementalRevoxelization()
+{
+    if (!ShouldRunBenchmark("Incremental revoxelization"))
+    {
+        return;
+    }
+
+    VoxelizerBench bench = {};
+    if (!LoadScene(&bench))
+    {
+        printf("Incremental revoxelization: %s/%s.scene not found, skipped\n", ASSET_DIR, VOXELIZER_SCENE);
+        return;
+    }
+    SetupLights(&bench);
+    bench.lights[1].radius = REVOXELIZATION_LIGHT_RADIUS;
+
+    // Voxel_Init's grid, RunBenchmark resets the benchmark arena so everything is allocated up front
+    const uint3_t gridSize = { 128, 64, 64 };
+    SubArena(&bench.scratch, &benchSettings.arena, VOXELIZER_SCRATCH_SIZE, "Voxelizer scratch");
+    CpuVoxel_AllocateOpacityGrid(&bench.grid, &benchSettings.arena, gridSize);
+    CpuVoxel_AllocateOpacityMips(&bench.mips, &benchSettings.arena, &bench.grid);
+    CpuVoxel_AllocateEmittanceGrid(&bench.emittance, &benchSettings.arena, gridSize, true);
+    CpuVoxel_AllocateEmittanceGrid(&bench.fixedEmittance, &benchSettings.arena, gridSize, false);
+    CpuVoxel_AllocateEmittanceMips(&bench.emittanceMips, &benchSettings.arena, &bench.fixedEmittance);
+    CpuVoxel_AllocateDirtyBricks(&bench.dirty, &benchSettings.arena, gridSize);
+    CpuVoxel_AllocateDirtyBricks(&bench.changed, &benchSettings.arena, gridSize);
+
+    // the vertexes are copied so that a mesh can move
+    const MeshFileHeader* header = (const MeshFileHeader*)bench.sceneData;
+    vec3_t* xyz = PushArray(&benchSettings.arena, header->numVertexes, vec3_t);
+    memcpy(xyz, bench.geometry.xyz, header->numVertexes * sizeof(vec3_t));
+    bench.geometry.xyz = xyz;
+    RenderAABB* meshBounds = PushArray(&benchSettings.arena, bench.geometry.numMeshes, RenderAABB);
+    RenderAABB* movedBounds = PushArray(&benchSettings.arena, bench.geometry.numMeshes, RenderAABB);
+    u8* moved = PushArray(&benchSettings.arena, header->numVertexes, u8);
+    CpuVoxel_ComputeMeshBounds(meshBounds, &bench.geometry);
+
+    const u32 numThreads = Sys_GetCoreCount();
+    Job_Init(numThreads - 1);
+    bench.revoxelizeOpacity = true;
+    RunFullRevoxelization(&bench);
+
+    // a local light moves by 4 voxels, it's marked where it was and where it is
+    {
+        bench.revoxelizeOpacity = false;
+        CpuVoxel_ClearDirtyBricks(&bench.dirty);
+        CpuVoxel_MarkDirtyLight(&bench.dirty, &bench.geometry.aabb, &bench.lights[1]);
+        bench.lights[1].position.x += (bench.geometry.aabb.max.x - bench.geometry.aabb.min.x) * 4.0f / (f32)gridSize.w;
+        CpuVoxel_MarkDirtyLight(&bench.dirty, &bench.geometry.aabb, &bench.lights[1]);
+        CompareRevoxelization(&bench, fmt("Incremental revoxelization light moved Sponza %ux%ux%u: %u threads", gridSize.w, gridSize.h, gridSize.d, numThreads));
+    }
+
+    // the color of the material of a prop, like the material editor does
+    const u32 prop = FindPropMesh(&bench, meshBounds, gridSize);
+    {
+        Material* material = &bench.materials[bench.geometry.meshes[prop].materialIndex];
+        material->alphaTestedColor.x = 1.0f - material->alphaTestedColor.x;
+        material->alphaTestedColor.z = 1.0f - material->alphaTestedColor.z;
+        CpuVoxel_ClearDirtyBricks(&bench.dirty);
+        CpuVoxel_MarkDirtyMaterial(&bench.dirty, &bench.geometry, meshBounds, bench.geometry.meshes[prop].materialIndex);
+        CompareRevoxelization(&bench, fmt("Incremental revoxelization material edited Sponza %ux%ux%u: %u threads", gridSize.w, gridSize.h, gridSize.d, numThreads));
+    }
+
+    // the prop moves up by 3 voxels, with the meshes it shares vertexes with
+    {
+        bench.revoxelizeOpacity = true;
+        const MeshFileMesh* mesh = &bench.geometry.meshes[prop];
+        const f32 offset = (bench.geometry.aabb.max.y - bench.geometry.aabb.min.y) * 3.0f / (f32)gridSize.h;
+        memset(moved, 0, header->numVertexes);
+        for (u32 i = 0; i < mesh->numIndexes; ++i)
+        {
+            const u32 vertex = bench.geometry.indexes[mesh->firstIndex + i];
+            if (!moved[vertex])
+            {
+                xyz[vertex].y += offset;
+                moved[vertex] = 1;
+            }
+        }
+
+        CpuVoxel_ClearDirtyBricks(&bench.dirty);
+        CpuVoxel_ComputeMeshBounds(movedBounds, &bench.geometry);
+        for (u32 m = 0; m < bench.geometry.numMeshes; ++m)
+        {
+            if (memcmp(&meshBounds[m], &movedBounds[m], sizeof(RenderAABB)) != 0)
+            {
+                CpuVoxel_MarkDirtyBounds(&bench.dirty, &bench.geometry.aabb, meshBounds[m].min, meshBounds[m].max);
+                CpuVoxel_MarkDirtyBounds(&bench.dirty, &bench.geometry.aabb, movedBounds[m].min, movedBounds[m].max);
+            }
+        }
+        CompareRevoxelization(&bench, fmt("Incremental revoxelization mesh moved Sponza %ux%ux%u: %u threads", gridSize.w, gridSize.h, gridSize.d, numThreads));
+    }
+    Job_Shutdown();
+
+    free(bench.sceneData);
+    free(bench.materialData);
+}
@@ -0,0 +1,126 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+BenchmarkSettings benchSettings;
+static volatile u64 checksum;
+
+static void PrintHelp()
+{
+    printf("usage: Benchmark [options] [filter]\n");
+    printf("runs the container micro-benchmarks whose name contains the filter\n\n");
+    printf("  -scale N  multiply the item counts by N (default 1)\n");
+}
+
+bool ShouldRunBenchmark(const char* name)
+{
+    return benchSettings.filter == NULL || strstr(name, benchSettings.filter) != NULL;
+}
+
+u64 RunBenchmark(const char* name, u64 numItems, BenchmarkFunc func, void* userData)
+{
+    if (!ShouldRunBenchmark(name))
+    {
+        return 0;
+    }
+
+    u64 best = UINT64_MAX;
+    for (u32 r = 0; r < BENCHMARK_REPEATS; ++r)
+    {
+        benchSettings.arena.mem_used = 0;
+        const u64 start = Sys_GetTimestamp();
+        checksum += func(userData);
+        best = MIN(best, Sys_GetElapsedMicroseconds(start));
+    }
+
+    const f64 nsPerItem = (f64)best * 1000.0 / (f64)MAX(numItems, 1);
+    printf("%-48s %9.3f ms %8.3f ns/item\n", name, (f64)best / 1000.0, nsPerItem);
+
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    benchSettings.scale = 1;
+    for (s32 i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-scale") == 0 && i + 1 < argc)
+        {
+            const s32 scale = atoi(argv[++i]);
+            benchSettings.scale = (u32)CLAMP_MIN(scale, 1);
+        }
+        else if (strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "/?") == 0)
+        {
+            PrintHelp();
+            return 0;
+        }
+        else
+        {
+            benchSettings.filter = argv[i];
+        }
+    }
+
+    const size_t arenaSize = Megabytes(512);
+    void* arenaMemory = malloc(arenaSize);
+    if (arenaMemory == NULL)
+    {
+        Sys_FatalError("Failed to allocate the benchmark arena");
+    }
+    AllocateArena(&benchSettings.arena, arenaSize, arenaMemory, "Benchmark");
+
+    Benchmark_DynamicArray();
+    Benchmark_HashMap();
+    Benchmark_StringIntern();
+    Benchmark_ThreadArena();
+    Benchmark_JobSystem();
+    Benchmark_RingBuffer();
+    Benchmark_Pool();
+    Benchmark_Math();
+    Benchmark_TextureResidency();
+    Benchmark_Voxelizer();
+    Benchmark_EmittanceVoxelizer();
+    Benchmark_VoxelMips();
+    Benchmark_ConeTracing();
+    Benchmark_Svo();
+    Benchmark_PagedGrid();
+    Benchmark_Clipmap();
+    Benchmark_EmptySpaceSkipping();
+    Benchmark_IncrementalRevoxelization();
+
+    free(arenaMemory);
+    printf("checksum: %llu\n", (unsigned long long)checksum);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "../../common/shared.h"
+
+#define BENCHMARK_REPEATS 7
+
+// Returns a checksum of the work done so that the compiler can't throw it away.
+typedef u64 (*BenchmarkFunc)(void* userData);
+
+struct BenchmarkSettings
+{
+    const char* filter; // only run benchmarks whose name contains this, NULL runs everything
+    u32 scale; // multiplies the item counts
+    MemoryArena arena; // reset before every run
+};
+
+extern BenchmarkSettings benchSettings;
+
+bool ShouldRunBenchmark(const char* name);
+// Runs the function BENCHMARK_REPEATS times and prints the fastest run.
+// Returns the fastest run in microseconds, 0 when the benchmark was filtered out.
+u64 RunBenchmark(const char* name, u64 numItems, BenchmarkFunc func, void* userData);
+
+void Benchmark_DynamicArray();
+void Benchmark_HashMap();
+void Benchmark_StringIntern();
+void Benchmark_ThreadArena();
+void Benchmark_JobSystem();
+void Benchmark_RingBuffer();
+void Benchmark_Pool();
+void Benchmark_Math();
+void Benchmark_TextureResidency();
+void Benchmark_Voxelizer();
+void Benchmark_EmittanceVoxelizer();
+void Benchmark_VoxelMips();
+void Benchmark_ConeTracing();
+void Benchmark_Svo();
+void Benchmark_PagedGrid();
+void Benchmark_Clipmap();
+void Benchmark_EmptySpaceSkipping();
+void Benchmark_IncrementalRevoxelization();
@@ -34,7 +34,37 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "shared.h"
 
-void WriteBinaryMaterialToFile(Mesh* mesh, const char* filePath)
+// Materials share most of their texture paths, each interned string is only written once.
+static u32 PushInternedString(MemoryArena* strings, HashMap<const char*, u32, InternedStringHash>* offsets, const char* string)
+{
+    if (string == NULL)
+        return 0;
+
+    const u32* offset = offsets->Find(string);
+    if (offset != NULL)
+        return *offset;
+
+    return *offsets->Insert(string, PushString(strings, string));
+}
+
+struct MaterialStatsJob
+{
+    Mesh* mesh;
+    MeshFileMaterial* materials;
+    const char* textureDir;
+};
+
+// every material decodes its own textures, so they're independent
+static void ComputeMaterialStatsRange(void* userData, u32 begin, u32 end)
+{
+    MaterialStatsJob* job = (MaterialStatsJob*)userData;
+    for (u32 m = begin; m < end; ++m)
+    {
+        ComputeMaterialStats(&job->materials[m], &job->mesh->materials[m], job->textureDir);
+    }
+}
+
+void WriteBinaryMaterialToFile(Mesh* mesh, const char* filePath, const char* textureDir)
 {
     FILE* file = fopen(filePath, "wb");
     if (!file)
@@ -46,22 +76,29 @@ void WriteBinaryMaterialToFile(Mesh* mesh, const char* filePath)
     MemoryArena strings;
     AllocateArena(&strings, Kilobytes(4), malloc(Kilobytes(4)), "string arena");
     strings.mem_used = 1; // 0 offset for null or invalid pointers
+    HashMap<const char*, u32, InternedStringHash> offsets;
     for (u32 m = 0; m < mesh->materials.Length(); ++m)
     {
-        MeshFileMaterial material;
-        material.albedoOffset = PushString(&strings, mesh->materials[m].mapPaths[TextureId::Albedo]);
-        material.normalOffset = PushString(&strings, mesh->materials[m].mapPaths[TextureId::Bump]);
-        material.specularOffset = PushString(&strings, mesh->materials[m].mapPaths[TextureId::Specular]);
-        material.materialOffset = PushString(&strings, mesh->materials[m].name);
+        MeshFileMaterial material = {};
+        material.albedoOffset = PushInternedString(&strings, &offsets, mesh->materials[m].mapPaths[TextureId::Albedo]);
+        material.normalOffset = PushInternedString(&strings, &offsets, mesh->materials[m].mapPaths[TextureId::Bump]);
+        material.specularOffset = PushInternedString(&strings, &offsets, mesh->materials[m].mapPaths[TextureId::Specular]);
+        material.materialOffset = PushInternedString(&strings, &offsets, mesh->materials[m].name);
         Vec3Copy(material.specularColor, mesh->materials[m].Ks);
         material.specularExponent = mesh->materials[m].Ns;
         material.flags |= mesh->materials[m].isAlphaTested ? IS_ALPHA_TESTED : 0;
-        Vec3Copy(material.alphaTestedColor, mesh->materials[m].Kd);
-        material.alphaTestedColor.w = mesh->materials[m].d;
         materials.Push(material);
     }
 
+    MaterialStatsJob statsJob;
+    statsJob.mesh = mesh;
+    statsJob.materials = materials.GetStart();
+    statsJob.textureDir = textureDir;
+    Job_ParallelFor(materials.Length(), &ComputeMaterialStatsRange, &statsJob, 1);
+
     MaterialFileHeader hdr;
+    hdr.magic = MATERIAL_FILE_MAGIC;
+    hdr.version = MATERIAL_FILE_VERSION;
     hdr.numMaterials = materials.Length();
     hdr.numStringBytes = strings.mem_used;
 
@@ -69,6 +106,7 @@ void WriteBinaryMaterialToFile(Mesh* mesh, const char* filePath)
     fwrite(materials.GetStart(), materials.UsedBytes(), 1, file);
     fwrite(strings.base_ptr, strings.mem_used, 1, file);
 
+    free(strings.base_ptr);
     fclose(file);
 }
 
@@ -82,7 +120,6 @@ void WriteBinaryMeshToFile(Mesh* mesh, const char* filePath)
     u32 indexOffset = 0;
     for (u32 groupIndex = 0; groupIndex < mesh->groups.Length(); ++groupIndex)
     {
-        ObjectGroup objGroup = mesh->groups[groupIndex];
         for (u32 materialGroupIndex = 0; materialGroupIndex < mesh->groups[groupIndex].numMaterialGroups; ++materialGroupIndex)
         {
             MaterialGroup* materialGroup = &mesh->groups[groupIndex].materialGroups[materialGroupIndex];
@@ -34,13 +34,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "shared.h"
 
-static ObjectGroup DefaultGroup()
+// The group being parsed is always the last one of the object.
+static ObjectGroup* CurrentGroup(ObjectData* data)
 {
-    ObjectGroup group = {};
-
-    group.numMaterialGroups = 1;
-
-    return group;
+    assert(data->m->groups.Length() > 0);
+    return &data->m->groups[data->m->groups.Length() - 1];
 }
 
 static const char* GetSign(const char* buff, s32* sign)
@@ -135,10 +133,8 @@ static void GetStringExtension(const char* string, char* format)
     start = ParseString(start, format);
 }
 
-static const char* ParsePath(const char* buff, char** v)
+static const char* ParsePath(const char* buff, const char** v)
 {
-    size_t n;
-
     const char* start = buff;
 
     while (IsAlnum(*buff) || *buff == '-' || *buff == '_' || *buff == '.' || *buff == '/' || IsDigit(*buff))
@@ -146,15 +142,7 @@ static const char* ParsePath(const char* buff, char** v)
         buff++;
     }
 
-    char* end = (char*)buff;
-    n = (size_t)(end - start);
-
-    *v = (char*)realloc(0, n + 1); // +1 because string must be null terminated
-    if (*v)
-    {
-        memcpy(*v, start, n);
-        (*v)[n] = '\0';
-    }
+    *v = InternRange(start, (u32)(buff - start));
 
     return buff;
 }
@@ -322,16 +310,16 @@ static const char* ParseFace(ObjectData* data, const char* start)
     if (count == 3)
     {
         // right now this is not pr. smoothing group
-        data->currentGroup.materialGroups[data->currentGroup.numMaterialGroups - 1].numIndexes += 3;
+        CurrentGroup(data)->materialGroups[CurrentGroup(data)->numMaterialGroups - 1].numIndexes += 3;
     }
     else
     {
-        data->currentGroup.materialGroups[data->currentGroup.numMaterialGroups - 1].numIndexes += 6;
+        CurrentGroup(data)->materialGroups[CurrentGroup(data)->numMaterialGroups - 1].numIndexes += 6;
     }
 
     data->m->faceVertexCount.Push(count); // how many vertices did we find in the face
     data->m->faceSGroupIndices.Push(data->currentSgroup);
-    data->currentGroup.numFaces++; // how many faces in the current group
+    CurrentGroup(data)->numFaces++; // how many faces in the current group
 
     return start;
 }
@@ -394,20 +382,24 @@ static const char* ParseTexcoord(ObjectData* data, const char* start)
 
 static void PushGroup(ObjectData* data)
 {
-    if (data->currentGroup.numFaces > 0)
+    // groups without faces are reused
+    DynamicArray<ObjectGroup>* groups = &data->m->groups;
+    if (groups->Length() == 0 || CurrentGroup(data)->numFaces > 0)
     {
-        data->m->groups.Push(data->currentGroup);
-    }
-    else
-    {
-        memset(&data->currentGroup, 0, sizeof(ObjectGroup));
+        groups->Reserve(groups->Length() + 1);
     }
 
-    data->currentGroup = DefaultGroup();
-    data->currentGroup.faceOffset = data->m->faceVertexCount.Length();
-    data->currentGroup.indexOffset = data->m->vertexes.Length();
-    data->currentGroup.vertexOffset = data->m->xyz.Length();
-    data->currentGroup.normalOffset = data->m->normals.Length();
+    ObjectGroup* group = CurrentGroup(data);
+    group->name = NULL;
+    group->numFaces = 0;
+    group->materialOffset = 0;
+    memset(group->materialGroups, 0, sizeof(group->materialGroups));
+    group->numMaterialGroups = 1;
+    group->sgroupIndices.Clear();
+    group->faceOffset = data->m->faceVertexCount.Length();
+    group->indexOffset = data->m->vertexes.Length();
+    group->vertexOffset = data->m->xyz.Length();
+    group->normalOffset = data->m->normals.Length();
 }
 
 static const char* ParseGroup(ObjectData* data, const char* start)
@@ -418,7 +410,7 @@ static const char* ParseGroup(ObjectData* data, const char* start)
 
     PushGroup(data);
 
-    data->currentGroup.name = name;
+    CurrentGroup(data)->name = Intern(name);
 
     return start;
 }
@@ -437,13 +429,13 @@ static const char* ParseSmoothingGroup(ObjectData* data, const char* start)
 
     data->currentSgroup = smoothingGroupIndex;
 
-    for (u32 i = 0; i < data->currentGroup.sgroupIndices.Length(); ++i)
+    for (u32 i = 0; i < CurrentGroup(data)->sgroupIndices.Length(); ++i)
     {
-        if (data->currentGroup.sgroupIndices[i] == smoothingGroupIndex)
+        if (CurrentGroup(data)->sgroupIndices[i] == smoothingGroupIndex)
             return start;
     }
 
-    data->currentGroup.sgroupIndices.Push(smoothingGroupIndex);
+    CurrentGroup(data)->sgroupIndices.Push(smoothingGroupIndex);
 
     return start;
 }
@@ -477,8 +469,10 @@ static const char* ParseNewMaterial(ObjectData* data, const char* start)
     material.Tf = { 0.0f, 0.0f, 0.0f };
     material.Illum = 2;
 
+    char name[MAX_PATH];
     start = SkipWhitespace(start);
-    start = ParseString(start, material.name);
+    start = ParseString(start, name);
+    material.name = Intern(name);
 
     data->m->materials.Push(material);
 
@@ -715,6 +709,13 @@ static const char* ParseMTLLib(ObjectData* data, const char* start)
         }
     }
 
+    data->materialIndexes.Clear();
+    for (u32 m = 0; m < data->m->materials.Length(); ++m)
+    {
+        bool inserted;
+        data->materialIndexes.FindOrInsert(data->m->materials[m].name, m, &inserted);
+    }
+
     return start;
 }
 
@@ -727,23 +728,18 @@ static const char* ParseUseMTL(ObjectData* data, const char* start)
     start = SkipLine(start);
 
     // find the material
-    u32 index = 0;
-    for (; index < data->m->materials.Length(); ++index)
+    const u32* index = data->materialIndexes.Find(Intern(name));
+    if (index != NULL)
     {
-        if (strcmp(name, data->m->materials[index].name) == 0)
-        {
-            assert(data->currentGroup.numMaterialGroups < ARRAY_LEN(data->currentGroup.materialGroups));
-            data->currentGroup.materialOffset = index; // this group should use material at index
-            data->currentGroup.materialGroups[data->currentGroup.numMaterialGroups++].materialIndex = index;
-            data->currentGroup.materialGroups[data->currentGroup.numMaterialGroups].numIndexes = 0;
-            break;
-        }
+        assert(CurrentGroup(data)->numMaterialGroups < ARRAY_LEN(CurrentGroup(data)->materialGroups));
+        CurrentGroup(data)->materialOffset = *index; // this group should use material at index
+        CurrentGroup(data)->materialGroups[CurrentGroup(data)->numMaterialGroups++].materialIndex = *index;
+        CurrentGroup(data)->materialGroups[CurrentGroup(data)->numMaterialGroups].numIndexes = 0;
     }
-
-    // if no name was specied we use the default material
-    if (index == data->m->materials.Length())
+    else
     {
-        data->currentGroup.materialOffset = 0;
+        // if no name was specied we use the default material
+        CurrentGroup(data)->materialOffset = 0;
     }
 
     return start;
@@ -789,14 +785,53 @@ static vec3_t ComputeVertexNormal(Mesh* mesh, u32 i0, u32 i1, u32 i2, u32 i3, u3
     return result;
 }
 
-static u32 PushVertex(Mesh* mesh, u32 firstVertexIndex, vec3_t xyz, vec2_t tc, vec3_t normal)
+// Vertices are welded within a smoothing group.
+struct WeldKey
 {
-    for (u32 vertexIndex = firstVertexIndex; vertexIndex < mesh->xyz.Length(); ++vertexIndex)
+    vec3_t xyz;
+    vec2_t tc;
+    vec3_t normal;
+};
+
+struct WeldKeyHash
+{
+    u32 operator()(const WeldKey& key) const
     {
-        if (mesh->xyz[vertexIndex] == xyz && mesh->tc[vertexIndex] == tc && mesh->normal[vertexIndex] == normal)
+        // -0 and 0 compare equal, so they have to hash the same
+        const f32* values = &key.xyz.x;
+        u64 hash = 14695981039346656037ull;
+        for (u32 i = 0; i < sizeof(WeldKey) / sizeof(f32); ++i)
         {
-            return vertexIndex;
+            u32 bits;
+            memcpy(&bits, &values[i], sizeof(bits));
+            bits = bits == 0x80000000 ? 0 : bits;
+            hash = (hash ^ bits) * 1099511628211ull;
         }
+        return HashMapMix(hash);
+    }
+};
+
+struct WeldKeyEqual
+{
+    bool operator()(const WeldKey& a, const WeldKey& b) const
+    {
+        return a.xyz == b.xyz && a.tc == b.tc && a.normal == b.normal;
+    }
+};
+
+typedef HashMap<WeldKey, u32, WeldKeyHash, WeldKeyEqual> WeldMap;
+
+static u32 PushVertex(Mesh* mesh, WeldMap* weldMap, vec3_t xyz, vec2_t tc, vec3_t normal)
+{
+    WeldKey key;
+    key.xyz = xyz;
+    key.tc = tc;
+    key.normal = normal;
+    bool inserted;
+    const u32 vertexIndex = *weldMap->FindOrInsert(key, (u32)mesh->xyz.Length(), &inserted);
+    if (!inserted)
+    {
+        return vertexIndex;
     }
 
     mesh->xyz.Push(xyz);
@@ -807,14 +842,14 @@ static u32 PushVertex(Mesh* mesh, u32 firstVertexIndex, vec3_t xyz, vec2_t tc, v
     return mesh->xyz.Length() - 1;
 }
 
-static void ProcessVertex(Mesh* mesh, Object* parseData, u32 faceIndex, u32 firstVertexIndex)
+static void ProcessVertex(Mesh* mesh, Object* parseData, u32 faceIndex, WeldMap* weldMap)
 {
     Vertex vertex = parseData->vertexes[faceIndex];
     vec3_t xyz = parseData->xyz[vertex.xyz];
     vec2_t tc = parseData->tc[vertex.tc];
     vec3_t normal = parseData->normals[vertex.normal];
 
-    u32 index = PushVertex(mesh, firstVertexIndex, xyz, tc, normal);
+    u32 index = PushVertex(mesh, weldMap, xyz, tc, normal);
     mesh->indexes.Push(index);
 }
 
@@ -849,26 +884,8 @@ static void SmoothNormals(Mesh* mesh, u32 firstVertex, u32 lastVertex, u32 first
 
 static void ParseRenderable(Object* parseData, Mesh* mesh)
 {
-    parseData->min.x = parseData->min.y = parseData->min.z = FLT_MAX;
-    parseData->max.x = parseData->max.y = parseData->max.z = -FLT_MAX;
-
     // Calcuate AABB for mesh
-    for (u32 i = 0; i < parseData->xyz.Length(); ++i)
-    {
-        vec3_t v = parseData->xyz[i];
-        if (v.x < parseData->min.x)
-            parseData->min.x = v.x;
-        if (v.y < parseData->min.y)
-            parseData->min.y = v.y;
-        if (v.z < parseData->min.z)
-            parseData->min.z = v.z;
-        if (v.x > parseData->max.x)
-            parseData->max.x = v.x;
-        if (v.y > parseData->max.y)
-            parseData->max.y = v.y;
-        if (v.z > parseData->max.z)
-            parseData->max.z = v.z;
-    }
+    ComputeBounds(parseData->xyz.GetStart(), parseData->xyz.Length(), &parseData->min, &parseData->max);
 
     mesh->name = parseData->fileName;
 
@@ -879,9 +896,9 @@ static void ParseRenderable(Object* parseData, Mesh* mesh)
     for (u32 i = 0; i < parseData->materials.Length(); ++i)
         mesh->materials.Push(parseData->materials[i]);
 
-    for (u32 i = 0; i < parseData->groups.Length(); ++i)
-        mesh->groups.Push(parseData->groups[i]);
+    mesh->groups = Move(parseData->groups);
 
+    WeldMap weldMap;
     for (u32 groupIndex = 0; groupIndex < mesh->groups.Length(); ++groupIndex)
     {
         ObjectGroup* group = &mesh->groups[groupIndex];
@@ -891,6 +908,7 @@ static void ParseRenderable(Object* parseData, Mesh* mesh)
             u32 sgi = group->sgroupIndices[sg];
             sgroup.firstIndex = mesh->indexes.Length();
             u32 firstVertexIndex = mesh->xyz.Length();
+            weldMap.Clear();
             u32 inputVertexIndex = group->indexOffset;
             u32 firstIndex = mesh->indexes.Length();
             for (u32 face = group->faceOffset; face < group->faceOffset + group->numFaces; ++face)
@@ -904,18 +922,18 @@ static void ParseRenderable(Object* parseData, Mesh* mesh)
 
                 if (numVertexes == 3)
                 {
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 0, firstVertexIndex);
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 1, firstVertexIndex);
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 2, firstVertexIndex);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 0, &weldMap);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 1, &weldMap);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 2, &weldMap);
                 }
                 else if (numVertexes == 4)
                 {
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 0, firstVertexIndex);
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 1, firstVertexIndex);
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 2, firstVertexIndex);
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 3, firstVertexIndex);
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 0, firstVertexIndex);
-                    ProcessVertex(mesh, parseData, inputVertexIndex + 2, firstVertexIndex);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 0, &weldMap);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 1, &weldMap);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 2, &weldMap);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 3, &weldMap);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 0, &weldMap);
+                    ProcessVertex(mesh, parseData, inputVertexIndex + 2, &weldMap);
                 }
                 else
                 {
@@ -953,11 +971,12 @@ void LoadObject(Mesh* mesh, MemoryArena* arena, void* data, u64 size, const char
     // why is this still needed when parsing?
 #if 1
     ParseMaterial x = {};
+    x.name = Intern("");
     m.materials.Push(x);
 #endif
 
     parseData.m = &m;
-    parseData.currentGroup = DefaultGroup();
+    PushGroup(&parseData);
 
     // Ensure that the buffer ends with a newline
     ((char*)data)[size] = '\n';
@@ -1077,8 +1096,11 @@ void LoadObject(Mesh* mesh, MemoryArena* arena, void* data, u64 size, const char
         }
     }
 
-    // When we are finished make sure to push the final group
-    PushGroup(&parseData);
+    // The final group is already in the object, unless it's empty
+    if (CurrentGroup(&parseData)->numFaces == 0)
+    {
+        m.groups.Reserve(m.groups.Length() - 1);
+    }
 
     // Before returning the object, parse the indices and materials to an index/color buffer
     ParseRenderable(&m, mesh);
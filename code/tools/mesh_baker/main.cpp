@@ -40,31 +40,6 @@ static void PrintHelp()
     printf("need valid obj file\n");
 }
 
-static void ReadEntireFile(void** data, size_t* size, const char* path)
-{
-    FILE* file = fopen(path, "rb");
-    if (file == NULL)
-    {
-        fprintf(stderr, "Can't open file.\n");
-        exit(__LINE__);
-    }
-
-    fseek(file, 0, SEEK_END);
-    *size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    *data = malloc(*size);
-    if (*data == NULL)
-    {
-        fprintf(stderr, "Can't allocate %d bytes.\n", (int)*size);
-        exit(__LINE__);
-    }
-
-    fread(*data, *size, 1, file);
-
-    fclose(file);
-}
-
 int main(int argc, char** argv)
 {
 #ifdef _DEBUG
@@ -81,7 +56,13 @@ int main(int argc, char** argv)
 
     size_t fileSize;
     void* fileData;
-    ReadEntireFile(&fileData, &fileSize, argv[1]);
+    if (!ReadEntireFile(&fileData, &fileSize, argv[1]))
+    {
+        fprintf(stderr, "Can't open file.\n");
+        return 1;
+    }
+
+    Job_Init(0);
 
     char fileName[MAX_PATH];
     GetFileName(fileName, argv[1]);
@@ -89,9 +70,17 @@ int main(int argc, char** argv)
     Mesh m = {};
     LoadObject(&m, NULL, fileData, fileSize, fileName, argv[1]);
 
+    // textures are looked up the same way the renderer does it: textures/<name>.dds next to the scene
+    char objDir[MAX_PATH];
+    char textureDir[MAX_PATH];
+    GetDirectoryPath(objDir, argv[1]);
+    PathCombine(textureDir, objDir, "textures");
+
     StripFileExtension(fileName);
     WriteBinaryMeshToFile(&m, fmt("%s.scene", fileName));
-    WriteBinaryMaterialToFile(&m, fmt("%s.material", fileName));
+    WriteBinaryMaterialToFile(&m, fmt("%s.material", fileName), textureDir);
+
+    Job_Shutdown();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,789 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define DDSKTX_IMPLEMENT
+#include "../../dds-ktx/dds-ktx.h"
+#include <emmintrin.h>
+
+// statistics are gathered on the first mip that fits in STATS_MIP_SIZE² texels,
+// which is cheap to decode and already filtered by the texture tool
+#define STATS_MIP_SIZE 64
+#define ALPHA_TEST_THRESHOLD 128
+
+struct DecodedImage
+{
+    u32 width;
+    u32 height;
+    u8* data; // rgba8
+    bool hasAlpha;
+};
+
+//
+// block decoders
+//
+
+static void DecodeColorBC1(u8* rgba, const u8* block, bool allowTransparent)
+{
+    const u32 c0 = block[0] | (block[1] << 8);
+    const u32 c1 = block[2] | (block[3] << 8);
+
+    u8 palette[4][4];
+    const u32 colors[2] = { c0, c1 };
+    for (u32 e = 0; e < 2; ++e)
+    {
+        const u32 r = (colors[e] >> 11) & 31;
+        const u32 g = (colors[e] >> 5) & 63;
+        const u32 b = colors[e] & 31;
+        palette[e][0] = (u8)((r << 3) | (r >> 2));
+        palette[e][1] = (u8)((g << 2) | (g >> 4));
+        palette[e][2] = (u8)((b << 3) | (b >> 2));
+        palette[e][3] = 255;
+    }
+
+    for (u32 c = 0; c < 4; ++c)
+    {
+        if (c0 > c1 || !allowTransparent)
+        {
+            palette[2][c] = (u8)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+            palette[3][c] = (u8)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+        }
+        else
+        {
+            palette[2][c] = (u8)((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+
+    const u32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((u32)block[7] << 24);
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const u32 index = (indices >> (2 * i)) & 3;
+        rgba[i * 4 + 0] = palette[index][0];
+        rgba[i * 4 + 1] = palette[index][1];
+        rgba[i * 4 + 2] = palette[index][2];
+        if (allowTransparent)
+        {
+            rgba[i * 4 + 3] = palette[index][3];
+        }
+    }
+}
+
+static void DecodeAlphaBC2(u8* rgba, const u8* block)
+{
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const u32 alpha = (block[i / 2] >> ((i & 1) * 4)) & 15;
+        rgba[i * 4 + 3] = (u8)(alpha * 17);
+    }
+}
+
+static void DecodeChannelBC4(u8* rgba, const u8* block, u32 channel)
+{
+    const u32 e0 = block[0];
+    const u32 e1 = block[1];
+
+    u8 palette[8];
+    palette[0] = (u8)e0;
+    palette[1] = (u8)e1;
+    if (e0 > e1)
+    {
+        for (u32 i = 1; i < 7; ++i)
+        {
+            palette[i + 1] = (u8)(((7 - i) * e0 + i * e1 + 3) / 7);
+        }
+    }
+    else
+    {
+        for (u32 i = 1; i < 5; ++i)
+        {
+            palette[i + 1] = (u8)(((5 - i) * e0 + i * e1 + 2) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    u64 bits = 0;
+    for (u32 i = 0; i < 6; ++i)
+    {
+        bits |= (u64)block[2 + i] << (8 * i);
+    }
+    for (u32 i = 0; i < 16; ++i)
+    {
+        rgba[i * 4 + channel] = palette[(bits >> (3 * i)) & 7];
+    }
+}
+
+// BC7 partition tables, bit i of a 2-subset entry is the subset of texel i
+static const u16 partitionsBC7_2[64] =
+{
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+static const u8 partitionsBC7_3[64][16] =
+{
+    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+    { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+    { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+    { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+    { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+    { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+    { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+    { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+    { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+    { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+    { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+    { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+    { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+    { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+    { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+    { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+    { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+    { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+    { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+    { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+    { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+    { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+    { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+    { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+    { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+    { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+    { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+    { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+};
+
+// anchor texels of the second subset (2 subsets), and of the second and third subsets (3 subsets)
+static const u8 anchorsBC7_2[64] =
+{
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+static const u8 anchorsBC7_3[2][64] =
+{
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+    },
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+    }
+};
+
+struct ModeBC7
+{
+    u8 numSubsets;
+    u8 partitionBits;
+    u8 rotationBits;
+    u8 indexSelectionBits;
+    u8 colorBits;
+    u8 alphaBits;
+    u8 endpointPBits;
+    u8 sharedPBits;
+    u8 indexBits;
+    u8 indexBits2;
+};
+
+static const ModeBC7 modesBC7[8] =
+{
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+static const u8 weightsBC7_2[4] = { 0, 21, 43, 64 };
+static const u8 weightsBC7_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const u8 weightsBC7_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static u32 ReadBits(const u8* block, u32* position, u32 count)
+{
+    u32 result = 0;
+    for (u32 i = 0; i < count; ++i)
+    {
+        const u32 bit = *position + i;
+        result |= ((block[bit >> 3] >> (bit & 7)) & 1) << i;
+    }
+    *position += count;
+    return result;
+}
+
+static const u8* GetWeightsBC7(u32 indexBits)
+{
+    return indexBits == 2 ? weightsBC7_2 : (indexBits == 3 ? weightsBC7_3 : weightsBC7_4);
+}
+
+static void DecodeBlockBC7(u8* rgba, const u8* block)
+{
+    u32 mode = 0;
+    while (mode < 8 && !(block[0] & (1 << mode)))
+    {
+        mode++;
+    }
+    if (mode == 8)
+    {
+        memset(rgba, 0, 64); // reserved mode
+        return;
+    }
+
+    const ModeBC7* info = &modesBC7[mode];
+    u32 position = mode + 1;
+    const u32 partition = ReadBits(block, &position, info->partitionBits);
+    const u32 rotation = ReadBits(block, &position, info->rotationBits);
+    const u32 indexSelection = ReadBits(block, &position, info->indexSelectionBits);
+
+    u32 endpoints[6][4];
+    const u32 numEndpoints = info->numSubsets * 2;
+    for (u32 c = 0; c < 3; ++c)
+    {
+        for (u32 e = 0; e < numEndpoints; ++e)
+        {
+            endpoints[e][c] = ReadBits(block, &position, info->colorBits);
+        }
+    }
+    for (u32 e = 0; e < numEndpoints; ++e)
+    {
+        endpoints[e][3] = info->alphaBits ? ReadBits(block, &position, info->alphaBits) : 255;
+    }
+
+    u32 pbits[6] = {};
+    if (info->endpointPBits)
+    {
+        for (u32 e = 0; e < numEndpoints; ++e)
+        {
+            pbits[e] = ReadBits(block, &position, 1);
+        }
+    }
+    else if (info->sharedPBits)
+    {
+        for (u32 s = 0; s < info->numSubsets; ++s)
+        {
+            pbits[s * 2 + 0] = pbits[s * 2 + 1] = ReadBits(block, &position, 1);
+        }
+    }
+
+    const bool hasPBits = info->endpointPBits || info->sharedPBits;
+    for (u32 e = 0; e < numEndpoints; ++e)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            u32 bits = c < 3 ? info->colorBits : info->alphaBits;
+            if (bits == 0)
+            {
+                continue;
+            }
+
+            u32 value = endpoints[e][c];
+            if (hasPBits)
+            {
+                value = (value << 1) | pbits[e];
+                bits++;
+            }
+            value <<= 8 - bits;
+            endpoints[e][c] = value | (value >> bits);
+        }
+    }
+
+    u32 subsets[16] = {};
+    u32 anchors[3] = { 0, 0, 0 };
+    if (info->numSubsets == 2)
+    {
+        for (u32 i = 0; i < 16; ++i)
+        {
+            subsets[i] = (partitionsBC7_2[partition] >> i) & 1;
+        }
+        anchors[1] = anchorsBC7_2[partition];
+    }
+    else if (info->numSubsets == 3)
+    {
+        for (u32 i = 0; i < 16; ++i)
+        {
+            subsets[i] = partitionsBC7_3[partition][i];
+        }
+        anchors[1] = anchorsBC7_3[0][partition];
+        anchors[2] = anchorsBC7_3[1][partition];
+    }
+
+    u32 indices[16];
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const bool isAnchor = i == anchors[subsets[i]];
+        indices[i] = ReadBits(block, &position, info->indexBits - (isAnchor ? 1 : 0));
+    }
+
+    u32 indices2[16] = {};
+    if (info->indexBits2)
+    {
+        for (u32 i = 0; i < 16; ++i)
+        {
+            indices2[i] = ReadBits(block, &position, info->indexBits2 - (i == 0 ? 1 : 0));
+        }
+    }
+    assert(position == 128);
+
+    // modes 4 and 5 have separate color and alpha indices, mode 4 can swap which set is which
+    const u8* colorWeights = GetWeightsBC7(info->indexBits);
+    const u8* alphaWeights = colorWeights;
+    const u32* colorIndices = indices;
+    const u32* alphaIndices = indices;
+    if (info->indexBits2)
+    {
+        alphaWeights = GetWeightsBC7(info->indexBits2);
+        alphaIndices = indices2;
+        if (indexSelection)
+        {
+            colorWeights = alphaWeights;
+            alphaWeights = GetWeightsBC7(info->indexBits);
+            colorIndices = indices2;
+            alphaIndices = indices;
+        }
+    }
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const u32* e0 = endpoints[subsets[i] * 2 + 0];
+        const u32* e1 = endpoints[subsets[i] * 2 + 1];
+        u8* texel = rgba + i * 4;
+        for (u32 c = 0; c < 4; ++c)
+        {
+            const u32 w = c < 3 ? colorWeights[colorIndices[i]] : alphaWeights[alphaIndices[i]];
+            texel[c] = (u8)(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+        }
+
+        if (rotation != 0)
+        {
+            const u8 temp = texel[3];
+            texel[3] = texel[rotation - 1];
+            texel[rotation - 1] = temp;
+        }
+    }
+}
+
+static bool DecodeBlock(u8* rgba, const u8* block, ddsktx_format format)
+{
+    switch (format)
+    {
+    case DDSKTX_FORMAT_BC1:
+        DecodeColorBC1(rgba, block, true);
+        return true;
+    case DDSKTX_FORMAT_BC2:
+        DecodeColorBC1(rgba, block + 8, false);
+        DecodeAlphaBC2(rgba, block);
+        return true;
+    case DDSKTX_FORMAT_BC3:
+        DecodeColorBC1(rgba, block + 8, false);
+        DecodeChannelBC4(rgba, block, 3);
+        return true;
+    case DDSKTX_FORMAT_BC4:
+        DecodeChannelBC4(rgba, block, 0);
+        for (u32 i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 1] = rgba[i * 4 + 2] = rgba[i * 4 + 0];
+            rgba[i * 4 + 3] = 255;
+        }
+        return true;
+    case DDSKTX_FORMAT_BC5:
+        DecodeChannelBC4(rgba, block + 0, 0);
+        DecodeChannelBC4(rgba, block + 8, 1);
+        for (u32 i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        return true;
+    case DDSKTX_FORMAT_BC7:
+        DecodeBlockBC7(rgba, block);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool HasAlpha(ddsktx_format format)
+{
+    return format == DDSKTX_FORMAT_BC1 || format == DDSKTX_FORMAT_BC2 || format == DDSKTX_FORMAT_BC3 ||
+           format == DDSKTX_FORMAT_BC7 || format == DDSKTX_FORMAT_RGBA8 || format == DDSKTX_FORMAT_BGRA8;
+}
+
+// Decodes the statistics mip of a .dds file to rgba8.
+static bool LoadTextureMip(DecodedImage* image, const char* filePath)
+{
+    void* fileData;
+    size_t size;
+    if (!ReadEntireFile(&fileData, &size, filePath))
+    {
+        return false;
+    }
+
+    ddsktx_texture_info tc = {};
+    if (!ddsktx_parse(&tc, fileData, (int)size, NULL))
+    {
+        fprintf(stderr, "warning: can't parse %s\n", filePath);
+        free(fileData);
+        return false;
+    }
+
+    s32 mip = 0;
+    while (mip + 1 < tc.num_mips && MAX(tc.width >> mip, tc.height >> mip) > STATS_MIP_SIZE)
+    {
+        mip++;
+    }
+
+    ddsktx_sub_data sub;
+    ddsktx_get_sub(&tc, &sub, fileData, size, 0, 0, mip);
+
+    image->width = sub.width;
+    image->height = sub.height;
+    image->hasAlpha = HasAlpha(tc.format);
+    image->data = (u8*)malloc((size_t)image->width * image->height * 4);
+
+    const u8* source = (const u8*)sub.buff;
+    bool result = true;
+    if (tc.format == DDSKTX_FORMAT_RGBA8 || tc.format == DDSKTX_FORMAT_BGRA8)
+    {
+        for (u32 y = 0; y < image->height; ++y)
+        {
+            const u8* row = source + y * sub.row_pitch_bytes;
+            u8* output = image->data + y * image->width * 4;
+            for (u32 x = 0; x < image->width; ++x)
+            {
+                const bool swap = tc.format == DDSKTX_FORMAT_BGRA8;
+                output[x * 4 + 0] = row[x * 4 + (swap ? 2 : 0)];
+                output[x * 4 + 1] = row[x * 4 + 1];
+                output[x * 4 + 2] = row[x * 4 + (swap ? 0 : 2)];
+                output[x * 4 + 3] = row[x * 4 + 3];
+            }
+        }
+    }
+    else
+    {
+        const u32 blockBytes = (tc.format == DDSKTX_FORMAT_BC1 || tc.format == DDSKTX_FORMAT_BC4) ? 8 : 16;
+        const u32 blocksX = (image->width + 3) / 4;
+        const u32 blocksY = (image->height + 3) / 4;
+        for (u32 by = 0; by < blocksY && result; ++by)
+        {
+            for (u32 bx = 0; bx < blocksX; ++bx)
+            {
+                u8 texels[64];
+                const u8* block = source + by * sub.row_pitch_bytes + bx * blockBytes;
+                if (!DecodeBlock(texels, block, tc.format))
+                {
+                    fprintf(stderr, "warning: unsupported texture format in %s\n", filePath);
+                    result = false;
+                    break;
+                }
+
+                for (u32 i = 0; i < 16; ++i)
+                {
+                    const u32 x = bx * 4 + (i & 3);
+                    const u32 y = by * 4 + (i >> 2);
+                    if (x < image->width && y < image->height)
+                    {
+                        memcpy(image->data + (y * image->width + x) * 4, texels + i * 4, 4);
+                    }
+                }
+            }
+        }
+    }
+
+    free(fileData);
+    if (!result)
+    {
+        free(image->data);
+        image->data = NULL;
+    }
+
+    return result;
+}
+
+//
+// reductions
+//
+
+struct TexelSums
+{
+    u64 weighted[3]; // rgb * alpha
+    u64 color[3];
+    u64 alpha;
+    u64 covered;
+    u64 count;
+};
+
+static u32 CountCoveredTexels(s32 mask)
+{
+    // one bit per alpha byte
+    return ((mask >> 3) & 1) + ((mask >> 7) & 1) + ((mask >> 11) & 1) + ((mask >> 15) & 1);
+}
+
+// Sums a run of rgba8 texels, 4 texels per iteration.
+static void SumTexels(TexelSums* sums, const u8* rgba, u32 count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i threshold = _mm_set1_epi8((char)ALPHA_TEST_THRESHOLD);
+
+    u32 i = 0;
+    while (i + 4 <= count)
+    {
+        // the 32-bit lanes can't overflow for 4096 texels: 4096 * 255 * 255 < 2^32
+        const u32 batchEnd = MIN(count & ~3u, i + 4096);
+        __m128i weighted = zero;
+        __m128i color = zero;
+        u32 covered = 0;
+        for (; i < batchEnd; i += 4)
+        {
+            const __m128i texels = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+            const __m128i lo = _mm_unpacklo_epi8(texels, zero);
+            const __m128i hi = _mm_unpackhi_epi8(texels, zero);
+
+            // broadcast each texel's alpha to its 4 channels
+            const __m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            const __m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            const __m128i productLo = _mm_mullo_epi16(lo, alphaLo);
+            const __m128i productHi = _mm_mullo_epi16(hi, alphaHi);
+
+            weighted = _mm_add_epi32(weighted, _mm_add_epi32(_mm_unpacklo_epi16(productLo, zero), _mm_unpackhi_epi16(productLo, zero)));
+            weighted = _mm_add_epi32(weighted, _mm_add_epi32(_mm_unpacklo_epi16(productHi, zero), _mm_unpackhi_epi16(productHi, zero)));
+            const __m128i sum = _mm_add_epi16(lo, hi);
+            color = _mm_add_epi32(color, _mm_add_epi32(_mm_unpacklo_epi16(sum, zero), _mm_unpackhi_epi16(sum, zero)));
+
+            const __m128i passed = _mm_cmpeq_epi8(_mm_max_epu8(texels, threshold), texels);
+            covered += CountCoveredTexels(_mm_movemask_epi8(passed));
+        }
+
+        u32 weightedLanes[4];
+        u32 colorLanes[4];
+        _mm_storeu_si128((__m128i*)weightedLanes, weighted);
+        _mm_storeu_si128((__m128i*)colorLanes, color);
+        for (u32 c = 0; c < 3; ++c)
+        {
+            sums->weighted[c] += weightedLanes[c];
+            sums->color[c] += colorLanes[c];
+        }
+        sums->alpha += colorLanes[3];
+        sums->covered += covered;
+    }
+
+    for (; i < count; ++i)
+    {
+        const u8* texel = rgba + i * 4;
+        for (u32 c = 0; c < 3; ++c)
+        {
+            sums->weighted[c] += texel[c] * texel[3];
+            sums->color[c] += texel[c];
+        }
+        sums->alpha += texel[3];
+        sums->covered += texel[3] >= ALPHA_TEST_THRESHOLD ? 1 : 0;
+    }
+
+    sums->count += count;
+}
+
+static void AddSums(TexelSums* output, const TexelSums* input)
+{
+    for (u32 c = 0; c < 3; ++c)
+    {
+        output->weighted[c] += input->weighted[c];
+        output->color[c] += input->color[c];
+    }
+    output->alpha += input->alpha;
+    output->covered += input->covered;
+    output->count += input->count;
+}
+
+// Average color of the visible texels (rgb) + average opacity.
+static vec4_t GetAverageColor(const TexelSums* sums)
+{
+    vec4_t result = {};
+    if (sums->count == 0)
+    {
+        return result;
+    }
+
+    for (u32 c = 0; c < 3; ++c)
+    {
+        // fully transparent regions fall back to the unweighted average
+        result.v[c] = sums->alpha > 0 ? (f32)sums->weighted[c] / (255.0f * sums->alpha) : (f32)sums->color[c] / (255.0f * sums->count);
+    }
+    result.w = (f32)sums->alpha / (255.0f * sums->count);
+
+    return result;
+}
+
+static u32 PackColor(vec4_t color)
+{
+    u32 result = 0;
+    for (u32 c = 0; c < 4; ++c)
+    {
+        const u32 value = (u32)(CLAMP_MAX(CLAMP_MIN(color.v[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+        result |= value << (8 * c);
+    }
+    return result;
+}
+
+void ComputeMaterialStats(MeshFileMaterial* material, const ParseMaterial* parseMaterial, const char* textureDir)
+{
+    const char* albedoName = parseMaterial->mapPaths[TextureId::Albedo];
+    const char* alphaName = parseMaterial->mapPaths[TextureId::Alpha];
+
+    DecodedImage albedo = {};
+    DecodedImage mask = {};
+    const bool hasAlbedo = albedoName != NULL && LoadTextureMip(&albedo, fmt("%s/%s.dds", textureDir, albedoName));
+    const bool hasMask = alphaName != NULL && LoadTextureMip(&mask, fmt("%s/%s.dds", textureDir, alphaName));
+
+    // without textures the constants come from the .mtl file
+    Vec3Copy(material->alphaTestedColor, parseMaterial->Kd);
+    material->alphaTestedColor.w = parseMaterial->d;
+    material->coverage = parseMaterial->d * 255.0f >= ALPHA_TEST_THRESHOLD ? 1.0f : 0.0f;
+    if (!hasAlbedo && !hasMask)
+    {
+        const u32 color = PackColor(material->alphaTestedColor);
+        for (u32 i = 0; i < ARRAY_LEN(material->colorSignature); ++i)
+        {
+            material->colorSignature[i] = color;
+        }
+        return;
+    }
+
+    if (!hasAlbedo)
+    {
+        albedo.width = mask.width;
+        albedo.height = mask.height;
+        albedo.data = (u8*)malloc((size_t)albedo.width * albedo.height * 4);
+        const u32 color = PackColor(material->alphaTestedColor);
+        for (u32 i = 0; i < albedo.width * albedo.height; ++i)
+        {
+            memcpy(albedo.data + i * 4, &color, 4);
+        }
+    }
+
+    // a separate mask replaces the albedo's alpha, single channel masks store it in red
+    if (hasMask)
+    {
+        const u32 channel = mask.hasAlpha ? 3 : 0;
+        for (u32 y = 0; y < albedo.height; ++y)
+        {
+            const u32 my = y * mask.height / albedo.height;
+            for (u32 x = 0; x < albedo.width; ++x)
+            {
+                const u32 mx = x * mask.width / albedo.width;
+                albedo.data[(y * albedo.width + x) * 4 + 3] = mask.data[(my * mask.width + mx) * 4 + channel];
+            }
+        }
+        free(mask.data);
+    }
+
+    // the signature cells partition the image, so the totals are the sum of the cells
+    TexelSums total = {};
+    TexelSums cells[MATERIAL_SIGNATURE_SIZE * MATERIAL_SIGNATURE_SIZE] = {};
+    for (u32 cy = 0; cy < MATERIAL_SIGNATURE_SIZE; ++cy)
+    {
+        const u32 y0 = cy * albedo.height / MATERIAL_SIGNATURE_SIZE;
+        const u32 y1 = (cy + 1) * albedo.height / MATERIAL_SIGNATURE_SIZE;
+        for (u32 cx = 0; cx < MATERIAL_SIGNATURE_SIZE; ++cx)
+        {
+            const u32 x0 = cx * albedo.width / MATERIAL_SIGNATURE_SIZE;
+            const u32 x1 = (cx + 1) * albedo.width / MATERIAL_SIGNATURE_SIZE;
+            TexelSums* cell = &cells[cy * MATERIAL_SIGNATURE_SIZE + cx];
+            for (u32 y = y0; y < y1; ++y)
+            {
+                SumTexels(cell, albedo.data + (y * albedo.width + x0) * 4, x1 - x0);
+            }
+            AddSums(&total, cell);
+        }
+    }
+    free(albedo.data);
+
+    material->alphaTestedColor = GetAverageColor(&total);
+    material->coverage = (f32)total.covered / (f32)total.count;
+    for (u32 i = 0; i < ARRAY_LEN(cells); ++i)
+    {
+        // cells can be empty when the mip is less than 4 texels wide
+        material->colorSignature[i] = PackColor(GetAverageColor(cells[i].count > 0 ? &cells[i] : &total));
+    }
+}
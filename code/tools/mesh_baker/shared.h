@@ -35,12 +35,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include "../../common/shared.h"
+#include "../../common/job_system.h"
 #include "../../scene/s_public.h"
 #include "../../shaders/material_flags.hlsli"
 
+// names and paths are interned
 struct ParseMaterial
 {
-    char name[MAX_PATH];
+    const char* name;
     vec3_t Ka; // Ambient color
     vec3_t Kd; // Diffuse color
     vec3_t Ks; // Specular color
@@ -53,7 +55,7 @@ struct ParseMaterial
     s32 Illum; // Illumination
     u32 isAlphaTested;
     Image maps[TextureId::Count];
-    char* mapPaths[TextureId::Count];
+    const char* mapPaths[TextureId::Count];
     u32 textureIndex[TextureId::Count];
 };
 
@@ -74,7 +76,7 @@ struct MaterialGroup
 // A group consists of a name, face amount, offsets in the mesh.
 struct ObjectGroup
 {
-    char* name;
+    const char* name; // interned
 
     u32 numFaces;
     u32 faceOffset; // where does this group start in the face_vertices buffer;
@@ -118,8 +120,8 @@ struct Object
 struct ObjectData
 {
     char objPath[MAX_PATH];
-    Object* m; // the mesh
-    ObjectGroup currentGroup;
+    Object* m; // the mesh, its last group is the one being parsed
+    HashMap<const char*, u32, InternedStringHash> materialIndexes; // by interned name
     u32 currentSgroup;
 };
 
@@ -146,4 +148,5 @@ struct Mesh
 
 void LoadObject(Mesh* mesh, MemoryArena* arena, void* data, u64 size, const char* name, const char* objPath);
 void WriteBinaryMeshToFile(Mesh* mesh, const char* filePath);
-void WriteBinaryMaterialToFile(Mesh* mesh, const char* filePath);
\ No newline at end of file
+void WriteBinaryMaterialToFile(Mesh* mesh, const char* filePath, const char* textureDir);
+void ComputeMaterialStats(MeshFileMaterial* material, const ParseMaterial* parseMaterial, const char* textureDir);
\ No newline at end of file
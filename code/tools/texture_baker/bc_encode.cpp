@@ -0,0 +1,708 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include <emmintrin.h>
+
+// SSE2 is part of x64, so no run-time dispatch is needed.
+// BC4/BC5 search the palette for 16 pixels at once with saturated byte arithmetic.
+// BC7 only uses mode 6 (1 subset, RGBA 7.7.7.7 + p-bit, 4-bit indices) and searches 4 pixels or 4 palette entries at once.
+
+static const u32 bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+u32 GetBlockBytes(BlockFormat::Type format)
+{
+    return format == BlockFormat::BC4 ? 8 : 16;
+}
+
+//
+// BC4
+//
+
+static void BuildPaletteBC4(u8* palette, u32 e0, u32 e1)
+{
+    palette[0] = (u8)e0;
+    palette[1] = (u8)e1;
+    if (e0 > e1)
+    {
+        for (u32 i = 1; i < 7; ++i)
+        {
+            palette[1 + i] = (u8)(((7 - i) * e0 + i * e1 + 3) / 7);
+        }
+    }
+    else
+    {
+        for (u32 i = 1; i < 5; ++i)
+        {
+            palette[1 + i] = (u8)(((5 - i) * e0 + i * e1 + 2) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// returns the squared error
+static u32 FindIndicesBC4(u8* indices, __m128i pixels, const u8* palette)
+{
+    __m128i best = _mm_set1_epi8((char)255);
+    __m128i bestIndex = _mm_setzero_si128();
+    for (u32 i = 0; i < 8; ++i)
+    {
+        const __m128i value = _mm_set1_epi8((char)palette[i]);
+        const __m128i dist = _mm_or_si128(_mm_subs_epu8(pixels, value), _mm_subs_epu8(value, pixels));
+        const __m128i isLess = _mm_andnot_si128(_mm_cmpeq_epi8(dist, best), _mm_cmpeq_epi8(_mm_min_epu8(dist, best), dist));
+        best = _mm_min_epu8(dist, best);
+        bestIndex = _mm_or_si128(_mm_and_si128(isLess, _mm_set1_epi8((char)i)), _mm_andnot_si128(isLess, bestIndex));
+    }
+    _mm_storeu_si128((__m128i*)indices, bestIndex);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_unpacklo_epi8(best, zero);
+    const __m128i hi = _mm_unpackhi_epi8(best, zero);
+    const __m128i sum = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+    u32 sums[4];
+    _mm_storeu_si128((__m128i*)sums, sum);
+    return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+static u32 HorizontalMin(__m128i v)
+{
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 4));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 2));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 1));
+    return (u32)(_mm_cvtsi128_si32(v) & 0xFF);
+}
+
+static u32 HorizontalMax(__m128i v)
+{
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 1));
+    return (u32)(_mm_cvtsi128_si32(v) & 0xFF);
+}
+
+struct BlockBC4
+{
+    u32 e0;
+    u32 e1;
+    u8 indices[16];
+    u32 error;
+};
+
+static void TryEndpointsBC4(BlockBC4* best, __m128i pixels, u32 e0, u32 e1)
+{
+    u8 palette[8];
+    u8 indices[16];
+    BuildPaletteBC4(palette, e0, e1);
+    const u32 error = FindIndicesBC4(indices, pixels, palette);
+    if (error < best->error)
+    {
+        best->e0 = e0;
+        best->e1 = e1;
+        best->error = error;
+        memcpy(best->indices, indices, sizeof(indices));
+    }
+}
+
+void EncodeBlockBC4(u8* output, const u8* rgba, u32 channel, BakePreset::Type preset)
+{
+    u8 values[16];
+    for (u32 i = 0; i < 16; ++i)
+    {
+        values[i] = rgba[i * 4 + channel];
+    }
+    const __m128i pixels = _mm_loadu_si128((const __m128i*)values);
+    const u32 minValue = HorizontalMin(pixels);
+    const u32 maxValue = HorizontalMax(pixels);
+
+    BlockBC4 best;
+    best.error = UINT32_MAX;
+    TryEndpointsBC4(&best, pixels, maxValue, minValue);
+
+    if (preset == BakePreset::Quality && best.error > 0)
+    {
+        // shrink the range a bit, the extremes rarely are the best endpoints
+        for (u32 d0 = 0; d0 < 3; ++d0)
+        {
+            for (u32 d1 = 0; d1 < 3; ++d1)
+            {
+                const s32 e0 = (s32)maxValue - (s32)d0;
+                const s32 e1 = (s32)minValue + (s32)d1;
+                if (e0 > e1)
+                {
+                    TryEndpointsBC4(&best, pixels, (u32)e0, (u32)e1);
+                }
+            }
+        }
+
+        // 6 interpolated values with explicit 0 and 255
+        const __m128i isZero = _mm_cmpeq_epi8(pixels, _mm_setzero_si128());
+        const __m128i isFull = _mm_cmpeq_epi8(pixels, _mm_set1_epi8((char)255));
+        const u32 innerMin = HorizontalMin(_mm_or_si128(pixels, isZero));
+        const u32 innerMax = HorizontalMax(_mm_andnot_si128(isFull, pixels));
+        if (innerMin <= innerMax)
+        {
+            TryEndpointsBC4(&best, pixels, innerMin, innerMax);
+        }
+    }
+
+    output[0] = (u8)best.e0;
+    output[1] = (u8)best.e1;
+    u64 bits = 0;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        bits |= (u64)best.indices[i] << (3 * i);
+    }
+    for (u32 i = 0; i < 6; ++i)
+    {
+        output[2 + i] = (u8)(bits >> (8 * i));
+    }
+}
+
+void EncodeBlockBC5(u8* output, const u8* rgba, BakePreset::Type preset)
+{
+    EncodeBlockBC4(output + 0, rgba, 0, preset);
+    EncodeBlockBC4(output + 8, rgba, 1, preset);
+}
+
+static void DecodeBlockBC4(u8* rgba, const u8* block, u32 channel)
+{
+    u8 palette[8];
+    BuildPaletteBC4(palette, block[0], block[1]);
+    u64 bits = 0;
+    for (u32 i = 0; i < 6; ++i)
+    {
+        bits |= (u64)block[2 + i] << (8 * i);
+    }
+    for (u32 i = 0; i < 16; ++i)
+    {
+        rgba[i * 4 + channel] = palette[(bits >> (3 * i)) & 7];
+    }
+}
+
+//
+// BC7 mode 6
+//
+
+struct BlockBC7
+{
+    s32 endpoints[2][4]; // 7 bits
+    s32 pbits[2];
+    u8 indices[16];
+    u32 error;
+};
+
+struct PixelsBC7
+{
+    __m128 channels[4][4]; // [channel][group of 4 pixels]
+    f32 values[16][4];
+};
+
+static s32 QuantizeBC7(f32 value, s32 pbit)
+{
+    const s32 q = (s32)((value - (f32)pbit) * 0.5f + 0.5f);
+    return CLAMP_MAX(CLAMP_MIN(q, 0), 127);
+}
+
+// picks the p-bit that gives the smallest error for a whole endpoint
+static s32 ChooseEndpointBC7(s32* endpoint, const f32* value)
+{
+    f32 bestError = FLT_MAX;
+    s32 bestPbit = 0;
+    for (s32 p = 0; p < 2; ++p)
+    {
+        f32 error = 0.0f;
+        for (u32 c = 0; c < 4; ++c)
+        {
+            const f32 d = (f32)((QuantizeBC7(value[c], p) << 1) | p) - value[c];
+            error += d * d;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            bestPbit = p;
+        }
+    }
+
+    for (u32 c = 0; c < 4; ++c)
+    {
+        endpoint[c] = QuantizeBC7(value[c], bestPbit);
+    }
+    return bestPbit;
+}
+
+static void BuildPaletteBC7(s32 palette[16][4], const BlockBC7* block)
+{
+    for (u32 c = 0; c < 4; ++c)
+    {
+        const s32 e0 = (block->endpoints[0][c] << 1) | block->pbits[0];
+        const s32 e1 = (block->endpoints[1][c] << 1) | block->pbits[1];
+        for (u32 i = 0; i < 16; ++i)
+        {
+            palette[i][c] = ((64 - (s32)bc7Weights4[i]) * e0 + (s32)bc7Weights4[i] * e1 + 32) >> 6;
+        }
+    }
+}
+
+static u32 ComputeErrorBC7(const BlockBC7* block, const PixelsBC7* pixels, const s32 palette[16][4])
+{
+    u32 error = 0;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            const s32 d = palette[block->indices[i]][c] - (s32)pixels->values[i][c];
+            error += (u32)(d * d);
+        }
+    }
+    return error;
+}
+
+// projects the pixels on the endpoint segment, 4 pixels at a time
+static void FindIndicesFastBC7(BlockBC7* block, const PixelsBC7* pixels, const s32 palette[16][4])
+{
+    __m128 e0[4];
+    __m128 dir[4];
+    f32 lengthSq = 0.0f;
+    for (u32 c = 0; c < 4; ++c)
+    {
+        const f32 d = (f32)(palette[15][c] - palette[0][c]);
+        e0[c] = _mm_set1_ps((f32)palette[0][c]);
+        dir[c] = _mm_set1_ps(d);
+        lengthSq += d * d;
+    }
+
+    const __m128 scale = _mm_set1_ps(lengthSq > 0.0f ? 15.0f / lengthSq : 0.0f);
+    const __m128i maxIndex = _mm_set1_epi32(15);
+    for (u32 g = 0; g < 4; ++g)
+    {
+        __m128 t = _mm_setzero_ps();
+        for (u32 c = 0; c < 4; ++c)
+        {
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(pixels->channels[c][g], e0[c]), dir[c]));
+        }
+        __m128i index = _mm_cvtps_epi32(_mm_mul_ps(t, scale));
+        index = _mm_and_si128(index, _mm_cmpgt_epi32(index, _mm_setzero_si128())); // max(index, 0)
+        const __m128i isOver = _mm_cmpgt_epi32(index, maxIndex);
+        index = _mm_or_si128(_mm_and_si128(isOver, maxIndex), _mm_andnot_si128(isOver, index));
+
+        s32 indices[4];
+        _mm_storeu_si128((__m128i*)indices, index);
+        for (u32 i = 0; i < 4; ++i)
+        {
+            block->indices[g * 4 + i] = (u8)indices[i];
+        }
+    }
+}
+
+// tests every palette entry, 4 entries at a time
+static void FindIndicesExhaustiveBC7(BlockBC7* block, const PixelsBC7* pixels, const s32 palette[16][4])
+{
+    __m128 entries[4][4];
+    for (u32 c = 0; c < 4; ++c)
+    {
+        for (u32 g = 0; g < 4; ++g)
+        {
+            entries[c][g] = _mm_setr_ps((f32)palette[g * 4 + 0][c], (f32)palette[g * 4 + 1][c], (f32)palette[g * 4 + 2][c], (f32)palette[g * 4 + 3][c]);
+        }
+    }
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        __m128 errors[4];
+        for (u32 g = 0; g < 4; ++g)
+        {
+            __m128 error = _mm_setzero_ps();
+            for (u32 c = 0; c < 4; ++c)
+            {
+                const __m128 d = _mm_sub_ps(entries[c][g], _mm_set1_ps(pixels->values[i][c]));
+                error = _mm_add_ps(error, _mm_mul_ps(d, d));
+            }
+            errors[g] = error;
+        }
+
+        __m128 minError = _mm_min_ps(_mm_min_ps(errors[0], errors[1]), _mm_min_ps(errors[2], errors[3]));
+        minError = _mm_min_ps(minError, _mm_shuffle_ps(minError, minError, _MM_SHUFFLE(2, 3, 0, 1)));
+        minError = _mm_min_ps(minError, _mm_shuffle_ps(minError, minError, _MM_SHUFFLE(1, 0, 3, 2)));
+        for (u32 g = 0; g < 4; ++g)
+        {
+            const s32 mask = _mm_movemask_ps(_mm_cmpeq_ps(errors[g], minError));
+            if (mask != 0)
+            {
+                u32 lane = 0;
+                while ((mask & (1 << lane)) == 0)
+                {
+                    ++lane;
+                }
+                block->indices[i] = (u8)(g * 4 + lane);
+                break;
+            }
+        }
+    }
+}
+
+static void EvaluateBC7(BlockBC7* block, const PixelsBC7* pixels, BakePreset::Type preset)
+{
+    s32 palette[16][4];
+    BuildPaletteBC7(palette, block);
+    if (preset == BakePreset::Quality)
+    {
+        FindIndicesExhaustiveBC7(block, pixels, palette);
+    }
+    else
+    {
+        FindIndicesFastBC7(block, pixels, palette);
+    }
+    block->error = ComputeErrorBC7(block, pixels, palette);
+}
+
+// least-squares fit of the endpoints for the current indices
+static bool RefineEndpointsBC7(f32 endpoints[2][4], const BlockBC7* block, const PixelsBC7* pixels)
+{
+    f32 a = 0.0f, b = 0.0f, c = 0.0f;
+    f32 d0[4] = {};
+    f32 d1[4] = {};
+    for (u32 i = 0; i < 16; ++i)
+    {
+        const f32 w = (f32)bc7Weights4[block->indices[i]] / 64.0f;
+        const f32 iw = 1.0f - w;
+        a += iw * iw;
+        b += iw * w;
+        c += w * w;
+        for (u32 ch = 0; ch < 4; ++ch)
+        {
+            d0[ch] += iw * pixels->values[i][ch];
+            d1[ch] += w * pixels->values[i][ch];
+        }
+    }
+
+    const f32 det = a * c - b * b;
+    if (fabsf(det) < 1e-6f)
+    {
+        return false;
+    }
+
+    const f32 invDet = 1.0f / det;
+    for (u32 ch = 0; ch < 4; ++ch)
+    {
+        endpoints[0][ch] = CLAMP_MAX(CLAMP_MIN((c * d0[ch] - b * d1[ch]) * invDet, 0.0f), 255.0f);
+        endpoints[1][ch] = CLAMP_MAX(CLAMP_MIN((a * d1[ch] - b * d0[ch]) * invDet, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+static void QuantizeEndpointsBC7(BlockBC7* block, const f32 endpoints[2][4])
+{
+    block->pbits[0] = ChooseEndpointBC7(block->endpoints[0], endpoints[0]);
+    block->pbits[1] = ChooseEndpointBC7(block->endpoints[1], endpoints[1]);
+}
+
+// principal axis of the block's colors with a few power iterations
+static void ComputeAxisBC7(f32* mean, f32* axis, const PixelsBC7* pixels, u32 numIterations)
+{
+    __m128 sum[4];
+    for (u32 c = 0; c < 4; ++c)
+    {
+        sum[c] = _mm_add_ps(_mm_add_ps(pixels->channels[c][0], pixels->channels[c][1]), _mm_add_ps(pixels->channels[c][2], pixels->channels[c][3]));
+        f32 lanes[4];
+        _mm_storeu_ps(lanes, sum[c]);
+        mean[c] = (lanes[0] + lanes[1] + lanes[2] + lanes[3]) / 16.0f;
+    }
+
+    f32 covariance[4][4];
+    for (u32 c0 = 0; c0 < 4; ++c0)
+    {
+        for (u32 c1 = c0; c1 < 4; ++c1)
+        {
+            __m128 acc = _mm_setzero_ps();
+            const __m128 m0 = _mm_set1_ps(mean[c0]);
+            const __m128 m1 = _mm_set1_ps(mean[c1]);
+            for (u32 g = 0; g < 4; ++g)
+            {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_sub_ps(pixels->channels[c0][g], m0), _mm_sub_ps(pixels->channels[c1][g], m1)));
+            }
+            f32 lanes[4];
+            _mm_storeu_ps(lanes, acc);
+            covariance[c0][c1] = covariance[c1][c0] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+    }
+
+    // start with the row of the largest variance, a diagonal start vector can be orthogonal to the axis
+    u32 startRow = 0;
+    for (u32 c = 1; c < 4; ++c)
+    {
+        if (covariance[c][c] > covariance[startRow][startRow])
+        {
+            startRow = c;
+        }
+    }
+    for (u32 c = 0; c < 4; ++c)
+    {
+        axis[c] = covariance[startRow][c];
+    }
+    for (u32 it = 0; it < numIterations; ++it)
+    {
+        f32 next[4];
+        f32 maxComponent = 0.0f;
+        for (u32 r = 0; r < 4; ++r)
+        {
+            next[r] = covariance[r][0] * axis[0] + covariance[r][1] * axis[1] + covariance[r][2] * axis[2] + covariance[r][3] * axis[3];
+            maxComponent = MAX(maxComponent, fabsf(next[r]));
+        }
+        if (maxComponent == 0.0f)
+        {
+            break;
+        }
+        for (u32 r = 0; r < 4; ++r)
+        {
+            axis[r] = next[r] / maxComponent;
+        }
+    }
+}
+
+static void LoadPixelsBC7(PixelsBC7* pixels, const u8* rgba)
+{
+    for (u32 i = 0; i < 16; ++i)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            pixels->values[i][c] = (f32)rgba[i * 4 + c];
+        }
+    }
+    for (u32 c = 0; c < 4; ++c)
+    {
+        for (u32 g = 0; g < 4; ++g)
+        {
+            pixels->channels[c][g] = _mm_setr_ps(pixels->values[g * 4 + 0][c], pixels->values[g * 4 + 1][c], pixels->values[g * 4 + 2][c], pixels->values[g * 4 + 3][c]);
+        }
+    }
+}
+
+struct BitWriter
+{
+    u8* output;
+    u32 position;
+};
+
+static void WriteBits(BitWriter* writer, u32 value, u32 numBits)
+{
+    for (u32 i = 0; i < numBits; ++i, ++writer->position)
+    {
+        if ((value >> i) & 1)
+        {
+            writer->output[writer->position >> 3] |= (u8)(1 << (writer->position & 7));
+        }
+    }
+}
+
+static u32 ReadBits(const u8* input, u32* position, u32 numBits)
+{
+    u32 value = 0;
+    for (u32 i = 0; i < numBits; ++i, ++*position)
+    {
+        value |= (u32)((input[*position >> 3] >> (*position & 7)) & 1) << i;
+    }
+    return value;
+}
+
+void EncodeBlockBC7(u8* output, const u8* rgba, BakePreset::Type preset)
+{
+    PixelsBC7 pixels;
+    LoadPixelsBC7(&pixels, rgba);
+
+    f32 mean[4];
+    f32 axis[4];
+    ComputeAxisBC7(mean, axis, &pixels, preset == BakePreset::Quality ? 8 : 2);
+
+    f32 axisLengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3];
+    f32 tMin = 0.0f, tMax = 0.0f;
+    if (axisLengthSq > 0.0f)
+    {
+        tMin = FLT_MAX;
+        tMax = -FLT_MAX;
+        for (u32 i = 0; i < 16; ++i)
+        {
+            f32 t = 0.0f;
+            for (u32 c = 0; c < 4; ++c)
+            {
+                t += (pixels.values[i][c] - mean[c]) * axis[c];
+            }
+            t /= axisLengthSq;
+            tMin = MIN(tMin, t);
+            tMax = MAX(tMax, t);
+        }
+    }
+
+    f32 endpoints[2][4];
+    for (u32 c = 0; c < 4; ++c)
+    {
+        endpoints[0][c] = CLAMP_MAX(CLAMP_MIN(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+        endpoints[1][c] = CLAMP_MAX(CLAMP_MIN(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+    }
+
+    BlockBC7 best;
+    QuantizeEndpointsBC7(&best, endpoints);
+    EvaluateBC7(&best, &pixels, preset);
+
+    if (preset == BakePreset::Quality)
+    {
+        // every p-bit combination
+        for (s32 p = 0; p < 4 && best.error > 0; ++p)
+        {
+            BlockBC7 block;
+            block.pbits[0] = p & 1;
+            block.pbits[1] = p >> 1;
+            for (u32 c = 0; c < 4; ++c)
+            {
+                block.endpoints[0][c] = QuantizeBC7(endpoints[0][c], block.pbits[0]);
+                block.endpoints[1][c] = QuantizeBC7(endpoints[1][c], block.pbits[1]);
+            }
+            EvaluateBC7(&block, &pixels, preset);
+            if (block.error < best.error)
+            {
+                best = block;
+            }
+        }
+
+        for (u32 it = 0; it < 2 && best.error > 0; ++it)
+        {
+            f32 refined[2][4];
+            if (!RefineEndpointsBC7(refined, &best, &pixels))
+            {
+                break;
+            }
+
+            BlockBC7 block;
+            QuantizeEndpointsBC7(&block, refined);
+            EvaluateBC7(&block, &pixels, preset);
+            if (block.error >= best.error)
+            {
+                break;
+            }
+            best = block;
+        }
+    }
+
+    // the anchor index has an implicit leading 0 bit
+    if (best.indices[0] & 8)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            const s32 temp = best.endpoints[0][c];
+            best.endpoints[0][c] = best.endpoints[1][c];
+            best.endpoints[1][c] = temp;
+        }
+        const s32 temp = best.pbits[0];
+        best.pbits[0] = best.pbits[1];
+        best.pbits[1] = temp;
+        for (u32 i = 0; i < 16; ++i)
+        {
+            best.indices[i] = 15 - best.indices[i];
+        }
+    }
+
+    memset(output, 0, 16);
+    BitWriter writer = { output, 0 };
+    WriteBits(&writer, 1 << 6, 7);
+    for (u32 c = 0; c < 4; ++c)
+    {
+        WriteBits(&writer, (u32)best.endpoints[0][c], 7);
+        WriteBits(&writer, (u32)best.endpoints[1][c], 7);
+    }
+    WriteBits(&writer, (u32)best.pbits[0], 1);
+    WriteBits(&writer, (u32)best.pbits[1], 1);
+    WriteBits(&writer, best.indices[0], 3);
+    for (u32 i = 1; i < 16; ++i)
+    {
+        WriteBits(&writer, best.indices[i], 4);
+    }
+    assert(writer.position == 128);
+}
+
+static void DecodeBlockBC7(u8* rgba, const u8* block)
+{
+    u32 position = 0;
+    if (ReadBits(block, &position, 7) != (1 << 6))
+    {
+        memset(rgba, 0, 64); // only mode 6 is written by the encoder
+        return;
+    }
+
+    BlockBC7 decoded;
+    for (u32 c = 0; c < 4; ++c)
+    {
+        decoded.endpoints[0][c] = (s32)ReadBits(block, &position, 7);
+        decoded.endpoints[1][c] = (s32)ReadBits(block, &position, 7);
+    }
+    decoded.pbits[0] = (s32)ReadBits(block, &position, 1);
+    decoded.pbits[1] = (s32)ReadBits(block, &position, 1);
+    decoded.indices[0] = (u8)ReadBits(block, &position, 3);
+    for (u32 i = 1; i < 16; ++i)
+    {
+        decoded.indices[i] = (u8)ReadBits(block, &position, 4);
+    }
+
+    s32 palette[16][4];
+    BuildPaletteBC7(palette, &decoded);
+    for (u32 i = 0; i < 16; ++i)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            rgba[i * 4 + c] = (u8)palette[decoded.indices[i]][c];
+        }
+    }
+}
+
+void DecodeBlock(u8* rgba, const u8* block, BlockFormat::Type format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC4:
+        memset(rgba, 0, 64);
+        DecodeBlockBC4(rgba, block, 0);
+        break;
+    case BlockFormat::BC5:
+        memset(rgba, 0, 64);
+        DecodeBlockBC4(rgba, block + 0, 0);
+        DecodeBlockBC4(rgba, block + 8, 1);
+        break;
+    case BlockFormat::BC7:
+        DecodeBlockBC7(rgba, block);
+        break;
+    default:
+        assert(0);
+    }
+}
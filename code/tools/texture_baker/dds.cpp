@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+#define DDSKTX_IMPLEMENT
+#include "../../dds-ktx/dds-ktx.h"
+
+// The source hash lives in the reserved header fields, NVTT uses them the same way.
+#define BAKER_FOURCC stc__makefourcc('T', 'B', 'K', '1')
+
+static u32 GetDXGIFormat(BlockFormat::Type format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC4:
+        return DDSKTX__DDS_FORMAT_BC4_UNORM;
+    case BlockFormat::BC5:
+        return DDSKTX__DDS_FORMAT_BC5_UNORM;
+    case BlockFormat::BC7:
+        return DDSKTX__DDS_FORMAT_BC7_UNORM; // CreateTexture expects UNORM, like the NVTT output
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+bool WriteDDS(const char* filePath, const EncodedTexture* texture, u64 sourceHash)
+{
+    FILE* file = fopen(filePath, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    ddsktx__dds_header header;
+    memset(&header, 0, sizeof(header));
+    header.size = DDSKTX__DDS_HEADER_SIZE;
+    header.flags = DDSKTX__DDSD_CAPS | DDSKTX__DDSD_HEIGHT | DDSKTX__DDSD_WIDTH | DDSKTX__DDSD_PIXELFORMAT | DDSKTX__DDSD_MIPMAPCOUNT | DDSKTX__DDSD_LINEARSIZE;
+    header.height = texture->height;
+    header.width = texture->width;
+    header.pitch_lin_size = texture->numMips > 1 ? texture->mipOffsets[1] : texture->numBytes;
+    header.mip_count = texture->numMips;
+    header.reserved1[0] = BAKER_FOURCC;
+    header.reserved1[1] = (u32)sourceHash;
+    header.reserved1[2] = (u32)(sourceHash >> 32);
+    header.pixel_format.size = sizeof(ddsktx__dds_pixel_format);
+    header.pixel_format.flags = DDSKTX__DDPF_FOURCC;
+    header.pixel_format.fourcc = DDSKTX__DDS_DX10;
+    header.caps1 = DDSKTX__DDSCAPS_COMPLEX | DDSKTX__DDSCAPS_TEXTURE | DDSKTX__DDSCAPS_MIPMAP;
+
+    ddsktx__dds_header_dxgi dxgi;
+    memset(&dxgi, 0, sizeof(dxgi));
+    dxgi.dxgi_format = GetDXGIFormat(texture->format);
+    dxgi.dimension = DDSKTX__DDS_DX10_DIMENSION_TEXTURE2D;
+    dxgi.array_size = 1;
+
+    const u32 magic = DDSKTX__DDS_MAGIC;
+    bool ok = fwrite(&magic, sizeof(magic), 1, file) == 1;
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(&dxgi, sizeof(dxgi), 1, file) == 1;
+    ok = ok && fwrite(texture->data, texture->numBytes, 1, file) == 1;
+    fclose(file);
+
+    return ok;
+}
+
+bool ReadDDSSourceHash(const char* filePath, u64* sourceHash)
+{
+    FILE* file = fopen(filePath, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    u32 magic = 0;
+    ddsktx__dds_header header;
+    const bool ok = fread(&magic, sizeof(magic), 1, file) == 1 && fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    if (!ok || magic != DDSKTX__DDS_MAGIC || header.reserved1[0] != BAKER_FOURCC)
+    {
+        return false;
+    }
+
+    *sourceHash = (u64)header.reserved1[1] | ((u64)header.reserved1[2] << 32);
+    return true;
+}
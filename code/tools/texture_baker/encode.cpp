@@ -0,0 +1,215 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+// Work is split into rows of blocks over every mip, so small mips don't serialize the tail.
+struct EncodeJob
+{
+    u32 mip;
+    u32 blockRow;
+};
+
+struct EncodeContext
+{
+    const MipChain* chain;
+    EncodedTexture* texture;
+    BakePreset::Type preset;
+    EncodeJob* jobs;
+    s32 numJobs;
+    volatile s32 nextJob;
+};
+
+static void GatherBlock(u8* rgba, const BakeImage* image, u32 blockX, u32 blockY)
+{
+    // edge blocks replicate the last row/column
+    for (u32 y = 0; y < 4; ++y)
+    {
+        const u32 sy = MIN(blockY * 4 + y, image->height - 1);
+        for (u32 x = 0; x < 4; ++x)
+        {
+            const u32 sx = MIN(blockX * 4 + x, image->width - 1);
+            memcpy(rgba + (y * 4 + x) * 4, image->data + ((size_t)sy * image->width + sx) * 4, 4);
+        }
+    }
+}
+
+static void EncodeBlockRow(EncodeContext* context, const EncodeJob* job)
+{
+    const BakeImage* image = &context->chain->mips[job->mip];
+    EncodedTexture* texture = context->texture;
+    const u32 blockBytes = GetBlockBytes(texture->format);
+    const u32 numBlocksX = (image->width + 3) / 4;
+    u8* output = texture->data + texture->mipOffsets[job->mip] + job->blockRow * numBlocksX * blockBytes;
+
+    u8 rgba[64];
+    for (u32 bx = 0; bx < numBlocksX; ++bx, output += blockBytes)
+    {
+        GatherBlock(rgba, image, bx, job->blockRow);
+        switch (texture->format)
+        {
+        case BlockFormat::BC4:
+            EncodeBlockBC4(output, rgba, 0, context->preset);
+            break;
+        case BlockFormat::BC5:
+            EncodeBlockBC5(output, rgba, context->preset);
+            break;
+        case BlockFormat::BC7:
+            EncodeBlockBC7(output, rgba, context->preset);
+            break;
+        default:
+            assert(0);
+        }
+    }
+}
+
+static void EncodeWorker(void* userData)
+{
+    EncodeContext* context = (EncodeContext*)userData;
+    for (;;)
+    {
+        const s32 job = Sys_AtomicIncrement(&context->nextJob) - 1;
+        if (job >= context->numJobs)
+        {
+            break;
+        }
+        EncodeBlockRow(context, &context->jobs[job]);
+    }
+}
+
+void EncodeMipChain(EncodedTexture* texture, const MipChain* chain, BlockFormat::Type format, BakePreset::Type preset, u32 numThreads)
+{
+    const u32 blockBytes = GetBlockBytes(format);
+    texture->format = format;
+    texture->width = chain->mips[0].width;
+    texture->height = chain->mips[0].height;
+    texture->numMips = chain->numMips;
+
+    u32 numBytes = 0;
+    u32 numJobs = 0;
+    for (u32 m = 0; m < chain->numMips; ++m)
+    {
+        const u32 numBlocksX = (chain->mips[m].width + 3) / 4;
+        const u32 numBlocksY = (chain->mips[m].height + 3) / 4;
+        texture->mipOffsets[m] = numBytes;
+        numBytes += numBlocksX * numBlocksY * blockBytes;
+        numJobs += numBlocksY;
+    }
+    texture->numBytes = numBytes;
+    texture->data = (u8*)malloc(numBytes);
+
+    EncodeContext context;
+    context.chain = chain;
+    context.texture = texture;
+    context.preset = preset;
+    context.jobs = (EncodeJob*)malloc(numJobs * sizeof(EncodeJob));
+    context.numJobs = (s32)numJobs;
+    context.nextJob = 0;
+
+    // the finest mip first, it has the most work
+    u32 j = 0;
+    for (u32 m = 0; m < chain->numMips; ++m)
+    {
+        const u32 numBlocksY = (chain->mips[m].height + 3) / 4;
+        for (u32 row = 0; row < numBlocksY; ++row, ++j)
+        {
+            context.jobs[j].mip = m;
+            context.jobs[j].blockRow = row;
+        }
+    }
+
+    // the calling thread is a worker too
+    numThreads = CLAMP_MAX(CLAMP_MIN(numThreads, 1), 64);
+    Thread* threads[64];
+    for (u32 t = 1; t < numThreads; ++t)
+    {
+        threads[t] = Sys_CreateThread(EncodeWorker, &context);
+    }
+    EncodeWorker(&context);
+    for (u32 t = 1; t < numThreads; ++t)
+    {
+        Sys_JoinThread(threads[t]);
+    }
+
+    free(context.jobs);
+}
+
+void FreeEncodedTexture(EncodedTexture* texture)
+{
+    free(texture->data);
+    texture->data = NULL;
+}
+
+// over the most detailed mip and the channels the format stores
+f32 ComputePSNR(const EncodedTexture* texture, const MipChain* chain)
+{
+    static const u32 numChannels[BlockFormat::Count] = { 1, 2, 4 };
+    const u32 channels = numChannels[texture->format];
+    const BakeImage* image = &chain->mips[0];
+    const u32 blockBytes = GetBlockBytes(texture->format);
+    const u32 numBlocksX = (image->width + 3) / 4;
+    const u32 numBlocksY = (image->height + 3) / 4;
+
+    f64 squaredError = 0.0;
+    u64 numSamples = 0;
+    u8 decoded[64];
+    for (u32 by = 0; by < numBlocksY; ++by)
+    {
+        for (u32 bx = 0; bx < numBlocksX; ++bx)
+        {
+            DecodeBlock(decoded, texture->data + (by * numBlocksX + bx) * blockBytes, texture->format);
+            for (u32 y = 0; y < 4 && by * 4 + y < image->height; ++y)
+            {
+                for (u32 x = 0; x < 4 && bx * 4 + x < image->width; ++x)
+                {
+                    const u8* original = image->data + ((size_t)(by * 4 + y) * image->width + bx * 4 + x) * 4;
+                    for (u32 c = 0; c < channels; ++c)
+                    {
+                        const f64 d = (f64)decoded[(y * 4 + x) * 4 + c] - (f64)original[c];
+                        squaredError += d * d;
+                    }
+                    numSamples += channels;
+                }
+            }
+        }
+    }
+
+    if (squaredError == 0.0)
+    {
+        return 99.0f;
+    }
+
+    const f64 mse = squaredError / (f64)numSamples;
+    return (f32)(10.0 * log10(255.0 * 255.0 / mse));
+}
@@ -0,0 +1,872 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+//
+// inflate (RFC 1951), enough for PNG
+//
+
+struct InflateState
+{
+    const u8* input;
+    size_t inputSize;
+    size_t inputPos;
+    u32 bitBuffer;
+    u32 bitCount;
+
+    u8* output;
+    size_t outputSize;
+    size_t outputPos;
+};
+
+// canonical Huffman code, decoded one bit at a time
+struct Huffman
+{
+    u16 counts[16];
+    u16 symbols[288];
+};
+
+static bool GetBits(InflateState* s, u32 numBits, u32* value)
+{
+    while (s->bitCount < numBits)
+    {
+        if (s->inputPos >= s->inputSize)
+        {
+            return false;
+        }
+        s->bitBuffer |= (u32)s->input[s->inputPos++] << s->bitCount;
+        s->bitCount += 8;
+    }
+
+    *value = s->bitBuffer & ((1u << numBits) - 1);
+    s->bitBuffer >>= numBits;
+    s->bitCount -= numBits;
+    return true;
+}
+
+static bool BuildHuffman(Huffman* h, const u8* lengths, u32 numSymbols)
+{
+    memset(h->counts, 0, sizeof(h->counts));
+    for (u32 i = 0; i < numSymbols; ++i)
+    {
+        h->counts[lengths[i]]++;
+    }
+    h->counts[0] = 0;
+
+    u16 offsets[16];
+    offsets[1] = 0;
+    for (u32 i = 1; i < 15; ++i)
+    {
+        offsets[i + 1] = offsets[i] + h->counts[i];
+    }
+    for (u32 i = 0; i < numSymbols; ++i)
+    {
+        if (lengths[i] != 0)
+        {
+            h->symbols[offsets[lengths[i]]++] = (u16)i;
+        }
+    }
+    return true;
+}
+
+static s32 DecodeSymbol(InflateState* s, const Huffman* h)
+{
+    s32 code = 0;
+    s32 first = 0;
+    s32 index = 0;
+    for (u32 length = 1; length < 16; ++length)
+    {
+        u32 bit;
+        if (!GetBits(s, 1, &bit))
+        {
+            return -1;
+        }
+        code |= (s32)bit;
+        const s32 count = h->counts[length];
+        if (code - count < first)
+        {
+            return h->symbols[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static bool PutByte(InflateState* s, u8 value)
+{
+    if (s->outputPos >= s->outputSize)
+    {
+        return false;
+    }
+    s->output[s->outputPos++] = value;
+    return true;
+}
+
+static bool InflateCodes(InflateState* s, const Huffman* lengthCodes, const Huffman* distanceCodes)
+{
+    static const u16 lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const u16 lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const u16 distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const u16 distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    for (;;)
+    {
+        s32 symbol = DecodeSymbol(s, lengthCodes);
+        if (symbol < 0)
+        {
+            return false;
+        }
+        if (symbol < 256)
+        {
+            if (!PutByte(s, (u8)symbol))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (symbol == 256)
+        {
+            return true;
+        }
+
+        symbol -= 257;
+        if (symbol >= 29)
+        {
+            return false;
+        }
+        u32 extra;
+        if (!GetBits(s, lengthExtra[symbol], &extra))
+        {
+            return false;
+        }
+        const u32 length = lengthBase[symbol] + extra;
+
+        symbol = DecodeSymbol(s, distanceCodes);
+        if (symbol < 0 || symbol >= 30 || !GetBits(s, distanceExtra[symbol], &extra))
+        {
+            return false;
+        }
+        const size_t distance = distanceBase[symbol] + extra;
+        if (distance > s->outputPos || s->outputPos + length > s->outputSize)
+        {
+            return false;
+        }
+
+        for (u32 i = 0; i < length; ++i, ++s->outputPos)
+        {
+            s->output[s->outputPos] = s->output[s->outputPos - distance];
+        }
+    }
+}
+
+static bool InflateStored(InflateState* s)
+{
+    s->bitBuffer = 0;
+    s->bitCount = 0;
+    if (s->inputPos + 4 > s->inputSize)
+    {
+        return false;
+    }
+
+    const u32 length = s->input[s->inputPos] | (s->input[s->inputPos + 1] << 8);
+    const u32 lengthComplement = s->input[s->inputPos + 2] | (s->input[s->inputPos + 3] << 8);
+    s->inputPos += 4;
+    if (length != (~lengthComplement & 0xFFFF) || s->inputPos + length > s->inputSize || s->outputPos + length > s->outputSize)
+    {
+        return false;
+    }
+
+    memcpy(s->output + s->outputPos, s->input + s->inputPos, length);
+    s->inputPos += length;
+    s->outputPos += length;
+    return true;
+}
+
+static bool InflateFixed(InflateState* s)
+{
+    static Huffman lengthCodes;
+    static Huffman distanceCodes;
+    static bool initialized = false;
+    if (!initialized)
+    {
+        u8 lengths[288];
+        u32 i = 0;
+        for (; i < 144; ++i)
+            lengths[i] = 8;
+        for (; i < 256; ++i)
+            lengths[i] = 9;
+        for (; i < 280; ++i)
+            lengths[i] = 7;
+        for (; i < 288; ++i)
+            lengths[i] = 8;
+        BuildHuffman(&lengthCodes, lengths, 288);
+        for (i = 0; i < 30; ++i)
+            lengths[i] = 5;
+        BuildHuffman(&distanceCodes, lengths, 30);
+        initialized = true;
+    }
+
+    return InflateCodes(s, &lengthCodes, &distanceCodes);
+}
+
+static bool InflateDynamic(InflateState* s)
+{
+    static const u8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    u32 numLengths, numDistances, numCodes;
+    if (!GetBits(s, 5, &numLengths) || !GetBits(s, 5, &numDistances) || !GetBits(s, 4, &numCodes))
+    {
+        return false;
+    }
+    numLengths += 257;
+    numDistances += 1;
+    numCodes += 4;
+
+    u8 lengths[320] = {};
+    for (u32 i = 0; i < numCodes; ++i)
+    {
+        u32 length;
+        if (!GetBits(s, 3, &length))
+        {
+            return false;
+        }
+        lengths[order[i]] = (u8)length;
+    }
+
+    Huffman codeLengths;
+    BuildHuffman(&codeLengths, lengths, 19);
+    memset(lengths, 0, sizeof(lengths));
+
+    u32 index = 0;
+    while (index < numLengths + numDistances)
+    {
+        const s32 symbol = DecodeSymbol(s, &codeLengths);
+        if (symbol < 0)
+        {
+            return false;
+        }
+        if (symbol < 16)
+        {
+            lengths[index++] = (u8)symbol;
+            continue;
+        }
+
+        u8 value = 0;
+        u32 repeat;
+        if (symbol == 16)
+        {
+            if (index == 0 || !GetBits(s, 2, &repeat))
+            {
+                return false;
+            }
+            value = lengths[index - 1];
+            repeat += 3;
+        }
+        else if (symbol == 17)
+        {
+            if (!GetBits(s, 3, &repeat))
+            {
+                return false;
+            }
+            repeat += 3;
+        }
+        else
+        {
+            if (!GetBits(s, 7, &repeat))
+            {
+                return false;
+            }
+            repeat += 11;
+        }
+
+        if (index + repeat > numLengths + numDistances)
+        {
+            return false;
+        }
+        while (repeat--)
+        {
+            lengths[index++] = value;
+        }
+    }
+
+    Huffman lengthCodes;
+    Huffman distanceCodes;
+    BuildHuffman(&lengthCodes, lengths, numLengths);
+    BuildHuffman(&distanceCodes, lengths + numLengths, numDistances);
+    return InflateCodes(s, &lengthCodes, &distanceCodes);
+}
+
+// zlib stream, the Adler-32 checksum is not verified
+static bool Inflate(u8* output, size_t outputSize, const u8* input, size_t inputSize)
+{
+    if (inputSize < 2 || (input[0] & 0x0F) != 8 || ((input[0] << 8) | input[1]) % 31 != 0)
+    {
+        return false;
+    }
+
+    InflateState s = {};
+    s.input = input + 2;
+    s.inputSize = inputSize - 2;
+    s.output = output;
+    s.outputSize = outputSize;
+
+    u32 isLast;
+    do
+    {
+        u32 type;
+        if (!GetBits(&s, 1, &isLast) || !GetBits(&s, 2, &type))
+        {
+            return false;
+        }
+
+        bool ok;
+        switch (type)
+        {
+        case 0:
+            ok = InflateStored(&s);
+            break;
+        case 1:
+            ok = InflateFixed(&s);
+            break;
+        case 2:
+            ok = InflateDynamic(&s);
+            break;
+        default:
+            ok = false;
+        }
+        if (!ok)
+        {
+            return false;
+        }
+    } while (!isLast);
+
+    return s.outputPos == outputSize;
+}
+
+//
+// PNG
+//
+
+static u32 ReadU32BE(const u8* p)
+{
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+}
+
+static u8 PaethPredictor(s32 a, s32 b, s32 c)
+{
+    const s32 p = a + b - c;
+    const s32 pa = abs(p - a);
+    const s32 pb = abs(p - b);
+    const s32 pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return (u8)a;
+    if (pb <= pc)
+        return (u8)b;
+    return (u8)c;
+}
+
+static bool DecodePNG(BakeImage* image, const u8* data, size_t size)
+{
+    static const u8 signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    if (size < 8 || memcmp(data, signature, 8) != 0)
+    {
+        return false;
+    }
+
+    u32 width = 0, height = 0, bitDepth = 0, colorType = 0, interlace = 0;
+    u8 palette[256][4];
+    memset(palette, 0xFF, sizeof(palette));
+    DynamicArray<u8> compressed;
+
+    size_t pos = 8;
+    while (pos + 12 <= size)
+    {
+        const u32 length = ReadU32BE(data + pos);
+        const u8* type = data + pos + 4;
+        const u8* chunk = data + pos + 8;
+        if (pos + 12 + length > size)
+        {
+            return false;
+        }
+
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            width = ReadU32BE(chunk);
+            height = ReadU32BE(chunk + 4);
+            bitDepth = chunk[8];
+            colorType = chunk[9];
+            interlace = chunk[12];
+        }
+        else if (memcmp(type, "PLTE", 4) == 0)
+        {
+            for (u32 i = 0; i < length / 3 && i < 256; ++i)
+            {
+                palette[i][0] = chunk[i * 3 + 0];
+                palette[i][1] = chunk[i * 3 + 1];
+                palette[i][2] = chunk[i * 3 + 2];
+            }
+        }
+        else if (memcmp(type, "tRNS", 4) == 0 && colorType == 3)
+        {
+            for (u32 i = 0; i < length && i < 256; ++i)
+            {
+                palette[i][3] = chunk[i];
+            }
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            const size_t offset = compressed.Length();
+            compressed.Reserve(offset + length);
+            memcpy(compressed.GetStart() + offset, chunk, length);
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            break;
+        }
+
+        pos += 12 + length;
+    }
+
+    static const u32 channelsPerType[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    if (width == 0 || height == 0 || colorType > 6 || channelsPerType[colorType] == 0 || interlace != 0 || (bitDepth != 8 && bitDepth != 16) || (colorType == 3 && bitDepth != 8))
+    {
+        fprintf(stderr, "PNG: unsupported format (color type %d, %d bits, interlace %d)\n", colorType, bitDepth, interlace);
+        return false;
+    }
+
+    const u32 channels = channelsPerType[colorType];
+    const u32 bytesPerPixel = channels * (bitDepth / 8);
+    const size_t stride = (size_t)width * bytesPerPixel;
+    const size_t rawSize = (stride + 1) * height;
+    u8* raw = (u8*)malloc(rawSize);
+    if (raw == NULL || !Inflate(raw, rawSize, compressed.GetStart(), compressed.Length()))
+    {
+        free(raw);
+        return false;
+    }
+
+    // undo the filters in place
+    for (u32 y = 0; y < height; ++y)
+    {
+        u8* row = raw + y * (stride + 1) + 1;
+        const u8* prev = y > 0 ? raw + (y - 1) * (stride + 1) + 1 : NULL;
+        const u8 filter = row[-1];
+        for (size_t x = 0; x < stride; ++x)
+        {
+            const s32 a = x >= bytesPerPixel ? row[x - bytesPerPixel] : 0;
+            const s32 b = prev ? prev[x] : 0;
+            const s32 c = (prev && x >= bytesPerPixel) ? prev[x - bytesPerPixel] : 0;
+            switch (filter)
+            {
+            case 0:
+                break;
+            case 1:
+                row[x] = (u8)(row[x] + a);
+                break;
+            case 2:
+                row[x] = (u8)(row[x] + b);
+                break;
+            case 3:
+                row[x] = (u8)(row[x] + ((a + b) >> 1));
+                break;
+            case 4:
+                row[x] = (u8)(row[x] + PaethPredictor(a, b, c));
+                break;
+            default:
+                free(raw);
+                return false;
+            }
+        }
+    }
+
+    image->width = width;
+    image->height = height;
+    image->data = (u8*)malloc((size_t)width * height * 4);
+    const u32 sampleBytes = bitDepth / 8; // we keep the most significant byte of 16-bit samples
+    for (u32 y = 0; y < height; ++y)
+    {
+        const u8* row = raw + y * (stride + 1) + 1;
+        u8* out = image->data + (size_t)y * width * 4;
+        for (u32 x = 0; x < width; ++x, out += 4)
+        {
+            const u8* p = row + x * bytesPerPixel;
+            switch (colorType)
+            {
+            case 0:
+                out[0] = out[1] = out[2] = p[0];
+                out[3] = 255;
+                break;
+            case 2:
+                out[0] = p[0];
+                out[1] = p[sampleBytes];
+                out[2] = p[2 * sampleBytes];
+                out[3] = 255;
+                break;
+            case 3:
+                memcpy(out, palette[p[0]], 4);
+                break;
+            case 4:
+                out[0] = out[1] = out[2] = p[0];
+                out[3] = p[sampleBytes];
+                break;
+            case 6:
+                out[0] = p[0];
+                out[1] = p[sampleBytes];
+                out[2] = p[2 * sampleBytes];
+                out[3] = p[3 * sampleBytes];
+                break;
+            }
+        }
+    }
+
+    free(raw);
+    return true;
+}
+
+//
+// TGA
+//
+
+static bool DecodeTGA(BakeImage* image, const u8* data, size_t size)
+{
+    if (size < 18)
+    {
+        return false;
+    }
+
+    const u32 idLength = data[0];
+    const u32 colorMapType = data[1];
+    const u32 imageType = data[2];
+    const u32 width = data[12] | (data[13] << 8);
+    const u32 height = data[14] | (data[15] << 8);
+    const u32 bitsPerPixel = data[16];
+    const bool topDown = (data[17] & 0x20) != 0;
+    const bool isRLE = imageType == 10 || imageType == 11;
+    const bool isGray = imageType == 3 || imageType == 11;
+    if (colorMapType != 0 || (imageType != 2 && imageType != 3 && !isRLE) || width == 0 || height == 0)
+    {
+        return false;
+    }
+    if ((isGray && bitsPerPixel != 8) || (!isGray && bitsPerPixel != 24 && bitsPerPixel != 32))
+    {
+        return false;
+    }
+
+    const u32 bytesPerPixel = bitsPerPixel / 8;
+    const u8* p = data + 18 + idLength;
+    const u8* end = data + size;
+    const u32 numPixels = width * height;
+    image->width = width;
+    image->height = height;
+    image->data = (u8*)malloc((size_t)numPixels * 4);
+
+    u32 runLeft = 0;
+    bool runIsPacked = false;
+    const u8* runPixel = NULL;
+    for (u32 i = 0; i < numPixels; ++i)
+    {
+        const u8* pixel;
+        if (isRLE)
+        {
+            if (runLeft == 0)
+            {
+                if (p >= end)
+                {
+                    FreeImage(image);
+                    return false;
+                }
+                runIsPacked = (*p & 0x80) != 0;
+                runLeft = (*p & 0x7F) + 1;
+                p++;
+                runPixel = p;
+                if (runIsPacked)
+                {
+                    p += bytesPerPixel;
+                }
+            }
+            if (runIsPacked)
+            {
+                pixel = runPixel;
+            }
+            else
+            {
+                pixel = p;
+                p += bytesPerPixel;
+            }
+            runLeft--;
+        }
+        else
+        {
+            pixel = p;
+            p += bytesPerPixel;
+        }
+
+        if (p > end)
+        {
+            FreeImage(image);
+            return false;
+        }
+
+        const u32 x = i % width;
+        const u32 y = topDown ? i / width : height - 1 - i / width;
+        u8* out = image->data + ((size_t)y * width + x) * 4;
+        if (isGray)
+        {
+            out[0] = out[1] = out[2] = pixel[0];
+            out[3] = 255;
+        }
+        else
+        {
+            out[0] = pixel[2];
+            out[1] = pixel[1];
+            out[2] = pixel[0];
+            out[3] = bytesPerPixel == 4 ? pixel[3] : 255;
+        }
+    }
+
+    return true;
+}
+
+bool DecodeImage(BakeImage* image, const void* fileData, size_t fileSize)
+{
+    image->data = NULL;
+    if (DecodePNG(image, (const u8*)fileData, fileSize))
+    {
+        return true;
+    }
+
+    FreeImage(image);
+    return DecodeTGA(image, (const u8*)fileData, fileSize);
+}
+
+void FreeImage(BakeImage* image)
+{
+    free(image->data);
+    image->data = NULL;
+}
+
+//
+// mip chain
+//
+
+static f32 SRGBToLinear(f32 c)
+{
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static f32 LinearToSRGB(f32 c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static u8 ToUnorm8(f32 v)
+{
+    return (u8)(CLAMP_MAX(CLAMP_MIN(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// fraction of texels that pass the alpha test after scaling alpha
+static f32 ComputeAlphaCoverage(const f32* texels, u32 numTexels, f32 scale)
+{
+    u32 numCovered = 0;
+    for (u32 i = 0; i < numTexels; ++i)
+    {
+        if (texels[i * 4 + 3] * scale >= 0.5f)
+        {
+            numCovered++;
+        }
+    }
+    return (f32)numCovered / (f32)numTexels;
+}
+
+// alpha-tested geometry gets thinner in coarser mips unless alpha is rescaled
+static f32 FindAlphaScale(const f32* texels, u32 numTexels, f32 coverage)
+{
+    f32 lo = 0.0f;
+    f32 hi = 4.0f;
+    for (u32 it = 0; it < 12; ++it)
+    {
+        const f32 mid = (lo + hi) * 0.5f;
+        if (ComputeAlphaCoverage(texels, numTexels, mid) < coverage)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return (lo + hi) * 0.5f;
+}
+
+static void StoreMip(BakeImage* mip, const f32* texels, u32 width, u32 height, TextureKind::Type kind, f32 alphaScale)
+{
+    mip->width = width;
+    mip->height = height;
+    mip->data = (u8*)malloc((size_t)width * height * 4);
+    for (u32 i = 0; i < width * height; ++i)
+    {
+        const f32* t = texels + i * 4;
+        u8* out = mip->data + i * 4;
+        switch (kind)
+        {
+        case TextureKind::Albedo:
+            out[0] = ToUnorm8(LinearToSRGB(t[0]));
+            out[1] = ToUnorm8(LinearToSRGB(t[1]));
+            out[2] = ToUnorm8(LinearToSRGB(t[2]));
+            out[3] = ToUnorm8(t[3] * alphaScale);
+            break;
+        case TextureKind::Normal:
+            out[0] = ToUnorm8(t[0] * 0.5f + 0.5f);
+            out[1] = ToUnorm8(t[1] * 0.5f + 0.5f);
+            out[2] = ToUnorm8(t[2] * 0.5f + 0.5f);
+            out[3] = 255;
+            break;
+        default:
+            out[0] = out[1] = out[2] = ToUnorm8(t[0]);
+            out[3] = 255;
+            break;
+        }
+    }
+}
+
+void BuildMipChain(MipChain* chain, const BakeImage* image, TextureKind::Type kind)
+{
+    f32 srgbToLinear[256];
+    for (u32 i = 0; i < 256; ++i)
+    {
+        srgbToLinear[i] = SRGBToLinear((f32)i / 255.0f);
+    }
+
+    u32 width = image->width;
+    u32 height = image->height;
+    f32* texels = (f32*)malloc((size_t)width * height * 4 * sizeof(f32));
+    bool hasAlpha = false;
+    for (u32 i = 0; i < width * height; ++i)
+    {
+        const u8* in = image->data + i * 4;
+        f32* t = texels + i * 4;
+        switch (kind)
+        {
+        case TextureKind::Albedo:
+            t[0] = srgbToLinear[in[0]];
+            t[1] = srgbToLinear[in[1]];
+            t[2] = srgbToLinear[in[2]];
+            t[3] = (f32)in[3] / 255.0f;
+            hasAlpha |= in[3] != 255;
+            break;
+        case TextureKind::Normal:
+            t[0] = (f32)in[0] / 127.5f - 1.0f;
+            t[1] = (f32)in[1] / 127.5f - 1.0f;
+            t[2] = (f32)in[2] / 127.5f - 1.0f;
+            t[3] = 1.0f;
+            break;
+        default:
+            // the specular maps are stored as grayscale
+            t[0] = t[1] = t[2] = (0.2126f * in[0] + 0.7152f * in[1] + 0.0722f * in[2]) / 255.0f;
+            t[3] = 1.0f;
+            break;
+        }
+    }
+
+    const f32 coverage = hasAlpha ? ComputeAlphaCoverage(texels, width * height, 1.0f) : 0.0f;
+
+    chain->numMips = ComputeMipCount(width, height);
+    assert(chain->numMips <= ARRAY_LEN(chain->mips));
+    StoreMip(&chain->mips[0], texels, width, height, kind, 1.0f);
+
+    for (u32 m = 1; m < chain->numMips; ++m)
+    {
+        const u32 srcWidth = width;
+        const u32 srcHeight = height;
+        width = MAX(width >> 1, 1);
+        height = MAX(height >> 1, 1);
+
+        // box filter in linear space, the source is read in place since dst never overtakes src
+        for (u32 y = 0; y < height; ++y)
+        {
+            for (u32 x = 0; x < width; ++x)
+            {
+                const u32 x0 = MIN(x * 2, srcWidth - 1);
+                const u32 x1 = MIN(x * 2 + 1, srcWidth - 1);
+                const u32 y0 = MIN(y * 2, srcHeight - 1);
+                const u32 y1 = MIN(y * 2 + 1, srcHeight - 1);
+                const f32* a = texels + (y0 * srcWidth + x0) * 4;
+                const f32* b = texels + (y0 * srcWidth + x1) * 4;
+                const f32* c = texels + (y1 * srcWidth + x0) * 4;
+                const f32* d = texels + (y1 * srcWidth + x1) * 4;
+                f32 result[4];
+                for (u32 ch = 0; ch < 4; ++ch)
+                {
+                    result[ch] = (a[ch] + b[ch] + c[ch] + d[ch]) * 0.25f;
+                }
+
+                if (kind == TextureKind::Normal)
+                {
+                    const f32 length = sqrtf(result[0] * result[0] + result[1] * result[1] + result[2] * result[2]);
+                    if (length > 0.0f)
+                    {
+                        result[0] /= length;
+                        result[1] /= length;
+                        result[2] /= length;
+                    }
+                    else
+                    {
+                        result[0] = result[1] = 0.0f;
+                        result[2] = 1.0f;
+                    }
+                }
+
+                memcpy(texels + (y * width + x) * 4, result, sizeof(result));
+            }
+        }
+
+        const f32 alphaScale = hasAlpha ? FindAlphaScale(texels, width * height, coverage) : 1.0f;
+        StoreMip(&chain->mips[m], texels, width, height, kind, alphaScale);
+    }
+
+    free(texels);
+}
+
+void FreeMipChain(MipChain* chain)
+{
+    for (u32 m = 0; m < chain->numMips; ++m)
+    {
+        FreeImage(&chain->mips[m]);
+    }
+    chain->numMips = 0;
+}
@@ -0,0 +1,365 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+
+struct BakeOptions
+{
+    BakePreset::Type preset;
+    s32 kind; // -1 picks the kind from the file name
+    u32 numThreads;
+    bool force;
+    bool benchmark;
+    const char* outputDir;
+};
+
+static const char* presetNames[BakePreset::Count] = { "fast", "quality" };
+static const char* formatNames[BlockFormat::Count] = { "BC4", "BC5", "BC7" };
+static const BlockFormat::Type kindFormats[TextureKind::Count] = { BlockFormat::BC7, BlockFormat::BC5, BlockFormat::BC4 };
+
+static void PrintHelp()
+{
+    printf("usage: TextureBaker [options] image...\n");
+    printf("  -fast | -quality    encoder preset (default: quality)\n");
+    printf("  -albedo | -normal | -specular\n");
+    printf("                      texture kind (default: from the _diff/_ddn/_spec suffix)\n");
+    printf("  -threads N          worker threads (default: core count)\n");
+    printf("  -out DIR            output directory (default: next to the image)\n");
+    printf("  -force              ignore the incremental cache\n");
+    printf("  -bench              measure encoder throughput, on generated images if none are given\n");
+    printf("images are PNG or TGA, the output is a DDS file with a full mip chain\n");
+}
+
+static TextureKind::Type GetKindFromFileName(const char* fileName)
+{
+    if (strstr(fileName, "_ddn") || strstr(fileName, "_normal"))
+    {
+        return TextureKind::Normal;
+    }
+    if (strstr(fileName, "_spec"))
+    {
+        return TextureKind::Specular;
+    }
+    return TextureKind::Albedo;
+}
+
+// FNV-1a
+static u64 HashBytes(u64 hash, const void* data, size_t size)
+{
+    const u8* bytes = (const u8*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static u64 ComputeSourceHash(const void* data, size_t size, TextureKind::Type kind, BakePreset::Type preset)
+{
+    const u32 settings[3] = { TEXTURE_BAKER_VERSION, (u32)kind, (u32)preset };
+    u64 hash = 0xCBF29CE484222325ull;
+    hash = HashBytes(hash, settings, sizeof(settings));
+    return HashBytes(hash, data, size);
+}
+
+static u64 GetMipChainBytes(const MipChain* chain)
+{
+    u64 bytes = 0;
+    for (u32 m = 0; m < chain->numMips; ++m)
+    {
+        bytes += (u64)chain->mips[m].width * chain->mips[m].height * 4;
+    }
+    return bytes;
+}
+
+static f64 GetMegabytesPerSecond(u64 bytes, u64 microseconds)
+{
+    return ((f64)bytes / (1024.0 * 1024.0)) / ((f64)MAX(microseconds, 1) / 1000000.0);
+}
+
+static bool BakeTexture(const char* imagePath, const BakeOptions* options)
+{
+    char fileName[MAX_PATH];
+    GetFileName(fileName, imagePath);
+    StripFileExtension(fileName);
+
+    char outputPath[MAX_PATH];
+    if (options->outputDir != NULL)
+    {
+        PathCombine(outputPath, options->outputDir, fmt("%s.dds", fileName));
+    }
+    else
+    {
+        strcpy(outputPath, imagePath);
+        StripFileExtension(outputPath);
+        strcat(outputPath, ".dds");
+    }
+
+    void* fileData;
+    size_t fileSize;
+    if (!Sys_ReadDataFromFile(&fileData, &fileSize, imagePath))
+    {
+        fprintf(stderr, "%s: can't read file\n", imagePath);
+        return false;
+    }
+
+    const TextureKind::Type kind = options->kind >= 0 ? (TextureKind::Type)options->kind : GetKindFromFileName(fileName);
+    const u64 sourceHash = ComputeSourceHash(fileData, fileSize, kind, options->preset);
+    u64 cachedHash;
+    if (!options->force && ReadDDSSourceHash(outputPath, &cachedHash) && cachedHash == sourceHash)
+    {
+        printf("%s: up to date\n", outputPath);
+        free(fileData);
+        return true;
+    }
+
+    BakeImage image;
+    const bool decoded = DecodeImage(&image, fileData, fileSize);
+    free(fileData);
+    if (!decoded)
+    {
+        fprintf(stderr, "%s: unsupported image format\n", imagePath);
+        return false;
+    }
+
+    const u64 timestamp = Sys_GetTimestamp();
+    MipChain chain;
+    BuildMipChain(&chain, &image, kind);
+    FreeImage(&image);
+
+    EncodedTexture texture;
+    EncodeMipChain(&texture, &chain, kindFormats[kind], options->preset, options->numThreads);
+    const u64 microseconds = Sys_GetElapsedMicroseconds(timestamp);
+
+    const bool written = WriteDDS(outputPath, &texture, sourceHash);
+    if (written)
+    {
+        printf("%s: %dx%d, %d mips, %s, %.1f MB/s, %.2f dB\n", outputPath, texture.width, texture.height, texture.numMips, formatNames[texture.format],
+            GetMegabytesPerSecond(GetMipChainBytes(&chain), microseconds), ComputePSNR(&texture, &chain));
+    }
+    else
+    {
+        fprintf(stderr, "%s: can't write file\n", outputPath);
+    }
+
+    FreeEncodedTexture(&texture);
+    FreeMipChain(&chain);
+    return written;
+}
+
+static void GenerateBenchmarkImage(BakeImage* image, u32 size, u32 seed)
+{
+    image->width = size;
+    image->height = size;
+    image->data = (u8*)malloc((size_t)size * size * 4);
+    u32 state = seed * 747796405u + 2891336453u;
+    for (u32 y = 0; y < size; ++y)
+    {
+        for (u32 x = 0; x < size; ++x)
+        {
+            state = state * 1664525u + 1013904223u;
+            const u32 noise = state >> 28;
+            u8* p = image->data + ((size_t)y * size + x) * 4;
+            p[0] = (u8)CLAMP_MAX(128.0f + 100.0f * sinf(x * 0.021f + seed) * cosf(y * 0.013f) + noise, 255.0f);
+            p[1] = (u8)(((x ^ y) >> 3) * 4 + noise);
+            p[2] = (u8)((x * y) >> 12);
+            p[3] = ((x / 64 + y / 64) & 1) ? 255 : (u8)(noise * 8);
+        }
+    }
+}
+
+static void RunBenchmark(const BakeOptions* options, char** imagePaths, u32 numImages)
+{
+    MipChain chains[TextureKind::Count][8];
+    u32 numChains = 0;
+    const u32 count = numImages > 0 ? numImages : 4; // generated images without paths
+    for (u32 i = 0; i < count && numChains < ARRAY_LEN(chains[0]); ++i)
+    {
+        BakeImage image;
+        if (numImages > 0)
+        {
+            void* fileData;
+            size_t fileSize;
+            if (!Sys_ReadDataFromFile(&fileData, &fileSize, imagePaths[i]))
+            {
+                continue;
+            }
+            const bool decoded = DecodeImage(&image, fileData, fileSize);
+            free(fileData);
+            if (!decoded)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            GenerateBenchmarkImage(&image, 1024, i);
+        }
+
+        for (u32 k = 0; k < TextureKind::Count; ++k)
+        {
+            BuildMipChain(&chains[k][numChains], &image, (TextureKind::Type)k);
+        }
+        FreeImage(&image);
+        numChains++;
+    }
+
+    if (numChains == 0)
+    {
+        fprintf(stderr, "no images to benchmark\n");
+        return;
+    }
+
+    u64 sourceBytes = 0;
+    for (u32 c = 0; c < numChains; ++c)
+    {
+        sourceBytes += GetMipChainBytes(&chains[0][c]);
+    }
+    printf("benchmark: %d image(s), %s of RGBA8 mips per format\n", numChains, FormatBytes(sourceBytes));
+    printf("%-8s %-8s %8s %12s %10s\n", "format", "preset", "threads", "MB/s", "PSNR (dB)");
+
+    const u32 threadCounts[2] = { 1, options->numThreads };
+    for (u32 k = 0; k < TextureKind::Count; ++k)
+    {
+        for (u32 p = 0; p < BakePreset::Count; ++p)
+        {
+            for (u32 t = 0; t < ARRAY_LEN(threadCounts); ++t)
+            {
+                if (t > 0 && threadCounts[t] == threadCounts[0])
+                {
+                    continue;
+                }
+
+                f64 psnr = 0.0;
+                const u64 timestamp = Sys_GetTimestamp();
+                for (u32 c = 0; c < numChains; ++c)
+                {
+                    EncodedTexture texture;
+                    EncodeMipChain(&texture, &chains[k][c], kindFormats[k], (BakePreset::Type)p, threadCounts[t]);
+                    psnr += ComputePSNR(&texture, &chains[k][c]);
+                    FreeEncodedTexture(&texture);
+                }
+                const u64 microseconds = Sys_GetElapsedMicroseconds(timestamp);
+
+                // the PSNR time is included, it's small compared to encoding
+                printf("%-8s %-8s %8d %12.1f %10.2f\n", formatNames[kindFormats[k]], presetNames[p], threadCounts[t],
+                    GetMegabytesPerSecond(sourceBytes, microseconds), psnr / numChains);
+            }
+        }
+    }
+
+    for (u32 k = 0; k < TextureKind::Count; ++k)
+    {
+        for (u32 c = 0; c < numChains; ++c)
+        {
+            FreeMipChain(&chains[k][c]);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BakeOptions options;
+    options.preset = BakePreset::Quality;
+    options.kind = -1;
+    options.numThreads = Sys_GetCoreCount();
+    options.force = false;
+    options.benchmark = false;
+    options.outputDir = NULL;
+
+    char** imagePaths = (char**)malloc(argc * sizeof(char*));
+    u32 numImages = 0;
+    for (s32 i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-fast") == 0)
+            options.preset = BakePreset::Fast;
+        else if (strcmp(arg, "-quality") == 0)
+            options.preset = BakePreset::Quality;
+        else if (strcmp(arg, "-albedo") == 0)
+            options.kind = TextureKind::Albedo;
+        else if (strcmp(arg, "-normal") == 0)
+            options.kind = TextureKind::Normal;
+        else if (strcmp(arg, "-specular") == 0)
+            options.kind = TextureKind::Specular;
+        else if (strcmp(arg, "-force") == 0)
+            options.force = true;
+        else if (strcmp(arg, "-bench") == 0)
+            options.benchmark = true;
+        else if (strcmp(arg, "-threads") == 0 && i + 1 < argc)
+        {
+            const s32 numThreads = atoi(argv[++i]);
+            options.numThreads = MAX(numThreads, 1);
+        }
+        else if (strcmp(arg, "-out") == 0 && i + 1 < argc)
+            options.outputDir = argv[++i];
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "Invalid argument: %s\n", arg);
+            PrintHelp();
+            return 1;
+        }
+        else
+            imagePaths[numImages++] = argv[i];
+    }
+
+    if (options.benchmark)
+    {
+        RunBenchmark(&options, imagePaths, numImages);
+        free(imagePaths);
+        return 0;
+    }
+
+    if (numImages == 0)
+    {
+        PrintHelp();
+        free(imagePaths);
+        return 1;
+    }
+
+    const u64 timestamp = Sys_GetTimestamp();
+    u32 numFailed = 0;
+    for (u32 i = 0; i < numImages; ++i)
+    {
+        if (!BakeTexture(imagePaths[i], &options))
+        {
+            numFailed++;
+        }
+    }
+    printf("%d texture(s) in %.3f s, %d failed\n", numImages, Sys_GetElapsedMilliseconds(timestamp) / 1000.0f, numFailed);
+
+    free(imagePaths);
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2021-2022 Bjarke Damsgaard Eriksen. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    1. Redistributions of source code must retain the above
+       copyright notice, this list of conditions and the
+       following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials
+       provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "../../common/shared.h"
+
+#define TEXTURE_BAKER_VERSION 1
+
+// What the texture is used for decides the encoding and how mips are filtered.
+// The suffixes match the ones used by the Sponza textures.
+struct TextureKind
+{
+    enum Type
+    {
+        Albedo, // *_diff: BC7, sRGB-correct mips, alpha coverage is preserved
+        Normal, // *_ddn: BC5, mips are renormalized
+        Specular, // *_spec: BC4 grayscale, linear mips
+        Count
+    };
+};
+
+struct BakePreset
+{
+    enum Type
+    {
+        Fast,
+        Quality,
+        Count
+    };
+};
+
+struct BlockFormat
+{
+    enum Type
+    {
+        BC4,
+        BC5,
+        BC7,
+        Count
+    };
+};
+
+// 8-bit RGBA image
+struct BakeImage
+{
+    u32 width;
+    u32 height;
+    u8* data;
+};
+
+struct MipChain
+{
+    BakeImage mips[16];
+    u32 numMips;
+};
+
+struct EncodedTexture
+{
+    BlockFormat::Type format;
+    u32 width;
+    u32 height;
+    u32 numMips;
+    u32 mipOffsets[16]; // in bytes from data
+    u32 numBytes;
+    u8* data;
+};
+
+// image.cpp
+// PNG (8-bit, not interlaced) and TGA (uncompressed or RLE)
+bool DecodeImage(BakeImage* image, const void* fileData, size_t fileSize);
+void FreeImage(BakeImage* image);
+void BuildMipChain(MipChain* chain, const BakeImage* image, TextureKind::Type kind);
+void FreeMipChain(MipChain* chain);
+
+// bc_encode.cpp
+u32 GetBlockBytes(BlockFormat::Type format);
+// rgba is the 4x4 block in row order
+void EncodeBlockBC4(u8* output, const u8* rgba, u32 channel, BakePreset::Type preset);
+void EncodeBlockBC5(u8* output, const u8* rgba, BakePreset::Type preset);
+void EncodeBlockBC7(u8* output, const u8* rgba, BakePreset::Type preset);
+// decoders are only used to measure the encoding error
+void DecodeBlock(u8* rgba, const u8* block, BlockFormat::Type format);
+
+// encode.cpp
+void EncodeMipChain(EncodedTexture* texture, const MipChain* chain, BlockFormat::Type format, BakePreset::Type preset, u32 numThreads);
+void FreeEncodedTexture(EncodedTexture* texture);
+f32 ComputePSNR(const EncodedTexture* texture, const MipChain* chain);
+
+// dds.cpp
+// sourceHash is stored in the header for incremental builds
+bool WriteDDS(const char* filePath, const EncodedTexture* texture, u64 sourceHash);
+bool ReadDDSSourceHash(const char* filePath, u64* sourceHash);
@@ -121,25 +121,292 @@ void Sys_FolderScan_End(FolderScan* fs)
 
 bool Sys_ReadDataFromFile(void** data, size_t* size, const char* filePath)
 {
-    FILE* file = fopen(filePath, "rb");
+    // ftell is 32-bit on Windows, files over 2 GB need the 64-bit size and positional reads
+    u64 fileSize;
+    void* file = Sys_OpenFileForReading(filePath, &fileSize);
     if (file == NULL)
     {
         return false;
     }
 
-    fseek(file, 0, SEEK_END);
-    *size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    *data = malloc(*size);
+    *data = malloc(MAX(fileSize, 1));
     if (*data == NULL)
     {
+        Sys_CloseFile(file);
+        return false;
+    }
+
+    if (!Sys_ReadFileAt(file, *data, 0, fileSize))
+    {
+        free(*data);
+        *data = NULL;
+        Sys_CloseFile(file);
+        return false;
+    }
+
+    *size = (size_t)fileSize;
+    Sys_CloseFile(file);
+
+    return true;
+}
+
+bool Sys_IsDirectory(const char* path)
+{
+    const DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+void* Sys_ReserveMemory(u64 size)
+{
+    return VirtualAlloc(NULL, (SIZE_T)size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool Sys_CommitMemory(void* address, u64 size)
+{
+    return VirtualAlloc(address, (SIZE_T)size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void Sys_DecommitMemory(void* address, u64 size)
+{
+    VirtualFree(address, (SIZE_T)size, MEM_DECOMMIT);
+}
+
+void Sys_ReleaseMemory(void* address)
+{
+    VirtualFree(address, 0, MEM_RELEASE);
+}
+
+bool Sys_MapFile(MappedFile* mappedFile, const char* filePath)
+{
+    memset(mappedFile, 0, sizeof(MappedFile));
+
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
         return false;
     }
 
-    fread(*data, *size, 1, file);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mappedFile->data = data;
+    mappedFile->size = (u64)size.QuadPart;
+    mappedFile->file = file;
+    mappedFile->mapping = mapping;
+
+    return true;
+}
+
+void Sys_UnmapFile(MappedFile* mappedFile)
+{
+    if (mappedFile->data != NULL)
+    {
+        UnmapViewOfFile(mappedFile->data);
+        CloseHandle((HANDLE)mappedFile->mapping);
+        CloseHandle((HANDLE)mappedFile->file);
+    }
+    memset(mappedFile, 0, sizeof(MappedFile));
+}
+
+void* Sys_OpenFileForReading(const char* filePath, u64* size)
+{
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
 
-    fclose(file);
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    *size = (u64)fileSize.QuadPart;
+    return file;
+}
+
+bool Sys_ReadFileAt(void* file, void* buffer, u64 offset, u64 size)
+{
+    u8* output = (u8*)buffer;
+    while (size > 0)
+    {
+        // ReadFile takes 32-bit sizes, the offset goes through the OVERLAPPED struct
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        const DWORD count = (DWORD)MIN(size, (u64)(1 << 30));
+        DWORD numRead = 0;
+        if (!ReadFile((HANDLE)file, output, count, &numRead, &overlapped) || numRead == 0)
+        {
+            return false;
+        }
+
+        output += numRead;
+        offset += numRead;
+        size -= numRead;
+    }
 
     return true;
-}
\ No newline at end of file
+}
+
+void Sys_CloseFile(void* file)
+{
+    if (file != NULL)
+    {
+        CloseHandle((HANDLE)file);
+    }
+}
+
+u64 Sys_GetTimestamp()
+{
+    LARGE_INTEGER result;
+    QueryPerformanceCounter(&result);
+    return result.QuadPart;
+}
+
+u64 Sys_GetElapsedMilliseconds(u64 startTimestamp)
+{
+    u64 endTimestamp = Sys_GetTimestamp();
+    u64 cyclesElapsed = endTimestamp - startTimestamp;
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return ((cyclesElapsed * 1000) / frequency.QuadPart);
+}
+
+u64 Sys_GetElapsedMicroseconds(u64 startTimestamp)
+{
+    u64 endTimestamp = Sys_GetTimestamp();
+    u64 cyclesElapsed = endTimestamp - startTimestamp;
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return ((cyclesElapsed * 1000000) / frequency.QuadPart);
+}
+
+u32 Sys_GetCoreCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return MAX(info.dwNumberOfProcessors, 1);
+}
+
+struct Thread
+{
+    HANDLE handle;
+    ThreadFunc function;
+    void* userData;
+};
+
+static DWORD WINAPI ThreadEntry(LPVOID param)
+{
+    Thread* thread = (Thread*)param;
+    thread->function(thread->userData);
+    FreeScratchArena();
+    return 0;
+}
+
+Thread* Sys_CreateThread(ThreadFunc function, void* userData)
+{
+    Thread* thread = (Thread*)malloc(sizeof(Thread));
+    if (thread == NULL)
+    {
+        Sys_FatalError("Sys_CreateThread: failed to allocate handle\n");
+    }
+
+    thread->function = function;
+    thread->userData = userData;
+    thread->handle = CreateThread(NULL, 0, ThreadEntry, thread, 0, NULL);
+    if (thread->handle == NULL)
+    {
+        Sys_FatalError("Sys_CreateThread: CreateThread failed\n");
+    }
+
+    return thread;
+}
+
+void Sys_JoinThread(Thread* thread)
+{
+    assert(thread != NULL);
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+s32 Sys_AtomicIncrement(volatile s32* value)
+{
+    return (s32)InterlockedIncrement((volatile LONG*)value);
+}
+
+s64 Sys_AtomicAdd64(volatile s64* value, s64 amount)
+{
+    return (s64)InterlockedExchangeAdd64((volatile LONG64*)value, amount) + amount;
+}
+
+// SRWLOCK_INIT is all zeros, which is what makes a zeroed Mutex usable as is
+static_assert(sizeof(SRWLOCK) == sizeof(Mutex), "Mutex must be able to hold a SRWLOCK");
+
+void Sys_LockMutex(Mutex* mutex)
+{
+    AcquireSRWLockExclusive((PSRWLOCK)&mutex->handle);
+}
+
+void Sys_UnlockMutex(Mutex* mutex)
+{
+    ReleaseSRWLockExclusive((PSRWLOCK)&mutex->handle);
+}
+
+Semaphore* Sys_CreateSemaphore(u32 initialCount)
+{
+    HANDLE handle = CreateSemaphoreA(NULL, (LONG)initialCount, LONG_MAX, NULL);
+    if (handle == NULL)
+    {
+        Sys_FatalError("Sys_CreateSemaphore: CreateSemaphore failed\n");
+    }
+
+    return (Semaphore*)handle;
+}
+
+void Sys_DestroySemaphore(Semaphore* semaphore)
+{
+    CloseHandle((HANDLE)semaphore);
+}
+
+void Sys_WaitSemaphore(Semaphore* semaphore)
+{
+    WaitForSingleObject((HANDLE)semaphore, INFINITE);
+}
+
+bool Sys_TryWaitSemaphore(Semaphore* semaphore)
+{
+    return WaitForSingleObject((HANDLE)semaphore, 0) == WAIT_OBJECT_0;
+}
+
+void Sys_SignalSemaphore(Semaphore* semaphore, u32 count)
+{
+    ReleaseSemaphore((HANDLE)semaphore, (LONG)count, NULL);
+}
+
+void Sys_YieldThread()
+{
+    SwitchToThread();
+}
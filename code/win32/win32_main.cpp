@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define WIN32_LEAN_AND_MEAN
 #include "../common/shared.h"
+#include "../common/asset_pack.h"
 #include <Windows.h>
 #include <hidusage.h>
 
@@ -143,31 +144,6 @@ LRESULT CALLBACK WAL_MainWindowCallback(HWND Window, UINT Message,
     return result;
 }
 
-u64 Sys_GetTimestamp()
-{
-    LARGE_INTEGER result;
-    QueryPerformanceCounter(&result);
-    return result.QuadPart;
-}
-
-u64 Sys_GetElapsedMilliseconds(u64 startTimestamp)
-{
-    u64 endTimestamp = Sys_GetTimestamp();
-    u64 cyclesElapsed = endTimestamp - startTimestamp;
-    LARGE_INTEGER frequency;
-    QueryPerformanceFrequency(&frequency);
-    return ((cyclesElapsed * 1000) / frequency.QuadPart);
-}
-
-u64 Sys_GetElapsedMicroseconds(u64 startTimestamp)
-{
-    u64 endTimestamp = Sys_GetTimestamp();
-    u64 cyclesElapsed = endTimestamp - startTimestamp;
-    LARGE_INTEGER frequency;
-    QueryPerformanceFrequency(&frequency);
-    return ((cyclesElapsed * 1000000) / frequency.QuadPart);
-}
-
 void Sys_Quit()
 {
     running = false;
@@ -292,10 +268,18 @@ static void WAL_ProcessPendingMessages(RawMouse* mouseInput, RawKeyboard* keyboa
     }
 }
 
-static void AllocateMemoryArenas(SystemMemory* memory, MemoryPools* state)
+// Writes the arena telemetry to the debugger output, to size the budgets from real runs.
+static void PrintArenaReports()
 {
-    AllocateArena(&state->persistent, (size_t)memory->permanentStorageSize, (u8*)memory->permanentStorage, "persistent arena");
-    AllocateArena(&state->transient, (size_t)memory->transientStorageSize, (u8*)memory->transientStorage, "transient arena");
+    ArenaReport reports[32];
+    const u32 numReports = GetTrackedArenaReports(reports, ARRAY_LEN(reports));
+    for (u32 i = 0; i < numReports; ++i)
+    {
+        const ArenaReport* r = &reports[i];
+        OutputDebugStringA(fmt("%s: high water %s of %s (%.1f%%), committed %s, %llu allocations, %.2f%% padding\n",
+            r->name, FormatBytes(r->highWater), FormatBytes(r->reserved), r->budgetUsage * 100.0f,
+            FormatBytes(r->committed), r->numAllocations, r->fragmentation * 100.0f));
+    }
 }
 
 int CALLBACK WinMain(HINSTANCE Instance,
@@ -347,18 +331,18 @@ int CALLBACK WinMain(HINSTANCE Instance,
             r_videoConfig.height = SCREEN_HEIGHT;
             r_videoConfig.width = SCREEN_WIDTH;
 
-            // Get memory from the system.
-            SystemMemory systemMemory = {};
-            systemMemory.permanentStorageSize = Megabytes(64);
-            systemMemory.permanentStorage = VirtualAlloc(0, systemMemory.permanentStorageSize,
-                MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-
-            systemMemory.transientStorageSize = Megabytes(64);
-            systemMemory.transientStorage = VirtualAlloc(0, systemMemory.transientStorageSize,
-                MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-
+            // Reserve address space, pages are committed as the arenas grow.
             MemoryPools memory;
-            AllocateMemoryArenas(&systemMemory, &memory);
+            AllocateVirtualArena(&memory.persistent, Gigabytes(1), "persistent arena");
+            AllocateVirtualArena(&memory.transient, Gigabytes(1), "transient arena");
+            TrackArena(&memory.persistent);
+            TrackArena(&memory.transient);
+
+            // without a pack, assets are loaded as loose files from ASSET_DIR
+            if (Asset_MountPack(ASSET_PACK_PATH))
+            {
+                OutputDebugStringA("mounted " ASSET_PACK_PATH "\n");
+            }
             S_Init(&memory);
 
             // Setup the imgui context
@@ -433,9 +417,11 @@ int CALLBACK WinMain(HINSTANCE Instance,
                 oldInput = temp;
             }
 
+            PrintArenaReports();
             R_ShutDown();
             ImGui_ImplWin32_Shutdown();
             ImGui::DestroyContext();
+            Asset_UnmountPack();
 
             rawInputDevices[0].dwFlags = RIDEV_REMOVE;
             rawInputDevices[0].hwndTarget = NULL;
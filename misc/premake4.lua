@@ -184,5 +184,22 @@ solution "Bachelor"
 		kind "ConsoleApp"
 		SetProjectOptions()
 
-		files { "../code/tools/mesh_baker/*.h", "../code/tools/mesh_baker/*.cpp", "../code/common/parsing.cpp", "../code/win32/win32_api.cpp", "../code/common/shared.cpp"}
-		--AddSourceFolders("../code", { "common", "ddx-kts", "imgui", "scene", "win32" })
\ No newline at end of file
+		files { "../code/tools/mesh_baker/*.h", "../code/tools/mesh_baker/*.cpp", "../code/common/parsing.cpp", "../code/common/string_intern.cpp", "../code/common/job_system.cpp", "../code/common/simd.cpp", "../code/win32/win32_api.cpp", "../code/common/shared.cpp"}
+		--AddSourceFolders("../code", { "common", "ddx-kts", "imgui", "scene", "win32" })
+	project "TextureBaker"
+		kind "ConsoleApp"
+		SetProjectOptions()
+
+		files { "../code/tools/texture_baker/*.h", "../code/tools/texture_baker/*.cpp", "../code/common/parsing.cpp", "../code/win32/win32_api.cpp", "../code/common/shared.cpp"}
+
+	project "AssetPacker"
+		kind "ConsoleApp"
+		SetProjectOptions()
+
+		files { "../code/tools/asset_packer/*.h", "../code/tools/asset_packer/*.cpp", "../code/common/asset_pack.cpp", "../code/common/async_io.cpp", "../code/common/job_system.cpp", "../code/common/parsing.cpp", "../code/win32/win32_api.cpp", "../code/common/shared.cpp"}
+
+	project "Benchmark"
+		kind "ConsoleApp"
+		SetProjectOptions()
+
+		files { "../code/tools/benchmark/*.h", "../code/tools/benchmark/*.cpp", "../code/common/parsing.cpp", "../code/common/string_intern.cpp", "../code/common/job_system.cpp", "../code/common/math.cpp", "../code/common/simd.cpp", "../code/renderer/r_texture_residency.cpp", "../code/renderer/r_voxel_cpu_voxelization.cpp", "../code/renderer/r_voxel_cpu_emittance.cpp", "../code/renderer/r_voxel_cpu_mip_downsample.cpp", "../code/renderer/r_voxel_cpu_voxelization_fix.cpp", "../code/renderer/r_voxel_cpu_cone_tracing.cpp", "../code/renderer/r_voxel_cpu_svo.cpp", "../code/renderer/r_voxel_cpu_clipmap.cpp", "../code/renderer/r_voxel_cpu_paged.cpp", "../code/renderer/r_voxel_cpu_occupancy.cpp", "../code/renderer/r_voxel_cpu_dirty.cpp", "../code/win32/win32_api.cpp", "../code/common/shared.cpp"}